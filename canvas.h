@@ -65,11 +65,22 @@ CANVAS_EXTERN_C_BEGIN
 #define MAX_CANVAS_TITLE 256
 #endif
 
+// frames a capture holds between readback and disk, frames beyond it are dropped
+#ifndef CANVAS_CAPTURE_QUEUE
+#define CANVAS_CAPTURE_QUEUE 8
+#endif
+
+// threads converting captured frames, per capture
+#ifndef CANVAS_CAPTURE_WORKERS
+#define CANVAS_CAPTURE_WORKERS 2
+#endif
+
 #include <stdbool.h>
 #include <stdint.h>
 #include <inttypes.h>
 #include <string.h>
 #include <stdlib.h>
+#include <stdio.h>
 #include <math.h>
 
 #if defined(_WIN32)
@@ -87,7 +98,6 @@ CANVAS_EXTERN_C_BEGIN
 
 #if CANVAS_VALIDATION > 0
 
-#include <stdio.h>
 #include <assert.h>
 #include <signal.h>
 #if !defined(_WIN32)
@@ -1033,8 +1043,21 @@ void canvas_pointer_release();
 int canvas(int64_t x, int64_t y, int64_t width, int64_t height, const char *title);
 int canvas_window(int64_t x, int64_t y, int64_t width, int64_t height, const char *title);
 
+typedef enum
+{
+    CANVAS_FORMAT_RGBA8,
+    CANVAS_FORMAT_BGRA8,
+    CANVAS_FORMAT_RGBA8_SRGB,
+    CANVAS_FORMAT_BGRA8_SRGB,
+    CANVAS_FORMAT_RGBA16F,
+} canvas_format;
+
+// renders into images instead of a window, works without a display server
+int canvas_offscreen(int64_t width, int64_t height, canvas_format format);
+
 int canvas_startup();
 int canvas_color(int window, const float color[4]);
+int canvas_set_render_scale(int window, float scale);
 int canvas_set(int window_id, int display, int64_t x, int64_t y, int64_t width, int64_t height, const char *title);
 
 int canvas_minimize(int window);
@@ -1062,6 +1085,7 @@ typedef enum
     CANVAS_BUFFER_INDEX,
     CANVAS_BUFFER_UNIFORM,
     CANVAS_BUFFER_STORAGE,
+    CANVAS_BUFFER_INDIRECT, // draw arguments and counts, also bindable as storage so shaders can write them
 } canvas_buffer_type;
 
 typedef enum
@@ -1069,6 +1093,7 @@ typedef enum
     CANVAS_BUFFER_STATIC,
     CANVAS_BUFFER_DYNAMIC,
     CANVAS_BUFFER_STAGING,
+    CANVAS_BUFFER_PER_FRAME, // dynamic, one slice per frame in flight so writes never race the gpu
 } canvas_buffer_usage;
 
 typedef struct
@@ -1081,6 +1106,19 @@ typedef struct
     int window_id;
 
     uint64_t memory;
+    uint64_t offset; // into memory, buffers share device memory blocks
+    int32_t _block;  // -1 for a dedicated allocation
+    uint32_t _node;
+
+    uint64_t upload; // token of the last upload into the buffer, see canvas_upload_done
+
+    size_t slice_size; // per-frame buffers: distance between slices, 0 otherwise
+
+    uint32_t heap;         // vulkan memory heap the buffer landed in
+    uint32_t memory_flags; // VkMemoryPropertyFlags of its memory type
+
+    size_t _dirty_begin; // non-coherent mappings: bytes written since the last flush
+    size_t _dirty_end;
 } canvas_buffer;
 
 canvas_buffer *canvas_buffer_create(int window_id, canvas_buffer_type type, canvas_buffer_usage usage, size_t size, void *initial_data);
@@ -1088,19 +1126,199 @@ void canvas_buffer_destroy(canvas_buffer *buf);
 
 void canvas_buffer_update(canvas_buffer *buf, void *data, size_t size, size_t offset);
 
+typedef struct
+{
+    size_t offset;
+    size_t size;
+    const void *data;
+} canvas_buffer_region;
+
+typedef struct
+{
+    canvas_buffer *buf;
+    size_t offset;
+    size_t size;
+    const void *data;
+} canvas_buffer_write;
+
+// many ranges in one go, adjacent ranges are merged and later ranges win where they overlap
+void canvas_buffer_update_regions(canvas_buffer *buf, const canvas_buffer_region *regions, uint32_t count);
+uint64_t canvas_upload_batch(const canvas_buffer_write *writes, uint32_t count);
+
 void *canvas_buffer_map(canvas_buffer *buf);
 void canvas_buffer_unmap(canvas_buffer *buf);
 
+// per-frame buffers: offset of the slice the next frame of the window reads, 0 for other buffers
+size_t canvas_buffer_frame_offset(canvas_buffer *buf);
+
+typedef struct
+{
+    void *platform_handle; // VkPipeline
+    void *layout;          // VkPipelineLayout, set 0 receives the storage bindings
+
+    uint64_t hash; // of the create info, equal requests share one pipeline
+    uint32_t refs;
+    bool compute;
+} canvas_pipeline;
+
+typedef enum
+{
+    CANVAS_VERTEX_FLOAT,
+    CANVAS_VERTEX_FLOAT2,
+    CANVAS_VERTEX_FLOAT3,
+    CANVAS_VERTEX_FLOAT4,
+    CANVAS_VERTEX_UBYTE4_NORM,
+    CANVAS_VERTEX_UINT,
+} canvas_vertex_format;
+
+typedef struct
+{
+    uint32_t stride;
+    bool per_instance;
+} canvas_vertex_binding;
+
+typedef struct
+{
+    uint32_t location;
+    uint32_t binding;
+    canvas_vertex_format format;
+    uint32_t offset;
+} canvas_vertex_attribute;
+
+typedef enum
+{
+    CANVAS_BLEND_NONE,
+    CANVAS_BLEND_ALPHA,
+    CANVAS_BLEND_PREMULTIPLIED,
+    CANVAS_BLEND_ADDITIVE,
+} canvas_blend_mode;
+
+typedef enum
+{
+    CANVAS_TOPOLOGY_TRIANGLES,
+    CANVAS_TOPOLOGY_TRIANGLE_STRIP,
+    CANVAS_TOPOLOGY_LINES,
+    CANVAS_TOPOLOGY_POINTS,
+} canvas_topology;
+
+typedef struct
+{
+    const uint32_t *vertex_spirv;
+    size_t vertex_size; // bytes
+    const uint32_t *fragment_spirv;
+    size_t fragment_size;
+    const char *vertex_entry; // "main" when NULL
+    const char *fragment_entry;
+
+    const canvas_vertex_binding *bindings;
+    uint32_t binding_count;
+    const canvas_vertex_attribute *attributes;
+    uint32_t attribute_count;
+
+    canvas_topology topology;
+    canvas_blend_mode blend;
+    bool cull_back;
+    bool depth_test; // only with a depth attachment
+    bool depth_write;
+} canvas_pipeline_desc;
+
+// built for the window's color format, repeated requests return the same pipeline
+canvas_pipeline *canvas_pipeline_create(int window, const canvas_pipeline_desc *desc);
+void canvas_pipeline_destroy(canvas_pipeline *pipeline);
+
+// same layout as graphics pipelines, storage bindings in set 0, entry "main" when NULL
+canvas_pipeline *canvas_compute_pipeline_create(const uint32_t *spirv, size_t size, const char *entry);
+
+// appended to the buffer's window during the update callback, replayed into its next frame
 void canvas_buffer_bind_vertex(canvas_buffer *buf, uint32_t binding);
-void canvas_buffer_bind_index(canvas_buffer *buf);
+void canvas_buffer_bind_index(canvas_buffer *buf); // 32 bit indices
 void canvas_buffer_bind_storage(canvas_buffer *buf, uint32_t binding);
 
+void canvas_set_pipeline(int window, canvas_pipeline *pipeline);
+void canvas_draw(int window, uint32_t vertex_count, uint32_t first_vertex);
+void canvas_draw_indexed(int window, uint32_t index_count, uint32_t first_index, int32_t vertex_offset);
+
+// runs ahead of the frame's draws with the storage buffers bound before it, results are visible to the draws
+void canvas_dispatch(int window, canvas_pipeline *pipeline, uint32_t x, uint32_t y, uint32_t z);
+
+void canvas_draw_instanced(int window, uint32_t vertex_count, uint32_t instance_count, uint32_t first_vertex, uint32_t first_instance);
+void canvas_draw_indexed_instanced(int window, uint32_t index_count, uint32_t instance_count, uint32_t first_index, int32_t vertex_offset, uint32_t first_instance);
+
+// layouts of the argument records read from indirect buffers, same as VkDrawIndirectCommand and VkDrawIndexedIndirectCommand
+typedef struct
+{
+    uint32_t vertex_count;
+    uint32_t instance_count;
+    uint32_t first_vertex;
+    uint32_t first_instance;
+} canvas_draw_arguments;
+
+typedef struct
+{
+    uint32_t index_count;
+    uint32_t instance_count;
+    uint32_t first_index;
+    int32_t vertex_offset;
+    uint32_t first_instance;
+} canvas_draw_indexed_arguments;
+
+// draw_count records, stride bytes apart (0 for tightly packed), starting at offset into args
+void canvas_draw_indirect(int window, canvas_buffer *args, size_t offset, uint32_t draw_count, uint32_t stride);
+void canvas_draw_indexed_indirect(int window, canvas_buffer *args, size_t offset, uint32_t draw_count, uint32_t stride);
+
+// the number of records is read on the gpu from a uint32_t in count, at most max_draws
+bool canvas_draw_indirect_count_supported(void);
+void canvas_draw_indirect_count(int window, canvas_buffer *args, size_t offset, canvas_buffer *count, size_t count_offset, uint32_t max_draws, uint32_t stride);
+void canvas_draw_indexed_indirect_count(int window, canvas_buffer *args, size_t offset, canvas_buffer *count, size_t count_offset, uint32_t max_draws, uint32_t stride);
+
+// rgba8 pixels in a storage buffer, sampled nearest by canvas_sprite
+typedef struct
+{
+    canvas_buffer *pixels; // width and height as uint32_t, then the texels row by row
+    uint32_t width;
+    uint32_t height;
+} canvas_image;
+
+canvas_image *canvas_image_create(int window, uint32_t width, uint32_t height, const void *rgba);
+void canvas_image_destroy(canvas_image *image);
+
+// batched 2D quads in window pixels, drawn over the frame's draw stream, color NULL is white
+void canvas_rect(int window, float x, float y, float width, float height, const float color[4]);
+void canvas_line(int window, float x0, float y0, float x1, float y1, float thickness, const float color[4]);
+void canvas_sprite(int window, canvas_image *image, float x, float y, float width, float height, const float uv[4], const float color[4]);
+
+// blend mode of the following 2D primitives, CANVAS_BLEND_ALPHA until changed
+void canvas_blend(int window, canvas_blend_mode mode);
+
+// let the frame's 2D primitives be regrouped by image and blend mode, for content that does not overlap
+void canvas_batch_reorder(int window, bool allow);
+
+typedef struct
+{
+    uint64_t block_count;
+    uint64_t block_bytes;     // device memory reserved in blocks
+    uint64_t used_bytes;      // handed out from blocks, including power of two rounding
+    uint64_t requested_bytes; // asked for by buffers placed in blocks
+    uint64_t allocation_count;
+    uint64_t dedicated_count; // too large for a block, one device allocation each
+    uint64_t dedicated_bytes;
+    uint64_t largest_free;   // largest contiguous free range in any block
+    float fragmentation;     // 1 - largest_free / free bytes
+} canvas_memory_stats;
+
+int canvas_gpu_memory_stats(canvas_memory_stats *stats);
+
+// uploads are queued and return at once, tokens order them
+bool canvas_upload_done(uint64_t token);
+int canvas_upload_wait(uint64_t token, uint64_t timeout_ns);
+
 void canvas_main_loop();
 int _canvas_platform();
 int _canvas_update();
 int _canvas_window(int64_t x, int64_t y, int64_t width, int64_t height, const char *title);
 int _canvas_gpu_init();
 int _canvas_gpu_new_window(int window_id);
+int _canvas_gpu_new_offscreen(int window_id, canvas_format format);
 int _canvas_window_resize(int window_id);
 int _canvas_primary_display_index();
 
@@ -1114,6 +1332,85 @@ typedef struct
     float x, y, z;
 } canvas_vec3;
 
+typedef enum
+{
+    CANVAS_PRESENT_FIFO = 0,
+    CANVAS_PRESENT_FIFO_RELAXED,
+    CANVAS_PRESENT_MAILBOX,
+    CANVAS_PRESENT_IMMEDIATE,
+} canvas_present_mode;
+
+int canvas_set_present_mode(int window, canvas_present_mode mode);
+
+typedef struct
+{
+    uint64_t presented;
+    uint64_t skipped; // image or frame fence not ready within CANVAS_ACQUIRE_TIMEOUT
+    uint64_t recorded;
+    uint64_t reused; // submitted without re-recording
+    uint64_t resize_requests;
+    uint64_t recreated; // swapchain recreations, at most one per frame
+    uint32_t recreations_per_second;
+    uint64_t submitted; // last frame number handed to the gpu
+    uint64_t draws;
+    uint64_t binds_skipped; // redundant state changes dropped while replaying draw commands
+    uint64_t primitives;    // 2D quads drawn by the batcher
+} canvas_frame_stats;
+
+// blocks until frame number `frame` (see stats.submitted) of the window has finished on the gpu
+int canvas_frame_wait(int window, uint64_t frame, uint64_t timeout_ns);
+
+// a frame copied into host memory by the gpu, see canvas_readback_request
+typedef struct
+{
+    int window;
+    uint32_t width;
+    uint32_t height;
+    size_t row_pitch;     // bytes between rows, rows are tightly packed
+    canvas_format format; // byte order of the pixels, the window's color format
+    uint64_t frame;       // frame number that was copied (see stats.submitted), 0 until it is recorded
+    const void *pixels;   // set once the copy has finished, valid until released
+
+    canvas_buffer *_buffer; // kept by the slot across releases, regrown when the window grows
+    bool _used;
+} canvas_readback;
+
+// copies the window's next frame once its draws are done, NULL when it can't be read or every slot is taken
+canvas_readback *canvas_readback_request(int window);
+
+// true once the copy has finished on the gpu, never blocks
+bool canvas_readback_poll(canvas_readback *readback);
+
+// blocks until the copy has finished, CANVAS_INVALID while its frame was not submitted yet
+int canvas_readback_wait(canvas_readback *readback, uint64_t timeout_ns);
+
+// hands the slot back to the window's ring, pixels are no longer valid
+void canvas_readback_release(canvas_readback *readback);
+
+typedef enum
+{
+    CANVAS_CAPTURE_Y4M, // one raw YUV 4:4:4 stream, path is the file
+    CANVAS_CAPTURE_QOI, // one image per frame, path is the prefix of the numbered files
+    CANVAS_CAPTURE_PNG,
+} canvas_capture_format;
+
+typedef struct
+{
+    uint64_t requested; // frames a readback was requested for
+    uint64_t captured;  // readbacks that finished and went to the workers
+    uint64_t written;
+    uint64_t dropped; // queue or readback slots full, failed writes, y4m frames after a resize
+    uint64_t bytes;   // written to disk
+    uint32_t queued;  // frames between readback and disk right now, at most CANVAS_CAPTURE_QUEUE
+} canvas_capture_stats;
+
+// records every frame of the window from the next one on, conversion and writes run on their own threads
+int canvas_capture_start(int window, canvas_capture_format format, const char *path, uint32_t fps);
+
+// drops frames still on the gpu and blocks until the queued ones are on disk
+int canvas_capture_stop(int window);
+int canvas_capture_status(int window, canvas_capture_stats *stats);
+
 typedef struct
 {
 #if CANVAS_VALIDATION >= 5
@@ -1124,8 +1421,12 @@ typedef struct
 
     bool resize, close, titlebar, os_moved, os_resized;
     bool minimized, maximized, fullscreen, vsync, _valid;
+    bool offscreen; // no window or surface, see canvas_offscreen
 
     float clear[4];
+    float render_scale;
+    canvas_present_mode present_mode;
+    canvas_frame_stats stats;
     char title[MAX_CANVAS_TITLE];
     canvas_window_handle window;
     canvas_update_callback update;
@@ -1161,6 +1462,7 @@ typedef struct
 #define CANVAS_ERR_GET_GPU -35
 #define CANVAS_ERR_GET_PLATFORM -36
 #define CANVAS_ERR_INVALID_SIZE -37
+#define CANVAS_ERR_UNSUPPORTED -38
 
 #ifdef KEY_EXECUTE
 #undef KEY_EXECUTE
@@ -1514,6 +1816,7 @@ typedef struct
     uint64_t _canary_head;
 #endif
     bool init, init_gpu, init_post, os_timed, auto_exit, quit, display_changed;
+    bool headless; // startup goes on without a display server, only offscreen canvases render
     int display_count, limit_fps, highest_refresh_rate;
 
     canvas_type canvas[MAX_CANVAS];
@@ -2404,6 +2707,9 @@ void canvas_library_close(void *lib)
 #endif
 }
 
+// frames the cpu records ahead of the gpu, per-frame buffers hold one slice for each
+#define MAX_FRAMES_IN_FLIGHT 2
+
 #if defined(__APPLE__)
 
 #include <TargetConditionals.h>
@@ -2442,6 +2748,7 @@ typedef struct
 {
     objc_id view;
     objc_id layer;
+    objc_id frame_command_buffers[MAX_FRAMES_IN_FLIGHT]; // retained, the newest frames indexed by frame number
     double scale;
     int saved_x, saved_y, saved_width, saved_height;
     unsigned long saved_style_mask;
@@ -2682,6 +2989,11 @@ typedef enum
     MTLStoreActionStore = 1,
 } MTLStoreAction;
 
+typedef enum
+{
+    MTLCommandBufferStatusCompleted = 4,
+} MTLCommandBufferStatus;
+
 static inline _CGRect make_rect(double x, double y, double w, double h)
 {
     _CGRect r = {x, y, w, h};
@@ -2771,14 +3083,50 @@ _canvas_platform_windows canvas_win32;
 #define CANVAS_VULKAN
 
 #include <time.h>
+#include <poll.h>
 
 struct wl_display;
 struct wl_registry;
 struct wl_compositor;
 struct wl_surface;
-struct wl_interface;
+struct wl_output;
 struct wl_proxy;
 
+struct wl_message
+{
+    const char *name;
+    const char *signature;
+    const struct wl_interface **types;
+};
+
+struct wl_interface
+{
+    const char *name;
+    int version;
+    int method_count;
+    const struct wl_message *methods;
+    int event_count;
+    const struct wl_message *events;
+};
+
+#define WL_MARSHAL_FLAG_DESTROY (1 << 0)
+#define WL_OUTPUT_MODE_CURRENT 0x1
+
+typedef struct
+{
+    struct wl_proxy *output;
+    struct wl_proxy *xdg_output;
+    uint32_t name;
+    uint32_t version;
+    int32_t x, y;
+    int32_t mode_width, mode_height;
+    int32_t logical_x, logical_y;
+    int32_t logical_width, logical_height;
+    int32_t scale;
+    int32_t refresh_mhz;
+    bool has_logical;
+} _canvas_wl_output;
+
 typedef struct _XDisplay Display;
 typedef unsigned long Window;
 typedef unsigned long Atom;
@@ -2797,22 +3145,34 @@ static struct
     struct wl_display *(*wl_display_connect)(const char *);
     void (*wl_display_disconnect)(struct wl_display *);
     int (*wl_display_dispatch)(struct wl_display *);
+    int (*wl_display_dispatch_pending)(struct wl_display *);
     int (*wl_display_roundtrip)(struct wl_display *);
-    void *(*wl_display_get_registry)(struct wl_display *);
-    void *(*wl_registry_bind)(struct wl_registry *, uint32_t, const struct wl_interface *, uint32_t);
-    int (*wl_registry_add_listener)(struct wl_registry *, const void *, void *);
-    void (*wl_registry_destroy)(struct wl_registry *);
-    struct wl_surface *(*wl_compositor_create_surface)(struct wl_compositor *);
-    void (*wl_surface_destroy)(struct wl_surface *);
-    void (*wl_compositor_destroy)(struct wl_compositor *);
+    int (*wl_display_flush)(struct wl_display *);
+    int (*wl_display_get_fd)(struct wl_display *);
+    int (*wl_display_prepare_read)(struct wl_display *);
+    int (*wl_display_read_events)(struct wl_display *);
+    void (*wl_display_cancel_read)(struct wl_display *);
+    struct wl_proxy *(*wl_proxy_marshal_flags)(struct wl_proxy *, uint32_t, const struct wl_interface *, uint32_t, uint32_t, ...);
+    int (*wl_proxy_add_listener)(struct wl_proxy *, void (**)(void), void *);
+    uint32_t (*wl_proxy_get_version)(struct wl_proxy *);
     void (*wl_proxy_destroy)(struct wl_proxy *);
 
+    const struct wl_interface *wl_registry_interface;
     const struct wl_interface *wl_compositor_interface;
+    const struct wl_interface *wl_surface_interface;
+    const struct wl_interface *wl_output_interface;
+
     struct wl_display *display;
     struct wl_registry *registry;
     struct wl_compositor *compositor;
     struct wl_shm *shm;
     struct xdg_wm_base *xdg_wm_base;
+    struct wl_proxy *xdg_output_manager;
+    struct wl_proxy *viewporter;
+    struct wl_proxy *fractional_scale_manager;
+
+    _canvas_wl_output outputs[MAX_DISPLAYS];
+    int output_count;
 } wl;
 
 typedef struct
@@ -2997,6 +3357,7 @@ static struct
     {                                                   \
         CANVAS_ERR("loading " #name ": %s", dlerror()); \
         dlclose(wl.library);                            \
+        wl.library = NULL;                              \
         return CANVAS_ERR_LOAD_SYMBOL;                  \
     }
 
@@ -3092,6 +3453,10 @@ typedef struct
 
     bool client_set;
     int saved_x, saved_y, saved_width, saved_height;
+
+    struct wl_proxy *wl_viewport;
+    struct wl_proxy *wl_fractional_scale;
+    uint32_t wl_preferred_scale; // 1/120 units
 } canvas_data;
 
 typedef struct
@@ -3191,8 +3556,80 @@ bool _canvas_using_wayland = false;
 
 canvas_data _canvas_data[MAX_CANVAS];
 
+static void _canvas_wayland_surface_scale_init(int window_id);
+static float _canvas_wayland_buffer_scale(int window_id);
+static void _canvas_wayland_set_destination(int window_id);
+static void _canvas_wayland_surface_scale_destroy(int window_id);
+
 #endif
 
+// written by the cpu through a persistent mapping
+static inline bool _canvas_buffer_host_written(canvas_buffer_usage usage)
+{
+    return usage == CANVAS_BUFFER_DYNAMIC || usage == CANVAS_BUFFER_PER_FRAME;
+}
+
+canvas_image *canvas_image_create(int window_id, uint32_t width, uint32_t height, const void *rgba)
+{
+    CANVAS_ENTER_FUNC();
+    CANVAS_ASSERT_NOT_NULL(rgba);
+
+    if (!rgba || width == 0 || height == 0)
+    {
+        CANVAS_RETURN_ERR(NULL, "image needs a size and pixels\n");
+    }
+
+    size_t size = 2 * sizeof(uint32_t) + (size_t)width * height * 4;
+    uint32_t *data = (uint32_t *)malloc(size);
+    canvas_image *image = (canvas_image *)calloc(1, sizeof(canvas_image));
+    if (!data || !image)
+    {
+        free(data);
+        free(image);
+        CANVAS_RETURN(NULL);
+    }
+
+    data[0] = width;
+    data[1] = height;
+    memcpy(data + 2, rgba, size - 2 * sizeof(uint32_t));
+
+    image->pixels = canvas_buffer_create(window_id, CANVAS_BUFFER_STORAGE, CANVAS_BUFFER_STATIC, size, data);
+    image->width = width;
+    image->height = height;
+    free(data);
+
+    if (!image->pixels)
+    {
+        free(image);
+        CANVAS_RETURN(NULL);
+    }
+
+    CANVAS_RETURN(image);
+}
+
+void canvas_image_destroy(canvas_image *image)
+{
+    if (!image)
+        return;
+
+    canvas_buffer_destroy(image->pixels);
+    free(image);
+}
+
+static inline uint32_t _canvas_pack_color(const float color[4])
+{
+    if (!color)
+        return 0xffffffffu;
+
+    uint32_t packed = 0;
+    for (int i = 0; i < 4; i++)
+    {
+        float c = color[i] < 0.0f ? 0.0f : (color[i] > 1.0f ? 1.0f : color[i]);
+        packed |= (uint32_t)(c * 255.0f + 0.5f) << (i * 8);
+    }
+    return packed;
+}
+
 #ifdef CANVAS_VULKAN
 
 #include <vulkan/vulkan.h>
@@ -3215,8 +3652,68 @@ typedef unsigned long VisualID;
 #define VK_USE_PLATFORM_METAL_EXT
 #endif
 
-#define MAX_FRAMES_IN_FLIGHT 2
 #define MAX_SWAPCHAIN_IMAGES 3
+#define MAX_RETIRED_SWAPCHAINS 4
+
+// buffers are sub-allocated from blocks of this size (power of two), larger ones get their own memory
+#ifndef CANVAS_VK_BLOCK_SIZE
+#define CANVAS_VK_BLOCK_SIZE (64ULL << 20)
+#endif
+
+#ifndef CANVAS_VK_MAX_BLOCKS
+#define CANVAS_VK_MAX_BLOCKS 64
+#endif
+
+#define CANVAS_VK_MIN_ALLOC 256ULL
+
+// persistent staging ring that buffer uploads are copied through
+#ifndef CANVAS_VK_STAGING_SIZE
+#define CANVAS_VK_STAGING_SIZE (16ULL << 20)
+#endif
+
+#define CANVAS_VK_UPLOAD_BATCHES 8
+
+#define CANVAS_VK_MAX_VERTEX_BINDINGS 16
+#define CANVAS_VK_STORAGE_BINDINGS 8
+#define CANVAS_VK_DESCRIPTOR_SETS 256 // per swapchain image and recording
+#define CANVAS_VK_PUSH_CONSTANTS 128    // the minimum every device supports
+#define CANVAS_VK_BATCH_RING_MIN (64 * 1024)
+#define CANVAS_VK_READBACKS 4 // per window, requested and not released yet
+
+// nanoseconds a window may hold up the frame before it is skipped, defaults to blocking on vsync
+#ifndef CANVAS_ACQUIRE_TIMEOUT
+#define CANVAS_ACQUIRE_TIMEOUT UINT64_MAX
+#endif
+
+// milliseconds a live resize keeps presenting the old swapchain stretched before recreating, 0 disables
+#ifndef CANVAS_RESIZE_SETTLE_MS
+#define CANVAS_RESIZE_SETTLE_MS 0
+#endif
+
+// per-window timeline semaphores on 1.2+ replace the frame and image fences, 0 forces fences
+#ifndef CANVAS_VULKAN_TIMELINE
+#define CANVAS_VULKAN_TIMELINE 1
+#endif
+
+// render straight into swapchain views on 1.3 / VK_KHR_dynamic_rendering, 0 forces render passes
+#ifndef CANVAS_VULKAN_DYNAMIC_RENDERING
+#define CANVAS_VULKAN_DYNAMIC_RENDERING 1
+#endif
+
+// mapped buffers prefer cached non-coherent memory, written bytes are flushed at submit
+#ifndef CANVAS_VULKAN_CACHED_MAPPING
+#define CANVAS_VULKAN_CACHED_MAPPING 0
+#endif
+
+// keep compiled pipelines in $XDG_CACHE_HOME (or ~/.cache) between runs
+#ifndef CANVAS_VULKAN_PIPELINE_CACHE
+#define CANVAS_VULKAN_PIPELINE_CACHE 1
+#endif
+
+// run dispatches on a compute-only queue family when there is one, they may overlap the previous frame's draws
+#ifndef CANVAS_VULKAN_ASYNC_COMPUTE
+#define CANVAS_VULKAN_ASYNC_COMPUTE 0
+#endif
 
 #if defined(_WIN32)
 #define canvas_vulkan_names 1
@@ -3270,14 +3767,33 @@ static struct
 
     VkInstance instance;
     VkPhysicalDevice physical_device;
+    VkPhysicalDeviceMemoryProperties memory_properties;
+    bool host_visible_vram; // all of vram is mappable (UMA or resizable BAR)
+    VkDescriptorSetLayout storage_set_layout; // CANVAS_VK_STORAGE_BINDINGS storage buffers, set 0 of canvas pipelines
+    uint8_t pipeline_cache_uuid[VK_UUID_SIZE];
+    uint32_t driver_version;
+    VkDeviceSize non_coherent_atom;
     VkDevice device;
     VkQueue graphics_queue;
     VkQueue present_queue;
     int graphics_family;
     int present_family;
+    int transfer_family; // graphics_family when there is no separate transfer queue
+    VkQueue transfer_queue;
+    int compute_family; // graphics_family unless async compute found its own family
+    VkQueue compute_queue;
     bool validation_enabled;
     VkDebugUtilsMessengerEXT debug_messenger;
 
+    uint32_t api_version;
+    bool swapchain; // VK_KHR_swapchain, only missing on a device picked for offscreen canvases
+    bool dynamic_rendering;
+    bool timeline;
+    bool multi_draw_indirect;
+    bool draw_indirect_first_instance;
+    bool draw_indirect_count; // VK_KHR_draw_indirect_count
+    uint32_t max_draw_indirect_count;
+
     PFN_vkGetInstanceProcAddr vkGetInstanceProcAddr;
     PFN_vkGetDeviceProcAddr vkGetDeviceProcAddr;
     PFN_vkCreateInstance vkCreateInstance;
@@ -3288,8 +3804,10 @@ static struct
     PFN_vkGetPhysicalDeviceProperties vkGetPhysicalDeviceProperties;
     PFN_vkGetPhysicalDeviceFeatures vkGetPhysicalDeviceFeatures;
     PFN_vkGetPhysicalDeviceMemoryProperties vkGetPhysicalDeviceMemoryProperties;
+    PFN_vkGetPhysicalDeviceFormatProperties vkGetPhysicalDeviceFormatProperties;
     PFN_vkEnumerateInstanceLayerProperties vkEnumerateInstanceLayerProperties;
     PFN_vkEnumerateInstanceExtensionProperties vkEnumerateInstanceExtensionProperties;
+    PFN_vkEnumerateInstanceVersion vkEnumerateInstanceVersion;
 
     PFN_vkCreateDevice vkCreateDevice;
     PFN_vkDestroyDevice vkDestroyDevice;
@@ -3329,10 +3847,15 @@ static struct
 
     PFN_vkCreateSemaphore vkCreateSemaphore;
     PFN_vkDestroySemaphore vkDestroySemaphore;
+    PFN_vkWaitSemaphores vkWaitSemaphores;
+    PFN_vkGetSemaphoreCounterValue vkGetSemaphoreCounterValue;
     PFN_vkCreateFence vkCreateFence;
     PFN_vkDestroyFence vkDestroyFence;
     PFN_vkWaitForFences vkWaitForFences;
     PFN_vkResetFences vkResetFences;
+    PFN_vkGetFenceStatus vkGetFenceStatus;
+    PFN_vkFlushMappedMemoryRanges vkFlushMappedMemoryRanges;
+    PFN_vkInvalidateMappedMemoryRanges vkInvalidateMappedMemoryRanges;
 
     PFN_vkQueueSubmit vkQueueSubmit;
     PFN_vkQueueWaitIdle vkQueueWaitIdle;
@@ -3349,10 +3872,44 @@ static struct
     PFN_vkGetBufferMemoryRequirements vkGetBufferMemoryRequirements;
     PFN_vkBindBufferMemory vkBindBufferMemory;
     PFN_vkCmdCopyBuffer vkCmdCopyBuffer;
+    PFN_vkCmdCopyImageToBuffer vkCmdCopyImageToBuffer;
 
     PFN_vkCmdBeginRenderPass vkCmdBeginRenderPass;
     PFN_vkCmdEndRenderPass vkCmdEndRenderPass;
+    PFN_vkCmdBeginRendering vkCmdBeginRendering;
+    PFN_vkCmdEndRendering vkCmdEndRendering;
     PFN_vkCmdPipelineBarrier vkCmdPipelineBarrier;
+    PFN_vkCreateDescriptorSetLayout vkCreateDescriptorSetLayout;
+    PFN_vkDestroyDescriptorSetLayout vkDestroyDescriptorSetLayout;
+    PFN_vkCreatePipelineLayout vkCreatePipelineLayout;
+    PFN_vkDestroyPipelineLayout vkDestroyPipelineLayout;
+    PFN_vkCreateDescriptorPool vkCreateDescriptorPool;
+    PFN_vkDestroyDescriptorPool vkDestroyDescriptorPool;
+    PFN_vkResetDescriptorPool vkResetDescriptorPool;
+    PFN_vkAllocateDescriptorSets vkAllocateDescriptorSets;
+    PFN_vkUpdateDescriptorSets vkUpdateDescriptorSets;
+    PFN_vkCmdBindPipeline vkCmdBindPipeline;
+    PFN_vkCmdBindVertexBuffers vkCmdBindVertexBuffers;
+    PFN_vkCmdBindIndexBuffer vkCmdBindIndexBuffer;
+    PFN_vkCmdBindDescriptorSets vkCmdBindDescriptorSets;
+    PFN_vkCmdSetViewport vkCmdSetViewport;
+    PFN_vkCmdSetScissor vkCmdSetScissor;
+    PFN_vkCmdDraw vkCmdDraw;
+    PFN_vkCmdDrawIndexed vkCmdDrawIndexed;
+    PFN_vkCmdPushConstants vkCmdPushConstants;
+    PFN_vkCmdDrawIndirect vkCmdDrawIndirect;
+    PFN_vkCmdDispatch vkCmdDispatch;
+    PFN_vkCreateComputePipelines vkCreateComputePipelines;
+    PFN_vkCmdDrawIndexedIndirect vkCmdDrawIndexedIndirect;
+    PFN_vkCmdDrawIndirectCount vkCmdDrawIndirectCount;
+    PFN_vkCmdDrawIndexedIndirectCount vkCmdDrawIndexedIndirectCount;
+    PFN_vkCreateShaderModule vkCreateShaderModule;
+    PFN_vkDestroyShaderModule vkDestroyShaderModule;
+    PFN_vkCreateGraphicsPipelines vkCreateGraphicsPipelines;
+    PFN_vkDestroyPipeline vkDestroyPipeline;
+    PFN_vkCreatePipelineCache vkCreatePipelineCache;
+    PFN_vkDestroyPipelineCache vkDestroyPipelineCache;
+    PFN_vkGetPipelineCacheData vkGetPipelineCacheData;
 
     PFN_vkCreateImage vkCreateImage;
     PFN_vkDestroyImage vkDestroyImage;
@@ -3380,6 +3937,136 @@ typedef struct
     uint32_t present_mode_count;
 } SwapchainSupportDetails;
 
+// what a cached command buffer was recorded with
+typedef struct
+{
+    float clear[4];
+    VkExtent2D extent;
+    uint32_t render_pass_version;
+    uint64_t commands_hash;
+    bool valid;
+} canvas_vk_command_key;
+
+typedef enum
+{
+    CANVAS_VK_CMD_PIPELINE,
+    CANVAS_VK_CMD_VERTEX,
+    CANVAS_VK_CMD_INDEX,
+    CANVAS_VK_CMD_STORAGE,
+    CANVAS_VK_CMD_DRAW,
+    CANVAS_VK_CMD_DRAW_INDEXED,
+    CANVAS_VK_CMD_DRAW_INDIRECT,
+    CANVAS_VK_CMD_DRAW_INDEXED_INDIRECT,
+    CANVAS_VK_CMD_DISPATCH,
+} canvas_vk_command_type;
+
+// one fixed size entry of a window's draw stream, zeroed before it is filled so streams hash byte for byte
+typedef struct
+{
+    uint32_t type;
+    uint32_t slot;
+    union
+    {
+        struct
+        {
+            VkPipeline pipeline;
+            VkPipelineLayout layout;
+        } pipeline;
+        struct
+        {
+            VkBuffer buffer;
+            VkDeviceSize offset;
+            VkDeviceSize range;
+        } buffer;
+        struct
+        {
+            uint32_t count;
+            uint32_t first;
+            int32_t vertex_offset;
+            uint32_t instance_count;
+            uint32_t first_instance;
+        } draw;
+        struct
+        {
+            VkBuffer buffer;
+            VkDeviceSize offset;
+            VkBuffer count_buffer; // null for a fixed draw_count
+            VkDeviceSize count_offset;
+            uint32_t draw_count; // max draws with a count buffer
+            uint32_t stride;
+        } indirect;
+        struct
+        {
+            VkPipeline pipeline;
+            VkPipelineLayout layout;
+            uint32_t x, y, z;
+        } dispatch;
+    };
+} canvas_vk_command;
+
+// one 2D primitive, a parallelogram drawn as a 4 vertex strip per instance
+typedef struct
+{
+    float origin[2];
+    float axis_x[2];
+    float axis_y[2];
+    float uv[4];    // u0 v0 u1 v1, negative when untextured
+    uint32_t color; // rgba8
+} canvas_vk_quad;
+
+// consecutive quads sharing an image and blend mode
+typedef struct
+{
+    VkBuffer image; // null for untextured quads, which fit with any image
+    uint32_t blend;
+    uint32_t first;
+    uint32_t count;
+} canvas_vk_batch_run;
+
+typedef struct
+{
+    canvas_vk_quad *quads;
+    uint32_t quad_count;
+    uint32_t quad_capacity;
+
+    canvas_vk_batch_run *runs;
+    canvas_buffer_region *regions;
+    uint32_t run_count;
+    uint32_t run_capacity;
+
+    canvas_buffer *ring; // per-frame vertex buffer the quads are copied into when the frame is recorded
+    canvas_pipeline *pipelines[CANVAS_BLEND_ADDITIVE + 1];
+    VkFormat pipeline_format;
+    canvas_image *white; // bound for untextured runs
+    canvas_blend_mode blend;
+    bool reorder;
+} canvas_vk_batch;
+
+// a replaced swapchain and everything built on it, freed once no submit can still use it and a newer one was retired
+typedef struct
+{
+    VkSwapchainKHR swapchain;
+    VkImageView image_views[MAX_SWAPCHAIN_IMAGES];
+    VkFramebuffer framebuffers[MAX_SWAPCHAIN_IMAGES];
+    VkCommandBuffer command_buffers[MAX_SWAPCHAIN_IMAGES];
+    VkDescriptorPool descriptor_pools[MAX_SWAPCHAIN_IMAGES];
+    uint32_t image_count;
+    uint64_t retire_frame; // device submit index, or the window's timeline value
+} canvas_vk_retired;
+
+// a destroyed buffer whose memory waits for the frames that bound it
+typedef struct
+{
+    VkBuffer buffer;
+    VkDeviceMemory memory;
+    int32_t block;
+    uint32_t node;
+    bool mapped;
+    VkDeviceSize requested;
+    VkDeviceSize size;
+    uint64_t retire_frame; // as in canvas_vk_retired
+} canvas_vk_dead_buffer;
+
 typedef struct
 {
     VkFence submit_frame;
@@ -3399,22 +4086,70 @@ typedef struct
     uint32_t swapchain_image_count;
     VkFormat swapchain_format;
     VkExtent2D swapchain_extent;
+    VkPresentModeKHR present_mode;
 
     VkCommandPool command_pool;
     VkCommandBuffer command_buffers[MAX_SWAPCHAIN_IMAGES];
+    canvas_vk_command_key command_keys[MAX_SWAPCHAIN_IMAGES];
+
+    // draw commands appended during the update callback, replayed into the frame's command buffer
+    canvas_vk_command *commands;
+    uint32_t command_count;
+    uint32_t command_capacity;
+
+    // the stream each image was last recorded from, a hash match is confirmed against it
+    canvas_vk_command *recorded[MAX_SWAPCHAIN_IMAGES];
+    uint32_t recorded_count[MAX_SWAPCHAIN_IMAGES];
+    uint32_t recorded_capacity[MAX_SWAPCHAIN_IMAGES];
+    VkDescriptorPool descriptor_pools[MAX_SWAPCHAIN_IMAGES]; // storage bindings, reset when the image is recorded
+
+    canvas_vk_batch batch;
+
+    // copies into host memory, recorded after the draws of the frame that follows the request
+    bool readable; // color images allow transfer reads
+    canvas_readback readbacks[CANVAS_VK_READBACKS];
+    uint32_t readback_pending;
 
     VkSemaphore image_available_semaphores[MAX_SWAPCHAIN_IMAGES];
     VkSemaphore render_finished_semaphores[MAX_SWAPCHAIN_IMAGES];
-    VkFence in_flight_fences[MAX_FRAMES_IN_FLIGHT];
-    VkFence images_in_flight[MAX_SWAPCHAIN_IMAGES];
     uint32_t current_frame;
 
+    // timeline path: signalled with the frame number once a submit finishes
+    VkSemaphore timeline;
+    uint64_t timeline_value;
+    uint64_t image_values[MAX_SWAPCHAIN_IMAGES];
+
+    // fence path: frame n signals frame_fences[n % MAX_FRAMES_IN_FLIGHT], standing in for the timeline
+    VkFence frame_fences[MAX_FRAMES_IN_FLIGHT];
+
     VkImage depth_image;
     VkDeviceMemory depth_memory;
     VkImageView depth_view;
+    VkFormat depth_format; // undefined without a depth attachment
+
+    // offscreen canvases own their color images, one per frame in flight, in place of a swapchain
+    bool offscreen;
+    VkDeviceMemory offscreen_memory[MAX_SWAPCHAIN_IMAGES];
 
     VkRenderPass render_pass;
+    uint32_t render_pass_version;
+
+    canvas_vk_retired retired[MAX_RETIRED_SWAPCHAINS];
+    uint32_t retired_count;
+
+    canvas_vk_dead_buffer *dead_buffers;
+    uint32_t dead_buffer_count;
+    uint32_t dead_buffer_capacity;
+
+    // window size the swapchain was built for, resizes back to it are dropped
+    int64_t built_width;
+    int64_t built_height;
+    uint64_t resize_request_ns;
+    uint64_t rate_start_ns;
+    uint64_t rate_start_count;
+
     bool needs_resize;
+    bool needs_recreate; // out of date, scale or present mode change, not subject to coalescing
     bool recreating_swapchain;
     bool initialized;
 } canvas_vulkan_window;
@@ -3497,6 +4232,7 @@ static int vk_load_instance_functions()
     VK_LOAD_INSTANCE_FUNC(vkGetPhysicalDeviceProperties);
     VK_LOAD_INSTANCE_FUNC(vkGetPhysicalDeviceFeatures);
     VK_LOAD_INSTANCE_FUNC(vkGetPhysicalDeviceMemoryProperties);
+    VK_LOAD_INSTANCE_FUNC(vkGetPhysicalDeviceFormatProperties);
     VK_LOAD_INSTANCE_FUNC(vkCreateDevice);
     VK_LOAD_INSTANCE_FUNC(vkGetDeviceQueue);
 
@@ -3534,11 +4270,14 @@ static int vk_load_device_functions()
 
     VK_LOAD_DEVICE_FUNC(vkDestroyDevice);
     VK_LOAD_DEVICE_FUNC(vkDeviceWaitIdle);
-    VK_LOAD_DEVICE_FUNC(vkCreateSwapchainKHR);
-    VK_LOAD_DEVICE_FUNC(vkDestroySwapchainKHR);
-    VK_LOAD_DEVICE_FUNC(vkGetSwapchainImagesKHR);
-    VK_LOAD_DEVICE_FUNC(vkAcquireNextImageKHR);
-    VK_LOAD_DEVICE_FUNC(vkQueuePresentKHR);
+    if (vk_info.swapchain)
+    {
+        VK_LOAD_DEVICE_FUNC(vkCreateSwapchainKHR);
+        VK_LOAD_DEVICE_FUNC(vkDestroySwapchainKHR);
+        VK_LOAD_DEVICE_FUNC(vkGetSwapchainImagesKHR);
+        VK_LOAD_DEVICE_FUNC(vkAcquireNextImageKHR);
+        VK_LOAD_DEVICE_FUNC(vkQueuePresentKHR);
+    }
     VK_LOAD_DEVICE_FUNC(vkCreateCommandPool);
     VK_LOAD_DEVICE_FUNC(vkDestroyCommandPool);
     VK_LOAD_DEVICE_FUNC(vkAllocateCommandBuffers);
@@ -3552,6 +4291,9 @@ static int vk_load_device_functions()
     VK_LOAD_DEVICE_FUNC(vkDestroyFence);
     VK_LOAD_DEVICE_FUNC(vkWaitForFences);
     VK_LOAD_DEVICE_FUNC(vkResetFences);
+    VK_LOAD_DEVICE_FUNC(vkGetFenceStatus);
+    VK_LOAD_DEVICE_FUNC(vkFlushMappedMemoryRanges);
+    VK_LOAD_DEVICE_FUNC(vkInvalidateMappedMemoryRanges);
     VK_LOAD_DEVICE_FUNC(vkQueueSubmit);
     VK_LOAD_DEVICE_FUNC(vkQueueWaitIdle);
     VK_LOAD_DEVICE_FUNC(vkCreateRenderPass);
@@ -3563,6 +4305,35 @@ static int vk_load_device_functions()
     VK_LOAD_DEVICE_FUNC(vkCmdBeginRenderPass);
     VK_LOAD_DEVICE_FUNC(vkCmdEndRenderPass);
     VK_LOAD_DEVICE_FUNC(vkCmdPipelineBarrier);
+    VK_LOAD_DEVICE_FUNC(vkCreateDescriptorSetLayout);
+    VK_LOAD_DEVICE_FUNC(vkDestroyDescriptorSetLayout);
+    VK_LOAD_DEVICE_FUNC(vkCreatePipelineLayout);
+    VK_LOAD_DEVICE_FUNC(vkDestroyPipelineLayout);
+    VK_LOAD_DEVICE_FUNC(vkCreateDescriptorPool);
+    VK_LOAD_DEVICE_FUNC(vkDestroyDescriptorPool);
+    VK_LOAD_DEVICE_FUNC(vkResetDescriptorPool);
+    VK_LOAD_DEVICE_FUNC(vkAllocateDescriptorSets);
+    VK_LOAD_DEVICE_FUNC(vkUpdateDescriptorSets);
+    VK_LOAD_DEVICE_FUNC(vkCmdBindPipeline);
+    VK_LOAD_DEVICE_FUNC(vkCmdBindVertexBuffers);
+    VK_LOAD_DEVICE_FUNC(vkCmdBindIndexBuffer);
+    VK_LOAD_DEVICE_FUNC(vkCmdBindDescriptorSets);
+    VK_LOAD_DEVICE_FUNC(vkCmdSetViewport);
+    VK_LOAD_DEVICE_FUNC(vkCmdSetScissor);
+    VK_LOAD_DEVICE_FUNC(vkCmdDraw);
+    VK_LOAD_DEVICE_FUNC(vkCmdDrawIndexed);
+    VK_LOAD_DEVICE_FUNC(vkCmdPushConstants);
+    VK_LOAD_DEVICE_FUNC(vkCmdDrawIndirect);
+    VK_LOAD_DEVICE_FUNC(vkCmdDispatch);
+    VK_LOAD_DEVICE_FUNC(vkCreateComputePipelines);
+    VK_LOAD_DEVICE_FUNC(vkCmdDrawIndexedIndirect);
+    VK_LOAD_DEVICE_FUNC(vkCreateShaderModule);
+    VK_LOAD_DEVICE_FUNC(vkDestroyShaderModule);
+    VK_LOAD_DEVICE_FUNC(vkCreateGraphicsPipelines);
+    VK_LOAD_DEVICE_FUNC(vkDestroyPipeline);
+    VK_LOAD_DEVICE_FUNC(vkCreatePipelineCache);
+    VK_LOAD_DEVICE_FUNC(vkDestroyPipelineCache);
+    VK_LOAD_DEVICE_FUNC(vkGetPipelineCacheData);
     VK_LOAD_DEVICE_FUNC(vkResetCommandPool);
 
     VK_LOAD_DEVICE_FUNC(vkCreateBuffer);
@@ -3570,6 +4341,7 @@ static int vk_load_device_functions()
     VK_LOAD_DEVICE_FUNC(vkGetBufferMemoryRequirements);
     VK_LOAD_DEVICE_FUNC(vkBindBufferMemory);
     VK_LOAD_DEVICE_FUNC(vkCmdCopyBuffer);
+    VK_LOAD_DEVICE_FUNC(vkCmdCopyImageToBuffer);
 
     VK_LOAD_DEVICE_FUNC(vkCreateImage);
     VK_LOAD_DEVICE_FUNC(vkDestroyImage);
@@ -3581,13 +4353,40 @@ static int vk_load_device_functions()
     VK_LOAD_DEVICE_FUNC(vkMapMemory);
     VK_LOAD_DEVICE_FUNC(vkUnmapMemory);
 
+    if (vk_info.timeline)
+    {
+        VK_LOAD_DEVICE_FUNC(vkWaitSemaphores);
+        VK_LOAD_DEVICE_FUNC(vkGetSemaphoreCounterValue);
+    }
+
+    if (vk_info.draw_indirect_count)
+    {
+        vk_info.vkCmdDrawIndirectCount = (PFN_vkCmdDrawIndirectCount)vk_info.vkGetDeviceProcAddr(vk_info.device, "vkCmdDrawIndirectCountKHR");
+        vk_info.vkCmdDrawIndexedIndirectCount = (PFN_vkCmdDrawIndexedIndirectCount)vk_info.vkGetDeviceProcAddr(vk_info.device, "vkCmdDrawIndexedIndirectCountKHR");
+        vk_info.draw_indirect_count = vk_info.vkCmdDrawIndirectCount && vk_info.vkCmdDrawIndexedIndirectCount;
+    }
+
+    if (vk_info.dynamic_rendering)
+    {
+        bool core = vk_info.api_version >= VK_API_VERSION_1_3;
+        vk_info.vkCmdBeginRendering = (PFN_vkCmdBeginRendering)vk_info.vkGetDeviceProcAddr(vk_info.device, core ? "vkCmdBeginRendering" : "vkCmdBeginRenderingKHR");
+        vk_info.vkCmdEndRendering = (PFN_vkCmdEndRendering)vk_info.vkGetDeviceProcAddr(vk_info.device, core ? "vkCmdEndRendering" : "vkCmdEndRenderingKHR");
+
+        if (!vk_info.vkCmdBeginRendering || !vk_info.vkCmdEndRendering)
+        {
+            CANVAS_WARN("dynamic rendering entry points missing, using render passes\n");
+            vk_info.dynamic_rendering = false;
+        }
+    }
+
     CANVAS_RETURN(CANVAS_OK);
 }
 
-static bool vk_check_device_extension_support(VkPhysicalDevice device)
+static bool vk_device_has_extension(VkPhysicalDevice device, const char *name)
 {
     CANVAS_ENTER_FUNC();
     CANVAS_ASSERT_NOT_NULL(device);
+    CANVAS_ASSERT_NOT_NULL(name);
 
     uint32_t extension_count = 0;
     vk_info.vkEnumerateDeviceExtensionProperties(device, NULL, &extension_count, NULL);
@@ -3606,25 +4405,24 @@ static bool vk_check_device_extension_support(VkPhysicalDevice device)
 
     vk_info.vkEnumerateDeviceExtensionProperties(device, NULL, &extension_count, available_extensions);
 
-    bool has_swapchain = false;
+    bool found = false;
     for (uint32_t i = 0; i < extension_count; i++)
     {
-        if (strcmp(available_extensions[i].extensionName, VK_KHR_SWAPCHAIN_EXTENSION_NAME) == 0)
+        if (strcmp(available_extensions[i].extensionName, name) == 0)
         {
-            has_swapchain = true;
+            found = true;
             break;
         }
     }
 
     free(available_extensions);
-    CANVAS_RETURN(has_swapchain);
+    CANVAS_RETURN(found);
 }
 
 static bool vk_find_queue_families(VkPhysicalDevice device, VkSurfaceKHR surface, int *graphics_family, int *present_family)
 {
     CANVAS_ENTER_FUNC();
     CANVAS_ASSERT_NOT_NULL(device);
-    CANVAS_ASSERT_NOT_NULL(surface);
     CANVAS_ASSERT_NOT_NULL(graphics_family);
     CANVAS_ASSERT_NOT_NULL(present_family);
 
@@ -3653,8 +4451,10 @@ static bool vk_find_queue_families(VkPhysicalDevice device, VkSurfaceKHR surface
         if (queue_families[i].queueFlags & VK_QUEUE_GRAPHICS_BIT)
             *graphics_family = (int)i;
 
-        VkBool32 present_support = VK_FALSE;
-        vk_info.vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &present_support);
+        // without a surface nothing is presented, the graphics queue stands in
+        VkBool32 present_support = (queue_families[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) ? VK_TRUE : VK_FALSE;
+        if (surface)
+            vk_info.vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &present_support);
         if (present_support)
             *present_family = (int)i;
 
@@ -3667,45 +4467,99 @@ static bool vk_find_queue_families(VkPhysicalDevice device, VkSurfaceKHR surface
     CANVAS_RETURN(result);
 }
 
-static bool vk_is_device_suitable(VkPhysicalDevice device, VkSurfaceKHR test_surface)
+// true when a mappable device local type lives in the largest device local heap, so it is not just the small BAR window
+static bool vk_has_host_visible_vram(const VkPhysicalDeviceMemoryProperties *mem_props)
 {
-    CANVAS_ENTER_FUNC();
-    CANVAS_ASSERT_NOT_NULL(device);
-    CANVAS_ASSERT_NOT_NULL(test_surface);
-
-    int graphics_family, present_family;
-
-    if (!vk_find_queue_families(device, test_surface, &graphics_family, &present_family))
+    VkDeviceSize largest_local = 0;
+    for (uint32_t i = 0; i < mem_props->memoryHeapCount; i++)
     {
-        CANVAS_RETURN(false);
+        if ((mem_props->memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) && mem_props->memoryHeaps[i].size > largest_local)
+            largest_local = mem_props->memoryHeaps[i].size;
     }
 
-    if (!vk_check_device_extension_support(device))
+    const VkMemoryPropertyFlags wanted = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    for (uint32_t i = 0; i < mem_props->memoryTypeCount; i++)
     {
-        CANVAS_RETURN(false);
+        const VkMemoryType *type = &mem_props->memoryTypes[i];
+        if ((type->propertyFlags & wanted) == wanted && mem_props->memoryHeaps[type->heapIndex].size >= largest_local)
+            return true;
     }
 
-    uint32_t format_count = 0;
-    vk_info.vkGetPhysicalDeviceSurfaceFormatsKHR(device, test_surface, &format_count, NULL);
-
-    uint32_t present_mode_count = 0;
-    vk_info.vkGetPhysicalDeviceSurfacePresentModesKHR(device, test_surface, &present_mode_count, NULL);
-
-    bool result = (format_count > 0 && present_mode_count > 0);
-    CANVAS_RETURN(result);
+    return false;
 }
 
-static VkResult vk_select_physical_device(VkSurfaceKHR test_surface)
+// first family with all of `want` and none of `avoid`, -1 if there is none
+static int vk_find_queue_family(VkPhysicalDevice device, VkQueueFlags want, VkQueueFlags avoid)
 {
     CANVAS_ENTER_FUNC();
-    CANVAS_ASSERT_NOT_NULL(vk_info.instance);
-    CANVAS_ASSERT_NOT_NULL(test_surface);
 
-    uint32_t device_count = 0;
-    VkResult result = vk_info.vkEnumeratePhysicalDevices(vk_info.instance, &device_count, NULL);
-    if (result != VK_SUCCESS || device_count == 0)
-    {
-        CANVAS_RETURN_ERR(VK_ERROR_INITIALIZATION_FAILED, "No physical devices found or enumeration failed\n");
+    uint32_t queue_family_count = 0;
+    vk_info.vkGetPhysicalDeviceQueueFamilyProperties(device, &queue_family_count, NULL);
+
+    VkQueueFamilyProperties *queue_families = (VkQueueFamilyProperties *)malloc(queue_family_count * sizeof(VkQueueFamilyProperties));
+    if (!queue_families)
+        CANVAS_RETURN(-1);
+
+    vk_info.vkGetPhysicalDeviceQueueFamilyProperties(device, &queue_family_count, queue_families);
+
+    int family = -1;
+    for (uint32_t i = 0; i < queue_family_count; i++)
+    {
+        VkQueueFlags flags = queue_families[i].queueFlags;
+        if ((flags & want) == want && !(flags & avoid) && queue_families[i].queueCount > 0)
+        {
+            family = (int)i;
+            break;
+        }
+    }
+
+    free(queue_families);
+    CANVAS_RETURN(family);
+}
+
+// a null surface asks for offscreen rendering, any device with a graphics queue will do
+static bool vk_is_device_suitable(VkPhysicalDevice device, VkSurfaceKHR test_surface)
+{
+    CANVAS_ENTER_FUNC();
+    CANVAS_ASSERT_NOT_NULL(device);
+
+    int graphics_family, present_family;
+
+    if (!vk_find_queue_families(device, test_surface, &graphics_family, &present_family))
+    {
+        CANVAS_RETURN(false);
+    }
+
+    if (!test_surface)
+    {
+        CANVAS_RETURN(true);
+    }
+
+    if (!vk_device_has_extension(device, VK_KHR_SWAPCHAIN_EXTENSION_NAME))
+    {
+        CANVAS_RETURN(false);
+    }
+
+    uint32_t format_count = 0;
+    vk_info.vkGetPhysicalDeviceSurfaceFormatsKHR(device, test_surface, &format_count, NULL);
+
+    uint32_t present_mode_count = 0;
+    vk_info.vkGetPhysicalDeviceSurfacePresentModesKHR(device, test_surface, &present_mode_count, NULL);
+
+    bool result = (format_count > 0 && present_mode_count > 0);
+    CANVAS_RETURN(result);
+}
+
+static VkResult vk_select_physical_device(VkSurfaceKHR test_surface)
+{
+    CANVAS_ENTER_FUNC();
+    CANVAS_ASSERT_NOT_NULL(vk_info.instance);
+
+    uint32_t device_count = 0;
+    VkResult result = vk_info.vkEnumeratePhysicalDevices(vk_info.instance, &device_count, NULL);
+    if (result != VK_SUCCESS || device_count == 0)
+    {
+        CANVAS_RETURN_ERR(VK_ERROR_INITIALIZATION_FAILED, "No physical devices found or enumeration failed\n");
     }
 
     VkPhysicalDevice *devices = (VkPhysicalDevice *)malloc(device_count * sizeof(VkPhysicalDevice));
@@ -3736,6 +4590,21 @@ static VkResult vk_select_physical_device(VkSurfaceKHR test_surface)
             vk_info.vkGetPhysicalDeviceProperties(devices[i], &props);
             CANVAS_INFO("selected GPU: %s\n", props.deviceName);
 
+            // usable version is the lower of what the instance asked for and the device reports
+            if (props.apiVersion < vk_info.api_version)
+                vk_info.api_version = props.apiVersion;
+
+            // memory types never change, so they are queried once instead of per allocation
+            vk_info.vkGetPhysicalDeviceMemoryProperties(devices[i], &vk_info.memory_properties);
+            vk_info.host_visible_vram = vk_has_host_visible_vram(&vk_info.memory_properties);
+            vk_info.non_coherent_atom = props.limits.nonCoherentAtomSize ? props.limits.nonCoherentAtomSize : 1;
+
+            memcpy(vk_info.pipeline_cache_uuid, props.pipelineCacheUUID, VK_UUID_SIZE);
+            vk_info.driver_version = props.driverVersion;
+            vk_info.max_draw_indirect_count = props.limits.maxDrawIndirectCount ? props.limits.maxDrawIndirectCount : 1;
+            if (vk_info.host_visible_vram)
+                CANVAS_INFO("all device memory is host visible, static buffers are written directly\n");
+
             free(devices);
             CANVAS_RETURN(VK_SUCCESS);
         }
@@ -3752,7 +4621,7 @@ static int vk_create_logical_device()
     CANVAS_ASSERT(vk_info.graphics_family >= 0);
     CANVAS_ASSERT(vk_info.present_family >= 0);
 
-    uint32_t unique_families[2];
+    uint32_t unique_families[4];
     uint32_t unique_count = 1;
     unique_families[0] = (uint32_t)vk_info.graphics_family;
 
@@ -3762,8 +4631,36 @@ static int vk_create_logical_device()
         unique_count = 2;
     }
 
+    // a dedicated transfer queue needs timeline semaphores to order uploads before draws
+    vk_info.transfer_family = vk_info.graphics_family;
+#if CANVAS_VULKAN_TIMELINE
+    if (vk_info.api_version >= VK_API_VERSION_1_2)
+    {
+        int transfer = vk_find_queue_family(vk_info.physical_device, VK_QUEUE_TRANSFER_BIT, VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT);
+        if (transfer >= 0 && transfer != vk_info.present_family)
+        {
+            vk_info.transfer_family = transfer;
+            unique_families[unique_count++] = (uint32_t)transfer;
+        }
+    }
+#endif
+
+    // async compute is ordered against draws with the same timelines
+    vk_info.compute_family = vk_info.graphics_family;
+#if CANVAS_VULKAN_TIMELINE && CANVAS_VULKAN_ASYNC_COMPUTE
+    if (vk_info.api_version >= VK_API_VERSION_1_2)
+    {
+        int compute = vk_find_queue_family(vk_info.physical_device, VK_QUEUE_COMPUTE_BIT, VK_QUEUE_GRAPHICS_BIT);
+        if (compute >= 0 && compute != vk_info.present_family && compute != vk_info.transfer_family)
+        {
+            vk_info.compute_family = compute;
+            unique_families[unique_count++] = (uint32_t)compute;
+        }
+    }
+#endif
+
     float queue_priority = 1.0f;
-    VkDeviceQueueCreateInfo queue_create_infos[2];
+    VkDeviceQueueCreateInfo queue_create_infos[4];
 
     for (uint32_t i = 0; i < unique_count; i++)
     {
@@ -3774,16 +4671,75 @@ static int vk_create_logical_device()
         queue_create_infos[i].pQueuePriorities = &queue_priority;
     }
 
+    // without multiDrawIndirect each indirect record becomes its own draw
+    VkPhysicalDeviceFeatures supported_features = {0};
+    vk_info.vkGetPhysicalDeviceFeatures(vk_info.physical_device, &supported_features);
+
     VkPhysicalDeviceFeatures device_features = {0};
+    device_features.multiDrawIndirect = supported_features.multiDrawIndirect;
+    device_features.drawIndirectFirstInstance = supported_features.drawIndirectFirstInstance;
+    vk_info.multi_draw_indirect = supported_features.multiDrawIndirect;
+    vk_info.draw_indirect_first_instance = supported_features.drawIndirectFirstInstance;
+
+    const char *device_extensions[3];
+    uint32_t device_extension_count = 0;
+
+    vk_info.swapchain = vk_device_has_extension(vk_info.physical_device, VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+    if (vk_info.swapchain)
+        device_extensions[device_extension_count++] = VK_KHR_SWAPCHAIN_EXTENSION_NAME;
 
-    const char *device_extensions[] = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
+    // gpu driven draw counts, no feature bit to enable for the extension
+    vk_info.draw_indirect_count = vk_device_has_extension(vk_info.physical_device, VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+    if (vk_info.draw_indirect_count)
+        device_extensions[device_extension_count++] = VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME;
 
     VkDeviceCreateInfo create_info = {0};
     create_info.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
     create_info.queueCreateInfoCount = unique_count;
     create_info.pQueueCreateInfos = queue_create_infos;
     create_info.pEnabledFeatures = &device_features;
-    create_info.enabledExtensionCount = 1;
+
+    // core in 1.3, the KHR extension only depends on 1.2 core features
+    VkPhysicalDeviceDynamicRenderingFeatures dynamic_rendering_features = {0};
+    vk_info.dynamic_rendering = false;
+
+#if CANVAS_VULKAN_DYNAMIC_RENDERING
+    if (vk_info.api_version >= VK_API_VERSION_1_3)
+    {
+        vk_info.dynamic_rendering = true;
+    }
+    else if (vk_info.api_version >= VK_API_VERSION_1_2 &&
+             vk_device_has_extension(vk_info.physical_device, VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME))
+    {
+        device_extensions[device_extension_count++] = VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME;
+        vk_info.dynamic_rendering = true;
+    }
+
+    if (vk_info.dynamic_rendering)
+    {
+        dynamic_rendering_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES;
+        dynamic_rendering_features.dynamicRendering = VK_TRUE;
+        dynamic_rendering_features.pNext = (void *)create_info.pNext;
+        create_info.pNext = &dynamic_rendering_features;
+    }
+#endif
+
+    // required by 1.2 core, no feature query needed
+    VkPhysicalDeviceTimelineSemaphoreFeatures timeline_features = {0};
+    vk_info.timeline = false;
+
+#if CANVAS_VULKAN_TIMELINE
+    if (vk_info.api_version >= VK_API_VERSION_1_2)
+    {
+        timeline_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+        timeline_features.timelineSemaphore = VK_TRUE;
+        timeline_features.pNext = (void *)create_info.pNext;
+        create_info.pNext = &timeline_features;
+        vk_info.timeline = true;
+    }
+#endif
+
+    create_info.enabledExtensionCount = device_extension_count;
     create_info.ppEnabledExtensionNames = device_extensions;
 
     VkResult result = vk_info.vkCreateDevice(vk_info.physical_device, &create_info, NULL, &vk_info.device);
@@ -3791,8 +4747,19 @@ static int vk_create_logical_device()
 
     CANVAS_ASSERT_NOT_NULL(vk_info.device);
 
+    if (vk_info.dynamic_rendering)
+        CANVAS_INFO("using dynamic rendering\n");
+
     vk_info.vkGetDeviceQueue(vk_info.device, vk_info.graphics_family, 0, &vk_info.graphics_queue);
     vk_info.vkGetDeviceQueue(vk_info.device, vk_info.present_family, 0, &vk_info.present_queue);
+    vk_info.vkGetDeviceQueue(vk_info.device, vk_info.transfer_family, 0, &vk_info.transfer_queue);
+    vk_info.vkGetDeviceQueue(vk_info.device, vk_info.compute_family, 0, &vk_info.compute_queue);
+
+    if (vk_info.transfer_family != vk_info.graphics_family)
+        CANVAS_INFO("using transfer queue family %d for uploads\n", vk_info.transfer_family);
+
+    if (vk_info.compute_family != vk_info.graphics_family)
+        CANVAS_INFO("using compute queue family %d for dispatches\n", vk_info.compute_family);
 
     CANVAS_ASSERT_NOT_NULL(vk_info.graphics_queue);
     CANVAS_ASSERT_NOT_NULL(vk_info.present_queue);
@@ -3823,6 +4790,10 @@ static int vk_create_surface(int window_id, VkSurfaceKHR *surface)
     {
         VkWaylandSurfaceCreateInfoKHR create_info = {0};
         create_info.sType = VK_STRUCTURE_TYPE_WAYLAND_SURFACE_CREATE_INFO_KHR;
+        create_info.display = wl.display;
+        create_info.surface = (struct wl_surface *)canvas_info.canvas[window_id].window;
+
+        _canvas_wayland_surface_scale_init(window_id);
 
         result = vk_info.vkCreateWaylandSurfaceKHR(vk_info.instance, &create_info, NULL, surface);
         VK_CHECK(result, "failed to create Wayland surface");
@@ -3899,6 +4870,7 @@ int canvas_backend_vulkan_init()
     vk_info.vkCreateInstance = (PFN_vkCreateInstance)vk_info.vkGetInstanceProcAddr(NULL, "vkCreateInstance");
     vk_info.vkEnumerateInstanceLayerProperties = (PFN_vkEnumerateInstanceLayerProperties)vk_info.vkGetInstanceProcAddr(NULL, "vkEnumerateInstanceLayerProperties");
     vk_info.vkEnumerateInstanceExtensionProperties = (PFN_vkEnumerateInstanceExtensionProperties)vk_info.vkGetInstanceProcAddr(NULL, "vkEnumerateInstanceExtensionProperties");
+    vk_info.vkEnumerateInstanceVersion = (PFN_vkEnumerateInstanceVersion)vk_info.vkGetInstanceProcAddr(NULL, "vkEnumerateInstanceVersion");
 
     CANVAS_ASSERT_NOT_NULL(vk_info.vkCreateInstance);
     CANVAS_ASSERT_NOT_NULL(vk_info.vkEnumerateInstanceLayerProperties);
@@ -3930,7 +4902,16 @@ int canvas_backend_vulkan_init()
     app_info.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
     app_info.pEngineName = "Canvas";
     app_info.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-    app_info.apiVersion = VK_API_VERSION_1_0;
+
+    // 1.0 loaders lack vkEnumerateInstanceVersion and reject anything above 1.0
+    vk_info.api_version = VK_API_VERSION_1_0;
+    if (vk_info.vkEnumerateInstanceVersion)
+        vk_info.vkEnumerateInstanceVersion(&vk_info.api_version);
+
+    if (vk_info.api_version > VK_API_VERSION_1_3)
+        vk_info.api_version = VK_API_VERSION_1_3;
+
+    app_info.apiVersion = vk_info.api_version;
 
     const char *extensions[16];
     uint32_t extension_count = 0;
@@ -4024,17 +5005,98 @@ static void vk_cleanup_swapchain_support_details(SwapchainSupportDetails *detail
         free(details->present_modes);
 }
 
+static bool vk_present_mode_supported(const SwapchainSupportDetails *support, VkPresentModeKHR mode)
+{
+    for (uint32_t i = 0; i < support->present_mode_count; i++)
+        if (support->present_modes[i] == mode)
+            return true;
+
+    return false;
+}
+
+// requested mode first, then the closest latency match, FIFO is always available
+static VkPresentModeKHR vk_choose_present_mode(const SwapchainSupportDetails *support, int window_id)
+{
+    CANVAS_ASSERT_NOT_NULL(support);
+    CANVAS_ASSERT_RANGE(window_id, 0, MAX_CANVAS - 1);
+
+    VkPresentModeKHR order[3] = {VK_PRESENT_MODE_FIFO_KHR, VK_PRESENT_MODE_FIFO_KHR, VK_PRESENT_MODE_FIFO_KHR};
+
+    switch (canvas_info.canvas[window_id].present_mode)
+    {
+    case CANVAS_PRESENT_FIFO_RELAXED:
+        order[0] = VK_PRESENT_MODE_FIFO_RELAXED_KHR;
+        break;
+    case CANVAS_PRESENT_MAILBOX:
+        order[0] = VK_PRESENT_MODE_MAILBOX_KHR;
+        order[1] = VK_PRESENT_MODE_IMMEDIATE_KHR;
+        break;
+    case CANVAS_PRESENT_IMMEDIATE:
+        order[0] = VK_PRESENT_MODE_IMMEDIATE_KHR;
+        order[1] = VK_PRESENT_MODE_MAILBOX_KHR;
+        break;
+    default:
+        break;
+    }
+
+    for (int i = 0; i < 3; i++)
+    {
+        if (vk_present_mode_supported(support, order[i]))
+        {
+            if (i > 0)
+                CANVAS_INFO("present mode %d not supported for window %d, using %d\n", order[0], window_id, order[i]);
+
+            return order[i];
+        }
+    }
+
+    return VK_PRESENT_MODE_FIFO_KHR;
+}
+
+// all swapchains share one display connection, Mesa's X11 WSI is not safe to
+// enter concurrently on it, so every present goes through here
+static VkResult vk_queue_present(const VkPresentInfoKHR *present_info)
+{
+#ifdef __linux__
+    bool lock = !_canvas_using_wayland && x11.display;
+
+    if (lock)
+        x11.XLockDisplay(x11.display);
+#endif
+
+    VkResult result = vk_info.vkQueuePresentKHR(vk_info.present_queue, present_info);
+
+#ifdef __linux__
+    if (lock)
+        x11.XUnlockDisplay(x11.display);
+#endif
+
+    return result;
+}
+
 static VkExtent2D vk_choose_swap_extent(const VkSurfaceCapabilitiesKHR *capabilities, int window_id)
 {
     CANVAS_ASSERT_NOT_NULL(capabilities);
     CANVAS_ASSERT_RANGE(window_id, 0, MAX_CANVAS - 1);
 
+    // fixed by the platform (X11, Win32, Metal), only the compositor can scale for us
     if (capabilities->currentExtent.width != UINT32_MAX)
         return capabilities->currentExtent;
 
+    float scale = 1.0f;
+#ifdef __linux__
+    if (_canvas_using_wayland)
+        scale = _canvas_wayland_buffer_scale(window_id);
+#endif
+
     VkExtent2D actual_extent = {
-        .width = (uint32_t)canvas_info.canvas[window_id].width,
-        .height = (uint32_t)canvas_info.canvas[window_id].height};
+        .width = (uint32_t)((float)canvas_info.canvas[window_id].width * scale + 0.5f),
+        .height = (uint32_t)((float)canvas_info.canvas[window_id].height * scale + 0.5f)};
+
+    if (actual_extent.width == 0)
+        actual_extent.width = 1;
+    if (actual_extent.height == 0)
+        actual_extent.height = 1;
 
     actual_extent.width = actual_extent.width < capabilities->minImageExtent.width
                               ? capabilities->minImageExtent.width
@@ -4051,6 +5113,12 @@ static VkExtent2D vk_choose_swap_extent(const VkSurfaceCapabilitiesKHR *capabili
     return actual_extent;
 }
 
+static void vk_retire_swapchain(int window_id);
+static uint32_t vk_find_memory_type(uint32_t type_filter, VkMemoryPropertyFlags properties);
+static uint64_t vk_upload_frame(VkSemaphore *wait_semaphore);
+static uint64_t vk_compute_frame(VkSemaphore *wait_semaphore);
+static void vk_flush_dirty(void);
+
 static int vk_create_swapchain(int window_id)
 {
     CANVAS_ENTER_FUNC();
@@ -4065,7 +5133,7 @@ static int vk_create_swapchain(int window_id)
     if (caps_result != VK_SUCCESS)
     {
         CANVAS_VERBOSE("vkGetPhysicalDeviceSurfaceCapabilitiesKHR failed: %d, skipping swapchain creation\n", caps_result);
-        vk_win->needs_resize = true;
+        vk_win->needs_recreate = true;
         CANVAS_RETURN(CANVAS_OK);
     }
 
@@ -4096,18 +5164,8 @@ static int vk_create_swapchain(int window_id)
         if (support.formats[i].format == VK_FORMAT_B8G8R8A8_SRGB && support.formats[i].colorSpace == VK_COLOR_SPACE_SRGB_NONLINEAR_KHR)
             surface_format = support.formats[i];
 
-    // Force FIFO mode for now to avoid X11 threading issues with many swapchains
-    // TODO: Investigate Mesa WSI X11 thread safety with multiple swapchains
-    VkPresentModeKHR present_mode = VK_PRESENT_MODE_FIFO_KHR;
-#if 0
-    for (uint32_t i = 0; i < support.present_mode_count; i++)
-        if (support.present_modes[i] == VK_PRESENT_MODE_MAILBOX_KHR)
-            present_mode = VK_PRESENT_MODE_MAILBOX_KHR;
-
-    for (uint32_t i = 0; i < support.present_mode_count; i++)
-        if (support.present_modes[i] == VK_PRESENT_MODE_IMMEDIATE_KHR)
-            present_mode = VK_PRESENT_MODE_IMMEDIATE_KHR;
-#endif
+    // presents are serialized per display in vk_queue_present
+    VkPresentModeKHR present_mode = vk_choose_present_mode(&support, window_id);
 
     VkExtent2D extent = vk_choose_swap_extent(&support.capabilities, window_id);
 
@@ -4118,12 +5176,16 @@ static int vk_create_swapchain(int window_id)
                        window_id, extent.width, extent.height);
         vk_cleanup_swapchain_support_details(&support);
         canvas_vulkan_window *vk_win_check = &vk_windows[window_id];
-        vk_win_check->needs_resize = true; // Retry when window is visible again
+        vk_win_check->needs_recreate = true; // Retry when window is visible again
         CANVAS_RETURN(CANVAS_OK);
     }
 
-    canvas_info.canvas[window_id].width = (int)extent.width;
-    canvas_info.canvas[window_id].height = (int)extent.height;
+    // a free extent may be render scaled, keep the window size in surface units
+    if (support.capabilities.currentExtent.width != UINT32_MAX)
+    {
+        canvas_info.canvas[window_id].width = (int)extent.width;
+        canvas_info.canvas[window_id].height = (int)extent.height;
+    }
 
     uint32_t image_count = support.capabilities.minImageCount + 1;
 
@@ -4145,6 +5207,11 @@ static int vk_create_swapchain(int window_id)
     create_info.imageArrayLayers = 1;
     create_info.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
 
+    // frames can be copied out where the surface allows it, see canvas_readback_request
+    vk_win->readable = (support.capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_SRC_BIT) != 0;
+    if (vk_win->readable)
+        create_info.imageUsage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+
     uint32_t queue_families[] = {(uint32_t)vk_info.graphics_family, (uint32_t)vk_info.present_family};
 
     if (vk_info.graphics_family != vk_info.present_family)
@@ -4162,14 +5229,20 @@ static int vk_create_swapchain(int window_id)
     create_info.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
     create_info.presentMode = present_mode;
     create_info.clipped = VK_TRUE;
-    create_info.oldSwapchain = VK_NULL_HANDLE;
+    create_info.oldSwapchain = vk_win->swapchain;
 
-    VkResult result = vk_info.vkCreateSwapchainKHR(vk_info.device, &create_info, NULL, &vk_win->swapchain);
+    VkSwapchainKHR swapchain = VK_NULL_HANDLE;
+    VkResult result = vk_info.vkCreateSwapchainKHR(vk_info.device, &create_info, NULL, &swapchain);
 
     vk_cleanup_swapchain_support_details(&support);
 
+    // the old swapchain is retired by the call even when it fails
+    vk_retire_swapchain(window_id);
+
     VK_CHECK(result, "failed to create swapchain");
-    CANVAS_ASSERT_NOT_NULL(vk_win->swapchain);
+    CANVAS_ASSERT_NOT_NULL(swapchain);
+
+    vk_win->swapchain = swapchain;
 
     vk_info.vkGetSwapchainImagesKHR(vk_info.device, vk_win->swapchain, &vk_win->swapchain_image_count, NULL);
 
@@ -4182,6 +5255,14 @@ static int vk_create_swapchain(int window_id)
 
     vk_win->swapchain_format = surface_format.format;
     vk_win->swapchain_extent = extent;
+    vk_win->present_mode = present_mode;
+    vk_win->built_width = canvas_info.canvas[window_id].width;
+    vk_win->built_height = canvas_info.canvas[window_id].height;
+
+#ifdef __linux__
+    if (_canvas_using_wayland)
+        _canvas_wayland_set_destination(window_id);
+#endif
 
     for (uint32_t i = 0; i < vk_win->swapchain_image_count; i++)
     {
@@ -4220,6 +5301,168 @@ static int vk_create_swapchain(int window_id)
     CANVAS_RETURN(CANVAS_OK);
 }
 
+static VkFormat vk_offscreen_format(canvas_format format)
+{
+    switch (format)
+    {
+    case CANVAS_FORMAT_BGRA8:
+        return VK_FORMAT_B8G8R8A8_UNORM;
+    case CANVAS_FORMAT_RGBA8_SRGB:
+        return VK_FORMAT_R8G8B8A8_SRGB;
+    case CANVAS_FORMAT_BGRA8_SRGB:
+        return VK_FORMAT_B8G8R8A8_SRGB;
+    case CANVAS_FORMAT_RGBA16F:
+        return VK_FORMAT_R16G16B16A16_SFLOAT;
+    default:
+        return VK_FORMAT_R8G8B8A8_UNORM;
+    }
+}
+
+// the other way around, false for swapchain formats without a canvas_format
+static bool vk_canvas_format(VkFormat vk_format, canvas_format *format)
+{
+    switch (vk_format)
+    {
+    case VK_FORMAT_R8G8B8A8_UNORM:
+        *format = CANVAS_FORMAT_RGBA8;
+        return true;
+    case VK_FORMAT_B8G8R8A8_UNORM:
+        *format = CANVAS_FORMAT_BGRA8;
+        return true;
+    case VK_FORMAT_R8G8B8A8_SRGB:
+        *format = CANVAS_FORMAT_RGBA8_SRGB;
+        return true;
+    case VK_FORMAT_B8G8R8A8_SRGB:
+        *format = CANVAS_FORMAT_BGRA8_SRGB;
+        return true;
+    case VK_FORMAT_R16G16B16A16_SFLOAT:
+        *format = CANVAS_FORMAT_RGBA16F;
+        return true;
+    default:
+        return false;
+    }
+}
+
+// D16 is always supported as a depth attachment, D32 when the device has it
+static VkFormat vk_depth_format(void)
+{
+    VkFormatProperties props;
+    vk_info.vkGetPhysicalDeviceFormatProperties(vk_info.physical_device, VK_FORMAT_D32_SFLOAT, &props);
+
+    if (props.optimalTilingFeatures & VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT)
+        return VK_FORMAT_D32_SFLOAT;
+
+    return VK_FORMAT_D16_UNORM;
+}
+
+// a device local 2D image with its own memory and a view over all of it
+static int vk_create_target_image(VkFormat format, VkExtent2D extent, VkImageUsageFlags usage, VkImageAspectFlags aspect,
+                                  VkImage *image, VkDeviceMemory *memory, VkImageView *view)
+{
+    CANVAS_ENTER_FUNC();
+
+    VkImageCreateInfo image_info = {0};
+    image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    image_info.imageType = VK_IMAGE_TYPE_2D;
+    image_info.format = format;
+    image_info.extent.width = extent.width;
+    image_info.extent.height = extent.height;
+    image_info.extent.depth = 1;
+    image_info.mipLevels = 1;
+    image_info.arrayLayers = 1;
+    image_info.samples = VK_SAMPLE_COUNT_1_BIT;
+    image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+    image_info.usage = usage;
+    image_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+    VkResult result = vk_info.vkCreateImage(vk_info.device, &image_info, NULL, image);
+    VK_CHECK(result, "failed to create offscreen image");
+
+    VkMemoryRequirements mem_reqs;
+    vk_info.vkGetImageMemoryRequirements(vk_info.device, *image, &mem_reqs);
+
+    VkMemoryAllocateInfo alloc_info = {0};
+    alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    alloc_info.allocationSize = mem_reqs.size;
+    alloc_info.memoryTypeIndex = vk_find_memory_type(mem_reqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    if (alloc_info.memoryTypeIndex == UINT32_MAX)
+        alloc_info.memoryTypeIndex = vk_find_memory_type(mem_reqs.memoryTypeBits, 0);
+
+    result = alloc_info.memoryTypeIndex == UINT32_MAX ? VK_ERROR_OUT_OF_DEVICE_MEMORY
+                                                      : vk_info.vkAllocateMemory(vk_info.device, &alloc_info, NULL, memory);
+    if (result == VK_SUCCESS)
+        result = vk_info.vkBindImageMemory(vk_info.device, *image, *memory, 0);
+
+    if (result == VK_SUCCESS)
+    {
+        VkImageViewCreateInfo view_info = {0};
+        view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        view_info.image = *image;
+        view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        view_info.format = format;
+        view_info.subresourceRange.aspectMask = aspect;
+        view_info.subresourceRange.levelCount = 1;
+        view_info.subresourceRange.layerCount = 1;
+
+        result = vk_info.vkCreateImageView(vk_info.device, &view_info, NULL, view);
+    }
+
+    if (result != VK_SUCCESS)
+    {
+        if (*memory)
+            vk_info.vkFreeMemory(vk_info.device, *memory, NULL);
+        vk_info.vkDestroyImage(vk_info.device, *image, NULL);
+        *image = VK_NULL_HANDLE;
+        *memory = VK_NULL_HANDLE;
+        CANVAS_RETURN_ERR(CANVAS_FAIL, "failed to back offscreen image (result=%d)\n", result);
+    }
+
+    CANVAS_RETURN(CANVAS_OK);
+}
+
+// color images for every frame in flight and one depth image, used where a window has its swapchain
+static int vk_create_offscreen_targets(int window_id, VkFormat format)
+{
+    CANVAS_ENTER_FUNC();
+    CANVAS_ASSERT_RANGE(window_id, 0, MAX_CANVAS - 1);
+
+    canvas_vulkan_window *vk_win = &vk_windows[window_id];
+
+    vk_win->offscreen = true;
+    vk_win->readable = true;
+    vk_win->swapchain_format = format;
+    vk_win->swapchain_extent.width = (uint32_t)canvas_info.canvas[window_id].width;
+    vk_win->swapchain_extent.height = (uint32_t)canvas_info.canvas[window_id].height;
+    vk_win->built_width = canvas_info.canvas[window_id].width;
+    vk_win->built_height = canvas_info.canvas[window_id].height;
+
+    // transfer source so finished frames can be copied out
+    for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+    {
+        int result = vk_create_target_image(format, vk_win->swapchain_extent,
+                                            VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, VK_IMAGE_ASPECT_COLOR_BIT,
+                                            &vk_win->swapchain_images[i], &vk_win->offscreen_memory[i], &vk_win->swapchain_image_views[i]);
+        if (result != CANVAS_OK)
+            CANVAS_RETURN(result);
+
+        vk_win->swapchain_image_count++;
+    }
+
+    vk_win->depth_format = vk_depth_format();
+    int result = vk_create_target_image(vk_win->depth_format, vk_win->swapchain_extent,
+                                        VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, VK_IMAGE_ASPECT_DEPTH_BIT,
+                                        &vk_win->depth_image, &vk_win->depth_memory, &vk_win->depth_view);
+    if (result != CANVAS_OK)
+    {
+        vk_win->depth_format = VK_FORMAT_UNDEFINED;
+        CANVAS_RETURN(result);
+    }
+
+    CANVAS_TRACE("offscreen targets created: %ux%u, %u images\n", vk_win->swapchain_extent.width, vk_win->swapchain_extent.height, vk_win->swapchain_image_count);
+    CANVAS_RETURN(CANVAS_OK);
+}
+
 static int vk_create_render_pass(int window_id)
 {
     CANVAS_ENTER_FUNC();
@@ -4235,16 +5478,34 @@ static int vk_create_render_pass(int window_id)
     color_attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
     color_attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
     color_attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    color_attachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    color_attachment.finalLayout = vk_win->offscreen ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+
+    VkAttachmentDescription depth_attachment = {0};
+    depth_attachment.format = vk_win->depth_format;
+    depth_attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+    depth_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    depth_attachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    depth_attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    depth_attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    depth_attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    depth_attachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+    VkAttachmentDescription attachments[] = {color_attachment, depth_attachment};
+    bool depth = vk_win->depth_view != VK_NULL_HANDLE;
 
     VkAttachmentReference color_attachment_ref = {0};
     color_attachment_ref.attachment = 0;
     color_attachment_ref.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
+    VkAttachmentReference depth_attachment_ref = {0};
+    depth_attachment_ref.attachment = 1;
+    depth_attachment_ref.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
     VkSubpassDescription subpass = {0};
     subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
     subpass.colorAttachmentCount = 1;
     subpass.pColorAttachments = &color_attachment_ref;
+    subpass.pDepthStencilAttachment = depth ? &depth_attachment_ref : NULL;
 
     VkSubpassDependency dependency = {0};
     dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
@@ -4254,18 +5515,38 @@ static int vk_create_render_pass(int window_id)
     dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
     dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
 
+    // the depth image is shared by the frames in flight, the previous frame's tests finish first
+    if (depth)
+    {
+        dependency.srcStageMask |= VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+        dependency.srcAccessMask |= VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        dependency.dstStageMask |= VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+        dependency.dstAccessMask |= VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    }
+
+    // the final layout transition reaches the transfer stage, so a readback copy after the pass chains to it
+    VkSubpassDependency dependencies[2] = {dependency};
+    dependencies[1].srcSubpass = 0;
+    dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+    dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    dependencies[1].dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    dependencies[1].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
     VkRenderPassCreateInfo render_pass_info = {0};
     render_pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-    render_pass_info.attachmentCount = 1;
-    render_pass_info.pAttachments = &color_attachment;
+    render_pass_info.attachmentCount = depth ? 2 : 1;
+    render_pass_info.pAttachments = attachments;
     render_pass_info.subpassCount = 1;
     render_pass_info.pSubpasses = &subpass;
-    render_pass_info.dependencyCount = 1;
-    render_pass_info.pDependencies = &dependency;
+    render_pass_info.dependencyCount = 2;
+    render_pass_info.pDependencies = dependencies;
 
     VkResult result = vk_info.vkCreateRenderPass(vk_info.device, &render_pass_info, NULL, &vk_win->render_pass);
     VK_CHECK(result, "failed to create render pass");
 
+    vk_win->render_pass_version++;
+
     CANVAS_ASSERT_NOT_NULL(vk_win->render_pass);
 
     CANVAS_RETURN(CANVAS_OK);
@@ -4284,12 +5565,12 @@ static int vk_create_framebuffers(int window_id)
     {
         CANVAS_ASSERT_NOT_NULL(vk_win->swapchain_image_views[i]);
 
-        VkImageView attachments[] = {vk_win->swapchain_image_views[i]};
+        VkImageView attachments[] = {vk_win->swapchain_image_views[i], vk_win->depth_view};
 
         VkFramebufferCreateInfo framebuffer_info = {0};
         framebuffer_info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
         framebuffer_info.renderPass = vk_win->render_pass;
-        framebuffer_info.attachmentCount = 1;
+        framebuffer_info.attachmentCount = vk_win->depth_view ? 2 : 1;
         framebuffer_info.pAttachments = attachments;
         framebuffer_info.width = vk_win->swapchain_extent.width;
         framebuffer_info.height = vk_win->swapchain_extent.height;
@@ -4350,6 +5631,8 @@ static int vk_create_command_buffers(int window_id)
     VkResult result = vk_info.vkAllocateCommandBuffers(vk_info.device, &alloc_info, vk_win->command_buffers);
     VK_CHECK(result, "failed to allocate command buffers");
 
+    memset(vk_win->command_keys, 0, sizeof(vk_win->command_keys));
+
     for (uint32_t i = 0; i < vk_win->swapchain_image_count; i++)
     {
         CANVAS_ASSERT_NOT_NULL(vk_win->command_buffers[i]);
@@ -4369,10 +5652,6 @@ static int vk_create_sync_objects(int window_id)
     VkSemaphoreCreateInfo semaphore_info = {0};
     semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 
-    VkFenceCreateInfo fence_info = {0};
-    fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-    fence_info.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-
     for (uint32_t i = 0; i < MAX_SWAPCHAIN_IMAGES; i++)
     {
         VkResult result;
@@ -4395,29 +5674,47 @@ static int vk_create_sync_objects(int window_id)
         }
     }
 
-    for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+    for (uint32_t i = 0; i < MAX_SWAPCHAIN_IMAGES; i++)
+        vk_win->image_values[i] = 0;
+    vk_win->timeline_value = 0;
+
+    if (vk_info.timeline)
     {
-        VkResult result = vk_info.vkCreateFence(vk_info.device, &fence_info, NULL,
-                                                &vk_win->in_flight_fences[i]);
+        VkSemaphoreTypeCreateInfo type_info = {0};
+        type_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+        type_info.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+        type_info.initialValue = 0;
+
+        VkSemaphoreCreateInfo timeline_info = {0};
+        timeline_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+        timeline_info.pNext = &type_info;
+
+        VkResult result = vk_info.vkCreateSemaphore(vk_info.device, &timeline_info, NULL, &vk_win->timeline);
         if (result != VK_SUCCESS)
         {
-            CANVAS_ERR("failed to create fence %d (result=%d)\n", i, result);
-            goto cleanup_fences;
+            CANVAS_ERR("failed to create timeline semaphore (result=%d)\n", result);
+            goto cleanup_semaphores;
         }
     }
+    else
+    {
+        VkFenceCreateInfo fence_info = {0};
+        fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        fence_info.flags = VK_FENCE_CREATE_SIGNALED_BIT;
 
-    for (uint32_t i = 0; i < MAX_SWAPCHAIN_IMAGES; i++)
-        vk_win->images_in_flight[i] = VK_NULL_HANDLE;
+        for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+        {
+            VkResult result = vk_info.vkCreateFence(vk_info.device, &fence_info, NULL, &vk_win->frame_fences[i]);
+            if (result != VK_SUCCESS)
+            {
+                CANVAS_ERR("failed to create frame fence %u (result=%d)\n", i, result);
+                goto cleanup_semaphores;
+            }
+        }
+    }
 
     CANVAS_RETURN(CANVAS_OK);
 
-cleanup_fences:
-    for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
-    {
-        if (vk_win->in_flight_fences[i])
-            vk_info.vkDestroyFence(vk_info.device, vk_win->in_flight_fences[i], NULL);
-    }
-
 cleanup_semaphores:
     for (uint32_t i = 0; i < MAX_SWAPCHAIN_IMAGES; i++)
     {
@@ -4426,23 +5723,182 @@ cleanup_semaphores:
         if (vk_win->render_finished_semaphores[i])
             vk_info.vkDestroySemaphore(vk_info.device, vk_win->render_finished_semaphores[i], NULL);
     }
+    for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+    {
+        if (vk_win->frame_fences[i])
+            vk_info.vkDestroyFence(vk_info.device, vk_win->frame_fences[i], NULL);
+        vk_win->frame_fences[i] = VK_NULL_HANDLE;
+    }
     CANVAS_RETURN(CANVAS_FAIL);
 }
 
-static void vk_cleanup_swapchain(int window_id)
+// last frame of the window the gpu has finished, on either path
+static uint64_t vk_timeline_completed(canvas_vulkan_window *vk_win)
 {
-    CANVAS_ENTER_FUNC();
-    CANVAS_ASSERT_RANGE(window_id, 0, MAX_CANVAS - 1);
-
-    canvas_vulkan_window *vk_win = &vk_windows[window_id];
+    uint64_t value = 0;
 
-    if (!vk_win->initialized)
+    if (!vk_info.timeline)
     {
-        CANVAS_RETURN_VOID();
-    }
+        // a fence is only reused after its frame was waited on, so frames older than the ring are done
+        value = vk_win->timeline_value;
+        uint64_t first = value >= MAX_FRAMES_IN_FLIGHT ? value - (MAX_FRAMES_IN_FLIGHT - 1) : 1;
 
-    if (vk_win->command_pool && vk_win->swapchain_image_count > 0)
-    {
+        for (uint64_t frame = first; frame <= value; frame++)
+        {
+            if (vk_info.vkGetFenceStatus(vk_info.device, vk_win->frame_fences[frame % MAX_FRAMES_IN_FLIGHT]) != VK_SUCCESS)
+                return frame - 1;
+        }
+
+        return value;
+    }
+
+    vk_info.vkGetSemaphoreCounterValue(vk_info.device, vk_win->timeline, &value);
+    return value;
+}
+
+static VkResult vk_timeline_wait(canvas_vulkan_window *vk_win, uint64_t value, uint64_t timeout)
+{
+    if (value == 0)
+        return VK_SUCCESS;
+
+    if (!vk_info.timeline)
+    {
+        if (value + MAX_FRAMES_IN_FLIGHT <= vk_win->timeline_value)
+            return VK_SUCCESS;
+
+        // the fence still belongs to an older frame until this one is submitted
+        if (value > vk_win->timeline_value)
+            return VK_TIMEOUT;
+
+        return vk_info.vkWaitForFences(vk_info.device, 1, &vk_win->frame_fences[value % MAX_FRAMES_IN_FLIGHT], VK_TRUE, timeout);
+    }
+
+    VkSemaphoreWaitInfo wait_info = {0};
+    wait_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+    wait_info.semaphoreCount = 1;
+    wait_info.pSemaphores = &vk_win->timeline;
+    wait_info.pValues = &value;
+
+    return vk_info.vkWaitSemaphores(vk_info.device, &wait_info, timeout);
+}
+
+static void vk_destroy_retired(canvas_vulkan_window *vk_win, canvas_vk_retired *retired)
+{
+    for (uint32_t i = 0; i < retired->image_count; i++)
+    {
+        if (retired->framebuffers[i])
+            vk_info.vkDestroyFramebuffer(vk_info.device, retired->framebuffers[i], NULL);
+
+        if (retired->image_views[i])
+            vk_info.vkDestroyImageView(vk_info.device, retired->image_views[i], NULL);
+
+        if (retired->command_buffers[i])
+            vk_info.vkFreeCommandBuffers(vk_info.device, vk_win->command_pool, 1, &retired->command_buffers[i]);
+
+        if (retired->descriptor_pools[i])
+            vk_info.vkDestroyDescriptorPool(vk_info.device, retired->descriptor_pools[i], NULL);
+    }
+
+    if (retired->swapchain)
+        vk_info.vkDestroySwapchainKHR(vk_info.device, retired->swapchain, NULL);
+
+    memset(retired, 0, sizeof(*retired));
+}
+
+// frees retired swapchains whose last submit has completed, all of them when forced
+// a completed submit does not mean its present was consumed, so the newest stays until the next recreation
+static void vk_collect_retired(int window_id, bool force)
+{
+    CANVAS_ENTER_FUNC();
+    CANVAS_ASSERT_RANGE(window_id, 0, MAX_CANVAS - 1);
+
+    canvas_vulkan_window *vk_win = &vk_windows[window_id];
+    uint64_t completed = force ? 0 : vk_timeline_completed(vk_win);
+    uint32_t kept = 0;
+
+    for (uint32_t i = 0; i < vk_win->retired_count; i++)
+    {
+        bool newest = i + 1 == vk_win->retired_count;
+        if (force || (!newest && vk_win->retired[i].retire_frame <= completed))
+        {
+            vk_destroy_retired(vk_win, &vk_win->retired[i]);
+            continue;
+        }
+
+        if (kept != i)
+        {
+            vk_win->retired[kept] = vk_win->retired[i];
+            memset(&vk_win->retired[i], 0, sizeof(canvas_vk_retired));
+        }
+        kept++;
+    }
+
+    vk_win->retired_count = kept;
+    CANVAS_RETURN_VOID();
+}
+
+// moves the live swapchain objects to the deletion queue instead of waiting for the device
+static void vk_retire_swapchain(int window_id)
+{
+    CANVAS_ENTER_FUNC();
+    CANVAS_ASSERT_RANGE(window_id, 0, MAX_CANVAS - 1);
+
+    canvas_vulkan_window *vk_win = &vk_windows[window_id];
+
+    if (!vk_win->swapchain && vk_win->swapchain_image_count == 0)
+        CANVAS_RETURN_VOID();
+
+    if (vk_win->retired_count == MAX_RETIRED_SWAPCHAINS)
+    {
+        // resizing faster than the gpu retires frames, drain the in flight submits once
+        vk_timeline_wait(vk_win, vk_win->timeline_value, UINT64_MAX);
+        vk_collect_retired(window_id, false);
+    }
+
+    CANVAS_ASSERT(vk_win->retired_count < MAX_RETIRED_SWAPCHAINS);
+
+    canvas_vk_retired *retired = &vk_win->retired[vk_win->retired_count++];
+    retired->swapchain = vk_win->swapchain;
+    retired->image_count = vk_win->swapchain_image_count;
+    retired->retire_frame = vk_win->timeline_value;
+
+    for (uint32_t i = 0; i < vk_win->swapchain_image_count; i++)
+    {
+        retired->image_views[i] = vk_win->swapchain_image_views[i];
+        retired->framebuffers[i] = vk_win->framebuffers[i];
+        retired->command_buffers[i] = vk_win->command_buffers[i];
+        retired->descriptor_pools[i] = vk_win->descriptor_pools[i];
+
+        vk_win->descriptor_pools[i] = VK_NULL_HANDLE;
+        vk_win->swapchain_images[i] = VK_NULL_HANDLE;
+        vk_win->swapchain_image_views[i] = VK_NULL_HANDLE;
+        vk_win->framebuffers[i] = VK_NULL_HANDLE;
+        vk_win->command_buffers[i] = VK_NULL_HANDLE;
+    }
+
+    for (uint32_t i = 0; i < MAX_SWAPCHAIN_IMAGES; i++)
+        vk_win->image_values[i] = 0;
+
+    vk_win->swapchain = VK_NULL_HANDLE;
+    vk_win->swapchain_image_count = 0;
+
+    CANVAS_RETURN_VOID();
+}
+
+static void vk_cleanup_swapchain(int window_id)
+{
+    CANVAS_ENTER_FUNC();
+    CANVAS_ASSERT_RANGE(window_id, 0, MAX_CANVAS - 1);
+
+    canvas_vulkan_window *vk_win = &vk_windows[window_id];
+
+    if (!vk_win->initialized)
+    {
+        CANVAS_RETURN_VOID();
+    }
+
+    if (vk_win->command_pool && vk_win->swapchain_image_count > 0)
+    {
         vk_info.vkFreeCommandBuffers(vk_info.device, vk_win->command_pool,
                                      vk_win->swapchain_image_count, vk_win->command_buffers);
 
@@ -4465,7 +5921,7 @@ static void vk_cleanup_swapchain(int window_id)
     }
 
     for (uint32_t i = 0; i < MAX_SWAPCHAIN_IMAGES; i++)
-        vk_win->images_in_flight[i] = VK_NULL_HANDLE;
+        vk_win->image_values[i] = 0;
 
     if (vk_win->swapchain)
     {
@@ -4476,6 +5932,72 @@ static void vk_cleanup_swapchain(int window_id)
     CANVAS_RETURN_VOID();
 }
 
+static uint64_t vk_time_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+// size events only mark the window, the swapchain is rebuilt at most once per frame in vk_acquire_frame
+static void vk_request_resize(int window_id)
+{
+    canvas_vulkan_window *vk_win = &vk_windows[window_id];
+
+    if (!vk_win->initialized)
+        return;
+
+    vk_win->needs_resize = true;
+    vk_win->resize_request_ns = vk_time_ns();
+    canvas_info.canvas[window_id].stats.resize_requests++;
+
+#if CANVAS_RESIZE_SETTLE_MS > 0 && defined(__linux__)
+    // the old buffer is scaled to the new size until the swapchain catches up
+    if (_canvas_using_wayland)
+        _canvas_wayland_set_destination(window_id);
+#endif
+}
+
+static bool vk_resize_pending(int window_id, uint64_t now)
+{
+    canvas_vulkan_window *vk_win = &vk_windows[window_id];
+
+    if (vk_win->needs_recreate || !vk_win->swapchain)
+        return vk_win->needs_recreate || vk_win->needs_resize;
+
+    if (!vk_win->needs_resize)
+        return false;
+
+    if (canvas_info.canvas[window_id].width == vk_win->built_width &&
+        canvas_info.canvas[window_id].height == vk_win->built_height)
+    {
+        vk_win->needs_resize = false;
+        return false;
+    }
+
+#if CANVAS_RESIZE_SETTLE_MS > 0
+    if (now - vk_win->resize_request_ns < (uint64_t)CANVAS_RESIZE_SETTLE_MS * 1000000ULL)
+        return false;
+#else
+    (void)now;
+#endif
+
+    return true;
+}
+
+static void vk_update_recreate_rate(int window_id, uint64_t now)
+{
+    canvas_vulkan_window *vk_win = &vk_windows[window_id];
+    canvas_frame_stats *stats = &canvas_info.canvas[window_id].stats;
+
+    if (now - vk_win->rate_start_ns < 1000000000ULL)
+        return;
+
+    stats->recreations_per_second = (uint32_t)(stats->recreated - vk_win->rate_start_count);
+    vk_win->rate_start_count = stats->recreated;
+    vk_win->rate_start_ns = now;
+}
+
 static int vk_recreate_swapchain(int window_id)
 {
     CANVAS_ENTER_FUNC();
@@ -4502,31 +6024,30 @@ static int vk_recreate_swapchain(int window_id)
 
     vk_win->recreating_swapchain = true;
 
-    for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
-    {
-        if (vk_win->in_flight_fences[i] != VK_NULL_HANDLE)
-        {
-            vk_info.vkWaitForFences(vk_info.device, 1, &vk_win->in_flight_fences[i], VK_TRUE, UINT64_MAX);
-        }
-    }
-
-    vk_info.vkDeviceWaitIdle(vk_info.device);
-
-    vk_cleanup_swapchain(window_id);
+    // the old swapchain is handed over and retired, other windows keep rendering
+    VkSwapchainKHR previous = vk_win->swapchain;
 
     int result;
     result = vk_create_swapchain(window_id);
-    if (result != CANVAS_OK)
+    if (result != CANVAS_OK || !vk_win->swapchain || vk_win->swapchain == previous)
     {
+        vk_win->needs_recreate = true;
         vk_win->recreating_swapchain = false;
-        CANVAS_RETURN_ERR(result, "vk_recreate_swapchain: Failed to create swapchain\n");
+
+        if (result != CANVAS_OK)
+            CANVAS_RETURN_ERR(result, "vk_recreate_swapchain: Failed to create swapchain\n");
+
+        CANVAS_RETURN(CANVAS_OK);
     }
 
-    result = vk_create_framebuffers(window_id);
-    if (result != CANVAS_OK)
+    if (!vk_info.dynamic_rendering)
     {
-        vk_win->recreating_swapchain = false;
-        CANVAS_RETURN_ERR(result, "vk_recreate_swapchain: Failed to create framebuffers\n");
+        result = vk_create_framebuffers(window_id);
+        if (result != CANVAS_OK)
+        {
+            vk_win->recreating_swapchain = false;
+            CANVAS_RETURN_ERR(result, "vk_recreate_swapchain: Failed to create framebuffers\n");
+        }
     }
 
     result = vk_create_command_buffers(window_id);
@@ -4537,5188 +6058,11013 @@ static int vk_recreate_swapchain(int window_id)
     }
 
     vk_win->needs_resize = false;
-    vk_win->current_frame = 0;
+    vk_win->needs_recreate = false;
     vk_win->recreating_swapchain = false;
 
+    canvas_info.canvas[window_id].stats.recreated++;
+
     CANVAS_RETURN(CANVAS_OK);
 }
 
-static int vk_record_command_buffer(int window_id, uint32_t image_index)
+// without a render pass the layout transitions are ours to record
+static void vk_transition_image(VkCommandBuffer cmd, VkImage image, VkImageLayout old_layout, VkImageLayout new_layout,
+                                VkAccessFlags src_access, VkAccessFlags dst_access,
+                                VkPipelineStageFlags src_stage, VkPipelineStageFlags dst_stage)
+{
+    VkImageMemoryBarrier barrier = {0};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcAccessMask = src_access;
+    barrier.dstAccessMask = dst_access;
+    barrier.oldLayout = old_layout;
+    barrier.newLayout = new_layout;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = image;
+    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    barrier.subresourceRange.levelCount = 1;
+    barrier.subresourceRange.layerCount = 1;
+
+    vk_info.vkCmdPipelineBarrier(cmd, src_stage, dst_stage, 0, 0, NULL, 0, NULL, 1, &barrier);
+}
+
+// FNV-1a, chained through `hash`
+static uint64_t vk_hash_bytes(uint64_t hash, const void *data, size_t size)
 {
-    CANVAS_ENTER_FUNC();
-    CANVAS_ASSERT_RANGE(window_id, 0, MAX_CANVAS - 1);
+    const uint8_t *bytes = (const uint8_t *)data;
+    for (size_t i = 0; i < size; i++)
+        hash = (hash ^ bytes[i]) * 1099511628211ULL;
+    return hash;
+}
 
-    canvas_vulkan_window *vk_win = &vk_windows[window_id];
-    CANVAS_ASSERT(image_index < vk_win->swapchain_image_count);
-    CANVAS_ASSERT_NOT_NULL(vk_win->command_buffers[image_index]);
-    CANVAS_ASSERT_NOT_NULL(vk_win->render_pass);
-    CANVAS_ASSERT_NOT_NULL(vk_win->framebuffers[image_index]);
+#define CANVAS_VK_HASH_SEED 14695981039346656037ULL
 
-    VkCommandBufferBeginInfo begin_info = {0};
-    begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+static VkDescriptorSetLayout vk_storage_set_layout(void)
+{
+    CANVAS_ENTER_FUNC();
 
-    VkResult result = vk_info.vkBeginCommandBuffer(vk_win->command_buffers[image_index], &begin_info);
-    if (result != VK_SUCCESS)
+    if (vk_info.storage_set_layout)
+        CANVAS_RETURN(vk_info.storage_set_layout);
+
+    VkDescriptorSetLayoutBinding bindings[CANVAS_VK_STORAGE_BINDINGS] = {0};
+    for (uint32_t i = 0; i < CANVAS_VK_STORAGE_BINDINGS; i++)
     {
-        CANVAS_RETURN_ERR(CANVAS_FAIL, "failed to begin command buffer (result=%d)\n", result);
+        bindings[i].binding = i;
+        bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        bindings[i].descriptorCount = 1;
+        bindings[i].stageFlags = VK_SHADER_STAGE_ALL;
     }
 
-    VkRenderPassBeginInfo render_pass_info = {0};
-    render_pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-    render_pass_info.renderPass = vk_win->render_pass;
-    render_pass_info.framebuffer = vk_win->framebuffers[image_index];
-    render_pass_info.renderArea.offset = (VkOffset2D){0, 0};
-    render_pass_info.renderArea.extent = vk_win->swapchain_extent;
-
-    VkClearValue clear_color = {0};
-    clear_color.color.float32[0] = canvas_info.canvas[window_id].clear[0];
-    clear_color.color.float32[1] = canvas_info.canvas[window_id].clear[1];
-    clear_color.color.float32[2] = canvas_info.canvas[window_id].clear[2];
-    clear_color.color.float32[3] = canvas_info.canvas[window_id].clear[3];
-
-    render_pass_info.clearValueCount = 1;
-    render_pass_info.pClearValues = &clear_color;
-
-    vk_info.vkCmdBeginRenderPass(vk_win->command_buffers[image_index], &render_pass_info, VK_SUBPASS_CONTENTS_INLINE);
-
-    vk_info.vkCmdEndRenderPass(vk_win->command_buffers[image_index]);
+    VkDescriptorSetLayoutCreateInfo layout_info = {0};
+    layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layout_info.bindingCount = CANVAS_VK_STORAGE_BINDINGS;
+    layout_info.pBindings = bindings;
 
-    result = vk_info.vkEndCommandBuffer(vk_win->command_buffers[image_index]);
-    if (result != VK_SUCCESS)
-    {
-        CANVAS_RETURN_ERR(CANVAS_FAIL, "failed to end command buffer (result=%d)\n", result);
-    }
+    if (vk_info.vkCreateDescriptorSetLayout(vk_info.device, &layout_info, NULL, &vk_info.storage_set_layout) != VK_SUCCESS)
+        CANVAS_RETURN_ERR(VK_NULL_HANDLE, "failed to create storage descriptor set layout\n");
 
-    CANVAS_RETURN(CANVAS_OK);
+    CANVAS_RETURN(vk_info.storage_set_layout);
 }
 
-static int vk_draw_frame(int window_id)
+// writes the bound storage buffers into a fresh set from the pool, created on first use
+static bool vk_bind_storage_set(VkDescriptorPool *pool, VkCommandBuffer cmd, VkPipelineBindPoint bind_point, VkPipelineLayout layout,
+                                const VkDescriptorBufferInfo *storage, uint32_t storage_mask)
 {
-    CANVAS_ENTER_FUNC();
-    CANVAS_ASSERT_RANGE(window_id, 0, MAX_CANVAS - 1);
-
-    canvas_vulkan_window *vk_win = &vk_windows[window_id];
-
-    if (!vk_win->initialized)
-        CANVAS_RETURN(CANVAS_OK);
-
-    if (vk_win->recreating_swapchain)
-        CANVAS_RETURN(CANVAS_OK);
+    VkDescriptorSetLayout set_layout = vk_storage_set_layout();
+    if (!set_layout || !layout)
+        return false;
 
-    if (vk_win->needs_resize)
+    if (!*pool)
     {
-        int recreate_result = vk_recreate_swapchain(window_id);
+        VkDescriptorPoolSize pool_size = {0};
+        pool_size.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        pool_size.descriptorCount = CANVAS_VK_DESCRIPTOR_SETS * CANVAS_VK_STORAGE_BINDINGS;
 
-        if (recreate_result != CANVAS_OK)
-            CANVAS_RETURN(CANVAS_OK);
+        VkDescriptorPoolCreateInfo pool_info = {0};
+        pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        pool_info.maxSets = CANVAS_VK_DESCRIPTOR_SETS;
+        pool_info.poolSizeCount = 1;
+        pool_info.pPoolSizes = &pool_size;
 
-        if (!vk_win->swapchain)
-            CANVAS_RETURN(CANVAS_OK);
+        if (vk_info.vkCreateDescriptorPool(vk_info.device, &pool_info, NULL, pool) != VK_SUCCESS)
+            return false;
     }
 
-    CANVAS_ASSERT_NOT_NULL(vk_info.device);
-    CANVAS_ASSERT_NOT_NULL(vk_win->swapchain);
-
-    uint32_t frame_index = vk_win->current_frame % MAX_FRAMES_IN_FLIGHT;
-    VkFence current_fence = vk_win->in_flight_fences[frame_index];
-
-    if (current_fence == VK_NULL_HANDLE)
-        CANVAS_RETURN(CANVAS_FAIL);
-
-    vk_info.vkWaitForFences(vk_info.device, 1, &current_fence, VK_TRUE, UINT64_MAX);
+    VkDescriptorSetAllocateInfo alloc_info = {0};
+    alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    alloc_info.descriptorPool = *pool;
+    alloc_info.descriptorSetCount = 1;
+    alloc_info.pSetLayouts = &set_layout;
 
-    uint32_t image_index;
+    VkDescriptorSet set;
+    if (vk_info.vkAllocateDescriptorSets(vk_info.device, &alloc_info, &set) != VK_SUCCESS)
+        return false;
 
-    VkResult result = vk_info.vkAcquireNextImageKHR(
-        vk_info.device, vk_win->swapchain, UINT64_MAX,
-        vk_win->image_available_semaphores[frame_index],
-        VK_NULL_HANDLE, &image_index);
+    VkWriteDescriptorSet writes[CANVAS_VK_STORAGE_BINDINGS];
+    uint32_t write_count = 0;
 
-    if (result == VK_ERROR_OUT_OF_DATE_KHR)
-    {
-        int recreate_result = vk_recreate_swapchain(window_id);
-        CANVAS_RETURN(recreate_result);
-    }
-    else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR)
+    for (uint32_t i = 0; i < CANVAS_VK_STORAGE_BINDINGS; i++)
     {
-        CANVAS_RETURN_ERR(CANVAS_FAIL, "failed to acquire swapchain image\n");
-    }
+        if (!(storage_mask & (1u << i)))
+            continue;
 
-    if (image_index >= vk_win->swapchain_image_count)
-    {
-        CANVAS_RETURN(CANVAS_FAIL);
+        VkWriteDescriptorSet write = {0};
+        write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write.dstSet = set;
+        write.dstBinding = i;
+        write.descriptorCount = 1;
+        write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        write.pBufferInfo = &storage[i];
+        writes[write_count++] = write;
     }
 
-    if (vk_win->images_in_flight[image_index] != VK_NULL_HANDLE)
+    vk_info.vkUpdateDescriptorSets(vk_info.device, write_count, writes, 0, NULL);
+    vk_info.vkCmdBindDescriptorSets(cmd, bind_point, layout, 0, 1, &set, 0, NULL);
+    return true;
+}
+
+static void vk_replay_indirect(VkCommandBuffer cmd, const canvas_vk_command *command)
+{
+    bool indexed = command->type == CANVAS_VK_CMD_DRAW_INDEXED_INDIRECT;
+
+    if (command->indirect.count_buffer)
     {
-        vk_info.vkWaitForFences(vk_info.device, 1, &vk_win->images_in_flight[image_index], VK_TRUE, UINT64_MAX);
+        if (indexed)
+            vk_info.vkCmdDrawIndexedIndirectCount(cmd, command->indirect.buffer, command->indirect.offset, command->indirect.count_buffer,
+                                                  command->indirect.count_offset, command->indirect.draw_count, command->indirect.stride);
+        else
+            vk_info.vkCmdDrawIndirectCount(cmd, command->indirect.buffer, command->indirect.offset, command->indirect.count_buffer,
+                                           command->indirect.count_offset, command->indirect.draw_count, command->indirect.stride);
+        return;
     }
 
-    vk_info.vkResetFences(vk_info.device, 1, &current_fence);
-    vk_win->images_in_flight[image_index] = current_fence;
+    // one call covers every record with multiDrawIndirect, otherwise one call each
+    uint32_t calls = vk_info.multi_draw_indirect ? 1 : command->indirect.draw_count;
+    uint32_t per_call = vk_info.multi_draw_indirect ? command->indirect.draw_count : 1;
 
-    int record_result = vk_record_command_buffer(window_id, image_index);
-
-    if (record_result != CANVAS_OK)
+    for (uint32_t i = 0; i < calls; i++)
     {
-        vk_win->images_in_flight[image_index] = VK_NULL_HANDLE;
-        CANVAS_RETURN(record_result);
+        VkDeviceSize offset = command->indirect.offset + (VkDeviceSize)i * command->indirect.stride;
+        if (indexed)
+            vk_info.vkCmdDrawIndexedIndirect(cmd, command->indirect.buffer, offset, per_call, command->indirect.stride);
+        else
+            vk_info.vkCmdDrawIndirect(cmd, command->indirect.buffer, offset, per_call, command->indirect.stride);
     }
+}
 
-    VkSubmitInfo submit_info = {0};
-    submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+// compute shader writes become visible to every stage that reads buffers in the pass
+static void vk_compute_barrier(VkCommandBuffer cmd)
+{
+    VkMemoryBarrier barrier = {0};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT |
+                            VK_ACCESS_UNIFORM_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
 
-    VkSemaphore wait_semaphores[] = {vk_win->image_available_semaphores[frame_index]};
-    VkPipelineStageFlags wait_stages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
-    submit_info.waitSemaphoreCount = 1;
-    submit_info.pWaitSemaphores = wait_semaphores;
-    submit_info.pWaitDstStageMask = wait_stages;
-    submit_info.commandBufferCount = 1;
-    submit_info.pCommandBuffers = &vk_win->command_buffers[image_index];
+    vk_info.vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                 VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT |
+                                     VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                                 0, 1, &barrier, 0, NULL, 0, NULL);
+}
 
-    VkSemaphore signal_semaphores[] = {vk_win->render_finished_semaphores[image_index]};
-    submit_info.signalSemaphoreCount = 1;
-    submit_info.pSignalSemaphores = signal_semaphores;
+// replays the dispatches of the window's stream ahead of its pass, returns how many were recorded
+static uint32_t vk_replay_compute(int window_id, VkCommandBuffer cmd, VkDescriptorPool *pool)
+{
+    canvas_vulkan_window *vk_win = &vk_windows[window_id];
 
-    result = vk_info.vkQueueSubmit(vk_info.graphics_queue, 1, &submit_info, current_fence);
-    if (result != VK_SUCCESS)
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    VkPipelineLayout layout = VK_NULL_HANDLE;
+    VkDescriptorBufferInfo storage[CANVAS_VK_STORAGE_BINDINGS] = {0};
+    uint32_t storage_mask = 0;
+    bool storage_dirty = false;
+    uint32_t dispatches = 0;
+
+    for (uint32_t i = 0; i < vk_win->command_count; i++)
     {
-        CANVAS_ERR("failed to submit draw command buffer\n");
-        vk_win->images_in_flight[image_index] = VK_NULL_HANDLE;
-        CANVAS_RETURN(CANVAS_FAIL);
-    }
+        const canvas_vk_command *command = &vk_win->commands[i];
 
-    VkPresentInfoKHR present_info = {0};
-    present_info.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
-    present_info.waitSemaphoreCount = 1;
-    present_info.pWaitSemaphores = signal_semaphores;
+        if (command->type == CANVAS_VK_CMD_STORAGE)
+        {
+            storage[command->slot].buffer = command->buffer.buffer;
+            storage[command->slot].offset = command->buffer.offset;
+            storage[command->slot].range = command->buffer.range;
+            storage_mask |= 1u << command->slot;
+            storage_dirty = true;
+            continue;
+        }
 
-    VkSwapchainKHR swapchains[] = {vk_win->swapchain};
-    present_info.swapchainCount = 1;
-    present_info.pSwapchains = swapchains;
-    present_info.pImageIndices = &image_index;
+        if (command->type != CANVAS_VK_CMD_DISPATCH)
+            continue;
 
-    result = vk_info.vkQueuePresentKHR(vk_info.present_queue, &present_info);
+        // earlier draws and dispatches may read or write what this one touches
+        VkMemoryBarrier barrier = {0};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
 
-    vk_win->current_frame = (vk_win->current_frame + 1);
+        VkPipelineStageFlags src_stage = dispatches ? VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT
+                                                    : VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT |
+                                                          VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
 
-    if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || vk_win->needs_resize)
-    {
-        vk_win->needs_resize = false;
-        int recreate_result = vk_recreate_swapchain(window_id);
-        CANVAS_RETURN(recreate_result);
-    }
-    else if (result != VK_SUCCESS)
-    {
-        CANVAS_RETURN_ERR(CANVAS_FAIL, "failed to present swapchain image\n");
-    }
+        vk_info.vkCmdPipelineBarrier(cmd, src_stage, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, NULL, 0, NULL);
 
-    CANVAS_RETURN(CANVAS_OK);
-}
+        if (command->dispatch.pipeline != pipeline)
+        {
+            vk_info.vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, command->dispatch.pipeline);
+            pipeline = command->dispatch.pipeline;
 
-static uint32_t vk_find_memory_type(uint32_t type_filter, VkMemoryPropertyFlags properties)
-{
-    CANVAS_ENTER_FUNC();
-    CANVAS_ASSERT_NOT_NULL(vk_info.physical_device);
-
-    VkPhysicalDeviceMemoryProperties mem_props;
-    vk_info.vkGetPhysicalDeviceMemoryProperties(vk_info.physical_device, &mem_props);
+            if (command->dispatch.layout != layout)
+                storage_dirty = storage_mask != 0;
+            layout = command->dispatch.layout;
+        }
 
-    for (uint32_t i = 0; i < mem_props.memoryTypeCount; i++)
-    {
-        if ((type_filter & (1 << i)) && (mem_props.memoryTypes[i].propertyFlags & properties) == properties)
+        if (storage_dirty)
         {
-            CANVAS_RETURN(i);
+            if (!vk_bind_storage_set(pool, cmd, VK_PIPELINE_BIND_POINT_COMPUTE, layout, storage, storage_mask))
+            {
+                CANVAS_WARN("window %d: out of storage descriptor sets, dispatch skipped\n", window_id);
+                continue;
+            }
+            storage_dirty = false;
         }
+
+        vk_info.vkCmdDispatch(cmd, command->dispatch.x, command->dispatch.y, command->dispatch.z);
+        dispatches++;
     }
 
-    CANVAS_RETURN_ERR(UINT32_MAX, "Failed to find suitable memory type\n");
+    return dispatches;
 }
 
-static int _vulkan_upload_buffer_data(canvas_buffer *buf, void *data, size_t size)
+// replays the window's draw stream inside the pass, binds that match the current state are dropped
+static void vk_replay_commands(int window_id, uint32_t image_index, VkCommandBuffer cmd)
 {
-    CANVAS_ENTER_FUNC();
-    CANVAS_ASSERT_NOT_NULL(buf);
-    CANVAS_ASSERT_NOT_NULL(data);
-    CANVAS_ASSERT(size > 0);
-    CANVAS_ASSERT_NOT_NULL(vk_info.device);
-
-    VkBufferCreateInfo staging_info = {0};
-    staging_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-    staging_info.size = size;
-    staging_info.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-    staging_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-
-    VkBuffer staging_buffer;
-    VkResult result = vk_info.vkCreateBuffer(vk_info.device, &staging_info, NULL, &staging_buffer);
-    if (result != VK_SUCCESS)
-    {
-        CANVAS_RETURN_ERR(CANVAS_FAIL, "Failed to create staging buffer\n");
-    }
+    canvas_vulkan_window *vk_win = &vk_windows[window_id];
+    canvas_frame_stats *stats = &canvas_info.canvas[window_id].stats;
 
-    VkMemoryRequirements mem_reqs;
-    vk_info.vkGetBufferMemoryRequirements(vk_info.device, staging_buffer, &mem_reqs);
+    if (vk_win->command_count == 0)
+        return;
 
-    VkMemoryAllocateInfo alloc_info = {0};
-    alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    alloc_info.allocationSize = mem_reqs.size;
-    alloc_info.memoryTypeIndex = vk_find_memory_type(
-        mem_reqs.memoryTypeBits,
-        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    // canvas pipelines keep viewport and scissor dynamic so they survive resizes
+    VkViewport viewport = {0};
+    viewport.width = (float)vk_win->swapchain_extent.width;
+    viewport.height = (float)vk_win->swapchain_extent.height;
+    viewport.maxDepth = 1.0f;
 
-    if (alloc_info.memoryTypeIndex == UINT32_MAX)
-    {
-        vk_info.vkDestroyBuffer(vk_info.device, staging_buffer, NULL);
-        CANVAS_RETURN_ERR(CANVAS_FAIL, "Failed to find suitable memory type for staging buffer\n");
-    }
+    VkRect2D scissor = {0};
+    scissor.extent = vk_win->swapchain_extent;
 
-    VkDeviceMemory staging_memory;
-    result = vk_info.vkAllocateMemory(vk_info.device, &alloc_info,
-                                      NULL, &staging_memory);
-    if (result != VK_SUCCESS)
-    {
-        vk_info.vkDestroyBuffer(vk_info.device, staging_buffer, NULL);
-        CANVAS_RETURN_ERR(CANVAS_FAIL, "Failed to allocate staging memory\n");
-    }
+    vk_info.vkCmdSetViewport(cmd, 0, 1, &viewport);
+    vk_info.vkCmdSetScissor(cmd, 0, 1, &scissor);
 
-    vk_info.vkBindBufferMemory(vk_info.device, staging_buffer, staging_memory, 0);
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    VkPipelineLayout layout = VK_NULL_HANDLE;
+    VkBuffer vertex_buffers[CANVAS_VK_MAX_VERTEX_BINDINGS] = {0};
+    VkDeviceSize vertex_offsets[CANVAS_VK_MAX_VERTEX_BINDINGS] = {0};
+    VkBuffer index_buffer = VK_NULL_HANDLE;
+    VkDeviceSize index_offset = 0;
+    VkDescriptorBufferInfo storage[CANVAS_VK_STORAGE_BINDINGS] = {0};
+    uint32_t storage_mask = 0;
+    bool storage_dirty = false;
 
-    // Copy data to staging
-    void *mapped;
-    result = vk_info.vkMapMemory(vk_info.device, staging_memory, 0, size, 0, &mapped);
-    if (result != VK_SUCCESS)
+    for (uint32_t i = 0; i < vk_win->command_count; i++)
     {
-        vk_info.vkFreeMemory(vk_info.device, staging_memory, NULL);
-        vk_info.vkDestroyBuffer(vk_info.device, staging_buffer, NULL);
-        CANVAS_RETURN_ERR(CANVAS_FAIL, "Failed to map staging memory\n");
-    }
+        const canvas_vk_command *command = &vk_win->commands[i];
 
-    memcpy(mapped, data, size);
-    vk_info.vkUnmapMemory(vk_info.device, staging_memory);
+        switch (command->type)
+        {
+        case CANVAS_VK_CMD_PIPELINE:
+            if (command->pipeline.pipeline == pipeline)
+            {
+                stats->binds_skipped++;
+                break;
+            }
 
-    // Create one-time command buffer
-    canvas_vulkan_window *vk_win = &vk_windows[buf->window_id];
+            vk_info.vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, command->pipeline.pipeline);
+            pipeline = command->pipeline.pipeline;
 
-    VkCommandBufferAllocateInfo cmd_alloc_info = {0};
-    cmd_alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-    cmd_alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    cmd_alloc_info.commandPool = vk_win->command_pool;
-    cmd_alloc_info.commandBufferCount = 1;
+            // a different layout may disturb set 0
+            if (command->pipeline.layout != layout)
+                storage_dirty = storage_mask != 0;
+            layout = command->pipeline.layout;
+            break;
 
-    VkCommandBuffer cmd_buffer;
-    vk_info.vkAllocateCommandBuffers(vk_info.device, &cmd_alloc_info, &cmd_buffer);
+        case CANVAS_VK_CMD_VERTEX:
+            if (vertex_buffers[command->slot] == command->buffer.buffer && vertex_offsets[command->slot] == command->buffer.offset)
+            {
+                stats->binds_skipped++;
+                break;
+            }
 
-    // Begin recording
-    VkCommandBufferBeginInfo begin_info = {0};
-    begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-    begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+            vk_info.vkCmdBindVertexBuffers(cmd, command->slot, 1, &command->buffer.buffer, &command->buffer.offset);
+            vertex_buffers[command->slot] = command->buffer.buffer;
+            vertex_offsets[command->slot] = command->buffer.offset;
+            break;
 
-    vk_info.vkBeginCommandBuffer(cmd_buffer, &begin_info);
+        case CANVAS_VK_CMD_INDEX:
+            if (index_buffer == command->buffer.buffer && index_offset == command->buffer.offset)
+            {
+                stats->binds_skipped++;
+                break;
+            }
 
-    // Copy command
-    VkBufferCopy copy_region = {0};
-    copy_region.srcOffset = 0;
-    copy_region.dstOffset = 0;
-    copy_region.size = size;
+            vk_info.vkCmdBindIndexBuffer(cmd, command->buffer.buffer, command->buffer.offset, VK_INDEX_TYPE_UINT32);
+            index_buffer = command->buffer.buffer;
+            index_offset = command->buffer.offset;
+            break;
 
-    vk_info.vkCmdCopyBuffer(cmd_buffer, staging_buffer,
-                            (VkBuffer)buf->platform_handle, 1, &copy_region);
+        case CANVAS_VK_CMD_STORAGE:
+        {
+            VkDescriptorBufferInfo *info = &storage[command->slot];
+            if ((storage_mask & (1u << command->slot)) && info->buffer == command->buffer.buffer &&
+                info->offset == command->buffer.offset && info->range == command->buffer.range)
+            {
+                stats->binds_skipped++;
+                break;
+            }
 
-    vk_info.vkEndCommandBuffer(cmd_buffer);
+            info->buffer = command->buffer.buffer;
+            info->offset = command->buffer.offset;
+            info->range = command->buffer.range;
+            storage_mask |= 1u << command->slot;
+            storage_dirty = true;
+            break;
+        }
 
-    // Submit and wait
-    VkSubmitInfo submit_info = {0};
-    submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    submit_info.commandBufferCount = 1;
-    submit_info.pCommandBuffers = &cmd_buffer;
+        case CANVAS_VK_CMD_DRAW:
+        case CANVAS_VK_CMD_DRAW_INDEXED:
+        case CANVAS_VK_CMD_DRAW_INDIRECT:
+        case CANVAS_VK_CMD_DRAW_INDEXED_INDIRECT:
+            if (!pipeline)
+            {
+                CANVAS_WARN("window %d: draw without a pipeline skipped\n", window_id);
+                break;
+            }
 
-    vk_info.vkQueueSubmit(vk_info.graphics_queue, 1, &submit_info, VK_NULL_HANDLE);
-    vk_info.vkQueueWaitIdle(vk_info.graphics_queue);
+            // storage changes are folded into one descriptor set per draw that needs it
+            if (storage_dirty)
+            {
+                if (!vk_bind_storage_set(&vk_win->descriptor_pools[image_index], cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, layout, storage, storage_mask))
+                {
+                    CANVAS_WARN("window %d: out of storage descriptor sets, draw skipped\n", window_id);
+                    break;
+                }
+                storage_dirty = false;
+            }
 
-    // Cleanup
-    vk_info.vkFreeCommandBuffers(vk_info.device, vk_win->command_pool, 1, &cmd_buffer);
-    vk_info.vkFreeMemory(vk_info.device, staging_memory, NULL);
-    vk_info.vkDestroyBuffer(vk_info.device, staging_buffer, NULL);
+            if (command->type == CANVAS_VK_CMD_DRAW)
+                vk_info.vkCmdDraw(cmd, command->draw.count, command->draw.instance_count, command->draw.first, command->draw.first_instance);
+            else if (command->type == CANVAS_VK_CMD_DRAW_INDEXED)
+                vk_info.vkCmdDrawIndexed(cmd, command->draw.count, command->draw.instance_count, command->draw.first, command->draw.vertex_offset, command->draw.first_instance);
+            else
+                vk_replay_indirect(cmd, command);
 
-    CANVAS_RETURN(CANVAS_OK);
+            stats->draws++;
+            break;
+        }
+    }
 }
 
-canvas_buffer *canvas_buffer_create(int window_id, canvas_buffer_type type, canvas_buffer_usage usage, size_t size, void *initial_data)
-{
-    CANVAS_ENTER_FUNC();
-    CANVAS_ASSERT_RANGE(window_id, 0, MAX_CANVAS - 1);
-    CANVAS_ASSERT(size > 0);
-    CANVAS_ASSERT_RANGE(type, CANVAS_BUFFER_VERTEX, CANVAS_BUFFER_STORAGE);
-    CANVAS_ASSERT_RANGE(usage, CANVAS_BUFFER_STATIC, CANVAS_BUFFER_STAGING);
+/*
+ * Batch shaders, SPIR-V 1.0. Equivalent GLSL:
+ *
+ * layout(location = 0) in vec2 origin;
+ * layout(location = 1) in vec2 axis_x;
+ * layout(location = 2) in vec2 axis_y;
+ * layout(location = 3) in vec4 uv;
+ * layout(location = 4) in vec4 color;
+ * layout(push_constant) uniform constants { vec2 scale; }; // 2 / framebuffer size
+ *
+ * void main()
+ * {
+ *     vec2 corner = vec2(gl_VertexIndex & 1, gl_VertexIndex >> 1);
+ *     vec2 position = origin + axis_x * corner.x + axis_y * corner.y;
+ *     gl_Position = vec4(position * scale - 1.0, 0.0, 1.0);
+ *     out_uv = uv.xy + (uv.zw - uv.xy) * corner;
+ *     out_color = color;
+ * }
+ *
+ * layout(set = 0, binding = 0) readonly buffer image { uint width; uint height; uint texels[]; };
+ *
+ * void main()
+ * {
+ *     vec2 t = clamp(in_uv, 0.0, 1.0);
+ *     uint x = min(uint(t.x * float(width)), width - 1);
+ *     uint y = min(uint(t.y * float(height)), height - 1);
+ *     vec4 texel = unpackUnorm4x8(texels[y * width + x]);
+ *     out_color = in_color * (in_uv.x < 0.0 ? vec4(1.0) : texel);
+ * }
+ */
+static const uint32_t canvas_vk_batch_vert[] = {
+    0x07230203, 0x00010000, 0x00000000, 0x0000003b, 0x00000000, 0x00020011, 0x00000001, 0x0003000e,
+    0x00000000, 0x00000001, 0x000e000f, 0x00000000, 0x00000001, 0x6e69616d, 0x00000000, 0x00000002,
+    0x00000003, 0x00000004, 0x00000005, 0x00000006, 0x00000007, 0x00000008, 0x00000009, 0x0000000a,
+    0x00040047, 0x00000002, 0x0000001e, 0x00000000, 0x00040047, 0x00000003, 0x0000001e, 0x00000001,
+    0x00040047, 0x00000004, 0x0000001e, 0x00000002, 0x00040047, 0x00000005, 0x0000001e, 0x00000003,
+    0x00040047, 0x00000006, 0x0000001e, 0x00000004, 0x00040047, 0x00000007, 0x0000000b, 0x0000002a,
+    0x00040047, 0x0000000a, 0x0000000b, 0x00000000, 0x00040047, 0x00000008, 0x0000001e, 0x00000000,
+    0x00040047, 0x00000009, 0x0000001e, 0x00000001, 0x00050048, 0x0000000b, 0x00000000, 0x00000023,
+    0x00000000, 0x00030047, 0x0000000b, 0x00000002, 0x00020013, 0x0000000c, 0x00030021, 0x0000000d,
+    0x0000000c, 0x00030016, 0x0000000e, 0x00000020, 0x00040017, 0x0000000f, 0x0000000e, 0x00000002,
+    0x00040017, 0x00000010, 0x0000000e, 0x00000004, 0x00040015, 0x00000011, 0x00000020, 0x00000001,
+    0x00040020, 0x00000012, 0x00000001, 0x0000000f, 0x00040020, 0x00000013, 0x00000001, 0x00000010,
+    0x00040020, 0x00000014, 0x00000001, 0x00000011, 0x00040020, 0x00000015, 0x00000003, 0x0000000f,
+    0x00040020, 0x00000016, 0x00000003, 0x00000010, 0x0003001e, 0x0000000b, 0x0000000f, 0x00040020,
+    0x00000017, 0x00000009, 0x0000000b, 0x00040020, 0x00000018, 0x00000009, 0x0000000f, 0x0004002b,
+    0x00000011, 0x00000019, 0x00000000, 0x0004002b, 0x00000011, 0x0000001a, 0x00000001, 0x0004002b,
+    0x0000000e, 0x0000001b, 0x00000000, 0x0004002b, 0x0000000e, 0x0000001c, 0x3f800000, 0x0005002c,
+    0x0000000f, 0x0000001d, 0x0000001c, 0x0000001c, 0x0004003b, 0x00000012, 0x00000002, 0x00000001,
+    0x0004003b, 0x00000012, 0x00000003, 0x00000001, 0x0004003b, 0x00000012, 0x00000004, 0x00000001,
+    0x0004003b, 0x00000013, 0x00000005, 0x00000001, 0x0004003b, 0x00000013, 0x00000006, 0x00000001,
+    0x0004003b, 0x00000014, 0x00000007, 0x00000001, 0x0004003b, 0x00000015, 0x00000008, 0x00000003,
+    0x0004003b, 0x00000016, 0x00000009, 0x00000003, 0x0004003b, 0x00000016, 0x0000000a, 0x00000003,
+    0x0004003b, 0x00000017, 0x0000001e, 0x00000009, 0x00050036, 0x0000000c, 0x00000001, 0x00000000,
+    0x0000000d, 0x000200f8, 0x0000001f, 0x0004003d, 0x00000011, 0x00000020, 0x00000007, 0x000500c7,
+    0x00000011, 0x00000021, 0x00000020, 0x0000001a, 0x000500c3, 0x00000011, 0x00000022, 0x00000020,
+    0x0000001a, 0x0004006f, 0x0000000e, 0x00000023, 0x00000021, 0x0004006f, 0x0000000e, 0x00000024,
+    0x00000022, 0x00050050, 0x0000000f, 0x00000025, 0x00000023, 0x00000024, 0x0004003d, 0x0000000f,
+    0x00000026, 0x00000002, 0x0004003d, 0x0000000f, 0x00000027, 0x00000003, 0x0004003d, 0x0000000f,
+    0x00000028, 0x00000004, 0x0005008e, 0x0000000f, 0x00000029, 0x00000027, 0x00000023, 0x0005008e,
+    0x0000000f, 0x0000002a, 0x00000028, 0x00000024, 0x00050081, 0x0000000f, 0x0000002b, 0x00000026,
+    0x00000029, 0x00050081, 0x0000000f, 0x0000002c, 0x0000002b, 0x0000002a, 0x00050041, 0x00000018,
+    0x0000002d, 0x0000001e, 0x00000019, 0x0004003d, 0x0000000f, 0x0000002e, 0x0000002d, 0x00050085,
+    0x0000000f, 0x0000002f, 0x0000002c, 0x0000002e, 0x00050083, 0x0000000f, 0x00000030, 0x0000002f,
+    0x0000001d, 0x00050051, 0x0000000e, 0x00000031, 0x00000030, 0x00000000, 0x00050051, 0x0000000e,
+    0x00000032, 0x00000030, 0x00000001, 0x00070050, 0x00000010, 0x00000033, 0x00000031, 0x00000032,
+    0x0000001b, 0x0000001c, 0x0003003e, 0x0000000a, 0x00000033, 0x0004003d, 0x00000010, 0x00000034,
+    0x00000005, 0x0007004f, 0x0000000f, 0x00000035, 0x00000034, 0x00000034, 0x00000000, 0x00000001,
+    0x0007004f, 0x0000000f, 0x00000036, 0x00000034, 0x00000034, 0x00000002, 0x00000003, 0x00050083,
+    0x0000000f, 0x00000037, 0x00000036, 0x00000035, 0x00050085, 0x0000000f, 0x00000038, 0x00000037,
+    0x00000025, 0x00050081, 0x0000000f, 0x00000039, 0x00000035, 0x00000038, 0x0003003e, 0x00000008,
+    0x00000039, 0x0004003d, 0x00000010, 0x0000003a, 0x00000006, 0x0003003e, 0x00000009, 0x0000003a,
+    0x000100fd, 0x00010038,
+};
 
-    CANVAS_VALID_PTR(window_id);
+static const uint32_t canvas_vk_batch_frag[] = {
+    0x07230203, 0x00010000, 0x00000000, 0x0000003e, 0x00000000, 0x00020011, 0x00000001, 0x0006000b,
+    0x00000001, 0x4c534c47, 0x6474732e, 0x3035342e, 0x00000000, 0x0003000e, 0x00000000, 0x00000001,
+    0x0008000f, 0x00000004, 0x00000002, 0x6e69616d, 0x00000000, 0x00000003, 0x00000004, 0x00000005,
+    0x00030010, 0x00000002, 0x00000007, 0x00040047, 0x00000003, 0x0000001e, 0x00000000, 0x00040047,
+    0x00000004, 0x0000001e, 0x00000001, 0x00040047, 0x00000005, 0x0000001e, 0x00000000, 0x00040047,
+    0x00000006, 0x00000006, 0x00000004, 0x00040048, 0x00000007, 0x00000000, 0x00000018, 0x00050048,
+    0x00000007, 0x00000000, 0x00000023, 0x00000000, 0x00040048, 0x00000007, 0x00000001, 0x00000018,
+    0x00050048, 0x00000007, 0x00000001, 0x00000023, 0x00000004, 0x00040048, 0x00000007, 0x00000002,
+    0x00000018, 0x00050048, 0x00000007, 0x00000002, 0x00000023, 0x00000008, 0x00030047, 0x00000007,
+    0x00000003, 0x00040047, 0x00000008, 0x00000022, 0x00000000, 0x00040047, 0x00000008, 0x00000021,
+    0x00000000, 0x00020013, 0x00000009, 0x00030021, 0x0000000a, 0x00000009, 0x00030016, 0x0000000b,
+    0x00000020, 0x00040017, 0x0000000c, 0x0000000b, 0x00000002, 0x00040017, 0x0000000d, 0x0000000b,
+    0x00000004, 0x00040015, 0x0000000e, 0x00000020, 0x00000000, 0x00040015, 0x0000000f, 0x00000020,
+    0x00000001, 0x00020014, 0x00000010, 0x00040017, 0x00000011, 0x00000010, 0x00000004, 0x0003001d,
+    0x00000006, 0x0000000e, 0x0005001e, 0x00000007, 0x0000000e, 0x0000000e, 0x00000006, 0x00040020,
+    0x00000012, 0x00000002, 0x00000007, 0x00040020, 0x00000013, 0x00000002, 0x0000000e, 0x00040020,
+    0x00000014, 0x00000001, 0x0000000c, 0x00040020, 0x00000015, 0x00000001, 0x0000000d, 0x00040020,
+    0x00000016, 0x00000003, 0x0000000d, 0x0004002b, 0x0000000f, 0x00000017, 0x00000000, 0x0004002b,
+    0x0000000f, 0x00000018, 0x00000001, 0x0004002b, 0x0000000f, 0x00000019, 0x00000002, 0x0004002b,
+    0x0000000e, 0x0000001a, 0x00000001, 0x0004002b, 0x0000000b, 0x0000001b, 0x00000000, 0x0004002b,
+    0x0000000b, 0x0000001c, 0x3f800000, 0x0005002c, 0x0000000c, 0x0000001d, 0x0000001b, 0x0000001b,
+    0x0005002c, 0x0000000c, 0x0000001e, 0x0000001c, 0x0000001c, 0x0007002c, 0x0000000d, 0x0000001f,
+    0x0000001c, 0x0000001c, 0x0000001c, 0x0000001c, 0x0004003b, 0x00000014, 0x00000003, 0x00000001,
+    0x0004003b, 0x00000015, 0x00000004, 0x00000001, 0x0004003b, 0x00000016, 0x00000005, 0x00000003,
+    0x0004003b, 0x00000012, 0x00000008, 0x00000002, 0x00050036, 0x00000009, 0x00000002, 0x00000000,
+    0x0000000a, 0x000200f8, 0x00000020, 0x0004003d, 0x0000000c, 0x00000021, 0x00000003, 0x0008000c,
+    0x0000000c, 0x00000022, 0x00000001, 0x0000002b, 0x00000021, 0x0000001d, 0x0000001e, 0x00050041,
+    0x00000013, 0x00000023, 0x00000008, 0x00000017, 0x0004003d, 0x0000000e, 0x00000024, 0x00000023,
+    0x00050041, 0x00000013, 0x00000025, 0x00000008, 0x00000018, 0x0004003d, 0x0000000e, 0x00000026,
+    0x00000025, 0x00040070, 0x0000000b, 0x00000027, 0x00000024, 0x00040070, 0x0000000b, 0x00000028,
+    0x00000026, 0x00050051, 0x0000000b, 0x00000029, 0x00000022, 0x00000000, 0x00050051, 0x0000000b,
+    0x0000002a, 0x00000022, 0x00000001, 0x00050085, 0x0000000b, 0x0000002b, 0x00000029, 0x00000027,
+    0x00050085, 0x0000000b, 0x0000002c, 0x0000002a, 0x00000028, 0x0004006d, 0x0000000e, 0x0000002d,
+    0x0000002b, 0x0004006d, 0x0000000e, 0x0000002e, 0x0000002c, 0x00050082, 0x0000000e, 0x0000002f,
+    0x00000024, 0x0000001a, 0x00050082, 0x0000000e, 0x00000030, 0x00000026, 0x0000001a, 0x0007000c,
+    0x0000000e, 0x00000031, 0x00000001, 0x00000026, 0x0000002d, 0x0000002f, 0x0007000c, 0x0000000e,
+    0x00000032, 0x00000001, 0x00000026, 0x0000002e, 0x00000030, 0x00050084, 0x0000000e, 0x00000033,
+    0x00000032, 0x00000024, 0x00050080, 0x0000000e, 0x00000034, 0x00000033, 0x00000031, 0x00060041,
+    0x00000013, 0x00000035, 0x00000008, 0x00000019, 0x00000034, 0x0004003d, 0x0000000e, 0x00000036,
+    0x00000035, 0x0006000c, 0x0000000d, 0x00000037, 0x00000001, 0x00000040, 0x00000036, 0x00050051,
+    0x0000000b, 0x00000038, 0x00000021, 0x00000000, 0x000500b8, 0x00000010, 0x00000039, 0x00000038,
+    0x0000001b, 0x00070050, 0x00000011, 0x0000003a, 0x00000039, 0x00000039, 0x00000039, 0x00000039,
+    0x000600a9, 0x0000000d, 0x0000003b, 0x0000003a, 0x0000001f, 0x00000037, 0x0004003d, 0x0000000d,
+    0x0000003c, 0x00000004, 0x00050085, 0x0000000d, 0x0000003d, 0x0000003c, 0x0000003b, 0x0003003e,
+    0x00000005, 0x0000003d, 0x000100fd, 0x00010038,
+};
 
-    CANVAS_ASSERT_NOT_NULL(vk_info.device);
-    CANVAS_ASSERT_NOT_NULL(vk_info.vkCreateBuffer);
-    CANVAS_ASSERT_NOT_NULL(vk_info.vkAllocateMemory);
-    CANVAS_ASSERT_NOT_NULL(vk_info.vkBindBufferMemory);
+// blend mode pipelines for the window's format and the white image, built on the first primitive
+static bool vk_batch_prepare(int window_id)
+{
+    canvas_vulkan_window *vk_win = &vk_windows[window_id];
+    canvas_vk_batch *batch = &vk_win->batch;
 
-    if (!vk_info.device)
+    if (!batch->white)
     {
-        CANVAS_RETURN_ERR(NULL, "GPU not initialized\\n");
+        uint32_t white = 0xffffffffu;
+        batch->white = canvas_image_create(window_id, 1, 1, &white);
+        if (!batch->white)
+            return false;
     }
 
-    canvas_buffer *buf = (canvas_buffer *)calloc(1, sizeof(canvas_buffer));
-    if (!buf)
-    {
-        CANVAS_RETURN(NULL);
-    }
-    CANVAS_ASSERT_NOT_NULL(buf);
+    if (batch->pipelines[0] && batch->pipeline_format == vk_win->swapchain_format)
+        return true;
 
-    buf->size = size;
-    buf->type = type;
-    buf->usage = usage;
-    buf->window_id = window_id;
+    canvas_vertex_binding binding = {sizeof(canvas_vk_quad), true};
+    canvas_vertex_attribute attributes[] = {
+        {0, 0, CANVAS_VERTEX_FLOAT2, offsetof(canvas_vk_quad, origin)},
+        {1, 0, CANVAS_VERTEX_FLOAT2, offsetof(canvas_vk_quad, axis_x)},
+        {2, 0, CANVAS_VERTEX_FLOAT2, offsetof(canvas_vk_quad, axis_y)},
+        {3, 0, CANVAS_VERTEX_FLOAT4, offsetof(canvas_vk_quad, uv)},
+        {4, 0, CANVAS_VERTEX_UBYTE4_NORM, offsetof(canvas_vk_quad, color)},
+    };
 
-    // Determine usage flags
-    VkBufferUsageFlags usage_flags;
-    switch (type)
+    canvas_pipeline_desc desc = {0};
+    desc.vertex_spirv = canvas_vk_batch_vert;
+    desc.vertex_size = sizeof(canvas_vk_batch_vert);
+    desc.fragment_spirv = canvas_vk_batch_frag;
+    desc.fragment_size = sizeof(canvas_vk_batch_frag);
+    desc.bindings = &binding;
+    desc.binding_count = 1;
+    desc.attributes = attributes;
+    desc.attribute_count = sizeof(attributes) / sizeof(attributes[0]);
+    desc.topology = CANVAS_TOPOLOGY_TRIANGLE_STRIP;
+
+    for (int i = 0; i <= CANVAS_BLEND_ADDITIVE; i++)
     {
-    case CANVAS_BUFFER_VERTEX:
-        usage_flags = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
-        break;
-    case CANVAS_BUFFER_INDEX:
-        usage_flags = VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
-        break;
-    case CANVAS_BUFFER_UNIFORM:
-        usage_flags = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
-        break;
-    case CANVAS_BUFFER_STORAGE:
-        usage_flags = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
-        break;
-    default:
-        usage_flags = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+        canvas_pipeline_destroy(batch->pipelines[i]);
+
+        desc.blend = (canvas_blend_mode)i;
+        batch->pipelines[i] = canvas_pipeline_create(window_id, &desc);
+        if (!batch->pipelines[i])
+            return false;
     }
 
-    if (initial_data)
-        usage_flags |= VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    batch->pipeline_format = vk_win->swapchain_format;
+    return true;
+}
 
-    // Create buffer
-    VkBufferCreateInfo buffer_info = {0};
-    buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-    buffer_info.size = size;
-    buffer_info.usage = usage_flags;
-    buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+static int vk_batch_run_compare(const void *a, const void *b)
+{
+    const canvas_vk_batch_run *ra = (const canvas_vk_batch_run *)a;
+    const canvas_vk_batch_run *rb = (const canvas_vk_batch_run *)b;
 
-    VkBuffer vk_buffer;
-    VkResult result = vk_info.vkCreateBuffer(vk_info.device, &buffer_info,
-                                             NULL, &vk_buffer);
-    if (result != VK_SUCCESS)
-    {
-        CANVAS_ERR("Failed to create Vulkan buffer\n");
-        free(buf);
-        CANVAS_RETURN(NULL);
-    }
+    if (ra->blend != rb->blend)
+        return ra->blend < rb->blend ? -1 : 1;
+    if (ra->image != rb->image)
+        return (uintptr_t)ra->image < (uintptr_t)rb->image ? -1 : 1;
 
-    // Get memory requirements
-    VkMemoryRequirements mem_reqs;
-    vk_info.vkGetBufferMemoryRequirements(vk_info.device, vk_buffer, &mem_reqs);
+    // submission order breaks ties, keeping the sort stable
+    return ra->first < rb->first ? -1 : 1;
+}
 
-    // Determine memory properties
-    VkMemoryPropertyFlags mem_props;
-    if (usage == CANVAS_BUFFER_DYNAMIC)
-    {
-        mem_props = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
-    }
-    else
-    {
-        mem_props = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
-    }
+// copies the frame's quads into the ring and draws them, one draw per run of shared state
+static void vk_batch_flush(int window_id, uint32_t image_index, VkCommandBuffer cmd)
+{
+    canvas_vulkan_window *vk_win = &vk_windows[window_id];
+    canvas_vk_batch *batch = &vk_win->batch;
+    canvas_frame_stats *stats = &canvas_info.canvas[window_id].stats;
 
-    // Allocate memory
-    VkMemoryAllocateInfo alloc_info = {0};
-    alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    alloc_info.allocationSize = mem_reqs.size;
-    alloc_info.memoryTypeIndex = vk_find_memory_type(mem_reqs.memoryTypeBits, mem_props);
+    if (batch->quad_count == 0 || !vk_batch_prepare(window_id))
+        return;
 
-    if (alloc_info.memoryTypeIndex == UINT32_MAX)
+    size_t bytes = (size_t)batch->quad_count * sizeof(canvas_vk_quad);
+    if (!batch->ring || batch->ring->size < bytes)
     {
-        CANVAS_ERR("Failed to find suitable memory type for buffer\n");
-        vk_info.vkDestroyBuffer(vk_info.device, vk_buffer, NULL);
-        free(buf);
-        CANVAS_RETURN(NULL);
+        size_t size = batch->ring ? batch->ring->size : CANVAS_VK_BATCH_RING_MIN;
+        while (size < bytes)
+            size *= 2;
+
+        // destroying defers the old ring until the window's earlier frames are done with it
+        if (batch->ring)
+            canvas_buffer_destroy(batch->ring);
+
+        batch->ring = canvas_buffer_create(window_id, CANVAS_BUFFER_VERTEX, CANVAS_BUFFER_PER_FRAME, size, NULL);
+        if (!batch->ring)
+        {
+            CANVAS_ERR("window %d: out of memory for 2D batches\n", window_id);
+            return;
+        }
     }
 
-    VkDeviceMemory memory;
-    result = vk_info.vkAllocateMemory(vk_info.device, &alloc_info, NULL, &memory);
-    if (result != VK_SUCCESS)
+    // regrouping only pays when the state actually changes between runs
+    if (batch->reorder && batch->run_count > 1)
+        qsort(batch->runs, batch->run_count, sizeof(canvas_vk_batch_run), vk_batch_run_compare);
+
+    size_t offset = 0;
+    for (uint32_t i = 0; i < batch->run_count; i++)
     {
-        CANVAS_ERR("Failed to allocate Vulkan buffer memory\n");
-        vk_info.vkDestroyBuffer(vk_info.device, vk_buffer, NULL);
-        free(buf);
-        CANVAS_RETURN(NULL);
+        const canvas_vk_batch_run *run = &batch->runs[i];
+        batch->regions[i].offset = offset;
+        batch->regions[i].size = (size_t)run->count * sizeof(canvas_vk_quad);
+        batch->regions[i].data = &batch->quads[run->first];
+        offset += batch->regions[i].size;
     }
 
-    // Bind memory
-    vk_info.vkBindBufferMemory(vk_info.device, vk_buffer, memory, 0);
+    canvas_buffer_update_regions(batch->ring, batch->regions, batch->run_count);
 
-    buf->platform_handle = vk_buffer;
-    buf->memory = (uint64_t)memory;
+    VkViewport viewport = {0};
+    viewport.width = (float)vk_win->swapchain_extent.width;
+    viewport.height = (float)vk_win->swapchain_extent.height;
+    viewport.maxDepth = 1.0f;
 
-    if (usage == CANVAS_BUFFER_DYNAMIC)
+    VkRect2D scissor = {0};
+    scissor.extent = vk_win->swapchain_extent;
+
+    vk_info.vkCmdSetViewport(cmd, 0, 1, &viewport);
+    vk_info.vkCmdSetScissor(cmd, 0, 1, &scissor);
+
+    VkBuffer ring = (VkBuffer)batch->ring->platform_handle;
+    VkDeviceSize ring_offset = canvas_buffer_frame_offset(batch->ring);
+    vk_info.vkCmdBindVertexBuffers(cmd, 0, 1, &ring, &ring_offset);
+
+    VkPipelineLayout layout = (VkPipelineLayout)batch->pipelines[0]->layout;
+    float scale[2] = {2.0f / (float)vk_win->swapchain_extent.width, 2.0f / (float)vk_win->swapchain_extent.height};
+
+    uint32_t bound_blend = UINT32_MAX;
+    VkBuffer bound_image = VK_NULL_HANDLE;
+    uint32_t first = 0;
+
+    for (uint32_t i = 0; i < batch->run_count;)
     {
-        result = vk_info.vkMapMemory(vk_info.device, memory, 0, size,
-                                     0, &buf->mapped);
-        if (result != VK_SUCCESS)
+        const canvas_vk_batch_run *run = &batch->runs[i];
+        uint32_t blend = run->blend;
+        VkBuffer image = run->image;
+        uint32_t count = run->count;
+
+        // neighbours after sorting may share state, untextured runs fit with any image
+        for (i++; i < batch->run_count; i++)
         {
-            CANVAS_ERR("Failed to map Vulkan buffer\n");
-            vk_info.vkFreeMemory(vk_info.device, memory, NULL);
-            vk_info.vkDestroyBuffer(vk_info.device, vk_buffer, NULL);
-            free(buf);
-            CANVAS_RETURN(NULL);
+            const canvas_vk_batch_run *next = &batch->runs[i];
+            if (next->blend != blend || (image && next->image && next->image != image))
+                break;
+
+            if (!image)
+                image = next->image;
+            count += next->count;
         }
 
-        if (initial_data)
+        if (!image)
+            image = bound_image ? bound_image : (VkBuffer)batch->white->pixels->platform_handle;
+
+        if (blend != bound_blend)
         {
-            memcpy(buf->mapped, initial_data, size);
+            vk_info.vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, (VkPipeline)batch->pipelines[blend]->platform_handle);
+            if (bound_blend == UINT32_MAX)
+                vk_info.vkCmdPushConstants(cmd, layout, VK_SHADER_STAGE_ALL, 0, sizeof(scale), scale);
+            bound_blend = blend;
         }
-    }
-    else if (initial_data)
-    {
-        if (_vulkan_upload_buffer_data(buf, initial_data, size) != CANVAS_OK)
+
+        if (image != bound_image)
         {
-            CANVAS_ERR("Failed to upload device-local buffer data\n");
-            vk_info.vkFreeMemory(vk_info.device, memory, NULL);
-            vk_info.vkDestroyBuffer(vk_info.device, vk_buffer, NULL);
-            free(buf);
-            CANVAS_RETURN(NULL);
+            VkDescriptorBufferInfo storage = {image, 0, VK_WHOLE_SIZE};
+            if (!vk_bind_storage_set(&vk_win->descriptor_pools[image_index], cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, layout, &storage, 1))
+            {
+                CANVAS_WARN("window %d: out of storage descriptor sets, 2D batch skipped\n", window_id);
+                first += count;
+                continue;
+            }
+            bound_image = image;
         }
+
+        vk_info.vkCmdDraw(cmd, 4, count, 0, first);
+        stats->draws++;
+        first += count;
     }
 
-    CANVAS_RETURN(buf);
+    stats->primitives += batch->quad_count;
 }
 
-void canvas_buffer_update(canvas_buffer *buf, void *data, size_t size, size_t offset)
+static void vk_render_dynamic(int window_id, uint32_t image_index, const VkClearValue *clear)
 {
-    CANVAS_ENTER_FUNC();
-    CANVAS_ASSERT_NOT_NULL(buf);
-    CANVAS_ASSERT_NOT_NULL(data);
-    CANVAS_ASSERT(size > 0);
+    canvas_vulkan_window *vk_win = &vk_windows[window_id];
+    VkCommandBuffer cmd = vk_win->command_buffers[image_index];
 
-    if (!buf || !data)
-    {
-        CANVAS_RETURN_VOID();
-    }
+    vk_transition_image(cmd, vk_win->swapchain_images[image_index],
+                        VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+                        0, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+                        VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
 
-    CANVAS_ASSERT_RANGE(buf->type, CANVAS_BUFFER_VERTEX, CANVAS_BUFFER_STORAGE);
-    CANVAS_ASSERT_RANGE(buf->usage, CANVAS_BUFFER_STATIC, CANVAS_BUFFER_STAGING);
-    CANVAS_ASSERT(buf->size > 0);
-    CANVAS_ASSERT(offset + size <= buf->size);
+    VkRenderingAttachmentInfo color_attachment = {0};
+    color_attachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+    color_attachment.imageView = vk_win->swapchain_image_views[image_index];
+    color_attachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    color_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    color_attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    color_attachment.clearValue = *clear;
+
+    VkRenderingAttachmentInfo depth_attachment = {0};
+    depth_attachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+    depth_attachment.imageView = vk_win->depth_view;
+    depth_attachment.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    depth_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    depth_attachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    depth_attachment.clearValue.depthStencil.depth = 1.0f;
 
-    if (buf->usage != CANVAS_BUFFER_DYNAMIC)
+    if (vk_win->depth_view)
     {
-        CANVAS_WARN("Can only update dynamic buffers\\n");
-        CANVAS_RETURN_VOID();
+        // contents are cleared anyway, the barrier only orders against the previous frame's tests
+        VkImageMemoryBarrier barrier = {0};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        barrier.newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = vk_win->depth_image;
+        barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+        barrier.subresourceRange.levelCount = 1;
+        barrier.subresourceRange.layerCount = 1;
+
+        vk_info.vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT,
+                                     0, 0, NULL, 0, NULL, 1, &barrier);
+    }
+
+    VkRenderingInfo rendering_info = {0};
+    rendering_info.sType = VK_STRUCTURE_TYPE_RENDERING_INFO;
+    rendering_info.renderArea.offset = (VkOffset2D){0, 0};
+    rendering_info.renderArea.extent = vk_win->swapchain_extent;
+    rendering_info.layerCount = 1;
+    rendering_info.colorAttachmentCount = 1;
+    rendering_info.pColorAttachments = &color_attachment;
+    rendering_info.pDepthAttachment = vk_win->depth_view ? &depth_attachment : NULL;
+
+    vk_info.vkCmdBeginRendering(cmd, &rendering_info);
+    vk_replay_commands(window_id, image_index, cmd);
+    vk_batch_flush(window_id, image_index, cmd);
+    vk_info.vkCmdEndRendering(cmd);
+
+    // offscreen images wait for a copy instead of the presentation engine
+    if (vk_win->offscreen)
+    {
+        vk_transition_image(cmd, vk_win->swapchain_images[image_index],
+                            VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                            VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT,
+                            VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
     }
-
-    CANVAS_ASSERT_NOT_NULL(buf->mapped);
-
-    if (offset > buf->size || size > buf->size - offset)
+    else
     {
-        CANVAS_ERR("Buffer update out of bounds\\n");
-        CANVAS_RETURN_VOID();
+        // ends at the transfer stage instead of bottom of pipe so a readback copy chains to the transition
+        vk_transition_image(cmd, vk_win->swapchain_images[image_index],
+                            VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+                            VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, 0,
+                            VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
     }
+}
 
-    memcpy((uint8_t *)buf->mapped + offset, data, size);
-    CANVAS_RETURN_VOID();
+static void vk_render_pass(int window_id, uint32_t image_index, const VkClearValue *clear)
+{
+    canvas_vulkan_window *vk_win = &vk_windows[window_id];
+
+    VkRenderPassBeginInfo render_pass_info = {0};
+    render_pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    render_pass_info.renderPass = vk_win->render_pass;
+    render_pass_info.framebuffer = vk_win->framebuffers[image_index];
+    render_pass_info.renderArea.offset = (VkOffset2D){0, 0};
+    render_pass_info.renderArea.extent = vk_win->swapchain_extent;
+
+    VkClearValue clears[2] = {*clear};
+    clears[1].depthStencil.depth = 1.0f;
+    render_pass_info.clearValueCount = vk_win->depth_view ? 2 : 1;
+    render_pass_info.pClearValues = clears;
+
+    vk_info.vkCmdBeginRenderPass(vk_win->command_buffers[image_index], &render_pass_info, VK_SUBPASS_CONTENTS_INLINE);
+    vk_replay_commands(window_id, image_index, vk_win->command_buffers[image_index]);
+    vk_batch_flush(window_id, image_index, vk_win->command_buffers[image_index]);
+    vk_info.vkCmdEndRenderPass(vk_win->command_buffers[image_index]);
 }
 
-void *canvas_buffer_map(canvas_buffer *buf)
+// copies the finished image into every readback requested since the last frame,
+// presented images go back to present layout so the copy costs no extra submit
+static void vk_readback_record(int window_id, uint32_t image_index, VkCommandBuffer cmd)
 {
     CANVAS_ENTER_FUNC();
-    CANVAS_ASSERT_NOT_NULL(buf);
 
-    if (!buf)
-    {
-        CANVAS_RETURN(NULL);
-    }
+    canvas_vulkan_window *vk_win = &vk_windows[window_id];
 
-    CANVAS_ASSERT(buf->size > 0);
-    CANVAS_ASSERT_NOT_NULL(vk_info.device);
+    if (vk_win->readback_pending == 0)
+        CANVAS_RETURN_VOID();
 
-    if (buf->usage == CANVAS_BUFFER_DYNAMIC)
-    {
-        CANVAS_ASSERT_NOT_NULL(buf->mapped);
-        CANVAS_RETURN(buf->mapped); // Already mapped
-    }
+    VkImage image = vk_win->swapchain_images[image_index];
+    VkImageLayout layout = vk_win->offscreen ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    VkExtent2D extent = vk_win->swapchain_extent;
 
-    // Map device-local buffers on demand (not recommended)
-    void *mapped = NULL;
-    CANVAS_ASSERT_NOT_NULL(vk_info.vkMapMemory);
-    VkResult result = vk_info.vkMapMemory(vk_info.device, (VkDeviceMemory)buf->memory, 0, buf->size, 0, &mapped);
-    if (result != VK_SUCCESS)
-    {
-        CANVAS_RETURN_ERR(NULL, "Failed to map Vulkan buffer\\n");
-    }
-
-    CANVAS_RETURN(mapped);
-}
-
-void canvas_buffer_unmap(canvas_buffer *buf)
-{
-    CANVAS_ENTER_FUNC();
+    canvas_format format = CANVAS_FORMAT_RGBA8;
+    vk_canvas_format(vk_win->swapchain_format, &format);
+    size_t row_pitch = (size_t)extent.width * (format == CANVAS_FORMAT_RGBA16F ? 8 : 4);
+    size_t size = row_pitch * extent.height;
 
-    if (!buf)
-    {
-        CANVAS_RETURN_VOID();
-    }
+    // the pass's final transition was made to end at the transfer stage, waiting on it chains to the rendering
+    vk_transition_image(cmd, image, layout, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                        VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT,
+                        VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
 
-    if (buf->usage == CANVAS_BUFFER_DYNAMIC)
+    for (uint32_t i = 0; i < CANVAS_VK_READBACKS; i++)
     {
-        CANVAS_RETURN_VOID(); // Persistently mapped
-    }
+        canvas_readback *readback = &vk_win->readbacks[i];
+        if (!readback->_used || readback->frame != 0)
+            continue;
 
-    vk_info.vkUnmapMemory(vk_info.device, (VkDeviceMemory)buf->memory);
-    CANVAS_RETURN_VOID();
-}
+        // slots keep their buffer, steady state allocates nothing; a copy still writing the old one keeps it alive
+        if (readback->_buffer && readback->_buffer->size < size)
+        {
+            canvas_buffer_destroy(readback->_buffer);
+            readback->_buffer = NULL;
+        }
 
-void canvas_buffer_destroy(canvas_buffer *buf)
-{
-    CANVAS_ENTER_FUNC();
+        if (!readback->_buffer)
+            readback->_buffer = canvas_buffer_create(window_id, CANVAS_BUFFER_STORAGE, CANVAS_BUFFER_STAGING, size, NULL);
 
-    if (!buf)
-    {
-        CANVAS_RETURN_VOID();
-    }
+        if (!readback->_buffer || !readback->_buffer->mapped)
+        {
+            CANVAS_ERR("no host memory for a %zu byte readback of window %d\n", size, window_id);
+            continue;
+        }
 
-    CANVAS_ASSERT_NOT_NULL(vk_info.device);
-    CANVAS_ASSERT_NOT_NULL(vk_info.vkDestroyBuffer);
-    CANVAS_ASSERT_NOT_NULL(vk_info.vkFreeMemory);
-    CANVAS_ASSERT(buf->size > 0);
-    CANVAS_ASSERT_RANGE(buf->type, CANVAS_BUFFER_VERTEX, CANVAS_BUFFER_STORAGE);
+        VkBufferImageCopy region = {0};
+        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        region.imageSubresource.layerCount = 1;
+        region.imageExtent.width = extent.width;
+        region.imageExtent.height = extent.height;
+        region.imageExtent.depth = 1;
 
-    VkBuffer vk_buffer = (VkBuffer)buf->platform_handle;
-    CANVAS_ASSERT_NOT_NULL(vk_buffer);
+        vk_info.vkCmdCopyImageToBuffer(cmd, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                                       (VkBuffer)readback->_buffer->platform_handle, 1, &region);
 
-    if (buf->mapped && buf->usage == CANVAS_BUFFER_DYNAMIC)
-    {
-        CANVAS_ASSERT_NOT_NULL(vk_info.vkUnmapMemory);
-        vk_info.vkUnmapMemory(vk_info.device, (VkDeviceMemory)buf->memory);
+        readback->width = extent.width;
+        readback->height = extent.height;
+        readback->row_pitch = row_pitch;
+        readback->format = format;
+        readback->frame = vk_win->timeline_value + 1;
+        vk_win->readback_pending--;
     }
 
-    vk_info.vkDestroyBuffer(vk_info.device, vk_buffer, NULL);
-    vk_info.vkFreeMemory(vk_info.device, (VkDeviceMemory)buf->memory, NULL);
+    VkMemoryBarrier barrier = {0};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    vk_info.vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &barrier, 0, NULL, 0, NULL);
+
+    vk_transition_image(cmd, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, layout,
+                        0, 0, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
 
-    free(buf);
     CANVAS_RETURN_VOID();
 }
 
-static void vk_cleanup_window(int window_id)
+static int vk_record_command_buffer(int window_id, uint32_t image_index)
 {
     CANVAS_ENTER_FUNC();
     CANVAS_ASSERT_RANGE(window_id, 0, MAX_CANVAS - 1);
 
     canvas_vulkan_window *vk_win = &vk_windows[window_id];
+    CANVAS_ASSERT(image_index < vk_win->swapchain_image_count);
+    CANVAS_ASSERT_NOT_NULL(vk_win->command_buffers[image_index]);
+    CANVAS_ASSERT(vk_info.dynamic_rendering || vk_win->framebuffers[image_index]);
+
+    canvas_vk_command_key key = {0};
+    memcpy(key.clear, canvas_info.canvas[window_id].clear, sizeof(key.clear));
+    key.extent = vk_win->swapchain_extent;
+    key.render_pass_version = vk_win->render_pass_version;
+
+    // 2D batches land in a different ring slice every frame and copies happen once, those recordings are not reused
+    bool batched = vk_win->batch.quad_count > 0 || vk_win->readback_pending > 0;
+    key.valid = !batched;
+
+    // the same stream as last time on this image replays to the same commands
+    key.commands_hash = vk_hash_bytes(CANVAS_VK_HASH_SEED, vk_win->commands, (size_t)vk_win->command_count * sizeof(canvas_vk_command));
+
+    // the image fence was waited on, an unchanged buffer can be submitted again as is
+    canvas_vk_command_key *cached = &vk_win->command_keys[image_index];
+    if (cached->valid && !batched &&
+        memcmp(cached->clear, key.clear, sizeof(key.clear)) == 0 &&
+        cached->extent.width == key.extent.width &&
+        cached->extent.height == key.extent.height &&
+        cached->render_pass_version == key.render_pass_version &&
+        cached->commands_hash == key.commands_hash &&
+        vk_win->recorded_count[image_index] == vk_win->command_count &&
+        (vk_win->command_count == 0 ||
+         memcmp(vk_win->recorded[image_index], vk_win->commands, (size_t)vk_win->command_count * sizeof(canvas_vk_command)) == 0))
+    {
+        canvas_info.canvas[window_id].stats.reused++;
+        CANVAS_RETURN(CANVAS_OK);
+    }
 
-    if (!vk_win->initialized)
-        CANVAS_RETURN_VOID();
+    cached->valid = false;
 
-    CANVAS_ASSERT_NOT_NULL(vk_info.device);
+    // the image's previous recording has finished, so have its descriptor sets
+    if (vk_win->descriptor_pools[image_index])
+        vk_info.vkResetDescriptorPool(vk_info.device, vk_win->descriptor_pools[image_index], 0);
 
-    vk_info.vkDeviceWaitIdle(vk_info.device);
+    VkCommandBufferBeginInfo begin_info = {0};
+    begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
 
-    if (vk_win->depth_view)
-    {
-        vk_info.vkDestroyImageView(vk_info.device, vk_win->depth_view, NULL);
-        vk_win->depth_view = VK_NULL_HANDLE;
-    }
-    if (vk_win->depth_image)
+    VkResult result = vk_info.vkBeginCommandBuffer(vk_win->command_buffers[image_index], &begin_info);
+    if (result != VK_SUCCESS)
     {
-        vk_info.vkDestroyImage(vk_info.device, vk_win->depth_image, NULL);
-        vk_win->depth_image = VK_NULL_HANDLE;
+        CANVAS_RETURN_ERR(CANVAS_FAIL, "failed to begin command buffer (result=%d)\n", result);
     }
-    if (vk_win->depth_memory)
+
+    // dispatches go ahead of the pass, on the compute queue instead with async compute
+    if (vk_info.compute_family == vk_info.graphics_family &&
+        vk_replay_compute(window_id, vk_win->command_buffers[image_index], &vk_win->descriptor_pools[image_index]) > 0)
     {
-        vk_info.vkFreeMemory(vk_info.device, vk_win->depth_memory, NULL);
-        vk_win->depth_memory = VK_NULL_HANDLE;
+        vk_compute_barrier(vk_win->command_buffers[image_index]);
     }
 
-    for (uint32_t i = 0; i < MAX_SWAPCHAIN_IMAGES; i++)
-    {
-        if (vk_win->image_available_semaphores[i])
-            vk_info.vkDestroySemaphore(vk_info.device, vk_win->image_available_semaphores[i], NULL);
+    VkClearValue clear_color = {0};
+    clear_color.color.float32[0] = canvas_info.canvas[window_id].clear[0];
+    clear_color.color.float32[1] = canvas_info.canvas[window_id].clear[1];
+    clear_color.color.float32[2] = canvas_info.canvas[window_id].clear[2];
+    clear_color.color.float32[3] = canvas_info.canvas[window_id].clear[3];
 
-        if (vk_win->render_finished_semaphores[i])
-            vk_info.vkDestroySemaphore(vk_info.device, vk_win->render_finished_semaphores[i], NULL);
-    }
+    if (vk_info.dynamic_rendering)
+        vk_render_dynamic(window_id, image_index, &clear_color);
+    else
+        vk_render_pass(window_id, image_index, &clear_color);
 
-    for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+    vk_readback_record(window_id, image_index, vk_win->command_buffers[image_index]);
+
+    result = vk_info.vkEndCommandBuffer(vk_win->command_buffers[image_index]);
+    if (result != VK_SUCCESS)
     {
-        if (vk_win->in_flight_fences[i])
-            vk_info.vkDestroyFence(vk_info.device, vk_win->in_flight_fences[i], NULL);
+        CANVAS_RETURN_ERR(CANVAS_FAIL, "failed to end command buffer (result=%d)\n", result);
     }
 
-    if (vk_win->command_pool)
-        vk_info.vkDestroyCommandPool(vk_info.device, vk_win->command_pool, NULL);
-
-    if (vk_win->render_pass)
-        vk_info.vkDestroyRenderPass(vk_info.device, vk_win->render_pass, NULL);
+    // keep the stream for the exact comparison, without room the recording is simply not reused
+    if (key.valid && vk_win->command_count > vk_win->recorded_capacity[image_index])
+    {
+        canvas_vk_command *grown = (canvas_vk_command *)realloc(vk_win->recorded[image_index], vk_win->command_capacity * sizeof(canvas_vk_command));
+        if (grown)
+        {
+            vk_win->recorded[image_index] = grown;
+            vk_win->recorded_capacity[image_index] = vk_win->command_capacity;
+        }
+        else
+        {
+            key.valid = false;
+        }
+    }
 
-    vk_cleanup_swapchain(window_id);
+    if (key.valid && vk_win->command_count > 0)
+        memcpy(vk_win->recorded[image_index], vk_win->commands, (size_t)vk_win->command_count * sizeof(canvas_vk_command));
+    vk_win->recorded_count[image_index] = vk_win->command_count;
 
-    if (vk_win->surface)
-        vk_info.vkDestroySurfaceKHR(vk_info.instance, vk_win->surface, NULL);
+    vk_win->command_keys[image_index] = key;
+    canvas_info.canvas[window_id].stats.recorded++;
 
-    memset(vk_win, 0, sizeof(canvas_vulkan_window));
-    CANVAS_RETURN_VOID();
+    CANVAS_RETURN(CANVAS_OK);
 }
 
-static void vk_cleanup(void)
+// an acquire that is never submitted leaves its semaphore signalled and the image held,
+// the semaphore is replaced and the swapchain rebuilt to hand the image back
+static void vk_recycle_acquire(int window_id)
 {
     CANVAS_ENTER_FUNC();
+    CANVAS_ASSERT_RANGE(window_id, 0, MAX_CANVAS - 1);
 
-    if (!vk_info.instance)
-        CANVAS_RETURN_VOID();
-
-    if (vk_info.device)
-        vk_info.vkDeviceWaitIdle(vk_info.device);
+    canvas_vulkan_window *vk_win = &vk_windows[window_id];
 
-    for (int i = 0; i < MAX_CANVAS; i++)
-        vk_cleanup_window(i);
+    if (vk_win->offscreen)
+        CANVAS_RETURN_VOID();
 
-    if (vk_info.device)
-    {
-        vk_info.vkDestroyDevice(vk_info.device, NULL);
-        vk_info.device = VK_NULL_HANDLE;
-    }
+    VkSemaphore *semaphore = &vk_win->image_available_semaphores[vk_win->current_frame % MAX_FRAMES_IN_FLIGHT];
 
-    if (vk_info.validation_enabled && vk_info.debug_messenger && vk_info.vkDestroyDebugUtilsMessengerEXT)
-    {
-        vk_info.vkDestroyDebugUtilsMessengerEXT(vk_info.instance, vk_info.debug_messenger, NULL);
-        vk_info.debug_messenger = VK_NULL_HANDLE;
-    }
+    VkSemaphoreCreateInfo semaphore_info = {0};
+    semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 
-    if (vk_info.instance)
+    VkSemaphore replacement = VK_NULL_HANDLE;
+    VkResult result = vk_info.vkCreateSemaphore(vk_info.device, &semaphore_info, NULL, &replacement);
+    if (result == VK_SUCCESS)
     {
-        vk_info.vkDestroyInstance(vk_info.instance, NULL);
-        vk_info.instance = VK_NULL_HANDLE;
+        // the pending signal has to land before the old one can go
+        vk_info.vkDeviceWaitIdle(vk_info.device);
+        vk_info.vkDestroySemaphore(vk_info.device, *semaphore, NULL);
+        *semaphore = replacement;
     }
-
-    if (vk_info.library)
+    else
     {
-        canvas_library_close(vk_info.library);
-        vk_info.library = NULL;
+        CANVAS_ERR("window %d: failed to replace image available semaphore (result=%d)\n", window_id, result);
     }
 
-    CANVAS_INFO("vulkan cleaned up\n");
+    vk_win->needs_recreate = true;
     CANVAS_RETURN_VOID();
 }
 
-#endif // CANVAS_VULKAN
-
-//
-//
-//
-#if defined(__APPLE__)
-
-int canvas_minimize(int window_id)
+// acquires and records one window, the submit and present happen in vk_draw_frames
+static int vk_acquire_frame(int window_id, uint32_t *image_index)
 {
     CANVAS_ENTER_FUNC();
-    CANVAS_VALID(window_id);
-
-    objc_id window = canvas_info.canvas[window_id].window;
-    if (!window)
-    {
-        CANVAS_RETURN_ERR(CANVAS_ERR_GET_WINDOW, "no window to minimize: %d\n", window_id);
-    }
-
-    msg_void_id(window, sel_c("miniaturize:"), NULL);
+    CANVAS_ASSERT_RANGE(window_id, 0, MAX_CANVAS - 1);
+    CANVAS_ASSERT_NOT_NULL(image_index);
 
-    canvas_info.canvas[window_id].minimized = true;
-    canvas_info.canvas[window_id].maximized = false;
+    canvas_vulkan_window *vk_win = &vk_windows[window_id];
 
-    CANVAS_RETURN(CANVAS_OK);
-}
+    if (!vk_win->initialized || vk_win->recreating_swapchain)
+        CANVAS_RETURN(CANVAS_FAIL);
 
-int canvas_maximize(int window_id)
-{
-    CANVAS_ENTER_FUNC();
-    CANVAS_VALID(window_id);
+    uint64_t now = vk_time_ns();
+    vk_update_recreate_rate(window_id, now);
 
-    objc_id window = canvas_info.canvas[window_id].window;
-    if (!window)
+    if (!vk_win->offscreen && vk_resize_pending(window_id, now))
     {
-        CANVAS_RETURN_ERR(CANVAS_ERR_GET_WINDOW, "no window to maximize: %d\n", window_id);
-    }
-
-    bool is_zoomed = msg_bool(window, "isZoomed");
+        int recreate_result = vk_recreate_swapchain(window_id);
 
-    if (!is_zoomed)
-    {
-        msg_void_id(window, sel_c("zoom:"), NULL);
-        canvas_info.canvas[window_id].maximized = true;
+        if (recreate_result != CANVAS_OK || !vk_win->swapchain)
+            CANVAS_RETURN(CANVAS_FAIL);
     }
 
-    canvas_info.canvas[window_id].minimized = false;
+    if (!vk_win->swapchain && !vk_win->offscreen)
+        CANVAS_RETURN(CANVAS_FAIL);
 
-    CANVAS_RETURN(CANVAS_OK);
-}
+    CANVAS_ASSERT_NOT_NULL(vk_info.device);
 
-int canvas_restore(int window_id)
-{
-    CANVAS_ENTER_FUNC();
-    CANVAS_VALID(window_id);
+    uint32_t frame_index = vk_win->current_frame % MAX_FRAMES_IN_FLIGHT;
 
-    objc_id window = canvas_info.canvas[window_id].window;
-    if (!window)
+    // at most MAX_FRAMES_IN_FLIGHT frames of this window on the gpu, other windows don't wait on it
+    if (vk_win->timeline_value >= MAX_FRAMES_IN_FLIGHT)
     {
-        CANVAS_RETURN_ERR(CANVAS_ERR_GET_WINDOW, "no window to restore: %d\n", window_id);
+        uint64_t oldest = vk_win->timeline_value - (MAX_FRAMES_IN_FLIGHT - 1);
+        if (vk_timeline_wait(vk_win, oldest, CANVAS_ACQUIRE_TIMEOUT) == VK_TIMEOUT)
+        {
+            canvas_info.canvas[window_id].stats.skipped++;
+            CANVAS_RETURN(CANVAS_FAIL);
+        }
     }
 
-    if (canvas_info.canvas[window_id].minimized)
+    // offscreen images are used in turn, the wait below covers their last frame
+    VkResult result = VK_SUCCESS;
+    if (vk_win->offscreen)
+        *image_index = (uint32_t)(vk_win->current_frame % vk_win->swapchain_image_count);
+    else
+        result = vk_info.vkAcquireNextImageKHR(
+            vk_info.device, vk_win->swapchain, CANVAS_ACQUIRE_TIMEOUT,
+            vk_win->image_available_semaphores[frame_index],
+            VK_NULL_HANDLE, image_index);
+
+    if (result == VK_NOT_READY || result == VK_TIMEOUT)
     {
-        msg_void_id(window, sel_c("deminiaturize:"), NULL);
+        canvas_info.canvas[window_id].stats.skipped++;
+        CANVAS_RETURN(CANVAS_FAIL);
     }
-    else if (canvas_info.canvas[window_id].maximized)
+    else if (result == VK_ERROR_OUT_OF_DATE_KHR)
     {
-        msg_void_id(window, sel_c("zoom:"), NULL);
+        vk_win->needs_recreate = true;
+        CANVAS_RETURN(CANVAS_FAIL);
     }
-    else if (canvas_info.canvas[window_id].fullscreen)
+    else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR)
     {
-        msg_void_id(window, sel_c("toggleFullScreen:"), NULL);
+        CANVAS_RETURN_ERR(CANVAS_FAIL, "failed to acquire swapchain image\n");
     }
 
-    canvas_info.canvas[window_id].minimized = false;
-    canvas_info.canvas[window_id].maximized = false;
-    canvas_info.canvas[window_id].fullscreen = false;
+    if (*image_index >= vk_win->swapchain_image_count)
+        CANVAS_RETURN(CANVAS_FAIL);
 
-    CANVAS_RETURN(CANVAS_OK);
-}
+    vk_timeline_wait(vk_win, vk_win->image_values[*image_index], UINT64_MAX);
 
-int canvas_fullscreen(int window_id)
-{
-    CANVAS_ENTER_FUNC();
-    CANVAS_VALID(window_id);
+    int record_result = vk_record_command_buffer(window_id, *image_index);
+    if (record_result != CANVAS_OK)
+        vk_recycle_acquire(window_id);
 
-    objc_id window = canvas_info.canvas[window_id].window;
-    if (!window)
-    {
-        CANVAS_RETURN_ERR(CANVAS_ERR_GET_WINDOW, "no window for fullscreen: %d\n", window_id);
-    }
+    CANVAS_RETURN(record_result);
+}
 
-    unsigned long style_mask = msg_ulong(window, "styleMask");
-    bool is_fullscreen = (style_mask & (1 << 14)) != 0; // NSWindowStyleMaskFullScreen
+static void vk_collect_buffers(int window_id, bool force);
 
-    if (!is_fullscreen)
+// recordings reference buffers and pipelines by handle, a new object may get the handle of a destroyed one
+static void vk_forget_recordings(void)
+{
+    for (int i = 0; i < MAX_CANVAS; i++)
     {
-        _CGRect frame = msg_rect(window, "frame");
-        _canvas_data[window_id].saved_x = (int)frame.x;
-        _canvas_data[window_id].saved_y = (int)frame.y;
-        _canvas_data[window_id].saved_width = (int)frame.w;
-        _canvas_data[window_id].saved_height = (int)frame.h;
-        _canvas_data[window_id].saved_style_mask = style_mask;
-
-        msg_void_id(window, sel_c("toggleFullScreen:"), NULL);
-        canvas_info.canvas[window_id].fullscreen = true;
+        for (uint32_t j = 0; j < MAX_SWAPCHAIN_IMAGES; j++)
+            vk_windows[i].command_keys[j].valid = false;
     }
-
-    canvas_info.canvas[window_id].minimized = false;
-    canvas_info.canvas[window_id].maximized = false;
-
-    CANVAS_RETURN(CANVAS_OK);
 }
 
-static objc_id _canvas_get_ns_cursor(canvas_cursor_type cursor)
+static int vk_draw_frames(void)
 {
     CANVAS_ENTER_FUNC();
 
-    if (cursor < 0 || cursor >= sizeof(_cursor_selector_names) / sizeof(_cursor_selector_names[0]))
-        cursor = CANVAS_CURSOR_ARROW;
+    if (!vk_info.device)
+        CANVAS_RETURN(CANVAS_OK);
 
-    const char *selector = _cursor_selector_names[cursor];
+    // each window is paced on its own frames in vk_acquire_frame
+    for (int i = 0; i < MAX_CANVAS; i++)
+    {
+        if (vk_windows[i].retired_count > 0)
+            vk_collect_retired(i, false);
+
+        if (vk_windows[i].dead_buffer_count > 0)
+            vk_collect_buffers(i, false);
+    }
+
+    int windows[MAX_CANVAS];
+    uint32_t image_indices[MAX_CANVAS];
+    VkSwapchainKHR swapchains[MAX_CANVAS];
+    VkSemaphore acquire_semaphores[MAX_CANVAS];
+    VkSemaphore present_semaphores[MAX_CANVAS];
+    VkPipelineStageFlags wait_stages[MAX_CANVAS];
+    VkSubmitInfo submits[MAX_CANVAS];
+    VkResult present_results[MAX_CANVAS];
+    VkSemaphore signal_semaphores[MAX_CANVAS][2];
+    uint64_t signal_values[MAX_CANVAS][2];
+    VkSemaphore wait_semaphores[MAX_CANVAS][3];
+    VkPipelineStageFlags wait_stage_masks[MAX_CANVAS][3];
+    uint64_t wait_values[MAX_CANVAS][3];
+    VkTimelineSemaphoreSubmitInfo timeline_infos[MAX_CANVAS];
+    uint32_t count = 0;
+
+    // cpu writes to non-coherent mappings become visible to this submit
+    vk_flush_dirty();
+
+    // uploads queued since the last frame go out first
+    VkSemaphore upload_semaphore = VK_NULL_HANDLE;
+    uint64_t upload_token = vk_upload_frame(&upload_semaphore);
+    bool wait_uploads = upload_semaphore != VK_NULL_HANDLE;
+
+    // then the frame's dispatches when they run on their own queue
+    VkSemaphore compute_semaphore = VK_NULL_HANDLE;
+    uint64_t compute_value = vk_compute_frame(&compute_semaphore);
 
-    if (!selector)
-        selector = "arrowCursor";
+    for (int i = 0; i < MAX_CANVAS; i++)
+    {
+        if (!canvas_info.canvas[i]._valid || !vk_windows[i].initialized)
+            continue;
 
-    objc_id result = msg_id(cls("NSCursor"), selector);
-    CANVAS_RETURN(result);
-}
-
-int canvas_cursor(int window_id, canvas_cursor_type cursor)
-{
-    CANVAS_ENTER_FUNC();
-    CANVAS_VALID(window_id);
+        uint32_t image_index;
+        if (vk_acquire_frame(i, &image_index) != CANVAS_OK)
+            continue;
 
-    canvas_info.canvas[window_id].cursor = cursor;
+        canvas_vulkan_window *vk_win = &vk_windows[i];
+
+        windows[count] = i;
+        image_indices[count] = image_index;
+        swapchains[count] = vk_win->swapchain;
+        acquire_semaphores[count] = vk_win->image_available_semaphores[vk_win->current_frame % MAX_FRAMES_IN_FLIGHT];
+        present_semaphores[count] = vk_win->render_finished_semaphores[image_index];
+        wait_stages[count] = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+
+        // offscreen canvases have no image to wait for and nothing to present
+        uint32_t swapchain_semaphores = vk_win->offscreen ? 0 : 1;
+
+        VkSubmitInfo submit_info = {0};
+        submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submit_info.waitSemaphoreCount = swapchain_semaphores;
+        submit_info.pWaitSemaphores = &acquire_semaphores[count];
+        submit_info.pWaitDstStageMask = &wait_stages[count];
+        submit_info.commandBufferCount = 1;
+        submit_info.pCommandBuffers = &vk_win->command_buffers[image_index];
+        submit_info.signalSemaphoreCount = swapchain_semaphores;
+        submit_info.pSignalSemaphores = &present_semaphores[count];
+
+        if (vk_info.timeline)
+        {
+            // the binary present semaphore's value is ignored
+            uint32_t signal_count = 0;
+            if (!vk_win->offscreen)
+            {
+                signal_semaphores[count][signal_count] = present_semaphores[count];
+                signal_values[count][signal_count++] = 0;
+            }
+            signal_semaphores[count][signal_count] = vk_win->timeline;
+            signal_values[count][signal_count++] = vk_win->timeline_value + 1;
 
-    objc_id ns_cursor = _canvas_get_ns_cursor(cursor);
-    if (ns_cursor)
-        msg_void(ns_cursor, "set");
+            VkTimelineSemaphoreSubmitInfo timeline_info = {0};
+            timeline_info.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+            timeline_info.signalSemaphoreValueCount = signal_count;
+            timeline_info.pSignalSemaphoreValues = signal_values[count];
 
-    CANVAS_RETURN(CANVAS_OK);
-}
+            uint32_t wait_count = 0;
+            if (!vk_win->offscreen)
+            {
+                wait_semaphores[count][0] = acquire_semaphores[count];
+                wait_stage_masks[count][0] = wait_stages[count];
+                wait_values[count][0] = 0;
+                wait_count = 1;
+            }
 
-int _canvas_close(int window_id)
-{
-    CANVAS_ENTER_FUNC();
-    CANVAS_BOUNDS(window_id);
+            if (wait_uploads)
+            {
+                wait_semaphores[count][wait_count] = upload_semaphore;
+                wait_stage_masks[count][wait_count] = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+                wait_values[count][wait_count] = upload_token;
+                wait_count++;
+            }
 
-    objc_id window = canvas_info.canvas[window_id].window;
-    if (!window)
-    {
-        CANVAS_RETURN_ERR(CANVAS_ERR_GET_WINDOW, "no window to close: %d\n", window_id);
-    }
+            if (compute_semaphore)
+            {
+                wait_semaphores[count][wait_count] = compute_semaphore;
+                wait_stage_masks[count][wait_count] = VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT |
+                                                      VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+                wait_values[count][wait_count] = compute_value;
+                wait_count++;
+            }
 
-    if (_canvas_data[window_id].layer)
-    {
-        msg_void(_canvas_data[window_id].layer, "release");
-    }
+            if (wait_count > swapchain_semaphores)
+            {
+                timeline_info.waitSemaphoreValueCount = wait_count;
+                timeline_info.pWaitSemaphoreValues = wait_values[count];
 
-    _canvas_data[window_id].layer = NULL;
-    _canvas_data[window_id].view = NULL;
-    _canvas_data[window_id].scale = 0.0;
+                submit_info.waitSemaphoreCount = wait_count;
+                submit_info.pWaitSemaphores = wait_semaphores[count];
+                submit_info.pWaitDstStageMask = wait_stage_masks[count];
+            }
 
-    msg_void(window, "close");
-    msg_void(window, "release");
+            timeline_infos[count] = timeline_info;
 
-    CANVAS_RETURN(CANVAS_OK);
-}
+            submit_info.pNext = &timeline_infos[count];
+            submit_info.signalSemaphoreCount = signal_count;
+            submit_info.pSignalSemaphores = signal_semaphores[count];
+        }
 
-int _canvas_set(int window_id, int display, int64_t x, int64_t y, int64_t width, int64_t height, const char *title)
-{
-    CANVAS_ENTER_FUNC();
-    CANVAS_BOUNDS(window_id);
+        submits[count] = submit_info;
 
-    objc_id window = canvas_info.canvas[window_id].window;
-    if (!window)
-    {
-        CANVAS_RETURN_ERR(CANVAS_ERR_GET_WINDOW, "no window to set: %d\n", window_id);
+        count++;
     }
 
-    CANVAS_DISPLAY_BOUNDS(display);
+    if (count == 0)
+        CANVAS_RETURN(CANVAS_OK);
 
-    int global_x = canvas_info.display[display].x + x;
-    int global_y = canvas_info.display[display].y + (canvas_info.display[display].height - (y + height));
+    // and so do the 2D batches written while recording
+    vk_flush_dirty();
 
-    if (x >= 0 && y >= 0 && width > 0 && height > 0)
-    {
-        _CGRect rect = make_rect(global_x, global_y, width, height);
-        msg_void_rect_bool(window, "setFrame:display:", rect, true);
-    }
+    VkResult result = VK_SUCCESS;
+    uint32_t submitted = 0;
 
-    if (title)
+    if (vk_info.timeline)
     {
-        objc_id nsTitle = nsstring_from_cstr(title);
-        if (nsTitle)
-            msg_void_id(window, "setTitle:", nsTitle);
+        result = vk_info.vkQueueSubmit(vk_info.graphics_queue, count, submits, VK_NULL_HANDLE);
+        if (result == VK_SUCCESS)
+            submitted = count;
     }
+    else
+    {
+        // a fence covers a whole submit, so each window gets its own
+        for (; submitted < count; submitted++)
+        {
+            canvas_vulkan_window *vk_win = &vk_windows[windows[submitted]];
+            VkFence fence = vk_win->frame_fences[(vk_win->timeline_value + 1) % MAX_FRAMES_IN_FLIGHT];
 
-    CANVAS_RETURN(CANVAS_OK);
-}
-
-int _canvas_get_window_display(int window_id)
-{
-    CANVAS_ENTER_FUNC();
-    CANVAS_BOUNDS(window_id);
+            vk_info.vkResetFences(vk_info.device, 1, &fence);
+            result = vk_info.vkQueueSubmit(vk_info.graphics_queue, 1, &submits[submitted], fence);
+            if (result != VK_SUCCESS)
+            {
+                // nothing will signal the reset fence, a new signalled one keeps later waits returning
+                VkFenceCreateInfo fence_info = {0};
+                fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+                fence_info.flags = VK_FENCE_CREATE_SIGNALED_BIT;
 
-    objc_id window = canvas_info.canvas[window_id].window;
-    if (!window)
-    {
-        CANVAS_RETURN_ERR(CANVAS_ERR_GET_WINDOW, "no window to get display: %d\n", window_id);
+                VkFence replacement = VK_NULL_HANDLE;
+                if (vk_info.vkCreateFence(vk_info.device, &fence_info, NULL, &replacement) == VK_SUCCESS)
+                {
+                    vk_info.vkDestroyFence(vk_info.device, fence, NULL);
+                    vk_win->frame_fences[(vk_win->timeline_value + 1) % MAX_FRAMES_IN_FLIGHT] = replacement;
+                }
+                break;
+            }
+        }
     }
 
-    objc_id screen = msg_id(window, "screen");
-    if (!screen)
+    if (submitted < count)
     {
-        CANVAS_RETURN_ERR(CANVAS_ERR_GET_DISPLAY, "no screen for window: %d\n", window_id);
-    }
+        CANVAS_ERR("failed to submit %u draw command buffers (result=%d)\n", count - submitted, result);
 
-    objc_id device_desc = msg_id(screen, "deviceDescription");
-    if (!device_desc)
-    {
-        CANVAS_RETURN_ERR(CANVAS_ERR_GET_GPU, "no device description: %d\n", window_id);
+        // the windows left out acquired an image that is never presented
+        for (uint32_t i = submitted; i < count; i++)
+            vk_recycle_acquire(windows[i]);
     }
 
-    objc_id screen_number_key = nsstring_from_cstr("NSScreenNumber");
-    if (!screen_number_key)
-    {
-        CANVAS_RETURN(CANVAS_ERR_GET_DISPLAY);
-    }
+    if (submitted == 0)
+        CANVAS_RETURN(CANVAS_FAIL);
 
-    objc_id display_id_obj = msg_id_id(device_desc, "objectForKey:", screen_number_key);
-    if (!display_id_obj)
+    // the submit has read the arrays, presented windows are packed to the front
+    uint32_t present_count = 0;
+
+    for (uint32_t i = 0; i < submitted; i++)
     {
-        CANVAS_RETURN(CANVAS_ERR_GET_DISPLAY);
-    }
+        canvas_vulkan_window *vk_win = &vk_windows[windows[i]];
 
-    unsigned long display_id = msg_ulong(display_id_obj, "unsignedIntValue");
+        vk_win->timeline_value++;
+        vk_win->image_values[image_indices[i]] = vk_win->timeline_value;
+        vk_win->current_frame++;
+        canvas_info.canvas[windows[i]].stats.submitted = vk_win->timeline_value;
 
-    uint32_t max_displays = MAX_DISPLAYS;
-    CGDirectDisplayID displays[MAX_DISPLAYS];
-    uint32_t display_count = 0;
+        if (vk_win->offscreen)
+            continue;
 
-    CGGetActiveDisplayList(max_displays, displays, &display_count);
+        windows[present_count] = windows[i];
+        swapchains[present_count] = swapchains[i];
+        present_semaphores[present_count] = present_semaphores[i];
+        image_indices[present_count] = image_indices[i];
+        present_count++;
+    }
 
-    for (uint32_t i = 0; i < display_count && i < MAX_DISPLAYS; i++)
+    VkPresentInfoKHR present_info = {0};
+    present_info.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+    present_info.waitSemaphoreCount = present_count;
+    present_info.pWaitSemaphores = present_semaphores;
+    present_info.swapchainCount = present_count;
+    present_info.pSwapchains = swapchains;
+    present_info.pImageIndices = image_indices;
+    present_info.pResults = present_results;
+
+    if (present_count > 0)
+        vk_queue_present(&present_info);
+
+    for (uint32_t i = 0; i < present_count; i++)
     {
-        if (displays[i] != (CGDirectDisplayID)display_id)
-            continue;
+        int window_id = windows[i];
+        canvas_vulkan_window *vk_win = &vk_windows[window_id];
 
-        canvas_info.canvas[window_id].display = i;
-        CANVAS_RETURN(i);
+        if (present_results[i] == VK_SUCCESS || present_results[i] == VK_SUBOPTIMAL_KHR)
+            canvas_info.canvas[window_id].stats.presented++;
+
+        // rebuilt by the next acquire, a settling resize already covers suboptimal
+        if (present_results[i] == VK_ERROR_OUT_OF_DATE_KHR)
+        {
+            vk_win->needs_recreate = true;
+        }
+        else if (present_results[i] == VK_SUBOPTIMAL_KHR)
+        {
+            if (!vk_win->needs_resize)
+                vk_win->needs_recreate = true;
+        }
+        else if (present_results[i] != VK_SUCCESS)
+        {
+            CANVAS_ERR("failed to present swapchain image for window %d (result=%d)\n", window_id, present_results[i]);
+        }
     }
 
     CANVAS_RETURN(CANVAS_OK);
 }
 
-int _canvas_refresh_displays()
+// UINT32_MAX when no allowed type has all of properties
+static uint32_t vk_find_memory_type(uint32_t type_filter, VkMemoryPropertyFlags properties)
 {
     CANVAS_ENTER_FUNC();
+    CANVAS_ASSERT_NOT_NULL(vk_info.physical_device);
 
-    canvas_info.display_count = 0;
-    canvas_info.display_changed = false;
-    canvas_info.highest_refresh_rate = 0;
-
-    uint32_t max_displays = MAX_DISPLAYS;
-    CGDirectDisplayID display[MAX_DISPLAYS];
-    uint32_t display_count = 0;
+    const VkPhysicalDeviceMemoryProperties *mem_props = &vk_info.memory_properties;
 
-    CGError err = CGGetActiveDisplayList(max_displays, display, &display_count);
-    if (err != kCGErrorSuccess)
+    for (uint32_t i = 0; i < mem_props->memoryTypeCount; i++)
     {
-        CANVAS_RETURN_ERR(CANVAS_ERR_GET_DISPLAY, "get display list: %d\n", err);
+        if ((type_filter & (1 << i)) && (mem_props->memoryTypes[i].propertyFlags & properties) == properties)
+        {
+            CANVAS_RETURN(i);
+        }
     }
 
-    CGDirectDisplayID main_display = CGMainDisplayID();
+    CANVAS_RETURN(UINT32_MAX);
+}
 
-    for (uint32_t i = 0; i < display_count && i < MAX_DISPLAYS; i++)
-    {
-        CGDirectDisplayID display_id = display[i];
-        CGRect bounds = CGDisplayBounds(display_id);
-        CGDisplayModeRef mode = CGDisplayCopyDisplayMode(display_id);
-        double refresh_rate = 60.0;
+// memory properties to try for a buffer usage, best first
+static uint32_t vk_memory_placement(canvas_buffer_usage usage, VkMemoryPropertyFlags candidates[4])
+{
+    const VkMemoryPropertyFlags local = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+    const VkMemoryPropertyFlags host = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    uint32_t count = 0;
 
-        if (mode)
-        {
-            refresh_rate = CGDisplayModeGetRefreshRate(mode);
+#if CANVAS_VULKAN_CACHED_MAPPING
+    // fast cpu reads and read-modify-write, at the cost of flushing what was written
+    if (usage != CANVAS_BUFFER_STATIC)
+        candidates[count++] = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+#endif
 
-            if (refresh_rate <= 0.0)
-                refresh_rate = 60.0;
+    switch (usage)
+    {
+    case CANVAS_BUFFER_DYNAMIC:
+    case CANVAS_BUFFER_PER_FRAME:
+        // small and rewritten often, worth a spot in the BAR window when there is one
+        candidates[count++] = local | host;
+        candidates[count++] = host;
+        break;
+    case CANVAS_BUFFER_STAGING:
+        // read back by the cpu, uncached reads are very slow
+        candidates[count++] = host | VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+        candidates[count++] = host;
+        break;
+    default:
+        // only mappable vram that is all of vram, a small BAR window would fill up with static data
+        if (vk_info.host_visible_vram)
+            candidates[count++] = local | host;
+        candidates[count++] = local;
+        candidates[count++] = host;
+        break;
+    }
 
-            CGDisplayModeRelease(mode);
-        }
+    return count;
+}
 
-        canvas_info.display[i].primary = (display_id == main_display);
-        canvas_info.display[i].x = (int)bounds.origin.x;
-        canvas_info.display[i].y = (int)bounds.origin.y;
-        canvas_info.display[i].width = (int)bounds.size.width;
-        canvas_info.display[i].height = (int)bounds.size.height;
-        canvas_info.display[i].refresh_rate = (int)refresh_rate;
+// binary buddy over one VkDeviceMemory, tree[n] holds 1 + the order of the largest free run under node n
+typedef struct
+{
+    VkDeviceMemory memory;
+    uint32_t memory_type;
+    uint8_t *tree;
+    uint8_t *mapped;
+    VkDeviceSize used;
+    uint32_t allocations;
+} canvas_vk_block;
 
-        if ((int)refresh_rate > canvas_info.highest_refresh_rate)
-            canvas_info.highest_refresh_rate = (int)refresh_rate;
+typedef struct
+{
+    VkDeviceMemory memory;
+    VkDeviceSize offset;
+    void *mapped;
+    int32_t block;
+    uint32_t node;
+    uint32_t memory_type;
+} canvas_vk_allocation;
 
-        canvas_info.display_count++;
-    }
+static canvas_vk_block vk_blocks[CANVAS_VK_MAX_BLOCKS] = {0};
+static canvas_memory_stats vk_memory_stats = {0};
 
-    for (int i = 0; i < MAX_CANVAS; i++)
+static uint32_t vk_buddy_levels(void)
+{
+    uint32_t levels = 0;
+    while ((CANVAS_VK_MIN_ALLOC << levels) < CANVAS_VK_BLOCK_SIZE)
+        levels++;
+    return levels;
+}
+
+static uint32_t vk_buddy_depth(uint32_t node)
+{
+    uint32_t depth = 0;
+    while (node > 0)
     {
-        if (canvas_info.canvas[i].window)
-            _canvas_get_window_display(i);
+        node = (node - 1) / 2;
+        depth++;
     }
-
-    CANVAS_RETURN(canvas_info.display_count);
+    return depth;
 }
 
-void _canvas_display_reconfigure_callback(CGDirectDisplayID display, CGDisplayChangeSummaryFlags flags, void *userInfo)
+static void vk_buddy_update_parents(uint8_t *tree, uint32_t node, uint32_t order)
 {
-    CANVAS_ENTER_FUNC();
+    while (node > 0)
+    {
+        node = (node - 1) / 2;
+        uint8_t left = tree[node * 2 + 1];
+        uint8_t right = tree[node * 2 + 2];
 
-    if (flags & (kCGDisplayAddFlag | kCGDisplayRemoveFlag | kCGDisplaySetModeFlag | kCGDisplayDesktopShapeChangedFlag))
-        canvas_info.display_changed = true;
+        // two whole free buddies merge back into their parent
+        if (left == order + 1 && right == order + 1)
+            tree[node] = (uint8_t)(order + 2);
+        else
+            tree[node] = left > right ? left : right;
 
-    CANVAS_RETURN_VOID();
+        order++;
+    }
 }
 
-int _canvas_init_displays()
+static bool vk_buddy_alloc(uint8_t *tree, uint32_t order, uint32_t *node, VkDeviceSize *offset)
 {
-    CANVAS_ENTER_FUNC();
+    uint32_t levels = vk_buddy_levels();
 
-    canvas_info.display_count = 0;
-    CGDisplayRegisterReconfigurationCallback(_canvas_display_reconfigure_callback, NULL);
+    if (tree[0] < order + 1)
+        return false;
 
-    int result = _canvas_refresh_displays();
-    CANVAS_RETURN(result);
+    uint32_t n = 0;
+    for (uint32_t node_order = levels; node_order > order; node_order--)
+    {
+        n = n * 2 + 1;
+        if (tree[n] < order + 1)
+            n++;
+    }
+
+    tree[n] = 0;
+    vk_buddy_update_parents(tree, n, order);
+
+    uint32_t depth = levels - order;
+    *node = n;
+    *offset = (VkDeviceSize)(n - ((1u << depth) - 1)) * (CANVAS_VK_MIN_ALLOC << order);
+    return true;
 }
 
-void _post_init()
+static void vk_buddy_free(uint8_t *tree, uint32_t node)
+{
+    uint32_t order = vk_buddy_levels() - vk_buddy_depth(node);
+    tree[node] = (uint8_t)(order + 1);
+    vk_buddy_update_parents(tree, node, order);
+}
+
+static int vk_block_create(uint32_t memory_type)
 {
     CANVAS_ENTER_FUNC();
 
-    if (canvas_info.init_post)
+    int slot = -1;
+    for (int i = 0; i < CANVAS_VK_MAX_BLOCKS; i++)
     {
-        CANVAS_RETURN_VOID();
+        if (!vk_blocks[i].memory)
+        {
+            slot = i;
+            break;
+        }
     }
-    canvas_info.init_post = 1;
 
-    objc_id poolClass = cls("NSAutoreleasePool");
-    if (!poolClass)
+    if (slot < 0)
+        CANVAS_RETURN(-1);
+
+    uint32_t levels = vk_buddy_levels();
+    size_t node_count = ((size_t)2 << levels) - 1;
+
+    uint8_t *tree = (uint8_t *)malloc(node_count);
+    if (!tree)
+        CANVAS_RETURN(-1);
+
+    // every node starts as one free run of its own size
+    for (uint32_t depth = 0, first = 0; depth <= levels; depth++)
     {
-        CANVAS_RETURN_VOID();
+        memset(tree + first, (int)(levels - depth + 1), (size_t)1 << depth);
+        first += 1u << depth;
     }
 
-    objc_id alloc = msg_id(poolClass, "alloc");
-    canvas_macos.pool = msg_id(alloc, "init");
-    mach_timebase_info(&canvas_macos.timebase);
+    VkMemoryAllocateInfo alloc_info = {0};
+    alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    alloc_info.allocationSize = CANVAS_VK_BLOCK_SIZE;
+    alloc_info.memoryTypeIndex = memory_type;
 
-    CANVAS_RETURN_VOID();
+    VkDeviceMemory memory;
+    if (vk_info.vkAllocateMemory(vk_info.device, &alloc_info, NULL, &memory) != VK_SUCCESS)
+    {
+        free(tree);
+        CANVAS_RETURN(-1);
+    }
+
+    // host visible blocks stay mapped, a VkDeviceMemory can only be mapped once
+    void *mapped = NULL;
+    if (vk_info.memory_properties.memoryTypes[memory_type].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+        vk_info.vkMapMemory(vk_info.device, memory, 0, VK_WHOLE_SIZE, 0, &mapped);
+
+    canvas_vk_block *block = &vk_blocks[slot];
+    block->memory = memory;
+    block->memory_type = memory_type;
+    block->tree = tree;
+    block->mapped = (uint8_t *)mapped;
+    block->used = 0;
+    block->allocations = 0;
+
+    vk_memory_stats.block_count++;
+    vk_memory_stats.block_bytes += CANVAS_VK_BLOCK_SIZE;
+
+    CANVAS_VERBOSE("allocated %llu MiB memory block %d (type %u)\n",
+                   (unsigned long long)(CANVAS_VK_BLOCK_SIZE >> 20), slot, memory_type);
+    CANVAS_RETURN(slot);
 }
 
-static void hid_input_cb(void *ctx, IOReturn res, void *sender, IOHIDValueRef value)
+static void vk_block_destroy(int slot)
 {
-    IOHIDElementRef elem = IOHIDValueGetElement(value);
-    uint32_t page = IOHIDElementGetUsagePage(elem);
-    uint32_t usage = IOHIDElementGetUsage(elem);
+    canvas_vk_block *block = &vk_blocks[slot];
 
-    if (page == 0x07) // USB HID Keyboard/Keypad page id
-    {
-        bool pressed = IOHIDValueGetIntegerValue(value) != 0;
-        int hid_key = (int)usage;
+    if (block->mapped)
+        vk_info.vkUnmapMemory(vk_info.device, block->memory);
 
-        if (hid_key > 0 && hid_key < 256)
-        {
-            bool was_down = canvas_keyboard.keys[hid_key];
-            canvas_keyboard.keys[hid_key] = pressed;
+    vk_info.vkFreeMemory(vk_info.device, block->memory, NULL);
+    free(block->tree);
 
-            if (pressed && !was_down)
-            {
-                canvas_keyboard.keys_pressed[hid_key] = true;
-            }
-            else if (!pressed && was_down)
-            {
-                canvas_keyboard.keys_released[hid_key] = true;
-            }
-        }
-    }
+    vk_memory_stats.block_count--;
+    vk_memory_stats.block_bytes -= CANVAS_VK_BLOCK_SIZE;
+
+    memset(block, 0, sizeof(*block));
 }
 
-static IOHIDManagerRef start_hid()
+static int vk_memory_alloc(const VkMemoryRequirements *reqs, VkMemoryPropertyFlags properties, VkDeviceSize requested, canvas_vk_allocation *out)
 {
-    IOHIDManagerRef m = IOHIDManagerCreate(kCFAllocatorDefault, kIOHIDOptionsTypeNone);
-
-    const uint32_t devPage = 0x01, devUsage = 0x06;
-    CFMutableDictionaryRef match = CFDictionaryCreateMutable(NULL, 0,
-                                                             &kCFCopyStringDictionaryKeyCallBacks, &kCFTypeDictionaryValueCallBacks);
-    CFNumberRef nPage = CFNumberCreate(NULL, kCFNumberIntType, &devPage);
-    CFNumberRef nUsage = CFNumberCreate(NULL, kCFNumberIntType, &devUsage);
-    CFDictionarySetValue(match, CFSTR(kIOHIDDeviceUsagePageKey), nPage);
-    CFDictionarySetValue(match, CFSTR(kIOHIDDeviceUsageKey), nUsage);
-    CFRelease(nPage);
-    CFRelease(nUsage);
-
-    IOHIDManagerSetDeviceMatching(m, match);
-    CFRelease(match);
+    CANVAS_ENTER_FUNC();
+    CANVAS_ASSERT_NOT_NULL(reqs);
+    CANVAS_ASSERT_NOT_NULL(out);
 
-    IOHIDManagerRegisterInputValueCallback(m, hid_input_cb, NULL);
-    IOHIDManagerScheduleWithRunLoop(m, CFRunLoopGetCurrent(), kCFRunLoopCommonModes);
+    memset(out, 0, sizeof(*out));
+    out->block = -1;
 
-    IOReturn r = IOHIDManagerOpen(m, kIOHIDOptionsTypeNone);
-    if (r != kIOReturnSuccess)
+    uint32_t memory_type = vk_find_memory_type(reqs->memoryTypeBits, properties);
+    if (memory_type == UINT32_MAX)
     {
+        CANVAS_VERBOSE("no memory type with properties 0x%x\n", properties);
+        CANVAS_RETURN(CANVAS_FAIL);
     }
-    return m;
-}
 
-int _canvas_platform()
-{
-    CANVAS_ENTER_FUNC();
+    out->memory_type = memory_type;
 
-    _post_init();
+    // buddy offsets are aligned to their size, so round up to the alignment too
+    VkDeviceSize size = reqs->size > reqs->alignment ? reqs->size : reqs->alignment;
+    uint32_t order = 0;
+    while ((CANVAS_VK_MIN_ALLOC << order) < size)
+        order++;
 
-    canvas_macos.hid_manager = start_hid();
+    VkDeviceSize rounded = CANVAS_VK_MIN_ALLOC << order;
 
-    canvas_macos.app = msg_id(cls("NSApplication"), "sharedApplication");
-    if (!canvas_macos.app)
+    if (rounded <= CANVAS_VK_BLOCK_SIZE / 2)
     {
-        CANVAS_RETURN_ERR(CANVAS_ERR_GET_PLATFORM, "failed to get NSApplication\n");
+        int slot = -1;
+        uint32_t node = 0;
+        VkDeviceSize offset = 0;
+
+        for (int i = 0; i < CANVAS_VK_MAX_BLOCKS && slot < 0; i++)
+        {
+            if (vk_blocks[i].memory && vk_blocks[i].memory_type == memory_type &&
+                vk_buddy_alloc(vk_blocks[i].tree, order, &node, &offset))
+                slot = i;
+        }
+
+        if (slot < 0)
+        {
+            slot = vk_block_create(memory_type);
+            if (slot >= 0 && !vk_buddy_alloc(vk_blocks[slot].tree, order, &node, &offset))
+                slot = -1;
+        }
+
+        if (slot >= 0)
+        {
+            canvas_vk_block *block = &vk_blocks[slot];
+            block->used += rounded;
+            block->allocations++;
+
+            out->memory = block->memory;
+            out->offset = offset;
+            out->mapped = block->mapped ? block->mapped + offset : NULL;
+            out->block = slot;
+            out->node = node;
+
+            vk_memory_stats.used_bytes += rounded;
+            vk_memory_stats.requested_bytes += requested;
+            vk_memory_stats.allocation_count++;
+            CANVAS_RETURN(CANVAS_OK);
+        }
+
+        CANVAS_VERBOSE("no memory block available for type %u, using a dedicated allocation\n", memory_type);
     }
 
-    msg_void_long(canvas_macos.app, "setActivationPolicy:", NSApplicationActivationPolicyRegular);
-    msg_void_bool(canvas_macos.app, "activateIgnoringOtherApps:", true);
+    VkMemoryAllocateInfo alloc_info = {0};
+    alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    alloc_info.allocationSize = reqs->size;
+    alloc_info.memoryTypeIndex = memory_type;
+
+    if (vk_info.vkAllocateMemory(vk_info.device, &alloc_info, NULL, &out->memory) != VK_SUCCESS)
+        CANVAS_RETURN(CANVAS_FAIL);
+
+    if (vk_info.memory_properties.memoryTypes[memory_type].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+        vk_info.vkMapMemory(vk_info.device, out->memory, 0, VK_WHOLE_SIZE, 0, &out->mapped);
+
+    vk_memory_stats.dedicated_count++;
+    vk_memory_stats.dedicated_bytes += reqs->size;
+    vk_memory_stats.allocation_count++;
 
     CANVAS_RETURN(CANVAS_OK);
 }
 
-int _canvas_window(int64_t x, int64_t y, int64_t width, int64_t height, const char *title)
+static void vk_memory_free(VkDeviceMemory memory, int32_t slot, uint32_t node, bool mapped, VkDeviceSize requested, VkDeviceSize dedicated_size)
 {
     CANVAS_ENTER_FUNC();
 
-    _post_init();
-    canvas_startup();
-
-    unsigned long style = NSWindowStyleMaskTitled | NSWindowStyleMaskClosable | NSWindowStyleMaskMiniaturizable | NSWindowStyleMaskResizable;
+    vk_memory_stats.allocation_count--;
 
-    objc_id winClass = cls("NSWindow");
-    if (!winClass)
+    if (slot < 0)
     {
-        CANVAS_RETURN_ERR(CANVAS_ERR_GET_WINDOW, "failed to get NSWindow class\n");
-    }
+        if (mapped)
+            vk_info.vkUnmapMemory(vk_info.device, memory);
 
-    int window_id = _canvas_get_free();
-    if (window_id < 0)
-    {
-        CANVAS_RETURN(window_id);
+        vk_info.vkFreeMemory(vk_info.device, memory, NULL);
+        vk_memory_stats.dedicated_count--;
+        vk_memory_stats.dedicated_bytes -= dedicated_size;
+        CANVAS_RETURN_VOID();
     }
 
-    objc_id walloc = msg_id(winClass, "alloc");
+    CANVAS_ASSERT_RANGE(slot, 0, CANVAS_VK_MAX_BLOCKS - 1);
+    canvas_vk_block *block = &vk_blocks[slot];
+    CANVAS_ASSERT(block->memory == memory);
 
-    typedef objc_id (*msg_initWin)(objc_id, objc_sel, _CGRect, unsigned long, long, int);
+    VkDeviceSize rounded = CANVAS_VK_BLOCK_SIZE >> vk_buddy_depth(node);
+    vk_buddy_free(block->tree, node);
 
-    _CGRect rect = make_rect(x, y, width, height);
+    block->used -= rounded;
+    block->allocations--;
+    vk_memory_stats.used_bytes -= rounded;
+    vk_memory_stats.requested_bytes -= requested;
 
-    objc_id window = ((msg_initWin)objc_msgSend)(walloc, sel_c("initWithContentRect:styleMask:backing:defer:"), rect, style, (long)NSBackingStoreBuffered, 0);
+    if (block->allocations > 0)
+        CANVAS_RETURN_VOID();
 
-    if (!window)
+    // one empty block per memory type is kept so a buffer recreated every frame doesn't reallocate it,
+    // the rest go back to the driver and canvas_exit frees the spare
+    for (int i = 0; i < CANVAS_VK_MAX_BLOCKS; i++)
     {
-        canvas_info.canvas[window_id]._valid = false;
-        CANVAS_RETURN_ERR(CANVAS_ERR_GET_WINDOW, "failed to create NSWindow\n");
+        if (i != slot && vk_blocks[i].memory && vk_blocks[i].memory_type == block->memory_type &&
+            vk_blocks[i].allocations == 0)
+        {
+            vk_block_destroy(slot);
+            break;
+        }
     }
 
-    msg_void_bool(window, "setTitlebarAppearsTransparent:", true);
-    msg_void_long(window, "setTitleVisibility:", NSWindowTitleHidden);
+    CANVAS_RETURN_VOID();
+}
 
-    unsigned long sm = msg_ulong(window, "styleMask");
-    sm |= NSWindowStyleMaskFullSizeContent;
-    msg_void_long(window, "setStyleMask:", sm);
+// frees destroyed buffers whose last frame has completed, all of them when forced
+static void vk_collect_buffers(int window_id, bool force)
+{
+    CANVAS_ENTER_FUNC();
+    CANVAS_ASSERT_RANGE(window_id, 0, MAX_CANVAS - 1);
 
-    if (title)
-    {
-        objc_id nsTitle = nsstring_from_cstr(title);
-        if (nsTitle)
-            msg_void_id(window, "setTitle:", nsTitle);
-    }
+    canvas_vulkan_window *vk_win = &vk_windows[window_id];
+    uint64_t completed = force ? 0 : vk_timeline_completed(vk_win);
+    uint32_t kept = 0;
 
-    msg_void_id(window, "makeKeyAndOrderFront:", NULL);
+    for (uint32_t i = 0; i < vk_win->dead_buffer_count; i++)
+    {
+        canvas_vk_dead_buffer *dead = &vk_win->dead_buffers[i];
+        if (force || dead->retire_frame <= completed)
+        {
+            vk_info.vkDestroyBuffer(vk_info.device, dead->buffer, NULL);
+            vk_memory_free(dead->memory, dead->block, dead->node, dead->mapped, dead->requested, dead->size);
+            continue;
+        }
 
-    canvas_info.canvas[window_id].window = window;
-    canvas_info.canvas[window_id].resize = false;
-    canvas_info.canvas[window_id].index = window_id;
-    canvas_info.canvas[window_id].minimized = false;
-    canvas_info.canvas[window_id].maximized = false;
-    canvas_info.canvas[window_id].fullscreen = false;
-    canvas_info.canvas[window_id]._valid = true;
+        vk_win->dead_buffers[kept++] = *dead;
+    }
 
-    CANVAS_RETURN(window_id);
+    vk_win->dead_buffer_count = kept;
+    CANVAS_RETURN_VOID();
 }
 
-int _canvas_gpu_init()
+int canvas_gpu_memory_stats(canvas_memory_stats *stats)
 {
     CANVAS_ENTER_FUNC();
+    CANVAS_ASSERT_NOT_NULL(stats);
 
-    if (canvas_info.init_gpu)
-    {
-        CANVAS_RETURN(CANVAS_OK);
-    }
-    canvas_info.init_gpu = 1;
+    if (!stats)
+        CANVAS_RETURN(CANVAS_INVALID);
 
-    canvas_macos.device = MTLCreateSystemDefaultDevice();
-    if (!canvas_macos.device)
-    {
-        CANVAS_RETURN_ERR(CANVAS_ERR_GET_GPU, "failed to create Metal device\n");
-    }
+    *stats = vk_memory_stats;
+    stats->largest_free = 0;
+    stats->fragmentation = 0.0f;
 
-    canvas_macos.queue = msg_id(canvas_macos.device, "newCommandQueue");
-    if (!canvas_macos.queue)
+    VkDeviceSize free_bytes = 0;
+    for (int i = 0; i < CANVAS_VK_MAX_BLOCKS; i++)
     {
-        CANVAS_RETURN_ERR(CANVAS_ERR_GET_GPU, "failed to create Metal command queue\n");
+        if (!vk_blocks[i].memory)
+            continue;
+
+        free_bytes += CANVAS_VK_BLOCK_SIZE - vk_blocks[i].used;
+
+        uint8_t root = vk_blocks[i].tree[0];
+        VkDeviceSize largest = root ? CANVAS_VK_MIN_ALLOC << (root - 1) : 0;
+        if (largest > stats->largest_free)
+            stats->largest_free = largest;
     }
 
+    if (free_bytes > 0)
+        stats->fragmentation = 1.0f - (float)stats->largest_free / (float)free_bytes;
+
     CANVAS_RETURN(CANVAS_OK);
 }
 
-int _canvas_update_drawable_size(int window_id)
+typedef struct
+{
+    VkCommandBuffer cmd;
+    VkFence fence; // fence path only, the timeline path signals upload_timeline with the token
+    uint64_t token;
+    VkDeviceSize bytes; // staging ring bytes held until the batch completes
+    bool open;
+    bool submitted;
+    bool overwrites; // copies into buffers that earlier frames may still read
+} canvas_vk_upload_batch;
+
+// copies go through one mapped ring and are submitted in batches, tokens count the batches
+static struct
+{
+    bool initialized;
+    VkCommandPool pool;
+    VkBuffer staging;
+    canvas_vk_allocation staging_allocation;
+    VkDeviceSize head;
+    VkDeviceSize in_use;
+    VkSemaphore timeline;
+    uint64_t next_token;
+    uint64_t submitted;
+    uint64_t completed;
+    canvas_vk_upload_batch batches[CANVAS_VK_UPLOAD_BATCHES];
+} vk_upload = {0};
+
+static int vk_upload_init(void)
 {
     CANVAS_ENTER_FUNC();
-    CANVAS_BOUNDS(window_id);
+    CANVAS_ASSERT_NOT_NULL(vk_info.device);
 
-    if (!_canvas_data[window_id].view || !_canvas_data[window_id].layer)
+    VkCommandPoolCreateInfo pool_info = {0};
+    pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    pool_info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    pool_info.queueFamilyIndex = (uint32_t)vk_info.transfer_family;
+
+    VkResult result = vk_info.vkCreateCommandPool(vk_info.device, &pool_info, NULL, &vk_upload.pool);
+    VK_CHECK(result, "failed to create upload command pool");
+
+    VkBufferCreateInfo staging_info = {0};
+    staging_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    staging_info.size = CANVAS_VK_STAGING_SIZE;
+    staging_info.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    staging_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    result = vk_info.vkCreateBuffer(vk_info.device, &staging_info, NULL, &vk_upload.staging);
+    VK_CHECK(result, "failed to create staging ring");
+
+    VkMemoryRequirements mem_reqs;
+    vk_info.vkGetBufferMemoryRequirements(vk_info.device, vk_upload.staging, &mem_reqs);
+
+    if (vk_memory_alloc(&mem_reqs, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                        CANVAS_VK_STAGING_SIZE, &vk_upload.staging_allocation) != CANVAS_OK ||
+        !vk_upload.staging_allocation.mapped)
     {
-        CANVAS_RETURN_ERR(CANVAS_ERR_GET_DISPLAY, "no view or layer to update drawable size: %d\n", window_id);
+        CANVAS_RETURN_ERR(CANVAS_FAIL, "failed to allocate staging ring memory\n");
     }
 
-    _CGRect b = msg_rect(_canvas_data[window_id].view, "bounds");
-    double w = b.w * _canvas_data[window_id].scale;
-    double h = b.h * _canvas_data[window_id].scale;
-    msg_void_size(_canvas_data[window_id].layer, "setDrawableSize:", w, h);
+    vk_info.vkBindBufferMemory(vk_info.device, vk_upload.staging, vk_upload.staging_allocation.memory, vk_upload.staging_allocation.offset);
 
-    CANVAS_RETURN(CANVAS_OK);
-}
+    VkCommandBufferAllocateInfo alloc_info = {0};
+    alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    alloc_info.commandPool = vk_upload.pool;
+    alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    alloc_info.commandBufferCount = 1;
 
-int _canvas_window_resize(int window_id)
-{
-    CANVAS_ENTER_FUNC();
-    CANVAS_BOUNDS(window_id);
+    VkFenceCreateInfo fence_info = {0};
+    fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
 
-    if (!_canvas_data[window_id].layer)
+    for (int i = 0; i < CANVAS_VK_UPLOAD_BATCHES; i++)
     {
-        CANVAS_RETURN(CANVAS_OK);
+        result = vk_info.vkAllocateCommandBuffers(vk_info.device, &alloc_info, &vk_upload.batches[i].cmd);
+        VK_CHECK(result, "failed to allocate upload command buffer");
+
+        if (!vk_info.timeline)
+        {
+            result = vk_info.vkCreateFence(vk_info.device, &fence_info, NULL, &vk_upload.batches[i].fence);
+            VK_CHECK(result, "failed to create upload fence");
+        }
     }
 
-    canvas_info.canvas[window_id].resize = false;
+    if (vk_info.timeline)
+    {
+        VkSemaphoreTypeCreateInfo type_info = {0};
+        type_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+        type_info.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
 
-    _canvas_update_drawable_size(window_id);
+        VkSemaphoreCreateInfo semaphore_info = {0};
+        semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+        semaphore_info.pNext = &type_info;
+
+        result = vk_info.vkCreateSemaphore(vk_info.device, &semaphore_info, NULL, &vk_upload.timeline);
+        VK_CHECK(result, "failed to create upload timeline");
+    }
 
+    vk_upload.next_token = 1;
+    vk_upload.initialized = true;
     CANVAS_RETURN(CANVAS_OK);
 }
 
-int _canvas_gpu_new_window(int window_id)
+static void vk_upload_cleanup(void)
 {
-    CANVAS_ENTER_FUNC();
-    CANVAS_BOUNDS(window_id);
+    if (!vk_upload.pool)
+        return;
 
-    objc_id window = canvas_info.canvas[window_id].window;
-    if (!window)
+    for (int i = 0; i < CANVAS_VK_UPLOAD_BATCHES; i++)
     {
-        CANVAS_RETURN_ERR(CANVAS_ERR_GET_WINDOW, "no window for GPU setup: %d\n", window_id);
+        if (vk_upload.batches[i].fence)
+            vk_info.vkDestroyFence(vk_info.device, vk_upload.batches[i].fence, NULL);
     }
 
-    objc_id content_view = msg_id(window, "contentView");
-    if (!content_view)
-    {
-        CANVAS_RETURN_ERR(CANVAS_ERR_GET_WINDOW, "no content view: %d\n", window_id);
-    }
+    if (vk_upload.timeline)
+        vk_info.vkDestroySemaphore(vk_info.device, vk_upload.timeline, NULL);
 
-    msg_void_bool(content_view, "setWantsLayer:", true);
+    if (vk_upload.staging)
+        vk_info.vkDestroyBuffer(vk_info.device, vk_upload.staging, NULL);
 
-    objc_id layer_class = cls("CAMetalLayer");
-    if (!layer_class)
+    if (vk_upload.staging_allocation.memory)
+        vk_memory_free(vk_upload.staging_allocation.memory, vk_upload.staging_allocation.block, vk_upload.staging_allocation.node,
+                       vk_upload.staging_allocation.mapped != NULL, CANVAS_VK_STAGING_SIZE, CANVAS_VK_STAGING_SIZE);
+
+    vk_info.vkDestroyCommandPool(vk_info.device, vk_upload.pool, NULL);
+    memset(&vk_upload, 0, sizeof(vk_upload));
+}
+
+// retires finished batches in order and gives their ring bytes back
+static uint64_t vk_upload_poll(void)
+{
+    if (vk_info.timeline && vk_upload.timeline)
     {
-        CANVAS_RETURN_ERR(CANVAS_ERR_GET_GPU, "failed to get CAMetalLayer class\n");
+        uint64_t value = 0;
+        vk_info.vkGetSemaphoreCounterValue(vk_info.device, vk_upload.timeline, &value);
+        while (vk_upload.completed < value)
+        {
+            canvas_vk_upload_batch *batch = &vk_upload.batches[(vk_upload.completed + 1) % CANVAS_VK_UPLOAD_BATCHES];
+            vk_upload.in_use -= batch->bytes;
+            batch->bytes = 0;
+            batch->submitted = false;
+            vk_upload.completed++;
+        }
+        return vk_upload.completed;
     }
 
-    objc_id layer_alloc = msg_id(layer_class, "alloc");
-    objc_id layer = msg_id(layer_alloc, "init");
-
-    if (!layer)
+    while (vk_upload.completed < vk_upload.submitted)
     {
-        msg_void(layer_alloc, "release");
-        CANVAS_RETURN_ERR(CANVAS_ERR_GET_GPU, "failed to create Metal layer\n");
+        canvas_vk_upload_batch *batch = &vk_upload.batches[(vk_upload.completed + 1) % CANVAS_VK_UPLOAD_BATCHES];
+        if (vk_info.vkGetFenceStatus(vk_info.device, batch->fence) != VK_SUCCESS)
+            break;
+
+        vk_upload.in_use -= batch->bytes;
+        batch->bytes = 0;
+        batch->submitted = false;
+        vk_upload.completed++;
     }
 
-    msg_void_id(layer, "setDevice:", canvas_macos.device);
-    msg_void_bool(layer, "setPresentsWithTransaction:", false);
+    return vk_upload.completed;
+}
 
-    msg_void_id(content_view, "setLayer:", layer);
+static canvas_vk_upload_batch *vk_upload_open_batch(void)
+{
+    canvas_vk_upload_batch *batch = &vk_upload.batches[vk_upload.next_token % CANVAS_VK_UPLOAD_BATCHES];
+    return batch->open ? batch : NULL;
+}
 
-    /* backingScaleFactor returns a double (CGFloat) on NSWindow, call it directly */
-    double scale = msg_dbl(window, "backingScaleFactor");
+// submits the open batch, returns its token or the last submitted one
+static uint64_t vk_upload_flush(void)
+{
+    CANVAS_ENTER_FUNC();
 
-    if (scale == 0.0)
-        scale = 1.0;
+    canvas_vk_upload_batch *batch = vk_upload_open_batch();
+    if (!batch)
+        CANVAS_RETURN(vk_upload.submitted);
 
-    msg_void_double(layer, "setContentsScale:", scale);
+    // same queue: later submits see the copies through this barrier, other queues through the timeline
+    VkMemoryBarrier barrier = {0};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = vk_info.transfer_family == vk_info.graphics_family
+                                ? VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_UNIFORM_READ_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT
+                                : VK_ACCESS_TRANSFER_WRITE_BIT;
 
-    _canvas_data[window_id].layer = layer;
-    _canvas_data[window_id].view = content_view;
-    _canvas_data[window_id].scale = scale;
+    VkPipelineStageFlags dst_stage = vk_info.transfer_family == vk_info.graphics_family
+                                         ? VK_PIPELINE_STAGE_ALL_COMMANDS_BIT
+                                         : VK_PIPELINE_STAGE_TRANSFER_BIT;
 
-    _canvas_update_drawable_size(window_id);
+    vk_info.vkCmdPipelineBarrier(batch->cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, dst_stage, 0, 1, &barrier, 0, NULL, 0, NULL);
+    vk_info.vkEndCommandBuffer(batch->cmd);
 
-    CANVAS_VERBOSE("metal layer setup complete for window %d\n", window_id);
+    uint64_t token = batch->token;
 
-    CANVAS_RETURN(CANVAS_OK);
-}
+    VkTimelineSemaphoreSubmitInfo timeline_info = {0};
+    timeline_info.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    timeline_info.signalSemaphoreValueCount = 1;
+    timeline_info.pSignalSemaphoreValues = &token;
 
-int _canvas_present(int window_id)
-{
-    CANVAS_ENTER_FUNC();
-    CANVAS_BOUNDS(window_id);
+    VkSubmitInfo submit_info = {0};
+    submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submit_info.commandBufferCount = 1;
+    submit_info.pCommandBuffers = &batch->cmd;
 
-    if (!_canvas_data[window_id].layer)
+    if (vk_upload.timeline)
     {
-        CANVAS_RETURN_ERR(CANVAS_ERR_GET_WINDOW, "no layer to present: %d\n", window_id);
+        submit_info.pNext = &timeline_info;
+        submit_info.signalSemaphoreCount = 1;
+        submit_info.pSignalSemaphores = &vk_upload.timeline;
     }
 
-    objc_id drawable = msg_id(_canvas_data[window_id].layer, "nextDrawable");
-    if (!drawable)
+    // on another queue, overwrites wait for the frames already submitted to finish reading
+    VkSemaphore wait_semaphores[MAX_CANVAS];
+    VkPipelineStageFlags wait_stages[MAX_CANVAS];
+    uint64_t wait_values[MAX_CANVAS];
+    uint32_t wait_count = 0;
+
+    if (batch->overwrites && vk_info.transfer_family != vk_info.graphics_family)
     {
-        CANVAS_WARN("no drawable available for window %d\n", window_id);
-        CANVAS_RETURN(CANVAS_OK);
+        for (int i = 0; i < MAX_CANVAS; i++)
+        {
+            canvas_vulkan_window *vk_win = &vk_windows[i];
+            if (!vk_win->initialized || !vk_win->timeline || vk_win->timeline_value == 0)
+                continue;
+
+            wait_semaphores[wait_count] = vk_win->timeline;
+            wait_stages[wait_count] = VK_PIPELINE_STAGE_TRANSFER_BIT;
+            wait_values[wait_count] = vk_win->timeline_value;
+            wait_count++;
+        }
+
+        timeline_info.waitSemaphoreValueCount = wait_count;
+        timeline_info.pWaitSemaphoreValues = wait_values;
+        submit_info.waitSemaphoreCount = wait_count;
+        submit_info.pWaitSemaphores = wait_semaphores;
+        submit_info.pWaitDstStageMask = wait_stages;
     }
 
-    objc_id cmdBuffer = msg_id(canvas_macos.queue, "commandBuffer");
-    if (!cmdBuffer)
-    {
-        CANVAS_RETURN_ERR(CANVAS_FAIL, "failed to create command buffer\n");
-    }
-
-    objc_id renderPassDescriptor = msg_id(cls("MTLRenderPassDescriptor"), "renderPassDescriptor");
-    if (!renderPassDescriptor)
-    {
-        CANVAS_RETURN_ERR(CANVAS_FAIL, "failed to create render pass descriptor\n");
-    }
+    VkResult result = vk_info.vkQueueSubmit(vk_info.transfer_queue, 1, &submit_info, batch->fence);
+    if (result != VK_SUCCESS)
+        CANVAS_ERR("failed to submit upload batch %llu (result=%d)\n", (unsigned long long)token, result);
 
-    objc_id color_attachments = msg_id(renderPassDescriptor, "colorAttachments");
-    objc_id color_attachment = msg_id_ulong(color_attachments, "objectAtIndexedSubscript:", 0);
+    batch->open = false;
+    batch->submitted = true;
+    vk_upload.submitted = token;
+    vk_upload.next_token++;
 
-    objc_id texture = msg_id(drawable, "texture");
-    msg_void_id(color_attachment, "setTexture:", texture);
-    msg_void_long(color_attachment, "setLoadAction:", MTLLoadActionClear);
-    msg_void_long(color_attachment, "setStoreAction:", MTLStoreActionStore);
+    CANVAS_RETURN(token);
+}
 
-    _MTLClearColor clear_color = make_clear_color(
-        canvas_info.canvas[window_id].clear[0],
-        canvas_info.canvas[window_id].clear[1],
-        canvas_info.canvas[window_id].clear[2],
-        canvas_info.canvas[window_id].clear[3]);
+static VkResult vk_upload_wait_token(uint64_t token, uint64_t timeout)
+{
+    if (token == 0 || vk_upload_poll() >= token)
+        return VK_SUCCESS;
 
-    msg_void_clear_color(color_attachment, "setClearColor:", clear_color);
+    if (token > vk_upload.submitted)
+        vk_upload_flush();
 
-    objc_id renderEncoder = msg_id_id_descriptor(cmdBuffer, "renderCommandEncoderWithDescriptor:", renderPassDescriptor);
-    if (!renderEncoder)
+    VkResult result;
+    if (vk_upload.timeline)
     {
-        CANVAS_RETURN_ERR(CANVAS_FAIL, "failed to create render encoder\n");
+        VkSemaphoreWaitInfo wait_info = {0};
+        wait_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+        wait_info.semaphoreCount = 1;
+        wait_info.pSemaphores = &vk_upload.timeline;
+        wait_info.pValues = &token;
+        result = vk_info.vkWaitSemaphores(vk_info.device, &wait_info, timeout);
+    }
+    else
+    {
+        result = vk_info.vkWaitForFences(vk_info.device, 1, &vk_upload.batches[token % CANVAS_VK_UPLOAD_BATCHES].fence, VK_TRUE, timeout);
     }
 
-    msg_void(renderEncoder, "endEncoding");
-    msg_void_id(cmdBuffer, "presentDrawable:", drawable);
-    msg_void(cmdBuffer, "commit");
-
-    CANVAS_RETURN(CANVAS_OK);
+    vk_upload_poll();
+    return result;
 }
 
-void _canvas_gpu_draw_all()
+static canvas_vk_upload_batch *vk_upload_begin(void)
 {
     CANVAS_ENTER_FUNC();
 
-    if (!canvas_macos.queue)
+    if (!vk_upload.initialized && vk_upload_init() != CANVAS_OK)
     {
-        CANVAS_VERBOSE("no metal command queue\n");
-        CANVAS_RETURN_VOID();
+        vk_upload_cleanup();
+        CANVAS_RETURN(NULL);
     }
 
-    for (int i = 0; i < MAX_CANVAS; ++i)
-    {
-        if (!canvas_info.canvas[i].window || !_canvas_data[i].layer)
-            continue;
+    canvas_vk_upload_batch *batch = vk_upload_open_batch();
+    if (batch)
+        CANVAS_RETURN(batch);
 
-        _canvas_update_drawable_size(i);
+    // the slot is reused every CANVAS_VK_UPLOAD_BATCHES batches
+    batch = &vk_upload.batches[vk_upload.next_token % CANVAS_VK_UPLOAD_BATCHES];
+    if (batch->submitted)
+        vk_upload_wait_token(vk_upload.next_token - CANVAS_VK_UPLOAD_BATCHES, UINT64_MAX);
 
-        objc_id layer = _canvas_data[i].layer;
-        if (!layer)
-            continue;
+    if (batch->fence)
+        vk_info.vkResetFences(vk_info.device, 1, &batch->fence);
 
-        objc_id drawable = msg_id(layer, "nextDrawable");
-        if (!drawable)
-            continue;
+    VkCommandBufferBeginInfo begin_info = {0};
+    begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
 
-        objc_id texture = msg_id(drawable, "texture");
+    vk_info.vkBeginCommandBuffer(batch->cmd, &begin_info);
 
-        objc_id rpd = msg_id(cls("MTLRenderPassDescriptor"), "renderPassDescriptor");
-        objc_id caps = msg_id(rpd, "colorAttachments");
-        objc_id att0 = msg_id_ulong(caps, "objectAtIndexedSubscript:", 0UL);
+    batch->token = vk_upload.next_token;
+    batch->bytes = 0;
+    batch->open = true;
+    batch->overwrites = false;
 
-        msg_void_id(att0, "setTexture:", texture);
-        msg_void_long(att0, "setLoadAction:", MTLLoadActionClear);
-        msg_void_long(att0, "setStoreAction:", MTLStoreActionStore);
+    CANVAS_RETURN(batch);
+}
 
-        _MTLClearColor clear = make_clear_color(
-            canvas_info.canvas[i].clear[0],
-            canvas_info.canvas[i].clear[1],
-            canvas_info.canvas[i].clear[2],
-            canvas_info.canvas[i].clear[3]);
-        msg_void_clear_color(att0, "setClearColor:", clear);
+// reserves ring bytes for the open batch, waiting for older batches only when the ring is full
+static bool vk_upload_reserve(VkDeviceSize size, VkDeviceSize *offset)
+{
+    size = (size + 63) & ~(VkDeviceSize)63;
 
-        objc_id cmd = msg_id(canvas_macos.queue, "commandBuffer");
-        objc_id enc = msg_id_id_descriptor(cmd, "renderCommandEncoderWithDescriptor:", rpd);
-        msg_void(enc, "endEncoding");
+    for (;;)
+    {
+        VkDeviceSize head = vk_upload.head;
+        VkDeviceSize waste = head + size > CANVAS_VK_STAGING_SIZE ? CANVAS_VK_STAGING_SIZE - head : 0;
 
-        msg_void_id(cmd, "presentDrawable:", drawable);
-        msg_void(cmd, "commit");
+        if (vk_upload.in_use + waste + size <= CANVAS_VK_STAGING_SIZE)
+        {
+            if (waste)
+                head = 0;
+
+            canvas_vk_upload_batch *batch = vk_upload_open_batch();
+            batch->bytes += waste + size;
+            vk_upload.in_use += waste + size;
+            vk_upload.head = head + size;
+            *offset = head;
+            return true;
+        }
+
+        if (vk_upload_poll() < vk_upload.submitted)
+        {
+            vk_upload_wait_token(vk_upload.completed + 1, UINT64_MAX);
+            continue;
+        }
+
+        // everything left in the ring belongs to the open batch
+        vk_upload_flush();
+        if (!vk_upload_begin())
+            return false;
+
+        if (vk_upload.in_use > 0 && vk_upload.submitted > vk_upload.completed)
+            continue;
+
+        return false;
     }
+}
 
-    CANVAS_RETURN_VOID();
+// orders a copy after earlier reads and writes of the same buffer, only the first copy in a batch pays for it
+static void vk_upload_order(canvas_vk_upload_batch *batch, canvas_buffer *buf, bool overwrite)
+{
+    // a copy into the same buffer earlier in this batch
+    if (buf->upload == batch->token)
+    {
+        VkMemoryBarrier barrier = {0};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        vk_info.vkCmdPipelineBarrier(batch->cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0, NULL, 0, NULL);
+    }
+
+    if (!overwrite || batch->overwrites)
+        return;
+
+    // reads by frames submitted earlier on the same queue, another queue waits on their timelines at submit
+    if (vk_info.transfer_family == vk_info.graphics_family)
+        vk_info.vkCmdPipelineBarrier(batch->cmd, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, NULL, 0, NULL, 0, NULL);
+
+    batch->overwrites = true;
 }
 
-static int _metal_upload_buffer_data(canvas_buffer *buf, void *data, size_t size)
+// queues a copy into buf, the data is copied out before returning
+static uint64_t vk_upload_copy(canvas_buffer *buf, VkDeviceSize dst_offset, const void *data, VkDeviceSize size, bool overwrite)
 {
     CANVAS_ENTER_FUNC();
-    CANVAS_ASSERT(buf != NULL);
-    CANVAS_ASSERT(data != NULL);
-    CANVAS_ASSERT(size > 0);
 
-    typedef objc_id (*msg_new_buffer)(objc_id, objc_sel, unsigned long, unsigned long);
-    objc_id staging = ((msg_new_buffer)objc_msgSend)(
-        canvas_macos.device,
-        sel_c("newBufferWithLength:options:"),
-        (unsigned long)size,
-        0 // MTLResourceStorageModeShared
-    );
+    const uint8_t *src = (const uint8_t *)data;
+    VkDeviceSize chunk_limit = CANVAS_VK_STAGING_SIZE / 4;
+    uint64_t token = 0;
 
-    if (!staging)
+    while (size > 0)
     {
-        CANVAS_RETURN_ERR(CANVAS_FAIL, "Failed to create staging buffer\n");
-    }
+        canvas_vk_upload_batch *batch = vk_upload_begin();
+        if (!batch)
+            CANVAS_RETURN(0);
 
-    void *staging_ptr = msg_id(staging, "contents");
-    memcpy(staging_ptr, data, size);
+        VkDeviceSize chunk = size < chunk_limit ? size : chunk_limit;
+        VkDeviceSize staging_offset;
 
-    objc_id cmd_buffer = msg_id(canvas_macos.queue, "commandBuffer");
-    if (!cmd_buffer)
-    {
-        msg_void(staging, "release");
-        CANVAS_RETURN_ERR(CANVAS_FAIL, "Failed to create command buffer\n");
-    }
+        if (!vk_upload_reserve(chunk, &staging_offset))
+            CANVAS_RETURN_ERR(0, "staging ring exhausted\n");
 
-    objc_id blit_encoder = msg_id(cmd_buffer, "blitCommandEncoder");
-    if (!blit_encoder)
-    {
-        msg_void(staging, "release");
-        CANVAS_RETURN_ERR(CANVAS_FAIL, "Failed to create blit encoder\n");
+        // reserve may have rolled over to a new batch
+        batch = vk_upload_open_batch();
+        vk_upload_order(batch, buf, overwrite);
+
+        memcpy((uint8_t *)vk_upload.staging_allocation.mapped + staging_offset, src, chunk);
+
+        VkBufferCopy region = {0};
+        region.srcOffset = staging_offset;
+        region.dstOffset = dst_offset;
+        region.size = chunk;
+        vk_info.vkCmdCopyBuffer(batch->cmd, vk_upload.staging, (VkBuffer)buf->platform_handle, 1, &region);
+
+        token = batch->token;
+        buf->upload = token;
+        src += chunk;
+        dst_offset += chunk;
+        size -= chunk;
     }
 
-    typedef void (*msg_copy_buffer)(objc_id, objc_sel, objc_id, unsigned long, objc_id, unsigned long, unsigned long);
-    ((msg_copy_buffer)objc_msgSend)(
-        blit_encoder,
-        sel_c("copyFromBuffer:sourceOffset:toBuffer:destinationOffset:size:"),
-        staging,
-        0UL,
-        buf->platform_handle,
-        0UL,
-        (unsigned long)size);
+    CANVAS_RETURN(token);
+}
 
-    msg_void(blit_encoder, "endEncoding");
+typedef struct
+{
+    VkDeviceSize offset;
+    VkDeviceSize end;
+    uint32_t index;
+} canvas_vk_range;
 
-    msg_void(cmd_buffer, "commit");
-    msg_void(cmd_buffer, "waitUntilCompleted");
+static int vk_range_compare(const void *a, const void *b)
+{
+    const canvas_vk_range *ra = (const canvas_vk_range *)a;
+    const canvas_vk_range *rb = (const canvas_vk_range *)b;
 
-    msg_void(staging, "release");
+    if (ra->offset != rb->offset)
+        return ra->offset < rb->offset ? -1 : 1;
 
-    CANVAS_RETURN(CANVAS_OK);
+    return ra->index < rb->index ? -1 : (ra->index > rb->index);
 }
 
-canvas_buffer *canvas_buffer_create(int window_id, canvas_buffer_type type, canvas_buffer_usage usage, size_t size, void *initial_data)
+// copies a group of runs through one ring reservation and one vkCmdCopyBuffer
+static bool vk_upload_runs(canvas_buffer *buf, const canvas_buffer_region *regions, uint32_t count, const uint32_t *run_of,
+                           VkBufferCopy *copies, uint32_t first, uint32_t last, VkDeviceSize bytes)
 {
-    CANVAS_ENTER_FUNC();
-    CANVAS_ASSERT_RANGE(window_id, 0, MAX_CANVAS - 1);
-    CANVAS_ASSERT(size > 0);
+    if (!vk_upload_begin())
+        return false;
 
-    CANVAS_VALID_PTR(window_id);
+    VkDeviceSize staging_offset;
+    if (!vk_upload_reserve(bytes, &staging_offset))
+        return false;
 
-    if (!canvas_macos.device)
-    {
-        CANVAS_RETURN_ERR(NULL, "GPU not initialized\n");
-    }
+    canvas_vk_upload_batch *batch = vk_upload_open_batch();
+    vk_upload_order(batch, buf, true);
 
-    canvas_buffer *buf = (canvas_buffer *)calloc(1, sizeof(canvas_buffer));
-    if (!buf)
+    // srcOffset holds the run's position inside the group until now
+    for (uint32_t r = first; r < last; r++)
+        copies[r].srcOffset += staging_offset;
+
+    // call order, so later regions overwrite earlier ones
+    uint8_t *staging = (uint8_t *)vk_upload.staging_allocation.mapped;
+    for (uint32_t i = 0; i < count; i++)
     {
-        CANVAS_RETURN(NULL);
+        uint32_t r = run_of[i];
+        if (r < first || r >= last)
+            continue;
+
+        memcpy(staging + copies[r].srcOffset + (regions[i].offset - copies[r].dstOffset), regions[i].data, regions[i].size);
     }
 
-    buf->size = size;
-    buf->type = type;
-    buf->usage = usage;
-    buf->window_id = window_id;
+    vk_info.vkCmdCopyBuffer(batch->cmd, vk_upload.staging, (VkBuffer)buf->platform_handle, last - first, &copies[first]);
+    buf->upload = batch->token;
+    return true;
+}
 
-    unsigned long storage_mode;
+// merges touching and overlapping regions into runs, then copies as many runs per reservation as fit
+static uint64_t vk_upload_regions(canvas_buffer *buf, const canvas_buffer_region *regions, uint32_t count)
+{
+    CANVAS_ENTER_FUNC();
 
-    if (usage == CANVAS_BUFFER_DYNAMIC)
-    {
-        storage_mode = 0; // MTLResourceStorageModeShared
-    }
-    else
-    {
-        storage_mode = 2; // MTLResourceStorageModePrivate
-    }
+    uint8_t *scratch = (uint8_t *)malloc(count * (sizeof(canvas_vk_range) + sizeof(VkBufferCopy) + sizeof(uint32_t)));
+    if (!scratch)
+        CANVAS_RETURN(0);
 
-    typedef objc_id (*msg_new_buffer)(objc_id, objc_sel, unsigned long, unsigned long);
-    objc_id metal_buffer = ((msg_new_buffer)objc_msgSend)(
-        canvas_macos.device,
-        sel_c("newBufferWithLength:options:"),
-        (unsigned long)size,
-        storage_mode);
+    canvas_vk_range *ranges = (canvas_vk_range *)scratch;
+    VkBufferCopy *copies = (VkBufferCopy *)(ranges + count);
+    uint32_t *run_of = (uint32_t *)(copies + count);
 
-    if (!metal_buffer)
+    for (uint32_t i = 0; i < count; i++)
     {
-        CANVAS_ERR("Failed to create Metal buffer\n");
-        free(buf);
-        CANVAS_RETURN(NULL);
+        ranges[i].offset = regions[i].offset;
+        ranges[i].end = regions[i].offset + regions[i].size;
+        ranges[i].index = i;
     }
 
-    buf->platform_handle = metal_buffer;
+    qsort(ranges, count, sizeof(canvas_vk_range), vk_range_compare);
 
-    if (usage == CANVAS_BUFFER_DYNAMIC)
+    uint32_t runs = 0;
+    for (uint32_t i = 0; i < count; i++)
     {
-        buf->mapped = msg_id(metal_buffer, "contents");
-        if (initial_data)
+        // empty regions copy nothing and belong to no run
+        if (ranges[i].end == ranges[i].offset)
         {
-            memcpy(buf->mapped, initial_data, size);
+            run_of[ranges[i].index] = UINT32_MAX;
+            continue;
         }
-    }
-    else if (initial_data)
-    {
-        if (_metal_upload_buffer_data(buf, initial_data, size) != CANVAS_OK)
+
+        if (runs > 0 && ranges[i].offset <= copies[runs - 1].dstOffset + copies[runs - 1].size)
         {
-            CANVAS_ERR("Failed to upload private buffer data\n");
-            msg_void(metal_buffer, "release");
-            free(buf);
-            CANVAS_RETURN(NULL);
+            VkDeviceSize end = copies[runs - 1].dstOffset + copies[runs - 1].size;
+            if (ranges[i].end > end)
+                copies[runs - 1].size += ranges[i].end - end;
+        }
+        else
+        {
+            copies[runs].dstOffset = ranges[i].offset;
+            copies[runs].size = ranges[i].end - ranges[i].offset;
+            runs++;
         }
-    }
 
-    CANVAS_RETURN(buf);
-}
+        run_of[ranges[i].index] = runs - 1;
+    }
 
-void canvas_buffer_update(canvas_buffer *buf, void *data, size_t size, size_t offset)
-{
-    CANVAS_ENTER_FUNC();
-    CANVAS_ASSERT_NOT_NULL(buf);
-    CANVAS_ASSERT_NOT_NULL(data);
-    CANVAS_ASSERT(size > 0);
+    VkDeviceSize chunk_limit = CANVAS_VK_STAGING_SIZE / 4;
+    VkDeviceSize bytes = 0;
+    uint32_t first = 0;
+    bool ok = true;
 
-    if (!buf || !data)
+    for (uint32_t r = 0; r < runs && ok; r++)
     {
-        CANVAS_RETURN_VOID();
-    }
+        if (copies[r].size > chunk_limit)
+        {
+            // too large for one reservation, its regions go through the chunked path one by one
+            if (first < r)
+                ok = vk_upload_runs(buf, regions, count, run_of, copies, first, r, bytes);
 
-    if (buf->usage != CANVAS_BUFFER_DYNAMIC)
-    {
-        CANVAS_WARN("Can only update dynamic buffers\n");
-        CANVAS_RETURN_VOID();
-    }
+            for (uint32_t i = 0; i < count && ok; i++)
+            {
+                if (run_of[i] == r)
+                    ok = vk_upload_copy(buf, regions[i].offset, regions[i].data, regions[i].size, true) != 0;
+            }
 
-    if (offset > buf->size || size > buf->size - offset)
-    {
-        CANVAS_ERR("Buffer update out of bounds\n");
-        CANVAS_RETURN_VOID();
+            first = r + 1;
+            bytes = 0;
+            continue;
+        }
+
+        if (bytes + copies[r].size > chunk_limit)
+        {
+            ok = vk_upload_runs(buf, regions, count, run_of, copies, first, r, bytes);
+            first = r;
+            bytes = 0;
+        }
+
+        copies[r].srcOffset = bytes;
+        bytes += copies[r].size;
     }
 
-    memcpy((uint8_t *)buf->mapped + offset, data, size);
+    if (ok && first < runs)
+        ok = vk_upload_runs(buf, regions, count, run_of, copies, first, runs, bytes);
 
-    // Synchronize shared memory (if needed on older hardware)
-    typedef void (*msg_did_modify)(objc_id, objc_sel, unsigned long, unsigned long);
-    ((msg_did_modify)objc_msgSend)(
-        buf->platform_handle,
-        sel_c("didModifyRange:"),
-        offset,
-        size);
-    CANVAS_RETURN_VOID();
+    free(scratch);
+
+    if (!ok)
+        CANVAS_RETURN_ERR(0, "Failed to queue buffer regions\n");
+
+    CANVAS_RETURN(buf->upload);
 }
 
-void *canvas_buffer_map(canvas_buffer *buf)
+// submits pending uploads ahead of a frame, sets the timeline to wait on when they run on another queue
+static uint64_t vk_upload_frame(VkSemaphore *wait_semaphore)
 {
-    CANVAS_ENTER_FUNC();
+    *wait_semaphore = VK_NULL_HANDLE;
 
-    if (!buf)
-    {
-        CANVAS_RETURN(NULL);
-    }
+    if (!vk_upload.initialized)
+        return 0;
 
-    if (buf->usage == CANVAS_BUFFER_DYNAMIC)
-    {
-        CANVAS_RETURN(buf->mapped); // Already mapped
-    }
+    uint64_t token = vk_upload_flush();
+    if (token > vk_upload_poll() && vk_upload.timeline && vk_info.transfer_family != vk_info.graphics_family)
+        *wait_semaphore = vk_upload.timeline;
 
-    CANVAS_WARN("Cannot map private Metal buffer\n");
-    CANVAS_RETURN(NULL);
+    return token;
 }
 
-void canvas_buffer_unmap(canvas_buffer *buf)
+// async compute: one command buffer and descriptor pool per frame in flight, ordered by a timeline
+static struct
 {
-    CANVAS_ENTER_FUNC();
-    // Metal shared buffers are persistently mapped
-    (void)buf;
-    CANVAS_RETURN_VOID();
-}
+    bool initialized;
+    VkCommandPool pool;
+    VkCommandBuffer cmds[MAX_FRAMES_IN_FLIGHT];
+    VkDescriptorPool descriptor_pools[MAX_FRAMES_IN_FLIGHT];
+    uint64_t values[MAX_FRAMES_IN_FLIGHT]; // timeline value of the slot's last submit
+    VkSemaphore timeline;
+    uint64_t value;
+} vk_compute = {0};
 
-void canvas_buffer_destroy(canvas_buffer *buf)
+static int vk_compute_init(void)
 {
     CANVAS_ENTER_FUNC();
 
-    if (!buf)
+    VkCommandPoolCreateInfo pool_info = {0};
+    pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    pool_info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    pool_info.queueFamilyIndex = (uint32_t)vk_info.compute_family;
+
+    VkResult result = vk_info.vkCreateCommandPool(vk_info.device, &pool_info, NULL, &vk_compute.pool);
+    VK_CHECK(result, "failed to create compute command pool");
+
+    VkCommandBufferAllocateInfo alloc_info = {0};
+    alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    alloc_info.commandPool = vk_compute.pool;
+    alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    alloc_info.commandBufferCount = MAX_FRAMES_IN_FLIGHT;
+
+    result = vk_info.vkAllocateCommandBuffers(vk_info.device, &alloc_info, vk_compute.cmds);
+    VK_CHECK(result, "failed to allocate compute command buffers");
+
+    VkSemaphoreTypeCreateInfo type_info = {0};
+    type_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+    type_info.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+
+    VkSemaphoreCreateInfo semaphore_info = {0};
+    semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    semaphore_info.pNext = &type_info;
+
+    result = vk_info.vkCreateSemaphore(vk_info.device, &semaphore_info, NULL, &vk_compute.timeline);
+    VK_CHECK(result, "failed to create compute timeline");
+
+    vk_compute.initialized = true;
+    CANVAS_RETURN(CANVAS_OK);
+}
+
+static void vk_compute_cleanup(void)
+{
+    for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
     {
-        CANVAS_RETURN_VOID();
+        if (vk_compute.descriptor_pools[i])
+            vk_info.vkDestroyDescriptorPool(vk_info.device, vk_compute.descriptor_pools[i], NULL);
     }
 
-    objc_id metal_buffer = (objc_id)buf->platform_handle;
-    msg_void(metal_buffer, "release");
+    if (vk_compute.timeline)
+        vk_info.vkDestroySemaphore(vk_info.device, vk_compute.timeline, NULL);
 
-    free(buf);
-    CANVAS_RETURN_VOID();
+    if (vk_compute.pool)
+        vk_info.vkDestroyCommandPool(vk_info.device, vk_compute.pool, NULL);
+
+    memset(&vk_compute, 0, sizeof(vk_compute));
 }
 
-int _canvas_update()
+// submits every window's dispatches to the compute queue, sets the timeline draws wait on
+static uint64_t vk_compute_frame(VkSemaphore *wait_semaphore)
 {
     CANVAS_ENTER_FUNC();
 
-    _post_init();
+    *wait_semaphore = VK_NULL_HANDLE;
 
-    if (canvas_info.display_changed)
-        _canvas_refresh_displays();
+    if (vk_info.compute_family == vk_info.graphics_family)
+        CANVAS_RETURN(0);
 
-    objc_id poolClass = cls("NSAutoreleasePool");
-    objc_id framePool = NULL;
-    if (poolClass)
+    bool any = false;
+    for (int i = 0; i < MAX_CANVAS && !any; i++)
     {
-        objc_id tmp = msg_id(poolClass, "alloc");
-        framePool = msg_id(tmp, "init");
+        if (!canvas_info.canvas[i]._valid || !vk_windows[i].initialized)
+            continue;
+
+        for (uint32_t c = 0; c < vk_windows[i].command_count && !any; c++)
+            any = vk_windows[i].commands[c].type == CANVAS_VK_CMD_DISPATCH;
     }
 
-    canvas_pointer *p = canvas_get_primary_pointer(0);
+    if (!any || (!vk_compute.initialized && vk_compute_init() != CANVAS_OK))
+        CANVAS_RETURN(0);
 
-    objc_id ns_event_class = cls("NSEvent");
-    typedef _CGRect (*msg_mouse_location)(objc_id, objc_sel);
-    _CGRect mouse_loc = ((msg_mouse_location)objc_msgSend)(ns_event_class, sel_c("mouseLocation"));
+    // the slot was last used MAX_FRAMES_IN_FLIGHT compute submits ago
+    uint32_t slot = (uint32_t)(vk_compute.value % MAX_FRAMES_IN_FLIGHT);
+    if (vk_compute.values[slot])
+    {
+        VkSemaphoreWaitInfo wait_info = {0};
+        wait_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+        wait_info.semaphoreCount = 1;
+        wait_info.pSemaphores = &vk_compute.timeline;
+        wait_info.pValues = &vk_compute.values[slot];
+        vk_info.vkWaitSemaphores(vk_info.device, &wait_info, UINT64_MAX);
+    }
 
-    int global_x = (int)mouse_loc.x;
-    int global_y = (int)mouse_loc.y;
+    VkCommandBuffer cmd = vk_compute.cmds[slot];
+    vk_info.vkResetCommandBuffer(cmd, 0);
+    if (vk_compute.descriptor_pools[slot])
+        vk_info.vkResetDescriptorPool(vk_info.device, vk_compute.descriptor_pools[slot], 0);
 
-    p->display = 0;
-    for (int d = 0; d < canvas_info.display_count; d++)
+    VkCommandBufferBeginInfo begin_info = {0};
+    begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    vk_info.vkBeginCommandBuffer(cmd, &begin_info);
+
+    for (int i = 0; i < MAX_CANVAS; i++)
     {
-        if (global_x >= canvas_info.display[d].x &&
-            global_x < canvas_info.display[d].x + canvas_info.display[d].width &&
-            global_y >= canvas_info.display[d].y &&
-            global_y < canvas_info.display[d].y + canvas_info.display[d].height)
-        {
-            p->display = d;
-            p->screen_x = global_x - canvas_info.display[d].x;
-            p->screen_y = canvas_info.display[d].height - (global_y - canvas_info.display[d].y);
-            break;
-        }
+        if (canvas_info.canvas[i]._valid && vk_windows[i].initialized)
+            vk_replay_compute(i, cmd, &vk_compute.descriptor_pools[slot]);
     }
 
-    uint64_t now = mach_absolute_time();
-    double timestamp = (double)now * (double)canvas_macos.timebase.numer /
-                       (double)canvas_macos.timebase.denom / 1e9;
+    vk_info.vkEndCommandBuffer(cmd);
 
-    p->_samples[p->_sample_index].x = p->screen_x;
-    p->_samples[p->_sample_index].y = p->screen_y;
-    p->_samples[p->_sample_index].time = timestamp;
-    p->_sample_index = (p->_sample_index + 1) % CANVAS_POINTER_SAMPLE_FRAMES;
+    uint64_t signal_value = vk_compute.value + 1;
+    uint64_t wait_value = vk_upload.submitted;
 
-    int active_window = -1;
-    bool found_window = false;
+    VkTimelineSemaphoreSubmitInfo timeline_info = {0};
+    timeline_info.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    timeline_info.signalSemaphoreValueCount = 1;
+    timeline_info.pSignalSemaphoreValues = &signal_value;
 
-    for (int i = MAX_CANVAS - 1; i >= 0; i--)
+    VkSubmitInfo submit_info = {0};
+    submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submit_info.pNext = &timeline_info;
+    submit_info.commandBufferCount = 1;
+    submit_info.pCommandBuffers = &cmd;
+    submit_info.signalSemaphoreCount = 1;
+    submit_info.pSignalSemaphores = &vk_compute.timeline;
+
+    // uploads signal their timeline on whichever queue ran them
+    VkPipelineStageFlags wait_stage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    if (vk_upload.timeline && wait_value > vk_upload_poll())
     {
-        if (!canvas_info.canvas[i]._valid || !canvas_info.canvas[i].window)
-            continue;
+        timeline_info.waitSemaphoreValueCount = 1;
+        timeline_info.pWaitSemaphoreValues = &wait_value;
+        submit_info.waitSemaphoreCount = 1;
+        submit_info.pWaitSemaphores = &vk_upload.timeline;
+        submit_info.pWaitDstStageMask = &wait_stage;
+    }
 
-        objc_id window = canvas_info.canvas[i].window;
-        _CGRect frame = msg_rect(window, "frame");
+    VkResult result = vk_info.vkQueueSubmit(vk_info.compute_queue, 1, &submit_info, VK_NULL_HANDLE);
+    if (result != VK_SUCCESS)
+        CANVAS_RETURN_ERR(0, "failed to submit compute work (result=%d)\n", result);
 
-        int win_x = (int)frame.x;
-        int win_y = (int)frame.y;
-        int win_w = (int)frame.w;
-        int win_h = (int)frame.h;
+    vk_compute.value = signal_value;
+    vk_compute.values[slot] = signal_value;
+    *wait_semaphore = vk_compute.timeline;
 
-        bool is_inside = (global_x >= win_x && global_x < win_x + win_w &&
-                          global_y >= win_y && global_y < win_y + win_h);
+    CANVAS_RETURN(signal_value);
+}
 
-        if (is_inside && !found_window)
-        {
-            active_window = i;
-            found_window = true;
+static int _vulkan_upload_buffer_data(canvas_buffer *buf, void *data, size_t size)
+{
+    CANVAS_ENTER_FUNC();
+    CANVAS_ASSERT_NOT_NULL(buf);
+    CANVAS_ASSERT_NOT_NULL(data);
+    CANVAS_ASSERT(size > 0);
+    CANVAS_ASSERT_NOT_NULL(vk_info.device);
 
-            p->window_id = i;
-            p->inside_window = true;
-            p->x = global_x - win_x;
-            p->y = win_h - (global_y - win_y);
+    if (!vk_upload_copy(buf, 0, data, size, false))
+        CANVAS_RETURN(CANVAS_FAIL);
 
-            objc_id ns_cursor = _canvas_get_ns_cursor(canvas_info.canvas[i].cursor);
-            if (ns_cursor)
-                msg_void(ns_cursor, "set");
+    CANVAS_RETURN(CANVAS_OK);
+}
 
-            break;
+bool canvas_upload_done(uint64_t token)
+{
+    CANVAS_ENTER_FUNC();
+
+    if (!vk_info.device || token == 0)
+        CANVAS_RETURN(true);
+
+    // the open batch goes out with the next frame, asking about it means someone is waiting
+    if (token > vk_upload.submitted)
+        vk_upload_flush();
+
+    CANVAS_RETURN(vk_upload_poll() >= token);
+}
+
+int canvas_upload_wait(uint64_t token, uint64_t timeout_ns)
+{
+    CANVAS_ENTER_FUNC();
+
+    if (!vk_info.device || token == 0)
+        CANVAS_RETURN(CANVAS_OK);
+
+    if (token >= vk_upload.next_token)
+        CANVAS_RETURN(CANVAS_INVALID);
+
+    VkResult result = vk_upload_wait_token(token, timeout_ns);
+    CANVAS_RETURN(result == VK_SUCCESS ? CANVAS_OK : CANVAS_FAIL);
+}
+
+// pipelines handed out so far, and the cache they are compiled through
+static struct
+{
+    VkPipelineCache cache;
+    bool cache_tried;
+    bool cache_dirty;
+    VkPipelineLayout layout;
+    canvas_pipeline **pipelines;
+    uint32_t count;
+    uint32_t capacity;
+} vk_pipelines = {0};
+
+#if CANVAS_VULKAN_PIPELINE_CACHE
+// written in front of the driver's cache data, a new driver or gpu starts over
+typedef struct
+{
+    uint32_t magic;
+    uint32_t driver_version;
+    uint8_t uuid[VK_UUID_SIZE];
+    uint64_t data_size;
+} canvas_vk_cache_header;
+
+#define CANVAS_VK_CACHE_MAGIC 0x43505643u // "CVPC"
+
+static bool vk_pipeline_cache_path(char *path, size_t size)
+{
+    char dir[512];
+    const char *xdg = getenv("XDG_CACHE_HOME");
+    const char *home = getenv("HOME");
+
+    if (xdg && xdg[0])
+        snprintf(dir, sizeof(dir), "%s", xdg);
+    else if (home && home[0])
+        snprintf(dir, sizeof(dir), "%s/.cache", home);
+    else
+        return false;
+
+    char uuid[VK_UUID_SIZE * 2 + 1];
+    for (int i = 0; i < VK_UUID_SIZE; i++)
+        snprintf(uuid + i * 2, 3, "%02x", vk_info.pipeline_cache_uuid[i]);
+
+    snprintf(path, size, "%s/canvas-pipelines-%s.bin", dir, uuid);
+    return true;
+}
+#endif
+
+static VkPipelineCache vk_pipeline_cache(void)
+{
+    CANVAS_ENTER_FUNC();
+
+    if (vk_pipelines.cache_tried)
+        CANVAS_RETURN(vk_pipelines.cache);
+
+    vk_pipelines.cache_tried = true;
+
+    void *data = NULL;
+    size_t data_size = 0;
+
+#if CANVAS_VULKAN_PIPELINE_CACHE
+    char path[600];
+    FILE *file = vk_pipeline_cache_path(path, sizeof(path)) ? fopen(path, "rb") : NULL;
+    if (file)
+    {
+        canvas_vk_cache_header header;
+        if (fread(&header, sizeof(header), 1, file) == 1 &&
+            header.magic == CANVAS_VK_CACHE_MAGIC &&
+            header.driver_version == vk_info.driver_version &&
+            memcmp(header.uuid, vk_info.pipeline_cache_uuid, VK_UUID_SIZE) == 0 &&
+            header.data_size > 0 && header.data_size < (256ULL << 20))
+        {
+            data = malloc((size_t)header.data_size);
+            if (data && fread(data, (size_t)header.data_size, 1, file) == 1)
+            {
+                data_size = (size_t)header.data_size;
+            }
+            else
+            {
+                free(data);
+                data = NULL;
+            }
         }
+        fclose(file);
+
+        if (data)
+            CANVAS_INFO("loaded %zu byte pipeline cache from %s\n", data_size, path);
+        else
+            CANVAS_VERBOSE("pipeline cache %s is stale, starting over\n", path);
     }
+#endif
 
-    if (!found_window)
+    VkPipelineCacheCreateInfo cache_info = {0};
+    cache_info.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    cache_info.initialDataSize = data_size;
+    cache_info.pInitialData = data;
+
+    // drivers reject data they can't use, an empty cache still dedupes this run
+    if (vk_info.vkCreatePipelineCache(vk_info.device, &cache_info, NULL, &vk_pipelines.cache) != VK_SUCCESS)
     {
-        p->inside_window = false;
-        p->x = 0;
-        p->y = 0;
+        cache_info.initialDataSize = 0;
+        cache_info.pInitialData = NULL;
+        if (vk_info.vkCreatePipelineCache(vk_info.device, &cache_info, NULL, &vk_pipelines.cache) != VK_SUCCESS)
+            vk_pipelines.cache = VK_NULL_HANDLE;
     }
 
-    objc_id ns_mode = nsstring_from_cstr("kCFRunLoopDefaultMode");
-    objc_id distantPast = msg_id(cls("NSDate"), "distantPast");
+    free(data);
+    CANVAS_RETURN(vk_pipelines.cache);
+}
 
-    for (;;)
+// written next to the old file and renamed over it, a crash never leaves half a cache
+static void vk_pipeline_cache_save(void)
+{
+    CANVAS_ENTER_FUNC();
+
+#if CANVAS_VULKAN_PIPELINE_CACHE
+    if (!vk_pipelines.cache || !vk_pipelines.cache_dirty)
+        CANVAS_RETURN_VOID();
+
+    size_t data_size = 0;
+    if (vk_info.vkGetPipelineCacheData(vk_info.device, vk_pipelines.cache, &data_size, NULL) != VK_SUCCESS || data_size == 0)
+        CANVAS_RETURN_VOID();
+
+    void *data = malloc(data_size);
+    if (!data)
+        CANVAS_RETURN_VOID();
+
+    char path[600], temp[640];
+    if (vk_info.vkGetPipelineCacheData(vk_info.device, vk_pipelines.cache, &data_size, data) == VK_SUCCESS &&
+        vk_pipeline_cache_path(path, sizeof(path)))
     {
-        objc_id ev = canvas_next_event(canvas_macos.app, ~0ULL, distantPast, ns_mode, true);
-        if (!ev)
-            break;
+        snprintf(temp, sizeof(temp), "%s.tmp", path);
 
-        unsigned long eventType = msg_ulong(ev, "type");
-        objc_id eventWindow = msg_id(ev, "window");
+        canvas_vk_cache_header header = {0};
+        header.magic = CANVAS_VK_CACHE_MAGIC;
+        header.driver_version = vk_info.driver_version;
+        memcpy(header.uuid, vk_info.pipeline_cache_uuid, VK_UUID_SIZE);
+        header.data_size = data_size;
 
-        if (eventWindow)
+        FILE *file = fopen(temp, "wb");
+        if (file)
         {
-            int window_idx = _canvas_window_index(eventWindow);
-            if (window_idx >= 0)
+            bool written = fwrite(&header, sizeof(header), 1, file) == 1 && fwrite(data, data_size, 1, file) == 1;
+            written = fclose(file) == 0 && written;
+
+            if (written && rename(temp, path) == 0)
             {
-                switch (eventType)
-                {
-                case 1: // NSEventTypeLeftMouseDown
-                {
-                    canvas_pointer *p = canvas_get_primary_pointer(window_idx);
-                    p->buttons |= CANVAS_BUTTON_LEFT;
-                    p->buttons_pressed |= CANVAS_BUTTON_LEFT;
-                    p->window_id = window_idx;
-                    break;
-                }
+                vk_pipelines.cache_dirty = false;
+                CANVAS_VERBOSE("saved %zu byte pipeline cache to %s\n", data_size, path);
+            }
+            else
+            {
+                remove(temp);
+            }
+        }
+    }
 
-                case 2: // NSEventTypeLeftMouseUp
-                {
-                    canvas_pointer *p = canvas_get_primary_pointer(window_idx);
-                    p->buttons &= ~CANVAS_BUTTON_LEFT;
-                    p->buttons_released |= CANVAS_BUTTON_LEFT;
-                    break;
-                }
+    free(data);
+#endif
+    CANVAS_RETURN_VOID();
+}
 
-                case 3: // NSEventTypeRightMouseDown
-                {
-                    canvas_pointer *p = canvas_get_primary_pointer(window_idx);
-                    p->buttons |= CANVAS_BUTTON_RIGHT;
-                    p->buttons_pressed |= CANVAS_BUTTON_RIGHT;
-                    p->window_id = window_idx;
-                    break;
-                }
+// one layout for every canvas pipeline: storage buffers in set 0 and CANVAS_VK_PUSH_CONSTANTS bytes of push constants
+static VkPipelineLayout vk_pipeline_layout(void)
+{
+    CANVAS_ENTER_FUNC();
 
-                case 4: // NSEventTypeRightMouseUp
-                {
-                    canvas_pointer *p = canvas_get_primary_pointer(window_idx);
-                    p->buttons &= ~CANVAS_BUTTON_RIGHT;
-                    p->buttons_released |= CANVAS_BUTTON_RIGHT;
-                    break;
-                }
+    if (vk_pipelines.layout)
+        CANVAS_RETURN(vk_pipelines.layout);
 
-                case 25: // NSEventTypeOtherMouseDown
-                {
-                    canvas_pointer *p = canvas_get_primary_pointer(window_idx);
-                    long button_number = msg_ulong(ev, "buttonNumber");
-                    if (button_number == 2)
-                    {
-                        p->buttons |= CANVAS_BUTTON_MIDDLE;
-                        p->buttons_pressed |= CANVAS_BUTTON_MIDDLE;
-                    }
-                    else if (button_number == 3)
-                    {
-                        p->buttons |= CANVAS_BUTTON_X1;
-                        p->buttons_pressed |= CANVAS_BUTTON_X1;
-                    }
-                    else if (button_number == 4)
-                    {
-                        p->buttons |= CANVAS_BUTTON_X2;
-                        p->buttons_pressed |= CANVAS_BUTTON_X2;
-                    }
-                    p->window_id = window_idx;
-                    break;
-                }
-
-                case 26: // NSEventTypeOtherMouseUp
-                {
-                    canvas_pointer *p = canvas_get_primary_pointer(window_idx);
-                    long button_number = msg_ulong(ev, "buttonNumber");
-                    if (button_number == 2)
-                    {
-                        p->buttons &= ~CANVAS_BUTTON_MIDDLE;
-                        p->buttons_released |= CANVAS_BUTTON_MIDDLE;
-                    }
-                    else if (button_number == 3)
-                    {
-                        p->buttons &= ~CANVAS_BUTTON_X1;
-                        p->buttons_released |= CANVAS_BUTTON_X1;
-                    }
-                    else if (button_number == 4)
-                    {
-                        p->buttons &= ~CANVAS_BUTTON_X2;
-                        p->buttons_released |= CANVAS_BUTTON_X2;
-                    }
-                    break;
-                }
+    VkDescriptorSetLayout set_layout = vk_storage_set_layout();
+    if (!set_layout)
+        CANVAS_RETURN(VK_NULL_HANDLE);
 
-                case 22: // NSEventTypeScrollWheel
-                {
-                    canvas_pointer *p = canvas_get_primary_pointer(window_idx);
-                    p->scroll_y = (float)msg_dbl(ev, "scrollingDeltaY");
-                    p->scroll_x = (float)msg_dbl(ev, "scrollingDeltaX");
-                    break;
-                }
-
-                case 10: // NSEventTypeKeyDown
-                case 11: // NSEventTypeKeyUp
-                case 12: // NSEventTypeFlagsChanged
-                    break;
+    VkPushConstantRange push_range = {0};
+    push_range.stageFlags = VK_SHADER_STAGE_ALL;
+    push_range.size = CANVAS_VK_PUSH_CONSTANTS;
 
-                case 6:  // NSEventTypeLeftMouseDragged
-                case 7:  // NSEventTypeRightMouseDragged
-                case 27: // NSEventTypeOtherMouseDragged
-                {
-                    _CGRect frame = msg_rect(eventWindow, "frame");
+    VkPipelineLayoutCreateInfo layout_info = {0};
+    layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    layout_info.setLayoutCount = 1;
+    layout_info.pSetLayouts = &set_layout;
+    layout_info.pushConstantRangeCount = 1;
+    layout_info.pPushConstantRanges = &push_range;
 
-                    if ((int)frame.x != canvas_info.canvas[window_idx].x ||
-                        (int)frame.y != canvas_info.canvas[window_idx].y)
-                    {
-                        canvas_info.canvas[window_idx].os_moved = true;
-                        canvas_info.canvas[window_idx].x = (int)frame.x;
-                        canvas_info.canvas[window_idx].y = (int)frame.y;
-                    }
+    if (vk_info.vkCreatePipelineLayout(vk_info.device, &layout_info, NULL, &vk_pipelines.layout) != VK_SUCCESS)
+        CANVAS_RETURN_ERR(VK_NULL_HANDLE, "failed to create pipeline layout\n");
 
-                    if ((int)frame.w != canvas_info.canvas[window_idx].width ||
-                        (int)frame.h != canvas_info.canvas[window_idx].height)
-                    {
-                        canvas_info.canvas[window_idx].resize = true;
-                        canvas_info.canvas[window_idx].os_resized = true;
-                        canvas_info.canvas[window_idx].width = (int)frame.w;
-                        canvas_info.canvas[window_idx].height = (int)frame.h;
-                    }
-                    break;
-                }
-                }
-            }
-        }
+    CANVAS_RETURN(vk_pipelines.layout);
+}
 
-        msg_void_id(canvas_macos.app, "sendEvent:", ev);
-    }
+static void vk_pipelines_cleanup(void)
+{
+    vk_pipeline_cache_save();
 
-    objc_id tracking_mode = nsstring_from_cstr("NSEventTrackingRunLoopMode");
-    for (;;)
+    for (uint32_t i = 0; i < vk_pipelines.count; i++)
     {
-        objc_id ev = canvas_next_event(canvas_macos.app, ~0ULL, distantPast, tracking_mode, true);
-        if (!ev)
-            break;
-        msg_void_id(canvas_macos.app, "sendEvent:", ev);
+        vk_info.vkDestroyPipeline(vk_info.device, (VkPipeline)vk_pipelines.pipelines[i]->platform_handle, NULL);
+        free(vk_pipelines.pipelines[i]);
     }
 
-    msg_void(canvas_macos.app, "updateWindows");
-    _canvas_gpu_draw_all();
+    free(vk_pipelines.pipelines);
 
-    if (framePool)
-        msg_void(framePool, "drain");
+    if (vk_pipelines.layout)
+        vk_info.vkDestroyPipelineLayout(vk_info.device, vk_pipelines.layout, NULL);
 
-    CANVAS_RETURN(CANVAS_OK);
+    if (vk_pipelines.cache)
+        vk_info.vkDestroyPipelineCache(vk_info.device, vk_pipelines.cache, NULL);
+
+    memset(&vk_pipelines, 0, sizeof(vk_pipelines));
 }
 
-int _canvas_post_update()
+static VkFormat vk_vertex_format(canvas_vertex_format format)
 {
-    CANVAS_ENTER_FUNC();
-    CANVAS_RETURN(CANVAS_OK);
+    switch (format)
+    {
+    case CANVAS_VERTEX_FLOAT:
+        return VK_FORMAT_R32_SFLOAT;
+    case CANVAS_VERTEX_FLOAT2:
+        return VK_FORMAT_R32G32_SFLOAT;
+    case CANVAS_VERTEX_FLOAT3:
+        return VK_FORMAT_R32G32B32_SFLOAT;
+    case CANVAS_VERTEX_FLOAT4:
+        return VK_FORMAT_R32G32B32A32_SFLOAT;
+    case CANVAS_VERTEX_UBYTE4_NORM:
+        return VK_FORMAT_R8G8B8A8_UNORM;
+    case CANVAS_VERTEX_UINT:
+        return VK_FORMAT_R32_UINT;
+    }
+    return VK_FORMAT_UNDEFINED;
 }
 
-int _canvas_exit()
+// covers everything the pipeline is built from, field by field so struct padding stays out
+static uint64_t vk_pipeline_hash(const canvas_pipeline_desc *desc, VkFormat color_format, VkFormat depth_format, VkRenderPass render_pass)
 {
-    CANVAS_ENTER_FUNC();
+    uint64_t hash = CANVAS_VK_HASH_SEED;
+    const char *vertex_entry = desc->vertex_entry ? desc->vertex_entry : "main";
+    const char *fragment_entry = desc->fragment_entry ? desc->fragment_entry : "main";
+    uint32_t state[] = {(uint32_t)color_format, (uint32_t)depth_format, (uint32_t)desc->topology, (uint32_t)desc->blend,
+                        desc->cull_back, desc->depth_test, desc->depth_write, desc->binding_count, desc->attribute_count};
 
-    if (canvas_macos.queue)
-    {
-        ((MSG_void_id)objc_msgSend)(canvas_macos.queue, sel_c("release"));
-        canvas_macos.queue = NULL;
-    }
-    if (canvas_macos.device)
-    {
-        ((MSG_void_id)objc_msgSend)(canvas_macos.device, sel_c("release"));
-        canvas_macos.device = NULL;
-    }
-    if (canvas_macos.pool)
+    hash = vk_hash_bytes(hash, state, sizeof(state));
+    hash = vk_hash_bytes(hash, &render_pass, sizeof(render_pass));
+    hash = vk_hash_bytes(hash, desc->vertex_spirv, desc->vertex_size);
+    hash = vk_hash_bytes(hash, desc->fragment_spirv, desc->fragment_size);
+    hash = vk_hash_bytes(hash, vertex_entry, strlen(vertex_entry) + 1);
+    hash = vk_hash_bytes(hash, fragment_entry, strlen(fragment_entry) + 1);
+
+    for (uint32_t i = 0; i < desc->binding_count; i++)
     {
-        ((MSG_void_id)objc_msgSend)(canvas_macos.pool, sel_c("drain"));
-        canvas_macos.pool = NULL;
+        uint32_t binding[] = {desc->bindings[i].stride, desc->bindings[i].per_instance};
+        hash = vk_hash_bytes(hash, binding, sizeof(binding));
     }
 
-    if (canvas_macos.hid_manager)
+    for (uint32_t i = 0; i < desc->attribute_count; i++)
     {
-        IOHIDManagerClose(canvas_macos.hid_manager, kIOHIDOptionsTypeNone);
-        CFRelease(canvas_macos.hid_manager);
-        canvas_macos.hid_manager = NULL;
+        uint32_t attribute[] = {desc->attributes[i].location, desc->attributes[i].binding,
+                                (uint32_t)desc->attributes[i].format, desc->attributes[i].offset};
+        hash = vk_hash_bytes(hash, attribute, sizeof(attribute));
     }
 
-    CGDisplayRemoveReconfigurationCallback(_canvas_display_reconfigure_callback, NULL);
-    CANVAS_RETURN(CANVAS_OK);
+    return hash;
 }
 
-static inline void _canvas_ensure_timebase()
+static VkShaderModule vk_shader_module(const uint32_t *code, size_t size)
 {
-    if (canvas_macos.timebase.denom == 0)
-        mach_timebase_info(&canvas_macos.timebase);
-}
+    VkShaderModuleCreateInfo module_info = {0};
+    module_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    module_info.codeSize = size;
+    module_info.pCode = code;
 
-double canvas_get_time(canvas_time_data *time)
-{
-    CANVAS_ENTER_FUNC();
-    CANVAS_ASSERT(time != NULL);
+    VkShaderModule module;
+    if (vk_info.vkCreateShaderModule(vk_info.device, &module_info, NULL, &module) != VK_SUCCESS)
+        return VK_NULL_HANDLE;
 
-    _canvas_ensure_timebase();
-    uint64_t elapsed = mach_absolute_time() - time->start;
-    double result = (double)elapsed * (double)canvas_macos.timebase.numer /
-                    (double)canvas_macos.timebase.denom / 1e9;
-    CANVAS_RETURN(result);
+    return module;
 }
 
-void canvas_sleep(double seconds)
+static VkPipeline vk_build_pipeline(const canvas_pipeline_desc *desc, VkFormat color_format, VkFormat depth_format, VkRenderPass render_pass, VkPipelineLayout layout)
 {
     CANVAS_ENTER_FUNC();
 
-    if (seconds <= 0.0)
+    if (desc->binding_count > CANVAS_VK_MAX_VERTEX_BINDINGS || desc->attribute_count > 32)
+        CANVAS_RETURN_ERR(VK_NULL_HANDLE, "too many vertex bindings or attributes\n");
+
+    VkShaderModule vertex_module = vk_shader_module(desc->vertex_spirv, desc->vertex_size);
+    VkShaderModule fragment_module = vk_shader_module(desc->fragment_spirv, desc->fragment_size);
+
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    if (!vertex_module || !fragment_module)
+    {
+        CANVAS_ERR("failed to create shader modules\n");
+        goto done;
+    }
+
+    VkPipelineShaderStageCreateInfo stages[2] = {0};
+    stages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    stages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+    stages[0].module = vertex_module;
+    stages[0].pName = desc->vertex_entry ? desc->vertex_entry : "main";
+    stages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    stages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+    stages[1].module = fragment_module;
+    stages[1].pName = desc->fragment_entry ? desc->fragment_entry : "main";
+
+    VkVertexInputBindingDescription bindings[CANVAS_VK_MAX_VERTEX_BINDINGS] = {0};
+    for (uint32_t i = 0; i < desc->binding_count; i++)
+    {
+        bindings[i].binding = i;
+        bindings[i].stride = desc->bindings[i].stride;
+        bindings[i].inputRate = desc->bindings[i].per_instance ? VK_VERTEX_INPUT_RATE_INSTANCE : VK_VERTEX_INPUT_RATE_VERTEX;
+    }
+
+    VkVertexInputAttributeDescription attributes[32] = {0};
+    for (uint32_t i = 0; i < desc->attribute_count; i++)
+    {
+        attributes[i].location = desc->attributes[i].location;
+        attributes[i].binding = desc->attributes[i].binding;
+        attributes[i].format = vk_vertex_format(desc->attributes[i].format);
+        attributes[i].offset = desc->attributes[i].offset;
+    }
+
+    VkPipelineVertexInputStateCreateInfo vertex_input = {0};
+    vertex_input.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    vertex_input.vertexBindingDescriptionCount = desc->binding_count;
+    vertex_input.pVertexBindingDescriptions = bindings;
+    vertex_input.vertexAttributeDescriptionCount = desc->attribute_count;
+    vertex_input.pVertexAttributeDescriptions = attributes;
+
+    static const VkPrimitiveTopology topologies[] = {
+        VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
+        VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP,
+        VK_PRIMITIVE_TOPOLOGY_LINE_LIST,
+        VK_PRIMITIVE_TOPOLOGY_POINT_LIST,
+    };
+
+    VkPipelineInputAssemblyStateCreateInfo input_assembly = {0};
+    input_assembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    input_assembly.topology = topologies[desc->topology <= CANVAS_TOPOLOGY_POINTS ? desc->topology : 0];
+
+    VkPipelineViewportStateCreateInfo viewport_state = {0};
+    viewport_state.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    viewport_state.viewportCount = 1;
+    viewport_state.scissorCount = 1;
+
+    VkPipelineRasterizationStateCreateInfo rasterizer = {0};
+    rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+    rasterizer.cullMode = desc->cull_back ? VK_CULL_MODE_BACK_BIT : VK_CULL_MODE_NONE;
+    rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+    rasterizer.lineWidth = 1.0f;
+
+    VkPipelineMultisampleStateCreateInfo multisample = {0};
+    multisample.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    multisample.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+    VkPipelineDepthStencilStateCreateInfo depth_stencil = {0};
+    depth_stencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+    depth_stencil.depthTestEnable = desc->depth_test;
+    depth_stencil.depthWriteEnable = desc->depth_write;
+    depth_stencil.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+
+    VkPipelineColorBlendAttachmentState blend_attachment = {0};
+    blend_attachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+    blend_attachment.blendEnable = desc->blend != CANVAS_BLEND_NONE;
+    blend_attachment.colorBlendOp = VK_BLEND_OP_ADD;
+    blend_attachment.alphaBlendOp = VK_BLEND_OP_ADD;
+    blend_attachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+    blend_attachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+
+    switch (desc->blend)
+    {
+    case CANVAS_BLEND_ALPHA:
+        blend_attachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+        blend_attachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+        break;
+    case CANVAS_BLEND_PREMULTIPLIED:
+        blend_attachment.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
+        blend_attachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+        break;
+    case CANVAS_BLEND_ADDITIVE:
+        blend_attachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+        blend_attachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE;
+        blend_attachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+        break;
+    default:
+        break;
+    }
+
+    VkPipelineColorBlendStateCreateInfo color_blend = {0};
+    color_blend.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    color_blend.attachmentCount = 1;
+    color_blend.pAttachments = &blend_attachment;
+
+    VkDynamicState dynamic_states[] = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+    VkPipelineDynamicStateCreateInfo dynamic_state = {0};
+    dynamic_state.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamic_state.dynamicStateCount = 2;
+    dynamic_state.pDynamicStates = dynamic_states;
+
+    // dynamic rendering has no render pass to be compatible with, only formats
+    VkPipelineRenderingCreateInfo rendering_info = {0};
+    rendering_info.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO;
+    rendering_info.colorAttachmentCount = 1;
+    rendering_info.pColorAttachmentFormats = &color_format;
+    rendering_info.depthAttachmentFormat = depth_format;
+
+    VkGraphicsPipelineCreateInfo pipeline_info = {0};
+    pipeline_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    pipeline_info.pNext = render_pass ? NULL : &rendering_info;
+    pipeline_info.stageCount = 2;
+    pipeline_info.pStages = stages;
+    pipeline_info.pVertexInputState = &vertex_input;
+    pipeline_info.pInputAssemblyState = &input_assembly;
+    pipeline_info.pViewportState = &viewport_state;
+    pipeline_info.pRasterizationState = &rasterizer;
+    pipeline_info.pMultisampleState = &multisample;
+    pipeline_info.pDepthStencilState = &depth_stencil;
+    pipeline_info.pColorBlendState = &color_blend;
+    pipeline_info.pDynamicState = &dynamic_state;
+    pipeline_info.layout = layout;
+    pipeline_info.renderPass = render_pass;
+
+    VkResult result = vk_info.vkCreateGraphicsPipelines(vk_info.device, vk_pipeline_cache(), 1, &pipeline_info, NULL, &pipeline);
+    if (result != VK_SUCCESS)
     {
-        CANVAS_RETURN_VOID();
+        CANVAS_ERR("failed to create graphics pipeline (result=%d)\n", result);
+        pipeline = VK_NULL_HANDLE;
     }
 
-    struct timespec ts;
-    ts.tv_sec = (time_t)seconds;
-    double frac = seconds - (double)ts.tv_sec;
+done:
+    if (vertex_module)
+        vk_info.vkDestroyShaderModule(vk_info.device, vertex_module, NULL);
+    if (fragment_module)
+        vk_info.vkDestroyShaderModule(vk_info.device, fragment_module, NULL);
 
-    if (frac < 0.0)
-        frac = 0.0;
-    ts.tv_nsec = (long)(frac * 1e9);
-    if (ts.tv_nsec >= 1000000000L)
+    CANVAS_RETURN(pipeline);
+}
+
+// an existing pipeline built from the same create info, with one more reference
+static canvas_pipeline *vk_pipeline_find(uint64_t hash)
+{
+    for (uint32_t i = 0; i < vk_pipelines.count; i++)
     {
-        ts.tv_sec += 1;
-        ts.tv_nsec -= 1000000000L;
+        if (vk_pipelines.pipelines[i]->hash == hash)
+        {
+            vk_pipelines.pipelines[i]->refs++;
+            return vk_pipelines.pipelines[i];
+        }
     }
 
-    nanosleep(&ts, NULL);
-    CANVAS_RETURN_VOID();
+    return NULL;
 }
 
-void canvas_time_init(canvas_time_data *time)
+// wraps a freshly built pipeline and adds it to the table, destroys it when that fails
+static canvas_pipeline *vk_pipeline_track(VkPipeline vk_pipeline, VkPipelineLayout layout, uint64_t hash, bool compute)
 {
-    CANVAS_ENTER_FUNC();
-    CANVAS_ASSERT(time != NULL);
+    if (!vk_pipeline)
+        return NULL;
 
-    _canvas_ensure_timebase();
+    if (vk_pipelines.count == vk_pipelines.capacity)
+    {
+        uint32_t capacity = vk_pipelines.capacity ? vk_pipelines.capacity * 2 : 16;
+        canvas_pipeline **pipelines = (canvas_pipeline **)realloc(vk_pipelines.pipelines, capacity * sizeof(canvas_pipeline *));
+        if (!pipelines)
+        {
+            vk_info.vkDestroyPipeline(vk_info.device, vk_pipeline, NULL);
+            return NULL;
+        }
 
-    time->frame = 0;
-    time->frame_index = 0;
-    time->accumulator = 0;
-    time->alpha = 0;
-    time->delta = 0;
-    time->fps = 0;
-    time->raw_delta = 0;
+        vk_pipelines.pipelines = pipelines;
+        vk_pipelines.capacity = capacity;
+    }
 
-    for (int i = 0; i < 60; i++)
-        time->times[i] = 0.0;
+    canvas_pipeline *pipeline = (canvas_pipeline *)calloc(1, sizeof(canvas_pipeline));
+    if (!pipeline)
+    {
+        vk_info.vkDestroyPipeline(vk_info.device, vk_pipeline, NULL);
+        return NULL;
+    }
 
-    time->start = mach_absolute_time();
-    time->current = canvas_get_time(time);
-    time->last = time->current;
-    CANVAS_RETURN_VOID();
-}
+    pipeline->platform_handle = (void *)vk_pipeline;
+    pipeline->layout = (void *)layout;
+    pipeline->hash = hash;
+    pipeline->refs = 1;
+    pipeline->compute = compute;
 
-#endif /* __APPLE__ */
+    vk_pipelines.pipelines[vk_pipelines.count++] = pipeline;
+    vk_pipelines.cache_dirty = true;
 
-//
-//
-//
-#if defined(_WIN32) || defined(_WIN64)
+    return pipeline;
+}
 
-int canvas_minimize(int window_id)
+canvas_pipeline *canvas_pipeline_create(int window_id, const canvas_pipeline_desc *desc)
 {
     CANVAS_ENTER_FUNC();
-    CANVAS_VALID(window_id);
+    CANVAS_ASSERT_RANGE(window_id, 0, MAX_CANVAS - 1);
+    CANVAS_ASSERT_NOT_NULL(desc);
 
-    HWND window = (HWND)canvas_info.canvas[window_id].window;
-    if (!window)
+    CANVAS_VALID_PTR(window_id);
+
+    if (!desc || !desc->vertex_spirv || !desc->fragment_spirv || !desc->vertex_size || !desc->fragment_size)
     {
-        CANVAS_RETURN_ERR(CANVAS_ERR_GET_WINDOW, "no window to minimize: %d\n", window_id);
+        CANVAS_RETURN_ERR(NULL, "pipeline needs vertex and fragment SPIR-V\n");
     }
 
-    ShowWindow(window, SW_MINIMIZE);
-    canvas_info.canvas[window_id].minimized = true;
-    canvas_info.canvas[window_id].maximized = false;
-
-    CANVAS_RETURN(CANVAS_OK);
-}
+    canvas_vulkan_window *vk_win = &vk_windows[window_id];
+    if (!vk_info.device || !vk_win->initialized)
+    {
+        CANVAS_RETURN_ERR(NULL, "GPU not initialized\n");
+    }
 
-int canvas_maximize(int window_id)
-{
-    CANVAS_ENTER_FUNC();
-    CANVAS_VALID(window_id);
+    // render pass pipelines only need a compatible pass, the window's current one will do
+    VkRenderPass render_pass = vk_info.dynamic_rendering ? VK_NULL_HANDLE : vk_win->render_pass;
+    uint64_t hash = vk_pipeline_hash(desc, vk_win->swapchain_format, vk_win->depth_format, render_pass);
 
-    HWND window = (HWND)canvas_info.canvas[window_id].window;
-    if (!window)
+    canvas_pipeline *pipeline = vk_pipeline_find(hash);
+    if (pipeline)
     {
-        CANVAS_RETURN_ERR(CANVAS_ERR_GET_WINDOW, "no window to maximize: %d\n", window_id);
+        CANVAS_RETURN(pipeline);
     }
 
-    ShowWindow(window, SW_MAXIMIZE);
-    canvas_info.canvas[window_id].maximized = true;
-    canvas_info.canvas[window_id].minimized = false;
+    VkPipelineLayout layout = vk_pipeline_layout();
+    if (!layout)
+    {
+        CANVAS_RETURN(NULL);
+    }
 
-    CANVAS_RETURN(CANVAS_OK);
+    VkPipeline vk_pipeline = vk_build_pipeline(desc, vk_win->swapchain_format, vk_win->depth_format, render_pass, layout);
+    CANVAS_RETURN(vk_pipeline_track(vk_pipeline, layout, hash, false));
 }
 
-int canvas_restore(int window_id)
+canvas_pipeline *canvas_compute_pipeline_create(const uint32_t *spirv, size_t size, const char *entry)
 {
     CANVAS_ENTER_FUNC();
-    CANVAS_VALID(window_id);
+    CANVAS_ASSERT_NOT_NULL(spirv);
 
-    HWND window = (HWND)canvas_info.canvas[window_id].window;
-    if (!window)
+    if (!spirv || !size)
     {
-        CANVAS_RETURN_ERR(CANVAS_ERR_GET_WINDOW, "no window to restore: %d\n", window_id);
+        CANVAS_RETURN_ERR(NULL, "compute pipeline needs SPIR-V\n");
     }
 
-    if (canvas_info.canvas[window_id].fullscreen)
+    if (!vk_info.device)
     {
-        SetWindowLong(window, GWL_STYLE, _canvas_data[window_id].saved_style);
+        CANVAS_RETURN_ERR(NULL, "GPU not initialized\n");
+    }
 
-        HWND insertAfter = _canvas_data[window_id].saved_z_order ? _canvas_data[window_id].saved_z_order : HWND_NOTOPMOST;
-        SetWindowPos(window, insertAfter,
-                     (int)_canvas_data[window_id].saved_x,
-                     (int)_canvas_data[window_id].saved_y,
-                     (unsigned int)_canvas_data[window_id].saved_width,
-                     (unsigned int)_canvas_data[window_id].saved_height,
-                     SWP_FRAMECHANGED | SWP_SHOWWINDOW | SWP_NOACTIVATE);
+    if (!entry)
+        entry = "main";
 
-        ShowWindow(window, SW_NORMAL);
+    uint64_t hash = vk_hash_bytes(CANVAS_VK_HASH_SEED, "compute", 8);
+    hash = vk_hash_bytes(hash, spirv, size);
+    hash = vk_hash_bytes(hash, entry, strlen(entry) + 1);
+
+    canvas_pipeline *pipeline = vk_pipeline_find(hash);
+    if (pipeline)
+    {
+        CANVAS_RETURN(pipeline);
     }
-    else
+
+    VkPipelineLayout layout = vk_pipeline_layout();
+    VkShaderModule module = vk_shader_module(spirv, size);
+    if (!layout || !module)
     {
-        ShowWindow(window, SW_RESTORE);
+        if (module)
+            vk_info.vkDestroyShaderModule(vk_info.device, module, NULL);
+        CANVAS_RETURN_ERR(NULL, "failed to create compute shader module\n");
     }
 
-    canvas_info.canvas[window_id].minimized = false;
-    canvas_info.canvas[window_id].maximized = false;
-    canvas_info.canvas[window_id].fullscreen = false;
+    VkComputePipelineCreateInfo pipeline_info = {0};
+    pipeline_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipeline_info.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipeline_info.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipeline_info.stage.module = module;
+    pipeline_info.stage.pName = entry;
+    pipeline_info.layout = layout;
 
-    CANVAS_RETURN(CANVAS_OK);
+    VkPipeline vk_pipeline = VK_NULL_HANDLE;
+    VkResult result = vk_info.vkCreateComputePipelines(vk_info.device, vk_pipeline_cache(), 1, &pipeline_info, NULL, &vk_pipeline);
+    vk_info.vkDestroyShaderModule(vk_info.device, module, NULL);
+
+    if (result != VK_SUCCESS)
+    {
+        CANVAS_RETURN_ERR(NULL, "failed to create compute pipeline (result=%d)\n", result);
+    }
+
+    CANVAS_RETURN(vk_pipeline_track(vk_pipeline, layout, hash, true));
 }
 
-int canvas_fullscreen(int window_id)
+void canvas_pipeline_destroy(canvas_pipeline *pipeline)
 {
     CANVAS_ENTER_FUNC();
-    CANVAS_VALID(window_id);
 
-    HWND window = (HWND)canvas_info.canvas[window_id].window;
-    if (!window)
+    if (!pipeline || --pipeline->refs > 0)
     {
-        CANVAS_RETURN_ERR(CANVAS_ERR_GET_WINDOW, "no window for fullscreen: %d\n", window_id);
+        CANVAS_RETURN_VOID();
     }
 
-    if (!canvas_info.canvas[window_id].fullscreen)
+    for (uint32_t i = 0; i < vk_pipelines.count; i++)
     {
-        RECT rect;
-        GetWindowRect(window, &rect);
-        _canvas_data[window_id].saved_x = rect.left;
-        _canvas_data[window_id].saved_y = rect.top;
-        _canvas_data[window_id].saved_width = rect.right - rect.left;
-        _canvas_data[window_id].saved_height = rect.bottom - rect.top;
-        _canvas_data[window_id].saved_style = GetWindowLong(window, GWL_STYLE);
-        _canvas_data[window_id].saved_z_order = GetWindow(window, GW_HWNDPREV);
+        if (vk_pipelines.pipelines[i] == pipeline)
+        {
+            vk_pipelines.pipelines[i] = vk_pipelines.pipelines[--vk_pipelines.count];
+            break;
+        }
+    }
 
-        HMONITOR monitor = MonitorFromWindow(window, MONITOR_DEFAULTTONEAREST);
-        MONITORINFO mi = {sizeof(mi)};
-        GetMonitorInfo(monitor, &mi);
+    // rare enough that waiting beats tracking which frames still use it
+    vk_info.vkDeviceWaitIdle(vk_info.device);
+    vk_forget_recordings();
+    vk_info.vkDestroyPipeline(vk_info.device, (VkPipeline)pipeline->platform_handle, NULL);
+    free(pipeline);
 
-        SetWindowLong(window, GWL_STYLE, WS_VISIBLE | WS_POPUP);
-        SetWindowPos(window, HWND_TOPMOST,
-                     mi.rcMonitor.left,
-                     mi.rcMonitor.top,
-                     mi.rcMonitor.right - mi.rcMonitor.left,
-                     mi.rcMonitor.bottom - mi.rcMonitor.top,
-                     SWP_FRAMECHANGED | SWP_SHOWWINDOW | SWP_NOACTIVATE);
+    CANVAS_RETURN_VOID();
+}
 
-        ShowWindow(window, SW_MAXIMIZE);
-        UpdateWindow(window);
+// buffers with unflushed writes to non-coherent memory
+static struct
+{
+    canvas_buffer **buffers;
+    uint32_t count;
+    uint32_t capacity;
+} vk_dirty = {0};
 
-        canvas_info.canvas[window_id].resize = true;
-        _canvas_window_resize(window_id);
+static size_t vk_buffer_bytes(canvas_buffer *buf)
+{
+    return buf->slice_size ? buf->slice_size * MAX_FRAMES_IN_FLIGHT : buf->size;
+}
 
-        canvas_info.canvas[window_id].fullscreen = true;
+static void vk_mark_dirty(canvas_buffer *buf, size_t begin, size_t end)
+{
+    if ((buf->memory_flags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) || begin >= end)
+        return;
+
+    if (buf->_dirty_end > buf->_dirty_begin)
+    {
+        if (begin < buf->_dirty_begin)
+            buf->_dirty_begin = begin;
+        if (end > buf->_dirty_end)
+            buf->_dirty_end = end;
+        return;
     }
 
-    canvas_info.canvas[window_id].minimized = false;
-    canvas_info.canvas[window_id].maximized = false;
+    if (vk_dirty.count == vk_dirty.capacity)
+    {
+        uint32_t capacity = vk_dirty.capacity ? vk_dirty.capacity * 2 : 64;
+        canvas_buffer **buffers = (canvas_buffer **)realloc(vk_dirty.buffers, capacity * sizeof(canvas_buffer *));
+        if (!buffers)
+        {
+            // no room to remember it, flush right away instead
+            VkMappedMemoryRange range = {0};
+            range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+            range.memory = (VkDeviceMemory)buf->memory;
+            range.offset = buf->_block < 0 ? 0 : buf->offset;
+            range.size = VK_WHOLE_SIZE;
+            vk_info.vkFlushMappedMemoryRanges(vk_info.device, 1, &range);
+            return;
+        }
 
-    CANVAS_RETURN(CANVAS_OK);
+        vk_dirty.buffers = buffers;
+        vk_dirty.capacity = capacity;
+    }
+
+    vk_dirty.buffers[vk_dirty.count++] = buf;
+    buf->_dirty_begin = begin;
+    buf->_dirty_end = end;
 }
 
-int _canvas_close(int window_id)
+// flushes only the written bytes, widened to nonCoherentAtomSize
+static VkMappedMemoryRange vk_dirty_range(canvas_buffer *buf)
+{
+    VkDeviceSize atom = vk_info.non_coherent_atom;
+    VkDeviceSize begin = (buf->offset + buf->_dirty_begin) / atom * atom;
+    VkDeviceSize end = (buf->offset + buf->_dirty_end + atom - 1) / atom * atom;
+
+    VkMappedMemoryRange range = {0};
+    range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+    range.memory = (VkDeviceMemory)buf->memory;
+    range.offset = begin;
+    range.size = end - begin;
+
+    // buddy ranges are power of two aligned and never cross the atom, a dedicated allocation may end inside one
+    if (buf->_block < 0 && end > buf->offset + vk_buffer_bytes(buf))
+        range.size = VK_WHOLE_SIZE;
+
+    return range;
+}
+
+static void vk_flush_dirty(void)
 {
     CANVAS_ENTER_FUNC();
-    CANVAS_BOUNDS(window_id);
 
-    if (canvas_win32.device && canvas_win32.fence && canvas_win32.cmdQueue)
+    VkMappedMemoryRange ranges[64];
+    uint32_t count = 0;
+
+    for (uint32_t i = 0; i < vk_dirty.count; i++)
     {
-        canvas_win32.fence_value++;
-        canvas_win32.cmdQueue->lpVtbl->Signal(canvas_win32.cmdQueue, canvas_win32.fence, canvas_win32.fence_value);
-        if (canvas_win32.fence->lpVtbl->GetCompletedValue(canvas_win32.fence) < canvas_win32.fence_value)
+        canvas_buffer *buf = vk_dirty.buffers[i];
+        ranges[count++] = vk_dirty_range(buf);
+        buf->_dirty_begin = buf->_dirty_end = 0;
+
+        if (count == 64 || i + 1 == vk_dirty.count)
         {
-            canvas_win32.fence->lpVtbl->SetEventOnCompletion(canvas_win32.fence, canvas_win32.fence_value, canvas_win32.fence_event);
-            WaitForSingleObject(canvas_win32.fence_event, INFINITE);
+            VkResult result = vk_info.vkFlushMappedMemoryRanges(vk_info.device, count, ranges);
+            if (result != VK_SUCCESS)
+                CANVAS_WARN("failed to flush %u mapped ranges (result=%d)\n", count, result);
+            count = 0;
         }
     }
 
-    if (canvas_info.canvas[window_id].depth_texture)
-    {
-        ID3D12Resource *depth = (ID3D12Resource *)canvas_info.canvas[window_id].depth_texture;
-        depth->lpVtbl->Release(depth);
-        canvas_info.canvas[window_id].depth_texture = NULL;
-    }
+    vk_dirty.count = 0;
+    CANVAS_RETURN_VOID();
+}
 
-    if (_canvas_data[window_id].swapChain)
-    {
-        _canvas_data[window_id].swapChain->lpVtbl->Release(_canvas_data[window_id].swapChain);
-        _canvas_data[window_id].swapChain = NULL;
-    }
+// a destroyed buffer leaves the dirty list, its writes don't matter anymore
+static void vk_forget_dirty(canvas_buffer *buf)
+{
+    if (buf->_dirty_end <= buf->_dirty_begin)
+        return;
 
-    for (int i = 0; i < 2; i++)
+    for (uint32_t i = 0; i < vk_dirty.count; i++)
     {
-        if (_canvas_data[window_id].backBuffers[i])
+        if (vk_dirty.buffers[i] == buf)
         {
-            _canvas_data[window_id].backBuffers[i]->lpVtbl->Release(_canvas_data[window_id].backBuffers[i]);
-            _canvas_data[window_id].backBuffers[i] = NULL;
+            vk_dirty.buffers[i] = vk_dirty.buffers[--vk_dirty.count];
+            break;
         }
     }
-
-    DestroyWindow((HWND)canvas_info.canvas[window_id].window);
-    CANVAS_RETURN(CANVAS_OK);
 }
 
-int _canvas_set(int window_id, int display, int64_t x, int64_t y, int64_t width, int64_t height, const char *title)
+canvas_buffer *canvas_buffer_create(int window_id, canvas_buffer_type type, canvas_buffer_usage usage, size_t size, void *initial_data)
 {
     CANVAS_ENTER_FUNC();
-    CANVAS_BOUNDS(window_id);
+    CANVAS_ASSERT_RANGE(window_id, 0, MAX_CANVAS - 1);
+    CANVAS_ASSERT(size > 0);
+    CANVAS_ASSERT_RANGE(type, CANVAS_BUFFER_VERTEX, CANVAS_BUFFER_INDIRECT);
+    CANVAS_ASSERT_RANGE(usage, CANVAS_BUFFER_STATIC, CANVAS_BUFFER_PER_FRAME);
 
-    HWND window = (HWND)canvas_info.canvas[window_id].window;
+    CANVAS_VALID_PTR(window_id);
 
-    if (!window)
+    CANVAS_ASSERT_NOT_NULL(vk_info.device);
+    CANVAS_ASSERT_NOT_NULL(vk_info.vkCreateBuffer);
+    CANVAS_ASSERT_NOT_NULL(vk_info.vkAllocateMemory);
+    CANVAS_ASSERT_NOT_NULL(vk_info.vkBindBufferMemory);
+
+    if (!vk_info.device)
     {
-        CANVAS_RETURN_ERR(CANVAS_ERR_GET_WINDOW, "no window to set: %d\n", window_id);
+        CANVAS_RETURN_ERR(NULL, "GPU not initialized\\n");
     }
 
-    if (display < 0 || display >= canvas_info.display_count)
-        display = 0;
+    canvas_buffer *buf = (canvas_buffer *)calloc(1, sizeof(canvas_buffer));
+    if (!buf)
+    {
+        CANVAS_RETURN(NULL);
+    }
+    CANVAS_ASSERT_NOT_NULL(buf);
 
-    CANVAS_DISPLAY_BOUNDS(display);
+    buf->size = size;
+    buf->type = type;
+    buf->usage = usage;
+    buf->window_id = window_id;
 
-    int screen_x = (int)(canvas_info.display[display].x + x);
-    int screen_y = (int)(canvas_info.display[display].y + y);
+    // Determine usage flags
+    VkBufferUsageFlags usage_flags;
+    switch (type)
+    {
+    case CANVAS_BUFFER_VERTEX:
+        usage_flags = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+        break;
+    case CANVAS_BUFFER_INDEX:
+        usage_flags = VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
+        break;
+    case CANVAS_BUFFER_UNIFORM:
+        usage_flags = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
+        break;
+    case CANVAS_BUFFER_STORAGE:
+        usage_flags = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT;
+        break;
+    case CANVAS_BUFFER_INDIRECT:
+        usage_flags = VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+        break;
+    default:
+        usage_flags = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+    }
 
-    int win_width = (width == -1) ? (int)canvas_info.canvas[window_id].width : (int)width;
-    int win_height = (height == -1) ? (int)canvas_info.canvas[window_id].height : (int)height;
+    // device local buffers are written through staged copies
+    if (!_canvas_buffer_host_written(usage))
+        usage_flags |= VK_BUFFER_USAGE_TRANSFER_DST_BIT;
 
-    UINT flags = SWP_NOZORDER | SWP_NOACTIVATE | SWP_NOOWNERZORDER;
-    
-    if (win_width <= 0 || win_height <= 0)
-        flags |= SWP_NOSIZE;
+    // staging goes both ways, uploads copy out of it and readbacks into it
+    if (usage == CANVAS_BUFFER_STAGING)
+        usage_flags |= VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
 
+    // slices start at 256 bytes, the largest offset alignment vulkan allows for uniform and storage bindings
+    VkDeviceSize buffer_size = size;
+    if (usage == CANVAS_BUFFER_PER_FRAME)
+    {
+        buf->slice_size = (size + 255) & ~(size_t)255;
+        buffer_size = (VkDeviceSize)buf->slice_size * MAX_FRAMES_IN_FLIGHT;
+    }
 
-    if (!SetWindowPos(window, NULL, screen_x, screen_y, win_width, win_height, flags))
-        CANVAS_WARN("SetWindowPos failed: %lu\n", GetLastError());
+    // Create buffer
+    VkBufferCreateInfo buffer_info = {0};
+    buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    buffer_info.size = buffer_size;
+    buffer_info.usage = usage_flags;
+    buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
-    if (title)
-        SetWindowTextA(window, title);
+    // shared with the transfer and compute queues instead of ownership transfers on every use
+    uint32_t queue_families[3] = {(uint32_t)vk_info.graphics_family};
+    uint32_t family_count = 1;
+    if (vk_info.transfer_family != vk_info.graphics_family)
+        queue_families[family_count++] = (uint32_t)vk_info.transfer_family;
+    if (vk_info.compute_family != vk_info.graphics_family)
+        queue_families[family_count++] = (uint32_t)vk_info.compute_family;
 
-    canvas_info.canvas[window_id].display = display;
+    if (family_count > 1)
+    {
+        buffer_info.sharingMode = VK_SHARING_MODE_CONCURRENT;
+        buffer_info.queueFamilyIndexCount = family_count;
+        buffer_info.pQueueFamilyIndices = queue_families;
+    }
 
-    CANVAS_RETURN(CANVAS_OK);
-}
+    VkBuffer vk_buffer;
+    VkResult result = vk_info.vkCreateBuffer(vk_info.device, &buffer_info,
+                                             NULL, &vk_buffer);
+    if (result != VK_SUCCESS)
+    {
+        CANVAS_ERR("Failed to create Vulkan buffer\n");
+        free(buf);
+        CANVAS_RETURN(NULL);
+    }
 
-int _canvas_get_window_display(int window_id)
-{
-    CANVAS_ENTER_FUNC();
-    CANVAS_BOUNDS(window_id);
+    // Get memory requirements
+    VkMemoryRequirements mem_reqs;
+    vk_info.vkGetBufferMemoryRequirements(vk_info.device, vk_buffer, &mem_reqs);
 
-    HWND window = (HWND)canvas_info.canvas[window_id].window;
+    // try placements best first, a full BAR heap falls through to the next one
+    VkMemoryPropertyFlags candidates[4];
+    uint32_t candidate_count = vk_memory_placement(usage, candidates);
 
-    if (!window)
+    canvas_vk_allocation allocation;
+    int alloc_result = CANVAS_FAIL;
+    for (uint32_t i = 0; i < candidate_count && alloc_result != CANVAS_OK; i++)
+        alloc_result = vk_memory_alloc(&mem_reqs, candidates[i], buffer_size, &allocation);
+
+    if (alloc_result != CANVAS_OK)
     {
-        CANVAS_RETURN_ERR(CANVAS_ERR_GET_WINDOW, "no window to set: %d\n", window_id);
+        CANVAS_ERR("Failed to allocate Vulkan buffer memory\n");
+        vk_info.vkDestroyBuffer(vk_info.device, vk_buffer, NULL);
+        free(buf);
+        CANVAS_RETURN(NULL);
     }
 
-    HMONITOR monitor = MonitorFromWindow(window, MONITOR_DEFAULTTOPRIMARY);
+    vk_info.vkBindBufferMemory(vk_info.device, vk_buffer, allocation.memory, allocation.offset);
 
-    for (int i = 0; i < canvas_info.display_count; i++)
-    {
-        DISPLAY_DEVICEA dd = {0};
-        dd.cb = sizeof(dd);
+    buf->platform_handle = vk_buffer;
+    buf->memory = (uint64_t)allocation.memory;
+    buf->offset = allocation.offset;
+    buf->_block = allocation.block;
+    buf->_node = allocation.node;
+    buf->heap = vk_info.memory_properties.memoryTypes[allocation.memory_type].heapIndex;
+    buf->memory_flags = vk_info.memory_properties.memoryTypes[allocation.memory_type].propertyFlags;
 
-        if (!EnumDisplayDevicesA(NULL, i, &dd, 0))
-            continue;
+    // host visible memory is mapped for the allocation's lifetime
+    buf->mapped = allocation.mapped;
 
-        if (!(dd.StateFlags & DISPLAY_DEVICE_ACTIVE))
-            continue;
+    if (_canvas_buffer_host_written(usage) && !buf->mapped)
+    {
+        CANVAS_ERR("Failed to map Vulkan buffer\n");
+        canvas_buffer_destroy(buf);
+        CANVAS_RETURN(NULL);
+    }
 
-        DEVMODEA dm = {0};
-        dm.dmSize = sizeof(dm);
+    if (_canvas_buffer_host_written(usage))
+    {
+        // every slice starts out with the initial data
+        for (uint32_t i = 0; initial_data && i < (buf->slice_size ? MAX_FRAMES_IN_FLIGHT : 1); i++)
+            memcpy((uint8_t *)buf->mapped + i * buf->slice_size, initial_data, size);
 
-        if (!EnumDisplaySettingsA(dd.DeviceName, ENUM_CURRENT_SETTINGS, &dm))
-            continue;
+        if (initial_data)
+            vk_mark_dirty(buf, 0, vk_buffer_bytes(buf));
+    }
+    else if (initial_data && buf->mapped)
+    {
+        // mappable vram, nothing reads a new buffer yet so no staging is needed
+        memcpy(buf->mapped, initial_data, size);
+    }
+    else if (initial_data)
+    {
+        if (_vulkan_upload_buffer_data(buf, initial_data, size) != CANVAS_OK)
+        {
+            CANVAS_ERR("Failed to upload device-local buffer data\n");
+            canvas_buffer_destroy(buf);
+            CANVAS_RETURN(NULL);
+        }
+    }
 
-        MONITORINFOEXA mi = {0};
-        mi.cbSize = sizeof(mi);
+    CANVAS_RETURN(buf);
+}
 
-        if (!GetMonitorInfoA(monitor, (MONITORINFO *)&mi))
-            continue;
+// slice the next frame of the buffer's window reads
+static uint32_t vk_frame_slice(canvas_buffer *buf)
+{
+    return (uint32_t)((vk_windows[buf->window_id].timeline_value + 1) % MAX_FRAMES_IN_FLIGHT);
+}
 
-        if (strcmp(mi.szDevice, dd.DeviceName) != 0)
-            continue;
+// returns the slice the next frame reads once the frame that read it last has finished,
+// acquire already paces frames that far back so this rarely waits
+static uint8_t *vk_frame_slice_write(canvas_buffer *buf)
+{
+    canvas_vulkan_window *vk_win = &vk_windows[buf->window_id];
+    uint64_t next = vk_win->timeline_value + 1;
 
-        canvas_info.canvas[window_id].display = i;
-        CANVAS_RETURN(i);
-    }
+    if (next > MAX_FRAMES_IN_FLIGHT)
+        vk_timeline_wait(vk_win, next - MAX_FRAMES_IN_FLIGHT, UINT64_MAX);
 
-    CANVAS_RETURN(CANVAS_OK);
+    return (uint8_t *)buf->mapped + (size_t)vk_frame_slice(buf) * buf->slice_size;
 }
 
-int _canvas_refresh_displays()
+void canvas_buffer_update(canvas_buffer *buf, void *data, size_t size, size_t offset)
 {
     CANVAS_ENTER_FUNC();
+    CANVAS_ASSERT_NOT_NULL(buf);
+    CANVAS_ASSERT_NOT_NULL(data);
+    CANVAS_ASSERT(size > 0);
 
-    canvas_info.display_count = 0;
-    canvas_info.display_changed = false;
-    canvas_info.highest_refresh_rate = 0;
-
-    for (int i = 0; i < MAX_DISPLAYS; i++)
+    if (!buf || !data)
     {
-        DISPLAY_DEVICEA dd = {0};
-        dd.cb = sizeof(dd);
+        CANVAS_RETURN_VOID();
+    }
 
-        if (!EnumDisplayDevicesA(NULL, i, &dd, 0))
-            continue;
+    CANVAS_ASSERT_RANGE(buf->type, CANVAS_BUFFER_VERTEX, CANVAS_BUFFER_INDIRECT);
+    CANVAS_ASSERT_RANGE(buf->usage, CANVAS_BUFFER_STATIC, CANVAS_BUFFER_PER_FRAME);
+    CANVAS_ASSERT(buf->size > 0);
+    CANVAS_ASSERT(offset + size <= buf->size);
 
-        if (!(dd.StateFlags & DISPLAY_DEVICE_ACTIVE))
-            continue;
+    if (offset > buf->size || size > buf->size - offset)
+    {
+        CANVAS_ERR("Buffer update out of bounds\\n");
+        CANVAS_RETURN_VOID();
+    }
 
-        DEVMODEA dm = {0};
-        dm.dmSize = sizeof(dm);
+    // device local, copied before the next frame reads it
+    if (!_canvas_buffer_host_written(buf->usage))
+    {
+        if (!vk_upload_copy(buf, offset, data, size, true))
+            CANVAS_ERR("Failed to queue buffer update\n");
 
-        if (!EnumDisplaySettingsA(dd.DeviceName, ENUM_CURRENT_SETTINGS, &dm))
-            continue;
+        CANVAS_RETURN_VOID();
+    }
 
-        POINT pt = {dm.dmPosition.x + 1, dm.dmPosition.y + 1};
-        HMONITOR monitor = MonitorFromPoint(pt, MONITOR_DEFAULTTONEAREST);
+    CANVAS_ASSERT_NOT_NULL(buf->mapped);
 
-        canvas_win32.monitors[i] = monitor;
+    uint8_t *dst = buf->usage == CANVAS_BUFFER_PER_FRAME ? vk_frame_slice_write(buf) : (uint8_t *)buf->mapped;
+    memcpy(dst + offset, data, size);
 
-        canvas_info.display[i].primary = (dd.StateFlags & DISPLAY_DEVICE_PRIMARY_DEVICE) != 0;
-        canvas_info.display[i].x = dm.dmPosition.x;
-        canvas_info.display[i].y = dm.dmPosition.y;
-        canvas_info.display[i].width = dm.dmPelsWidth;
-        canvas_info.display[i].height = dm.dmPelsHeight;
-        canvas_info.display[i].refresh_rate = dm.dmDisplayFrequency;
+    size_t base = (size_t)(dst - (uint8_t *)buf->mapped);
+    vk_mark_dirty(buf, base + offset, base + offset + size);
+    CANVAS_RETURN_VOID();
+}
 
-        if (dm.dmDisplayFrequency > canvas_info.highest_refresh_rate)
-            canvas_info.highest_refresh_rate = dm.dmDisplayFrequency;
+void canvas_buffer_update_regions(canvas_buffer *buf, const canvas_buffer_region *regions, uint32_t count)
+{
+    CANVAS_ENTER_FUNC();
+    CANVAS_ASSERT_NOT_NULL(buf);
+    CANVAS_ASSERT_NOT_NULL(regions);
 
-        canvas_info.display_count++;
+    if (!buf || !regions || count == 0)
+    {
+        CANVAS_RETURN_VOID();
     }
 
-    for (int i = 0; i < MAX_CANVAS; i++)
+    for (uint32_t i = 0; i < count; i++)
     {
-        if (canvas_info.canvas[i].window)
-            _canvas_get_window_display(i);
+        if (!regions[i].data || regions[i].offset > buf->size || regions[i].size > buf->size - regions[i].offset)
+        {
+            CANVAS_ERR("Buffer region %u out of bounds\n", i);
+            CANVAS_RETURN_VOID();
+        }
     }
 
-    CANVAS_RETURN(canvas_info.display_count);
+    if (!_canvas_buffer_host_written(buf->usage))
+    {
+        vk_upload_regions(buf, regions, count);
+        CANVAS_RETURN_VOID();
+    }
+
+    CANVAS_ASSERT_NOT_NULL(buf->mapped);
+
+    uint8_t *dst = buf->usage == CANVAS_BUFFER_PER_FRAME ? vk_frame_slice_write(buf) : (uint8_t *)buf->mapped;
+    size_t base = (size_t)(dst - (uint8_t *)buf->mapped);
+    for (uint32_t i = 0; i < count; i++)
+    {
+        memcpy(dst + regions[i].offset, regions[i].data, regions[i].size);
+        vk_mark_dirty(buf, base + regions[i].offset, base + regions[i].offset + regions[i].size);
+    }
+
+    CANVAS_RETURN_VOID();
 }
-int _canvas_init_displays()
+
+typedef struct
+{
+    canvas_buffer *buf;
+    uint32_t index;
+} canvas_vk_write_key;
+
+static int vk_write_compare(const void *a, const void *b)
+{
+    const canvas_vk_write_key *wa = (const canvas_vk_write_key *)a;
+    const canvas_vk_write_key *wb = (const canvas_vk_write_key *)b;
+
+    if (wa->buf != wb->buf)
+        return (uintptr_t)wa->buf < (uintptr_t)wb->buf ? -1 : 1;
+
+    return wa->index < wb->index ? -1 : (wa->index > wb->index);
+}
+
+uint64_t canvas_upload_batch(const canvas_buffer_write *writes, uint32_t count)
 {
     CANVAS_ENTER_FUNC();
+    CANVAS_ASSERT_NOT_NULL(writes);
 
-    canvas_info.display_count = 0;
+    if (!writes || count == 0)
+    {
+        CANVAS_RETURN(0);
+    }
 
-    // SetProcessDpiAwarenessContext(DPI_AWARENESS_CONTEXT_PER_MONITOR_AWARE_V2);
+    canvas_vk_write_key *keys = (canvas_vk_write_key *)malloc(count * (sizeof(canvas_vk_write_key) + sizeof(canvas_buffer_region)));
+    if (!keys)
+    {
+        CANVAS_RETURN(0);
+    }
 
-    int result = _canvas_refresh_displays();
-    CANVAS_RETURN(result);
+    canvas_buffer_region *regions = (canvas_buffer_region *)(keys + count);
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        keys[i].buf = writes[i].buf;
+        keys[i].index = i;
+    }
+
+    // one region list per buffer, call order kept within each
+    qsort(keys, count, sizeof(canvas_vk_write_key), vk_write_compare);
+
+    uint64_t token = 0;
+    uint32_t start = 0;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        const canvas_buffer_write *write = &writes[keys[i].index];
+        regions[i].offset = write->offset;
+        regions[i].size = write->size;
+        regions[i].data = write->data;
+
+        if (i + 1 < count && keys[i + 1].buf == keys[i].buf)
+            continue;
+
+        canvas_buffer *buf = keys[i].buf;
+        if (buf)
+        {
+            canvas_buffer_update_regions(buf, &regions[start], i + 1 - start);
+            if (!_canvas_buffer_host_written(buf->usage) && buf->upload > token)
+                token = buf->upload;
+        }
+
+        start = i + 1;
+    }
+
+    free(keys);
+    CANVAS_RETURN(token);
 }
 
-double canvas_get_time(canvas_time_data *time)
+void *canvas_buffer_map(canvas_buffer *buf)
 {
     CANVAS_ENTER_FUNC();
-    CANVAS_ASSERT(time != NULL);
+    CANVAS_ASSERT_NOT_NULL(buf);
 
-    LARGE_INTEGER counter;
-    QueryPerformanceCounter(&counter);
-    double result = (double)((uint64_t)counter.QuadPart - time->start) /
-                    (double)_canvas_qpc_frequency.QuadPart;
-    CANVAS_RETURN(result);
+    if (!buf)
+    {
+        CANVAS_RETURN(NULL);
+    }
+
+    CANVAS_ASSERT(buf->size > 0);
+    CANVAS_ASSERT_NOT_NULL(vk_info.device);
+
+    // host visible allocations are persistently mapped, the shared block can't be mapped again
+    if (!buf->mapped)
+    {
+        CANVAS_RETURN_ERR(NULL, "Buffer memory is not host visible\n");
+    }
+
+    uint8_t *mapped = buf->usage == CANVAS_BUFFER_PER_FRAME ? vk_frame_slice_write(buf) : (uint8_t *)buf->mapped;
+    size_t base = (size_t)(mapped - (uint8_t *)buf->mapped);
+
+    if (!(buf->memory_flags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT))
+    {
+        // gpu writes become visible to cached reads, unless that would drop cpu writes not flushed yet
+        if (buf->_dirty_end <= buf->_dirty_begin)
+        {
+            buf->_dirty_begin = base;
+            buf->_dirty_end = base + buf->size;
+            VkMappedMemoryRange range = vk_dirty_range(buf);
+            buf->_dirty_begin = buf->_dirty_end = 0;
+            vk_info.vkInvalidateMappedMemoryRanges(vk_info.device, 1, &range);
+        }
+
+        // what the caller writes through the pointer is unknown, the whole mapping gets flushed
+        vk_mark_dirty(buf, base, base + buf->size);
+    }
+
+    CANVAS_RETURN(mapped);
 }
 
-void canvas_sleep(double seconds)
+void canvas_buffer_unmap(canvas_buffer *buf)
 {
     CANVAS_ENTER_FUNC();
 
-    HANDLE timer = CreateWaitableTimer(NULL, TRUE, NULL);
-    if (timer)
+    if (!buf)
     {
-        LARGE_INTEGER li;
-        li.QuadPart = -(LONGLONG)(seconds * 10000000.0); // 100ns units
-        SetWaitableTimer(timer, &li, 0, NULL, NULL, FALSE);
-        WaitForSingleObject(timer, INFINITE);
-        CloseHandle(timer);
+        CANVAS_RETURN_VOID();
     }
 
+    // Persistently mapped
     CANVAS_RETURN_VOID();
 }
 
-void canvas_time_init(canvas_time_data *time)
+size_t canvas_buffer_frame_offset(canvas_buffer *buf)
 {
-    CANVAS_ENTER_FUNC();
-    CANVAS_ASSERT(time != NULL);
+    if (!buf || buf->usage != CANVAS_BUFFER_PER_FRAME)
+        return 0;
 
-    time->frame = 0;
-    time->frame_index = 0;
-    time->accumulator = 0;
-    time->alpha = 0;
-    time->delta = 0;
-    time->fps = 0;
-    time->raw_delta = 0;
+    return (size_t)vk_frame_slice(buf) * buf->slice_size;
+}
 
-    for (int i = 0; i < 60; i++)
-        time->times[i] = 0.0;
+// next zeroed entry of the window's draw stream, the arena keeps its capacity across frames
+static canvas_vk_command *vk_command_push(int window_id, canvas_vk_command_type type)
+{
+    if (window_id < 0 || window_id >= MAX_CANVAS || !canvas_info.canvas[window_id]._valid)
+        return NULL;
 
-    QueryPerformanceFrequency(&_canvas_qpc_frequency);
+    canvas_vulkan_window *vk_win = &vk_windows[window_id];
 
-    LARGE_INTEGER counter;
-    QueryPerformanceCounter(&counter);
+    if (vk_win->command_count == vk_win->command_capacity)
+    {
+        uint32_t capacity = vk_win->command_capacity ? vk_win->command_capacity * 2 : 256;
+        canvas_vk_command *commands = (canvas_vk_command *)realloc(vk_win->commands, capacity * sizeof(canvas_vk_command));
+        if (!commands)
+        {
+            CANVAS_ERR("window %d: out of memory for draw commands\n", window_id);
+            return NULL;
+        }
 
-    time->start = (uint64_t)counter.QuadPart;
-    time->current = canvas_get_time(time);
-    time->last = time->current;
-    CANVAS_RETURN_VOID();
+        vk_win->commands = commands;
+        vk_win->command_capacity = capacity;
+    }
+
+    canvas_vk_command *command = &vk_win->commands[vk_win->command_count++];
+    memset(command, 0, sizeof(*command));
+    command->type = type;
+    return command;
 }
 
-HCURSOR _canvas_get_win32_cursor(canvas_cursor_type cursor)
+static void vk_command_buffer(canvas_buffer *buf, canvas_vk_command_type type, uint32_t slot)
 {
-    CANVAS_ENTER_FUNC();
+    canvas_vk_command *command = vk_command_push(buf->window_id, type);
+    if (!command)
+        return;
 
-    LPCTSTR cursor_name;
+    command->slot = slot;
+    command->buffer.buffer = (VkBuffer)buf->platform_handle;
+    command->buffer.offset = canvas_buffer_frame_offset(buf);
+    command->buffer.range = buf->size;
+}
 
-    switch (cursor)
+void canvas_buffer_bind_vertex(canvas_buffer *buf, uint32_t binding)
+{
+    CANVAS_ENTER_FUNC();
+    CANVAS_ASSERT_NOT_NULL(buf);
+
+    if (!buf || binding >= CANVAS_VK_MAX_VERTEX_BINDINGS)
     {
-    case CANVAS_CURSOR_ARROW:
-        cursor_name = IDC_ARROW;
-        break;
-    case CANVAS_CURSOR_TEXT:
-        cursor_name = IDC_IBEAM;
-        break;
-    case CANVAS_CURSOR_CROSSHAIR:
-        cursor_name = IDC_CROSS;
-        break;
-    case CANVAS_CURSOR_HAND:
-        cursor_name = IDC_HAND;
-        break;
-    case CANVAS_CURSOR_SIZE_NS:
-        cursor_name = IDC_SIZENS;
-        break;
-    case CANVAS_CURSOR_SIZE_EW:
-        cursor_name = IDC_SIZEWE;
-        break;
-    case CANVAS_CURSOR_SIZE_NESW:
-        cursor_name = IDC_SIZENESW;
-        break;
-    case CANVAS_CURSOR_SIZE_NWSE:
-        cursor_name = IDC_SIZENWSE;
-        break;
-    case CANVAS_CURSOR_SIZE_ALL:
-        cursor_name = IDC_SIZEALL;
-        break;
-    case CANVAS_CURSOR_NOT_ALLOWED:
-        cursor_name = IDC_NO;
-        break;
-    case CANVAS_CURSOR_WAIT:
-        cursor_name = IDC_WAIT;
-        break;
-    default:
-        cursor_name = IDC_ARROW;
-        break;
+        CANVAS_RETURN_VOID();
     }
 
-    HCURSOR result = LoadCursor(NULL, cursor_name);
-    CANVAS_RETURN(result);
+    vk_command_buffer(buf, CANVAS_VK_CMD_VERTEX, binding);
+    CANVAS_RETURN_VOID();
 }
 
-int canvas_cursor(int window_id, canvas_cursor_type cursor)
+void canvas_buffer_bind_index(canvas_buffer *buf)
 {
     CANVAS_ENTER_FUNC();
-    CANVAS_VALID(window_id);
+    CANVAS_ASSERT_NOT_NULL(buf);
 
-    canvas_info.canvas[window_id].cursor = cursor;
-    SetCursor(_canvas_get_win32_cursor(cursor));
+    if (!buf)
+    {
+        CANVAS_RETURN_VOID();
+    }
 
-    CANVAS_RETURN(CANVAS_OK);
+    vk_command_buffer(buf, CANVAS_VK_CMD_INDEX, 0);
+    CANVAS_RETURN_VOID();
 }
 
-LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
+void canvas_buffer_bind_storage(canvas_buffer *buf, uint32_t binding)
 {
-    int window_index = _canvas_window_index(hwnd);
-
-    if (window_index < 0)
-        return DefWindowProc(hwnd, msg, wParam, lParam);
+    CANVAS_ENTER_FUNC();
+    CANVAS_ASSERT_NOT_NULL(buf);
 
-    switch (msg)
-    {
-    case WM_MOUSEWHEEL:
+    if (!buf || binding >= CANVAS_VK_STORAGE_BINDINGS)
     {
-        canvas_pointer *p = canvas_get_primary_pointer(window_index);
-        short delta = GET_WHEEL_DELTA_WPARAM(wParam);
-        p->scroll_y = (float)delta / 120.0f;
-        return 0;
+        CANVAS_RETURN_VOID();
     }
 
-    case WM_MOUSEHWHEEL:
+    vk_command_buffer(buf, CANVAS_VK_CMD_STORAGE, binding);
+    CANVAS_RETURN_VOID();
+}
+
+void canvas_set_pipeline(int window_id, canvas_pipeline *pipeline)
+{
+    CANVAS_ENTER_FUNC();
+    CANVAS_ASSERT_NOT_NULL(pipeline);
+
+    if (!pipeline)
     {
-        canvas_pointer *p = canvas_get_primary_pointer(window_index);
-        short delta = GET_WHEEL_DELTA_WPARAM(wParam);
-        p->scroll_x = (float)delta / 120.0f;
-        return 0;
+        CANVAS_RETURN_VOID();
     }
 
-    case WM_SETCURSOR:
+    if (pipeline->compute)
     {
-        if (LOWORD(lParam) == HTCLIENT)
-        {
-            SetCursor(_canvas_get_win32_cursor(canvas_info.canvas[window_index].cursor));
-            return TRUE;
-        }
-        break;
+        CANVAS_ERR("compute pipelines run through canvas_dispatch\n");
+        CANVAS_RETURN_VOID();
     }
 
-    case WM_CREATE:
+    canvas_vk_command *command = vk_command_push(window_id, CANVAS_VK_CMD_PIPELINE);
+    if (command)
     {
-        if (!canvas_info.canvas[window_index].titlebar)
-        {
-            DWM_WINDOW_CORNER_PREFERENCE corner = DWMWCP_ROUND;
-            DwmSetWindowAttribute(hwnd, DWMWA_WINDOW_CORNER_PREFERENCE, &corner, sizeof(corner));
-
-            enum DWM_SYSTEMBACKDROP_TYPE backdrop = DWMSBT_MAINWINDOW;
-            DwmSetWindowAttribute(hwnd, DWMWA_SYSTEMBACKDROP_TYPE, &backdrop, sizeof(backdrop));
-        }
-        return CANVAS_OK;
+        command->pipeline.pipeline = (VkPipeline)pipeline->platform_handle;
+        command->pipeline.layout = (VkPipelineLayout)pipeline->layout;
     }
 
-    case WM_NCCALCSIZE:
-    {
-        if (canvas_info.canvas[window_index].fullscreen)
-            break;
+    CANVAS_RETURN_VOID();
+}
 
-        if (wParam == true && !canvas_info.canvas[window_index].titlebar)
-        {
-            NCCALCSIZE_PARAMS *params = (NCCALCSIZE_PARAMS *)lParam;
-
-            params->rgrc[0].top += 1;
-            params->rgrc[0].right -= 8;
-            params->rgrc[0].bottom -= 8;
-            params->rgrc[0].left += 8;
-            return 0;
-        }
-        break;
-    }
+void canvas_draw_instanced(int window_id, uint32_t vertex_count, uint32_t instance_count, uint32_t first_vertex, uint32_t first_instance)
+{
+    CANVAS_ENTER_FUNC();
 
-    case WM_NCHITTEST:
+    canvas_vk_command *command = vk_command_push(window_id, CANVAS_VK_CMD_DRAW);
+    if (command)
     {
-        if (canvas_info.canvas[window_index].fullscreen)
-            break;
-
-        if (!canvas_info.canvas[window_index].titlebar)
-        {
-            LRESULT hit = DefWindowProc(hwnd, msg, wParam, lParam);
+        command->draw.count = vertex_count;
+        command->draw.first = first_vertex;
+        command->draw.instance_count = instance_count;
+        command->draw.first_instance = first_instance;
+    }
 
-            if (hit == HTCLIENT)
-            {
-                POINT pt = {LOWORD(lParam), HIWORD(lParam)};
-                ScreenToClient(hwnd, &pt);
+    CANVAS_RETURN_VOID();
+}
 
-                RECT rcWindow;
-                GetClientRect(hwnd, &rcWindow);
+void canvas_draw_indexed_instanced(int window_id, uint32_t index_count, uint32_t instance_count, uint32_t first_index, int32_t vertex_offset, uint32_t first_instance)
+{
+    CANVAS_ENTER_FUNC();
 
-                if (pt.y < 30 && pt.y >= 0)
-                {
-                    return HTCAPTION;
-                }
-            }
+    canvas_vk_command *command = vk_command_push(window_id, CANVAS_VK_CMD_DRAW_INDEXED);
+    if (command)
+    {
+        command->draw.count = index_count;
+        command->draw.first = first_index;
+        command->draw.vertex_offset = vertex_offset;
+        command->draw.instance_count = instance_count;
+        command->draw.first_instance = first_instance;
+    }
 
-            return hit;
-        }
+    CANVAS_RETURN_VOID();
+}
 
-        break;
-    }
+void canvas_dispatch(int window_id, canvas_pipeline *pipeline, uint32_t x, uint32_t y, uint32_t z)
+{
+    CANVAS_ENTER_FUNC();
+    CANVAS_ASSERT_NOT_NULL(pipeline);
 
-    case WM_DISPLAYCHANGE:
+    if (!pipeline || !pipeline->compute)
     {
-        canvas_info.canvas[window_index].os_moved = true;
-        canvas_info.display_changed = true;
-        return CANVAS_OK;
+        CANVAS_ERR("canvas_dispatch needs a compute pipeline\n");
+        CANVAS_RETURN_VOID();
     }
 
-    case WM_MOVE:
+    if (x == 0 || y == 0 || z == 0)
     {
-        // _canvas_update_window_display(window_index);
-
-        return CANVAS_OK;
+        CANVAS_RETURN_VOID();
     }
 
-    case WM_MOVING:
+    canvas_vk_command *command = vk_command_push(window_id, CANVAS_VK_CMD_DISPATCH);
+    if (command)
     {
-
-        return CANVAS_OK;
+        command->dispatch.pipeline = (VkPipeline)pipeline->platform_handle;
+        command->dispatch.layout = (VkPipelineLayout)pipeline->layout;
+        command->dispatch.x = x;
+        command->dispatch.y = y;
+        command->dispatch.z = z;
     }
 
-    case WM_SIZE:
-    {
+    CANVAS_RETURN_VOID();
+}
 
-        if (wParam != SIZE_MINIMIZED)
-        {
-            UINT width = LOWORD(lParam);
-            UINT height = HIWORD(lParam);
-            if (width > 0 && height > 0)
-            {
-                canvas_info.canvas[window_index].width = width;
-                canvas_info.canvas[window_index].height = height;
-                canvas_info.canvas[window_index].resize = true;
-                canvas_info.canvas[window_index].os_resized = true;
-            }
+void canvas_draw(int window_id, uint32_t vertex_count, uint32_t first_vertex)
+{
+    canvas_draw_instanced(window_id, vertex_count, 1, first_vertex, 0);
+}
 
-            if (!canvas_info.os_timed)
-            {
-                InvalidateRect(hwnd, NULL, FALSE);
-            }
-        }
-        return CANVAS_OK;
-    }
+void canvas_draw_indexed(int window_id, uint32_t index_count, uint32_t first_index, int32_t vertex_offset)
+{
+    canvas_draw_indexed_instanced(window_id, index_count, 1, first_index, vertex_offset, 0);
+}
 
-    case WM_SIZING:
-    {
+bool canvas_draw_indirect_count_supported(void)
+{
+    return vk_info.draw_indirect_count;
+}
 
-        canvas_info.canvas[window_index].os_resized = true;
+static bool vk_indirect_buffer(canvas_buffer *buf)
+{
+    return buf && (buf->type == CANVAS_BUFFER_INDIRECT || buf->type == CANVAS_BUFFER_STORAGE);
+}
 
-        /* TODO
-            RECT *rect = (RECT *)lParam;
-            UINT width = rect->right - rect->left;
-            UINT height = rect->bottom - rect->top;
+static void vk_command_indirect(int window_id, canvas_vk_command_type type, canvas_buffer *args, size_t offset,
+                                canvas_buffer *count, size_t count_offset, uint32_t draw_count, uint32_t stride)
+{
+    CANVAS_ENTER_FUNC();
 
-            RECT client;
-            GetClientRect(hwnd, &client);
-            width = client.right - client.left;
-            height = client.bottom - client.top;
+    // storage buffers take the indirect usage too, so one a shader already fills can feed draws
+    if (!vk_indirect_buffer(args) || (count && !vk_indirect_buffer(count)))
+    {
+        CANVAS_ERR("indirect draws need INDIRECT or STORAGE buffers\n");
+        CANVAS_RETURN_VOID();
+    }
 
-            if (width > 0 && height > 0)
-            {
-                canvas_info.canvas[window_index].resize = true;
-                _canvas_window_resize(window_index);
-                _canvas_update();
-            }
-                */
+    uint32_t record = type == CANVAS_VK_CMD_DRAW_INDEXED_INDIRECT ? sizeof(canvas_draw_indexed_arguments) : sizeof(canvas_draw_arguments);
+    if (stride == 0)
+        stride = record;
 
-        return TRUE;
+    if (offset % 4 || stride % 4 || stride < record || count_offset % 4)
+    {
+        CANVAS_ERR("indirect offsets and strides must be 4 byte aligned and hold a whole record\n");
+        CANVAS_RETURN_VOID();
     }
 
-    case WM_ENTERSIZEMOVE:
-    {
-        if (canvas_info.os_timed)
-            break;
+    if (draw_count == 0)
+        CANVAS_RETURN_VOID();
 
-        canvas_info.os_timed = true;
-        timeBeginPeriod(1);
-        SetTimer(hwnd, 1, 0, NULL);
-        return CANVAS_OK;
+    if (!count && offset + (size_t)(draw_count - 1) * stride + record > args->size)
+    {
+        CANVAS_ERR("indirect draw reads past the end of its argument buffer\n");
+        CANVAS_RETURN_VOID();
     }
 
-    case WM_EXITSIZEMOVE:
+    if (draw_count > vk_info.max_draw_indirect_count && (count || vk_info.multi_draw_indirect))
     {
-        if (!canvas_info.os_timed)
-            break;
-
-        canvas_info.os_timed = false;
-        KillTimer(hwnd, 1);
-        timeEndPeriod(1);
-        return CANVAS_OK;
+        CANVAS_WARN("indirect draw count %u clamped to the device limit %u\n", draw_count, vk_info.max_draw_indirect_count);
+        draw_count = vk_info.max_draw_indirect_count;
     }
 
-    case WM_TIMER:
-    {
-        if (wParam != 1)
-            break;
+    canvas_vk_command *command = vk_command_push(window_id, type);
+    if (!command)
+        CANVAS_RETURN_VOID();
 
-        canvas_main_loop();
+    command->indirect.buffer = (VkBuffer)args->platform_handle;
+    command->indirect.offset = canvas_buffer_frame_offset(args) + offset;
+    command->indirect.draw_count = draw_count;
+    command->indirect.stride = stride;
 
-        return CANVAS_OK;
+    if (count)
+    {
+        command->indirect.count_buffer = (VkBuffer)count->platform_handle;
+        command->indirect.count_offset = canvas_buffer_frame_offset(count) + count_offset;
     }
 
-    case WM_SYSCOMMAND:
+    CANVAS_RETURN_VOID();
+}
+
+void canvas_draw_indirect(int window_id, canvas_buffer *args, size_t offset, uint32_t draw_count, uint32_t stride)
+{
+    vk_command_indirect(window_id, CANVAS_VK_CMD_DRAW_INDIRECT, args, offset, NULL, 0, draw_count, stride);
+}
+
+void canvas_draw_indexed_indirect(int window_id, canvas_buffer *args, size_t offset, uint32_t draw_count, uint32_t stride)
+{
+    vk_command_indirect(window_id, CANVAS_VK_CMD_DRAW_INDEXED_INDIRECT, args, offset, NULL, 0, draw_count, stride);
+}
+
+void canvas_draw_indirect_count(int window_id, canvas_buffer *args, size_t offset, canvas_buffer *count, size_t count_offset, uint32_t max_draws, uint32_t stride)
+{
+    CANVAS_ENTER_FUNC();
+
+    if (!vk_info.draw_indirect_count || !count)
     {
-        if (wParam == SC_MINIMIZE)
-            canvas_info.canvas[window_index].minimized = true;
-        else if (wParam == SC_MAXIMIZE)
-            canvas_info.canvas[window_index].maximized = true;
-        else if (wParam == SC_RESTORE)
-        {
-            canvas_info.canvas[window_index].minimized = false;
-            canvas_info.canvas[window_index].maximized = false;
-        }
-        break;
+        CANVAS_ERR("draw counts from a buffer need VK_KHR_draw_indirect_count\n");
+        CANVAS_RETURN_VOID();
     }
 
-    case WM_KEYDOWN:
-    case WM_SYSKEYDOWN:
+    vk_command_indirect(window_id, CANVAS_VK_CMD_DRAW_INDIRECT, args, offset, count, count_offset, max_draws, stride);
+    CANVAS_RETURN_VOID();
+}
+
+void canvas_draw_indexed_indirect_count(int window_id, canvas_buffer *args, size_t offset, canvas_buffer *count, size_t count_offset, uint32_t max_draws, uint32_t stride)
+{
+    CANVAS_ENTER_FUNC();
+
+    if (!vk_info.draw_indirect_count || !count)
     {
-        int scancode = (lParam >> 16) & 0xFF;
-        bool extended = (lParam >> 24) & 1;
+        CANVAS_ERR("draw counts from a buffer need VK_KHR_draw_indirect_count\n");
+        CANVAS_RETURN_VOID();
+    }
 
-        if (extended)
-        {
-            if (scancode == 0x1D)
-                scancode = 0xE01D;
-            else if (scancode == 0x38)
-                scancode = 0xE038;
-            else
-                scancode |= 0xE000;
-        }
+    vk_command_indirect(window_id, CANVAS_VK_CMD_DRAW_INDEXED_INDIRECT, args, offset, count, count_offset, max_draws, stride);
+    CANVAS_RETURN_VOID();
+}
 
-        int hid = 0;
-        if (scancode < 128)
-            hid = win32_to_hid[scancode];
-        else if (scancode == 0xE01D)
-            hid = 228;
-        else if (scancode == 0xE038)
-            hid = 230;
-        else if (scancode == 0xE05B)
-            hid = 227;
-        else if (scancode == 0xE05C)
-            hid = 231;
+// next quad of the window's batch, extends the last run when image and blend mode allow it
+static canvas_vk_quad *vk_batch_push(int window_id, canvas_image *image)
+{
+    if (window_id < 0 || window_id >= MAX_CANVAS || !canvas_info.canvas[window_id]._valid || !vk_windows[window_id].initialized)
+        return NULL;
 
-        if (hid > 0 && hid < 256 && !canvas_keyboard.keys[hid])
-        {
-            canvas_keyboard.keys[hid] = true;
-            canvas_keyboard.keys_pressed[hid] = true;
-        }
-        return 0;
-    }
+    canvas_vk_batch *batch = &vk_windows[window_id].batch;
 
-    case WM_KEYUP:
-    case WM_SYSKEYUP:
+    // built here rather than at record time, so the white image upload goes out with this frame
+    if (!vk_batch_prepare(window_id))
+        return NULL;
+
+    if (batch->quad_count == batch->quad_capacity)
     {
-        int scancode = (lParam >> 16) & 0xFF;
-        bool extended = (lParam >> 24) & 1;
+        uint32_t capacity = batch->quad_capacity ? batch->quad_capacity * 2 : 1024;
+        canvas_vk_quad *quads = (canvas_vk_quad *)realloc(batch->quads, capacity * sizeof(canvas_vk_quad));
+        if (!quads)
+            return NULL;
 
-        if (extended)
-        {
-            if (scancode == 0x1D)
-                scancode = 0xE01D;
-            else if (scancode == 0x38)
-                scancode = 0xE038;
-            else
-                scancode |= 0xE000;
-        }
+        batch->quads = quads;
+        batch->quad_capacity = capacity;
+    }
 
-        int hid = 0;
-        if (scancode < 128)
-            hid = win32_to_hid[scancode];
-        else if (scancode == 0xE01D)
-            hid = 228;
-        else if (scancode == 0xE038)
-            hid = 230;
-        else if (scancode == 0xE05B)
-            hid = 227;
-        else if (scancode == 0xE05C)
-            hid = 231;
+    VkBuffer vk_image = image ? (VkBuffer)image->pixels->platform_handle : VK_NULL_HANDLE;
+    canvas_vk_batch_run *last = batch->run_count ? &batch->runs[batch->run_count - 1] : NULL;
 
-        if (hid > 0 && hid < 256 && canvas_keyboard.keys[hid])
-        {
-            canvas_keyboard.keys[hid] = false;
-            canvas_keyboard.keys_released[hid] = true;
-        }
-        return 0;
+    if (last && last->blend == (uint32_t)batch->blend && (!vk_image || !last->image || last->image == vk_image))
+    {
+        if (!last->image)
+            last->image = vk_image;
     }
-
-    case WM_CLOSE:
+    else
     {
-        canvas_info.canvas[window_index].close = true;
-
-        if (canvas_info.os_timed)
+        if (batch->run_count == batch->run_capacity)
         {
-            KillTimer(hwnd, 1);
-            timeEndPeriod(1);
-            canvas_info.os_timed = false;
+            uint32_t capacity = batch->run_capacity ? batch->run_capacity * 2 : 64;
+            canvas_vk_batch_run *runs = (canvas_vk_batch_run *)realloc(batch->runs, capacity * sizeof(canvas_vk_batch_run));
+            if (!runs)
+                return NULL;
+            batch->runs = runs;
+
+            canvas_buffer_region *regions = (canvas_buffer_region *)realloc(batch->regions, capacity * sizeof(canvas_buffer_region));
+            if (!regions)
+                return NULL;
+            batch->regions = regions;
+
+            batch->run_capacity = capacity;
         }
 
-        return 0;
+        last = &batch->runs[batch->run_count++];
+        last->image = vk_image;
+        last->blend = (uint32_t)batch->blend;
+        last->first = batch->quad_count;
+        last->count = 0;
     }
 
-    case WM_DESTROY:
-        PostQuitMessage(0);
-    }
+    last->count++;
+    return &batch->quads[batch->quad_count++];
+}
 
-    return DefWindowProc(hwnd, msg, wParam, lParam);
+void canvas_rect(int window_id, float x, float y, float width, float height, const float color[4])
+{
+    canvas_vk_quad *quad = vk_batch_push(window_id, NULL);
+    if (!quad)
+        return;
+
+    quad->origin[0] = x;
+    quad->origin[1] = y;
+    quad->axis_x[0] = width;
+    quad->axis_x[1] = 0.0f;
+    quad->axis_y[0] = 0.0f;
+    quad->axis_y[1] = height;
+    quad->uv[0] = quad->uv[1] = quad->uv[2] = quad->uv[3] = -1.0f;
+    quad->color = _canvas_pack_color(color);
 }
 
-int _canvas_window(int64_t x, int64_t y, int64_t width, int64_t height, const char *title)
+void canvas_line(int window_id, float x0, float y0, float x1, float y1, float thickness, const float color[4])
 {
-    canvas_startup();
+    float dx = x1 - x0;
+    float dy = y1 - y0;
+    float length = sqrtf(dx * dx + dy * dy);
+    if (length <= 0.0f || thickness <= 0.0f)
+        return;
 
-    int window_id = _canvas_get_free();
-    if (window_id < 0)
-        return window_id;
+    canvas_vk_quad *quad = vk_batch_push(window_id, NULL);
+    if (!quad)
+        return;
 
-    DWORD style = WS_SYSMENU | WS_MINIMIZEBOX | WS_MAXIMIZEBOX | WS_THICKFRAME | WS_VISIBLE;
+    // the quad runs along the line, centered on it across its thickness
+    float nx = -dy / length * thickness;
+    float ny = dx / length * thickness;
+
+    quad->origin[0] = x0 - nx * 0.5f;
+    quad->origin[1] = y0 - ny * 0.5f;
+    quad->axis_x[0] = dx;
+    quad->axis_x[1] = dy;
+    quad->axis_y[0] = nx;
+    quad->axis_y[1] = ny;
+    quad->uv[0] = quad->uv[1] = quad->uv[2] = quad->uv[3] = -1.0f;
+    quad->color = _canvas_pack_color(color);
+}
 
-    canvas_info.canvas[window_id].index = window_id;
+void canvas_sprite(int window_id, canvas_image *image, float x, float y, float width, float height, const float uv[4], const float color[4])
+{
+    CANVAS_ASSERT_NOT_NULL(image);
+    if (!image)
+        return;
 
-    HWND window = CreateWindowA("CanvasWindowClass", title, style, x, y, width, height, NULL, NULL, canvas_win32.instance, NULL);
+    canvas_vk_quad *quad = vk_batch_push(window_id, image);
+    if (!quad)
+        return;
 
-    if (!window)
+    quad->origin[0] = x;
+    quad->origin[1] = y;
+    quad->axis_x[0] = width;
+    quad->axis_x[1] = 0.0f;
+    quad->axis_y[0] = 0.0f;
+    quad->axis_y[1] = height;
+
+    if (uv)
+        memcpy(quad->uv, uv, sizeof(quad->uv));
+    else
     {
-        CANVAS_ERR("create win32 window");
-        return CANVAS_ERR_GET_WINDOW;
+        quad->uv[0] = quad->uv[1] = 0.0f;
+        quad->uv[2] = quad->uv[3] = 1.0f;
     }
 
-    RAWINPUTDEVICE rid;
-    rid.usUsagePage = 0x01; // HID_USAGE_PAGE_GENERIC
-    rid.usUsage = 0x02;     // HID_USAGE_GENERIC_MOUSE
-    rid.dwFlags = 0;        // 0 = get input only when focused
-    rid.hwndTarget = window;
+    quad->color = _canvas_pack_color(color);
+}
 
-    if (!RegisterRawInputDevices(&rid, 1, sizeof(rid)))
-        CANVAS_WARN("failed to register raw input (error: %lu)\n", GetLastError());
+void canvas_blend(int window_id, canvas_blend_mode mode)
+{
+    CANVAS_ASSERT_RANGE(mode, CANVAS_BLEND_NONE, CANVAS_BLEND_ADDITIVE);
+    if (window_id < 0 || window_id >= MAX_CANVAS || mode < CANVAS_BLEND_NONE || mode > CANVAS_BLEND_ADDITIVE)
+        return;
 
-    canvas_info.canvas[window_id].window = window;
-    canvas_info.canvas[window_id].resize = false;
-    canvas_info.canvas[window_id].titlebar = false;
-    canvas_info.canvas[window_id].minimized = false;
-    canvas_info.canvas[window_id].maximized = false;
-    canvas_info.canvas[window_id].fullscreen = false;
-    canvas_info.canvas[window_id]._valid = true;
+    vk_windows[window_id].batch.blend = mode;
+}
 
-    return window_id;
+void canvas_batch_reorder(int window_id, bool allow)
+{
+    if (window_id < 0 || window_id >= MAX_CANVAS)
+        return;
+
+    vk_windows[window_id].batch.reorder = allow;
 }
 
-int _canvas_platform()
+canvas_readback *canvas_readback_request(int window_id)
 {
     CANVAS_ENTER_FUNC();
+    CANVAS_ASSERT_RANGE(window_id, 0, MAX_CANVAS - 1);
 
-    canvas_win32.instance = GetModuleHandle(NULL);
+    if (window_id < 0 || window_id >= MAX_CANVAS || !vk_windows[window_id].initialized)
+    {
+        CANVAS_RETURN_ERR(NULL, "window %d has no renderer to read back\n", window_id);
+    }
 
-    WNDCLASSA wc = {0};
-    wc.style = CS_HREDRAW | CS_VREDRAW | CS_DBLCLKS;
-    wc.lpfnWndProc = WndProc;
-    wc.hInstance = canvas_win32.instance;
-    wc.hCursor = LoadCursor(NULL, IDC_ARROW);
-    wc.hbrBackground = NULL;
-    wc.lpszClassName = "CanvasWindowClass";
+    canvas_vulkan_window *vk_win = &vk_windows[window_id];
+    canvas_format format;
 
-    canvas_win32.class = RegisterClassA(&wc);
+    if (!vk_win->readable || !vk_canvas_format(vk_win->swapchain_format, &format))
+    {
+        CANVAS_RETURN_ERR(NULL, "images of window %d can't be copied (format %d)\n", window_id, vk_win->swapchain_format);
+    }
 
-    if (!canvas_win32.class)
+    for (uint32_t i = 0; i < CANVAS_VK_READBACKS; i++)
     {
-        CANVAS_RETURN_ERR(CANVAS_ERR_GET_PLATFORM, "register windows class failed");
+        canvas_readback *readback = &vk_win->readbacks[i];
+        if (readback->_used)
+            continue;
+
+        readback->_used = true;
+        readback->window = window_id;
+        readback->format = format;
+        readback->frame = 0;
+        readback->pixels = NULL;
+        vk_win->readback_pending++;
+
+        CANVAS_RETURN(readback);
     }
 
-    CANVAS_RETURN(CANVAS_OK);
+    CANVAS_RETURN_ERR(NULL, "all %d readbacks of window %d are in use\n", CANVAS_VK_READBACKS, window_id);
 }
 
-int _canvas_update()
+bool canvas_readback_poll(canvas_readback *readback)
 {
     CANVAS_ENTER_FUNC();
+    CANVAS_ASSERT_NOT_NULL(readback);
 
-    canvas_pointer *p = canvas_get_primary_pointer(0);
+    if (!readback || !readback->_used)
+        CANVAS_RETURN(false);
 
-    POINT abs_screen_pt;
-    if (GetCursorPos(&abs_screen_pt))
-    {
-        HMONITOR monitor = MonitorFromPoint(abs_screen_pt, MONITOR_DEFAULTTONEAREST);
-        p->display = 0;
+    if (readback->pixels)
+        CANVAS_RETURN(true);
 
-        for (int d = 0; d < canvas_info.display_count; d++)
-        {
-            if (canvas_win32.monitors[d] == monitor)
-            {
-                p->display = d;
-                p->screen_x = abs_screen_pt.x - canvas_info.display[d].x;
-                p->screen_y = abs_screen_pt.y - canvas_info.display[d].y;
-                break;
-            }
-        }
+    canvas_vulkan_window *vk_win = &vk_windows[readback->window];
 
-        uint32_t old_buttons = p->buttons;
-        uint32_t new_buttons = 0;
+    // recorded into a frame that has not been submitted yet
+    if (readback->frame == 0 || readback->frame > vk_win->timeline_value)
+        CANVAS_RETURN(false);
 
-        if (GetAsyncKeyState(VK_LBUTTON) & 0x8000)
-            new_buttons |= CANVAS_BUTTON_LEFT;
-        if (GetAsyncKeyState(VK_RBUTTON) & 0x8000)
-            new_buttons |= CANVAS_BUTTON_RIGHT;
-        if (GetAsyncKeyState(VK_MBUTTON) & 0x8000)
-            new_buttons |= CANVAS_BUTTON_MIDDLE;
-        if (GetAsyncKeyState(VK_XBUTTON1) & 0x8000)
-            new_buttons |= CANVAS_BUTTON_X1;
-        if (GetAsyncKeyState(VK_XBUTTON2) & 0x8000)
-            new_buttons |= CANVAS_BUTTON_X2;
+    if (vk_timeline_completed(vk_win) < readback->frame)
+        CANVAS_RETURN(false);
 
-        p->buttons_pressed = new_buttons & ~old_buttons;
-        p->buttons_released = old_buttons & ~new_buttons;
-        p->buttons = new_buttons;
+    canvas_buffer *buf = readback->_buffer;
 
-        LARGE_INTEGER counter;
-        QueryPerformanceCounter(&counter);
-        double timestamp = (double)counter.QuadPart / (double)_canvas_qpc_frequency.QuadPart;
+    if (!(buf->memory_flags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT))
+    {
+        // cached memory still holds what the cpu saw before the copy
+        buf->_dirty_begin = 0;
+        buf->_dirty_end = buf->size;
+        VkMappedMemoryRange range = vk_dirty_range(buf);
+        buf->_dirty_begin = buf->_dirty_end = 0;
+        vk_info.vkInvalidateMappedMemoryRanges(vk_info.device, 1, &range);
+    }
 
-        p->_samples[p->_sample_index].x = p->screen_x;
-        p->_samples[p->_sample_index].y = p->screen_y;
-        p->_samples[p->_sample_index].time = timestamp;
-        p->_sample_index = (p->_sample_index + 1) % CANVAS_POINTER_SAMPLE_FRAMES;
+    readback->pixels = buf->mapped;
+    CANVAS_RETURN(true);
+}
 
-        HWND hwnd_at_point = WindowFromPoint(abs_screen_pt);
-        int active_window = -1;
-        bool found_window = false;
+int canvas_readback_wait(canvas_readback *readback, uint64_t timeout_ns)
+{
+    CANVAS_ENTER_FUNC();
+    CANVAS_ASSERT_NOT_NULL(readback);
 
-        for (int i = 0; i < MAX_CANVAS; i++)
-        {
-            if (!canvas_info.canvas[i]._valid || !canvas_info.canvas[i].window)
-                continue;
+    if (!readback || !readback->_used)
+        CANVAS_RETURN(CANVAS_INVALID);
 
-            HWND hwnd = (HWND)canvas_info.canvas[i].window;
+    canvas_vulkan_window *vk_win = &vk_windows[readback->window];
 
-            if (hwnd == hwnd_at_point || IsChild(hwnd, hwnd_at_point))
-            {
-                active_window = i;
-                found_window = true;
+    // the frame is drawn by the main loop on this thread, waiting for it here would never end
+    if (readback->frame == 0 || readback->frame > vk_win->timeline_value)
+        CANVAS_RETURN(CANVAS_INVALID);
 
-                POINT client_pt = abs_screen_pt;
-                ScreenToClient(hwnd, &client_pt);
+    if (canvas_readback_poll(readback))
+        CANVAS_RETURN(CANVAS_OK);
 
-                p->window_id = i;
-                p->inside_window = true;
-                p->x = client_pt.x;
-                p->y = client_pt.y;
+    VkResult result = vk_timeline_wait(vk_win, readback->frame, timeout_ns);
 
-                break;
-            }
-        }
+    if (result != VK_SUCCESS || !canvas_readback_poll(readback))
+        CANVAS_RETURN(CANVAS_FAIL);
 
-        if (!found_window)
-        {
-            p->inside_window = false;
-            p->x = 0;
-            p->y = 0;
-        }
-    }
+    CANVAS_RETURN(CANVAS_OK);
+}
 
-    MSG msg;
-    while (PeekMessage(&msg, NULL, 0, 0, PM_REMOVE))
+void canvas_readback_release(canvas_readback *readback)
+{
+    CANVAS_ENTER_FUNC();
+
+    if (!readback || !readback->_used)
     {
-        TranslateMessage(&msg);
-        DispatchMessage(&msg);
+        CANVAS_RETURN_VOID();
     }
 
-    if (canvas_win32.device)
+    // a copy that was never recorded is dropped, one in flight writes into the kept buffer harmlessly
+    if (readback->frame == 0)
+        vk_windows[readback->window].readback_pending--;
+
+    readback->_used = false;
+    readback->frame = 0;
+    readback->pixels = NULL;
+    CANVAS_RETURN_VOID();
+}
+
+void canvas_buffer_destroy(canvas_buffer *buf)
+{
+    CANVAS_ENTER_FUNC();
+
+    if (!buf)
     {
-        for (int i = 0; i < MAX_CANVAS; ++i)
-        {
-            if (canvas_info.canvas[i].resize)
-            {
-                _canvas_window_resize(i);
-            }
-        }
+        CANVAS_RETURN_VOID();
+    }
 
-        canvas_win32.cmdAllocator->lpVtbl->Reset(canvas_win32.cmdAllocator);
-        canvas_win32.cmdList->lpVtbl->Reset(canvas_win32.cmdList, canvas_win32.cmdAllocator, NULL);
+    CANVAS_ASSERT_NOT_NULL(vk_info.device);
+    CANVAS_ASSERT_NOT_NULL(vk_info.vkDestroyBuffer);
+    CANVAS_ASSERT_NOT_NULL(vk_info.vkFreeMemory);
+    CANVAS_ASSERT(buf->size > 0);
+    CANVAS_ASSERT_RANGE(buf->type, CANVAS_BUFFER_VERTEX, CANVAS_BUFFER_INDIRECT);
 
-        for (int i = 0; i < MAX_CANVAS; ++i)
-        {
-            if (canvas_info.canvas[i].window == NULL ||
-                _canvas_data[i].swapChain == NULL ||
-                _canvas_data[i].backBuffers[0] == NULL)
-                continue;
+    VkBuffer vk_buffer = (VkBuffer)buf->platform_handle;
+    CANVAS_ASSERT_NOT_NULL(vk_buffer);
 
-            UINT backBufferIndex = _canvas_data[i].swapChain->lpVtbl->GetCurrentBackBufferIndex(_canvas_data[i].swapChain);
+    // a queued copy still targets this buffer
+    if (buf->upload)
+        vk_upload_wait_token(buf->upload, UINT64_MAX);
 
-            D3D12_RESOURCE_BARRIER barrier = {0};
-            barrier.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
-            barrier.Transition.pResource = _canvas_data[i].backBuffers[backBufferIndex];
-            barrier.Transition.StateBefore = D3D12_RESOURCE_STATE_PRESENT;
-            barrier.Transition.StateAfter = D3D12_RESOURCE_STATE_RENDER_TARGET;
-            barrier.Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
-            canvas_win32.cmdList->lpVtbl->ResourceBarrier(canvas_win32.cmdList, 1, &barrier);
+    vk_forget_dirty(buf);
 
-            canvas_win32.cmdList->lpVtbl->ClearRenderTargetView(canvas_win32.cmdList, _canvas_data[i].rtvHandles[backBufferIndex], canvas_info.canvas[i].clear, 0, NULL);
+    VkMemoryRequirements mem_reqs;
+    vk_info.vkGetBufferMemoryRequirements(vk_info.device, vk_buffer, &mem_reqs);
 
-            barrier.Transition.StateBefore = D3D12_RESOURCE_STATE_RENDER_TARGET;
-            barrier.Transition.StateAfter = D3D12_RESOURCE_STATE_PRESENT;
-            canvas_win32.cmdList->lpVtbl->ResourceBarrier(canvas_win32.cmdList, 1, &barrier);
-        }
+    vk_forget_recordings();
 
-        canvas_win32.cmdList->lpVtbl->Close(canvas_win32.cmdList);
-        ID3D12CommandList *cmdLists[] = {(ID3D12CommandList *)canvas_win32.cmdList};
-        canvas_win32.cmdQueue->lpVtbl->ExecuteCommandLists(canvas_win32.cmdQueue, 1, cmdLists);
+    canvas_vk_dead_buffer dead = {0};
+    dead.buffer = vk_buffer;
+    dead.memory = (VkDeviceMemory)buf->memory;
+    dead.block = buf->_block;
+    dead.node = buf->_node;
+    dead.mapped = buf->mapped != NULL;
+    dead.requested = vk_buffer_bytes(buf);
+    dead.size = mem_reqs.size;
+    dead.retire_frame = vk_windows[buf->window_id].timeline_value;
 
-        for (int i = 0; i < MAX_CANVAS; ++i)
+    // frames already submitted may still read it, the range is reused once they are done
+    canvas_vulkan_window *vk_win = &vk_windows[buf->window_id];
+    bool queued = false;
+    if (vk_win->initialized)
+    {
+        if (vk_win->dead_buffer_count == vk_win->dead_buffer_capacity)
         {
-            if (_canvas_data[i].swapChain != NULL)
+            uint32_t capacity = vk_win->dead_buffer_capacity ? vk_win->dead_buffer_capacity * 2 : 16;
+            canvas_vk_dead_buffer *grown = (canvas_vk_dead_buffer *)realloc(vk_win->dead_buffers, capacity * sizeof(canvas_vk_dead_buffer));
+            if (grown)
             {
-                if (canvas_info.canvas[i].vsync)
-                {
-                    _canvas_data[i].swapChain->lpVtbl->Present(_canvas_data[i].swapChain, 1, 0);
-                }
-                else
-                {
-                    _canvas_data[i].swapChain->lpVtbl->Present(_canvas_data[i].swapChain, 0, DXGI_PRESENT_ALLOW_TEARING);
-                }
+                vk_win->dead_buffers = grown;
+                vk_win->dead_buffer_capacity = capacity;
             }
         }
 
-        canvas_win32.fence_value++;
-        canvas_win32.cmdQueue->lpVtbl->Signal(canvas_win32.cmdQueue, canvas_win32.fence, canvas_win32.fence_value);
-        if (canvas_win32.fence->lpVtbl->GetCompletedValue(canvas_win32.fence) < canvas_win32.fence_value)
+        if (vk_win->dead_buffer_count < vk_win->dead_buffer_capacity)
         {
-            canvas_win32.fence->lpVtbl->SetEventOnCompletion(canvas_win32.fence, canvas_win32.fence_value, canvas_win32.fence_event);
-            WaitForSingleObject(canvas_win32.fence_event, INFINITE);
+            vk_win->dead_buffers[vk_win->dead_buffer_count++] = dead;
+            queued = true;
         }
     }
 
-    CANVAS_RETURN(CANVAS_OK);
+    if (!queued)
+    {
+        // a closed window has no frames left, without room in the queue wait for the window instead
+        if (vk_win->initialized)
+            canvas_frame_wait(buf->window_id, vk_win->timeline_value, UINT64_MAX);
+
+        vk_info.vkDestroyBuffer(vk_info.device, vk_buffer, NULL);
+        vk_memory_free(dead.memory, dead.block, dead.node, dead.mapped, dead.requested, dead.size);
+    }
+
+    free(buf);
+    CANVAS_RETURN_VOID();
 }
 
-int _canvas_gpu_init()
+int canvas_frame_wait(int window_id, uint64_t frame, uint64_t timeout_ns)
 {
     CANVAS_ENTER_FUNC();
+    CANVAS_VALID(window_id);
 
-    if (canvas_info.init_gpu)
-    {
-        CANVAS_RETURN(CANVAS_OK);
-    }
+    canvas_vulkan_window *vk_win = &vk_windows[window_id];
 
-    canvas_info.init_gpu = 1;
+    if (!vk_win->initialized || frame > vk_win->timeline_value)
+        CANVAS_RETURN(CANVAS_INVALID);
 
-    HRESULT result;
+    VkResult result = vk_timeline_wait(vk_win, frame, timeout_ns);
 
-    result = CreateDXGIFactory1(&IID_IDXGIFactory4, (void **)&canvas_win32.factory);
-    if (FAILED(result))
-    {
-        CANVAS_ERR("create dx12 factory failed (HRESULT: 0x%08lX)\n", result);
-        return CANVAS_ERR_GET_GPU;
-    }
+    CANVAS_RETURN(result == VK_SUCCESS ? CANVAS_OK : CANVAS_FAIL);
+}
 
-    result = D3D12CreateDevice(NULL, D3D_FEATURE_LEVEL_11_0, &IID_ID3D12Device, (void **)&canvas_win32.device);
-    if (FAILED(result))
-    {
-        CANVAS_ERR("create dx12 device failed (HRESULT: 0x%08lX)\n", result);
-        canvas_win32.factory->lpVtbl->Release(canvas_win32.factory);
-        canvas_win32.factory = NULL;
-        return CANVAS_ERR_GET_GPU;
-    }
+static void vk_cleanup_window(int window_id)
+{
+    CANVAS_ENTER_FUNC();
+    CANVAS_ASSERT_RANGE(window_id, 0, MAX_CANVAS - 1);
 
-    D3D12_COMMAND_QUEUE_DESC queueDesc = {0};
-    queueDesc.Type = D3D12_COMMAND_LIST_TYPE_DIRECT;
+    canvas_vulkan_window *vk_win = &vk_windows[window_id];
 
-    result = canvas_win32.device->lpVtbl->CreateCommandQueue(canvas_win32.device, &queueDesc, &IID_ID3D12CommandQueue, (void **)&canvas_win32.cmdQueue);
-    if (FAILED(result))
+    if (!vk_win->initialized)
+        CANVAS_RETURN_VOID();
+
+    CANVAS_ASSERT_NOT_NULL(vk_info.device);
+
+    vk_info.vkDeviceWaitIdle(vk_info.device);
+
+    if (vk_win->depth_view)
     {
-        CANVAS_ERR("create command queue failed (HRESULT: 0x%08lX)\n", result);
-        goto cleanup_gpu;
+        vk_info.vkDestroyImageView(vk_info.device, vk_win->depth_view, NULL);
+        vk_win->depth_view = VK_NULL_HANDLE;
     }
-
-    result = canvas_win32.device->lpVtbl->CreateCommandAllocator(canvas_win32.device, D3D12_COMMAND_LIST_TYPE_DIRECT, &IID_ID3D12CommandAllocator, (void **)&canvas_win32.cmdAllocator);
-    if (FAILED(result))
+    if (vk_win->depth_image)
     {
-        CANVAS_ERR("create command allocator failed (HRESULT: 0x%08lX)\n", result);
-        goto cleanup_gpu;
+        vk_info.vkDestroyImage(vk_info.device, vk_win->depth_image, NULL);
+        vk_win->depth_image = VK_NULL_HANDLE;
     }
-
-    result = canvas_win32.device->lpVtbl->CreateCommandList(canvas_win32.device, 0, D3D12_COMMAND_LIST_TYPE_DIRECT, canvas_win32.cmdAllocator, NULL, &IID_ID3D12GraphicsCommandList, (void **)&canvas_win32.cmdList);
-    if (FAILED(result))
+    if (vk_win->depth_memory)
     {
-        CANVAS_ERR("create command list failed (HRESULT: 0x%08lX)\n", result);
-        goto cleanup_gpu;
+        vk_info.vkFreeMemory(vk_info.device, vk_win->depth_memory, NULL);
+        vk_win->depth_memory = VK_NULL_HANDLE;
     }
 
-    canvas_win32.cmdList->lpVtbl->Close(canvas_win32.cmdList);
-
-    D3D12_DESCRIPTOR_HEAP_DESC heapDesc = {0};
-    heapDesc.NumDescriptors = MAX_CANVAS * 2;
-    heapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_RTV;
-
-    result = canvas_win32.device->lpVtbl->CreateDescriptorHeap(canvas_win32.device, &heapDesc, &IID_ID3D12DescriptorHeap, (void **)&canvas_win32.rtvHeap);
-    if (FAILED(result))
+    for (uint32_t i = 0; i < MAX_SWAPCHAIN_IMAGES; i++)
     {
-        CANVAS_ERR("create descriptor heap failed (HRESULT: 0x%08lX)\n", result);
-        goto cleanup_gpu;
+        if (vk_win->image_available_semaphores[i])
+            vk_info.vkDestroySemaphore(vk_info.device, vk_win->image_available_semaphores[i], NULL);
+
+        if (vk_win->render_finished_semaphores[i])
+            vk_info.vkDestroySemaphore(vk_info.device, vk_win->render_finished_semaphores[i], NULL);
     }
 
-    canvas_win32.rtvDescriptorSize = canvas_win32.device->lpVtbl->GetDescriptorHandleIncrementSize(canvas_win32.device, D3D12_DESCRIPTOR_HEAP_TYPE_RTV);
+    vk_collect_retired(window_id, true);
+    vk_cleanup_swapchain(window_id);
 
-    result = canvas_win32.device->lpVtbl->CreateFence(canvas_win32.device, 0, D3D12_FENCE_FLAG_NONE, &IID_ID3D12Fence, (void **)&canvas_win32.fence);
-    if (FAILED(result))
+    for (uint32_t i = 0; i < MAX_SWAPCHAIN_IMAGES; i++)
     {
-        CANVAS_ERR("create fence failed (HRESULT: 0x%08lX)\n", result);
-        goto cleanup_gpu;
+        if (!vk_win->offscreen_memory[i])
+            continue;
+
+        vk_info.vkDestroyImage(vk_info.device, vk_win->swapchain_images[i], NULL);
+        vk_info.vkFreeMemory(vk_info.device, vk_win->offscreen_memory[i], NULL);
     }
 
-    canvas_win32.fence_event = CreateEvent(NULL, FALSE, FALSE, NULL);
-    if (!canvas_win32.fence_event)
+    for (uint32_t i = 0; i < MAX_SWAPCHAIN_IMAGES; i++)
     {
-        CANVAS_ERR("create fence event failed (GetLastError: %lu)\n", GetLastError());
-        goto cleanup_gpu;
+        if (vk_win->descriptor_pools[i])
+            vk_info.vkDestroyDescriptorPool(vk_info.device, vk_win->descriptor_pools[i], NULL);
     }
 
-    return CANVAS_OK;
+    free(vk_win->commands);
+    for (uint32_t i = 0; i < MAX_SWAPCHAIN_IMAGES; i++)
+        free(vk_win->recorded[i]);
 
-cleanup_gpu:
-    if (canvas_win32.fence)
-    {
-        canvas_win32.fence->lpVtbl->Release(canvas_win32.fence);
-        canvas_win32.fence = NULL;
-    }
-    if (canvas_win32.rtvHeap)
-    {
-        canvas_win32.rtvHeap->lpVtbl->Release(canvas_win32.rtvHeap);
-        canvas_win32.rtvHeap = NULL;
-    }
-    if (canvas_win32.cmdList)
+    for (uint32_t i = 0; i < CANVAS_VK_READBACKS; i++)
+        canvas_buffer_destroy(vk_win->readbacks[i]._buffer);
+
+    canvas_vk_batch *batch = &vk_win->batch;
+    free(batch->quads);
+    free(batch->runs);
+    free(batch->regions);
+    canvas_buffer_destroy(batch->ring);
+    canvas_image_destroy(batch->white);
+    for (int i = 0; i <= CANVAS_BLEND_ADDITIVE; i++)
+        canvas_pipeline_destroy(batch->pipelines[i]);
+
+    // the device is idle, buffers destroyed while the window was open go now
+    vk_collect_buffers(window_id, true);
+    free(vk_win->dead_buffers);
+
+    if (vk_win->timeline)
+        vk_info.vkDestroySemaphore(vk_info.device, vk_win->timeline, NULL);
+
+    for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
     {
-        canvas_win32.cmdList->lpVtbl->Release(canvas_win32.cmdList);
-        canvas_win32.cmdList = NULL;
+        if (vk_win->frame_fences[i])
+            vk_info.vkDestroyFence(vk_info.device, vk_win->frame_fences[i], NULL);
     }
-    if (canvas_win32.cmdAllocator)
+
+    if (vk_win->command_pool)
+        vk_info.vkDestroyCommandPool(vk_info.device, vk_win->command_pool, NULL);
+
+    if (vk_win->render_pass)
+        vk_info.vkDestroyRenderPass(vk_info.device, vk_win->render_pass, NULL);
+
+    if (vk_win->surface)
+        vk_info.vkDestroySurfaceKHR(vk_info.instance, vk_win->surface, NULL);
+
+    memset(vk_win, 0, sizeof(canvas_vulkan_window));
+    CANVAS_RETURN_VOID();
+}
+
+static void vk_cleanup(void)
+{
+    CANVAS_ENTER_FUNC();
+
+    if (!vk_info.instance)
+        CANVAS_RETURN_VOID();
+
+    if (vk_info.device)
+        vk_info.vkDeviceWaitIdle(vk_info.device);
+
+    for (int i = 0; i < MAX_CANVAS; i++)
+        vk_cleanup_window(i);
+
+    if (vk_info.device)
     {
-        canvas_win32.cmdAllocator->lpVtbl->Release(canvas_win32.cmdAllocator);
-        canvas_win32.cmdAllocator = NULL;
+        vk_upload_cleanup();
+        vk_compute_cleanup();
+        vk_pipelines_cleanup();
+
+        if (vk_info.storage_set_layout)
+            vk_info.vkDestroyDescriptorSetLayout(vk_info.device, vk_info.storage_set_layout, NULL);
+        vk_info.storage_set_layout = VK_NULL_HANDLE;
+
+        free(vk_dirty.buffers);
+        memset(&vk_dirty, 0, sizeof(vk_dirty));
+
+        for (int i = 0; i < CANVAS_VK_MAX_BLOCKS; i++)
+        {
+            if (vk_blocks[i].memory)
+                vk_block_destroy(i);
+        }
+
+        vk_info.vkDestroyDevice(vk_info.device, NULL);
+        vk_info.device = VK_NULL_HANDLE;
     }
-    if (canvas_win32.cmdQueue)
+
+    if (vk_info.validation_enabled && vk_info.debug_messenger && vk_info.vkDestroyDebugUtilsMessengerEXT)
     {
-        canvas_win32.cmdQueue->lpVtbl->Release(canvas_win32.cmdQueue);
-        canvas_win32.cmdQueue = NULL;
+        vk_info.vkDestroyDebugUtilsMessengerEXT(vk_info.instance, vk_info.debug_messenger, NULL);
+        vk_info.debug_messenger = VK_NULL_HANDLE;
     }
-    if (canvas_win32.device)
+
+    if (vk_info.instance)
     {
-        canvas_win32.device->lpVtbl->Release(canvas_win32.device);
-        canvas_win32.device = NULL;
+        vk_info.vkDestroyInstance(vk_info.instance, NULL);
+        vk_info.instance = VK_NULL_HANDLE;
     }
-    if (canvas_win32.factory)
+
+    if (vk_info.library)
     {
-        canvas_win32.factory->lpVtbl->Release(canvas_win32.factory);
-        canvas_win32.factory = NULL;
+        canvas_library_close(vk_info.library);
+        vk_info.library = NULL;
     }
 
-    canvas_info.init_gpu = 0;
-    CANVAS_RETURN(CANVAS_ERR_GET_GPU);
+    CANVAS_INFO("vulkan cleaned up\n");
+    CANVAS_RETURN_VOID();
 }
 
-int _canvas_gpu_new_window(int window_id)
+#endif // CANVAS_VULKAN
+
+//
+//
+//
+#if defined(__APPLE__)
+
+int canvas_minimize(int window_id)
 {
     CANVAS_ENTER_FUNC();
-    CANVAS_BOUNDS(window_id);
+    CANVAS_VALID(window_id);
 
-    _canvas_data[window_id] = (canvas_data){0};
+    objc_id window = canvas_info.canvas[window_id].window;
+    if (!window)
+    {
+        CANVAS_RETURN_ERR(CANVAS_ERR_GET_WINDOW, "no window to minimize: %d\n", window_id);
+    }
 
-    HWND window = (HWND)canvas_info.canvas[window_id].window;
+    msg_void_id(window, sel_c("miniaturize:"), NULL);
 
-    RECT rect;
-    GetClientRect(window, &rect);
+    canvas_info.canvas[window_id].minimized = true;
+    canvas_info.canvas[window_id].maximized = false;
 
-    DXGI_SWAP_CHAIN_DESC1 scDesc = {0};
-    scDesc.Width = rect.right - rect.left;
-    scDesc.Height = rect.bottom - rect.top;
-    scDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
-    scDesc.SampleDesc.Count = 1;
-    scDesc.BufferUsage = DXGI_USAGE_RENDER_TARGET_OUTPUT;
-    scDesc.BufferCount = 2;
-    scDesc.SwapEffect = DXGI_SWAP_EFFECT_FLIP_DISCARD;
-    scDesc.Flags = DXGI_SWAP_CHAIN_FLAG_ALLOW_TEARING;
-    scDesc.Scaling = DXGI_SCALING_STRETCH;
-    scDesc.AlphaMode = DXGI_ALPHA_MODE_IGNORE;
+    CANVAS_RETURN(CANVAS_OK);
+}
 
-    IDXGISwapChain1 *swapChain1;
-    HRESULT result = canvas_win32.factory->lpVtbl->CreateSwapChainForHwnd(
-        canvas_win32.factory,
-        (IUnknown *)canvas_win32.cmdQueue,
-        window,
-        &scDesc,
-        NULL,
-        NULL,
-        &swapChain1);
+int canvas_maximize(int window_id)
+{
+    CANVAS_ENTER_FUNC();
+    CANVAS_VALID(window_id);
 
-    if (FAILED(result))
+    objc_id window = canvas_info.canvas[window_id].window;
+    if (!window)
     {
-        CANVAS_ERR("create swapchain for hwnd\n");
-        return CANVAS_ERR_GET_GPU;
+        CANVAS_RETURN_ERR(CANVAS_ERR_GET_WINDOW, "no window to maximize: %d\n", window_id);
     }
 
-    result = swapChain1->lpVtbl->QueryInterface(
-        swapChain1,
-        &IID_IDXGISwapChain3,
-        (void **)&_canvas_data[window_id].swapChain);
-    swapChain1->lpVtbl->Release(swapChain1);
+    bool is_zoomed = msg_bool(window, "isZoomed");
 
-    if (FAILED(result))
+    if (!is_zoomed)
     {
-        CANVAS_RETURN_ERR(CANVAS_ERR_GET_GPU, "query swapchain interface\n");
+        msg_void_id(window, sel_c("zoom:"), NULL);
+        canvas_info.canvas[window_id].maximized = true;
     }
 
-    canvas_win32.factory->lpVtbl->MakeWindowAssociation(
-        canvas_win32.factory,
-        window,
-        DXGI_MWA_NO_ALT_ENTER);
+    canvas_info.canvas[window_id].minimized = false;
 
-    D3D12_CPU_DESCRIPTOR_HANDLE rtvHandle;
-    canvas_win32.rtvHeap->lpVtbl->GetCPUDescriptorHandleForHeapStart(canvas_win32.rtvHeap, &rtvHandle);
+    CANVAS_RETURN(CANVAS_OK);
+}
 
-    rtvHandle.ptr += window_id * 2 * canvas_win32.rtvDescriptorSize;
+int canvas_restore(int window_id)
+{
+    CANVAS_ENTER_FUNC();
+    CANVAS_VALID(window_id);
 
-    for (int i = 0; i < 2; i++)
+    objc_id window = canvas_info.canvas[window_id].window;
+    if (!window)
     {
-        result = _canvas_data[window_id].swapChain->lpVtbl->GetBuffer(
-            _canvas_data[window_id].swapChain,
-            i,
-            &IID_ID3D12Resource,
-            (void **)&_canvas_data[window_id].backBuffers[i]);
-
-        if (FAILED(result))
-        {
-            CANVAS_RETURN_ERR(CANVAS_ERR_GET_GPU, "get swapchain buffer %d\n", i);
-        }
-
-        _canvas_data[window_id].rtvHandles[i] = rtvHandle;
-        canvas_win32.device->lpVtbl->CreateRenderTargetView(
-            canvas_win32.device,
-            _canvas_data[window_id].backBuffers[i],
-            NULL,
-            rtvHandle);
-        rtvHandle.ptr += canvas_win32.rtvDescriptorSize;
+        CANVAS_RETURN_ERR(CANVAS_ERR_GET_WINDOW, "no window to restore: %d\n", window_id);
     }
 
-    // Create depth stencil texture
-    D3D12_HEAP_PROPERTIES depthHeapProps = {0};
-    depthHeapProps.Type = D3D12_HEAP_TYPE_DEFAULT;
+    if (canvas_info.canvas[window_id].minimized)
+    {
+        msg_void_id(window, sel_c("deminiaturize:"), NULL);
+    }
+    else if (canvas_info.canvas[window_id].maximized)
+    {
+        msg_void_id(window, sel_c("zoom:"), NULL);
+    }
+    else if (canvas_info.canvas[window_id].fullscreen)
+    {
+        msg_void_id(window, sel_c("toggleFullScreen:"), NULL);
+    }
 
-    D3D12_RESOURCE_DESC depthDesc = {0};
-    depthDesc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
-    depthDesc.Width = rect.right - rect.left;
-    depthDesc.Height = rect.bottom - rect.top;
-    depthDesc.DepthOrArraySize = 1;
-    depthDesc.MipLevels = 1;
-    depthDesc.Format = DXGI_FORMAT_D32_FLOAT;
-    depthDesc.SampleDesc.Count = 1;
-    depthDesc.Flags = D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL;
+    canvas_info.canvas[window_id].minimized = false;
+    canvas_info.canvas[window_id].maximized = false;
+    canvas_info.canvas[window_id].fullscreen = false;
 
-    D3D12_CLEAR_VALUE depthClearValue = {0};
-    depthClearValue.Format = DXGI_FORMAT_D32_FLOAT;
-    depthClearValue.DepthStencil.Depth = 1.0f;
+    CANVAS_RETURN(CANVAS_OK);
+}
 
-    ID3D12Resource *depthTexture;
-    result = canvas_win32.device->lpVtbl->CreateCommittedResource(
-        canvas_win32.device,
-        &depthHeapProps,
-        D3D12_HEAP_FLAG_NONE,
-        &depthDesc,
-        D3D12_RESOURCE_STATE_DEPTH_WRITE,
-        &depthClearValue,
-        &IID_ID3D12Resource,
-        (void **)&depthTexture);
+int canvas_fullscreen(int window_id)
+{
+    CANVAS_ENTER_FUNC();
+    CANVAS_VALID(window_id);
 
-    if (FAILED(result))
+    objc_id window = canvas_info.canvas[window_id].window;
+    if (!window)
     {
-        CANVAS_RETURN_ERR(CANVAS_ERR_GET_GPU, "failed to create depth texture (HRESULT: 0x%08lX)\n", result);
+        CANVAS_RETURN_ERR(CANVAS_ERR_GET_WINDOW, "no window for fullscreen: %d\n", window_id);
     }
 
-    canvas_info.canvas[window_id].depth_texture = depthTexture;
+    unsigned long style_mask = msg_ulong(window, "styleMask");
+    bool is_fullscreen = (style_mask & (1 << 14)) != 0; // NSWindowStyleMaskFullScreen
+
+    if (!is_fullscreen)
+    {
+        _CGRect frame = msg_rect(window, "frame");
+        _canvas_data[window_id].saved_x = (int)frame.x;
+        _canvas_data[window_id].saved_y = (int)frame.y;
+        _canvas_data[window_id].saved_width = (int)frame.w;
+        _canvas_data[window_id].saved_height = (int)frame.h;
+        _canvas_data[window_id].saved_style_mask = style_mask;
+
+        msg_void_id(window, sel_c("toggleFullScreen:"), NULL);
+        canvas_info.canvas[window_id].fullscreen = true;
+    }
+
+    canvas_info.canvas[window_id].minimized = false;
+    canvas_info.canvas[window_id].maximized = false;
 
     CANVAS_RETURN(CANVAS_OK);
 }
 
-int _canvas_window_resize(int window_id)
+static objc_id _canvas_get_ns_cursor(canvas_cursor_type cursor)
 {
     CANVAS_ENTER_FUNC();
-    CANVAS_BOUNDS(window_id);
 
-    canvas_data *window = &_canvas_data[window_id];
+    if (cursor < 0 || cursor >= sizeof(_cursor_selector_names) / sizeof(_cursor_selector_names[0]))
+        cursor = CANVAS_CURSOR_ARROW;
 
-    if (!window->swapChain || !canvas_info.canvas[window_id].resize)
-    {
-        canvas_info.canvas[window_id].resize = false;
-        CANVAS_RETURN(CANVAS_OK);
-    }
+    const char *selector = _cursor_selector_names[cursor];
 
-    canvas_info.canvas[window_id].resize = false;
+    if (!selector)
+        selector = "arrowCursor";
 
-    canvas_win32.fence_value++;
-    canvas_win32.cmdQueue->lpVtbl->Signal(canvas_win32.cmdQueue, canvas_win32.fence, canvas_win32.fence_value);
-    if (canvas_win32.fence->lpVtbl->GetCompletedValue(canvas_win32.fence) < canvas_win32.fence_value)
-    {
-        canvas_win32.fence->lpVtbl->SetEventOnCompletion(canvas_win32.fence, canvas_win32.fence_value, canvas_win32.fence_event);
-        WaitForSingleObject(canvas_win32.fence_event, INFINITE);
-    }
+    objc_id result = msg_id(cls("NSCursor"), selector);
+    CANVAS_RETURN(result);
+}
 
-    RECT rect;
-    GetClientRect((HWND)canvas_info.canvas[window_id].window, &rect);
-    UINT width = rect.right - rect.left;
-    UINT height = rect.bottom - rect.top;
+int canvas_cursor(int window_id, canvas_cursor_type cursor)
+{
+    CANVAS_ENTER_FUNC();
+    CANVAS_VALID(window_id);
 
-    if (width == 0 || height == 0)
+    canvas_info.canvas[window_id].cursor = cursor;
+
+    objc_id ns_cursor = _canvas_get_ns_cursor(cursor);
+    if (ns_cursor)
+        msg_void(ns_cursor, "set");
+
+    CANVAS_RETURN(CANVAS_OK);
+}
+
+int _canvas_close(int window_id)
+{
+    CANVAS_ENTER_FUNC();
+    CANVAS_BOUNDS(window_id);
+
+    objc_id window = canvas_info.canvas[window_id].window;
+    if (!window)
     {
-        CANVAS_RETURN(CANVAS_OK);
+        CANVAS_RETURN_ERR(CANVAS_ERR_GET_WINDOW, "no window to close: %d\n", window_id);
     }
 
-    for (int i = 0; i < 2; i++)
+    for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
     {
-        if (window->backBuffers[i])
+        objc_id cmd = _canvas_data[window_id].frame_command_buffers[i];
+        if (cmd)
         {
-            window->backBuffers[i]->lpVtbl->Release(window->backBuffers[i]);
-            window->backBuffers[i] = NULL;
+            msg_void(cmd, "waitUntilCompleted");
+            msg_void(cmd, "release");
+            _canvas_data[window_id].frame_command_buffers[i] = NULL;
         }
     }
 
-    HRESULT hr = window->swapChain->lpVtbl->ResizeBuffers(
-        window->swapChain, 2, width, height,
-        DXGI_FORMAT_UNKNOWN,
-        DXGI_SWAP_CHAIN_FLAG_ALLOW_TEARING);
-
-    if (FAILED(hr))
+    if (_canvas_data[window_id].layer)
     {
-        CANVAS_RETURN_ERR(CANVAS_ERR_GET_GPU, "resize swapchain buffers\n");
+        msg_void(_canvas_data[window_id].layer, "release");
     }
 
-    D3D12_CPU_DESCRIPTOR_HANDLE rtvHandle;
-    canvas_win32.rtvHeap->lpVtbl->GetCPUDescriptorHandleForHeapStart(canvas_win32.rtvHeap, &rtvHandle);
-    rtvHandle.ptr += window_id * 2 * canvas_win32.rtvDescriptorSize;
+    _canvas_data[window_id].layer = NULL;
+    _canvas_data[window_id].view = NULL;
+    _canvas_data[window_id].scale = 0.0;
 
-    for (int i = 0; i < 2; i++)
-    {
-        hr = window->swapChain->lpVtbl->GetBuffer(
-            window->swapChain, i, &IID_ID3D12Resource,
-            (void **)&window->backBuffers[i]);
+    msg_void(window, "close");
+    msg_void(window, "release");
 
-        if (FAILED(hr))
-        {
-            CANVAS_RETURN_ERR(CANVAS_ERR_GET_GPU, "get resized buffer %d\n", i);
-        }
+    CANVAS_RETURN(CANVAS_OK);
+}
 
-        window->rtvHandles[i] = rtvHandle;
-        canvas_win32.device->lpVtbl->CreateRenderTargetView(
-            canvas_win32.device, window->backBuffers[i], NULL, rtvHandle);
-        rtvHandle.ptr += canvas_win32.rtvDescriptorSize;
-    }
+int _canvas_set(int window_id, int display, int64_t x, int64_t y, int64_t width, int64_t height, const char *title)
+{
+    CANVAS_ENTER_FUNC();
+    CANVAS_BOUNDS(window_id);
 
-    if (canvas_info.canvas[window_id].depth_texture)
+    objc_id window = canvas_info.canvas[window_id].window;
+    if (!window)
     {
-        ID3D12Resource *old_depth = (ID3D12Resource *)canvas_info.canvas[window_id].depth_texture;
-        old_depth->lpVtbl->Release(old_depth);
-        canvas_info.canvas[window_id].depth_texture = NULL;
+        CANVAS_RETURN_ERR(CANVAS_ERR_GET_WINDOW, "no window to set: %d\n", window_id);
     }
 
-    D3D12_HEAP_PROPERTIES depthHeapProps = {0};
-    depthHeapProps.Type = D3D12_HEAP_TYPE_DEFAULT;
-
-    D3D12_RESOURCE_DESC depthDesc = {0};
-    depthDesc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
-    depthDesc.Width = width;
-    depthDesc.Height = height;
-    depthDesc.DepthOrArraySize = 1;
-    depthDesc.MipLevels = 1;
-    depthDesc.Format = DXGI_FORMAT_D32_FLOAT;
-    depthDesc.SampleDesc.Count = 1;
-    depthDesc.Flags = D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL;
-
-    D3D12_CLEAR_VALUE depthClearValue = {0};
-    depthClearValue.Format = DXGI_FORMAT_D32_FLOAT;
-    depthClearValue.DepthStencil.Depth = 1.0f;
+    CANVAS_DISPLAY_BOUNDS(display);
 
-    ID3D12Resource *depthTexture;
-    hr = canvas_win32.device->lpVtbl->CreateCommittedResource(
-        canvas_win32.device,
-        &depthHeapProps,
-        D3D12_HEAP_FLAG_NONE,
-        &depthDesc,
-        D3D12_RESOURCE_STATE_DEPTH_WRITE,
-        &depthClearValue,
-        &IID_ID3D12Resource,
-        (void **)&depthTexture);
+    int global_x = canvas_info.display[display].x + x;
+    int global_y = canvas_info.display[display].y + (canvas_info.display[display].height - (y + height));
 
-    if (SUCCEEDED(hr))
+    if (x >= 0 && y >= 0 && width > 0 && height > 0)
     {
-        canvas_info.canvas[window_id].depth_texture = depthTexture;
+        _CGRect rect = make_rect(global_x, global_y, width, height);
+        msg_void_rect_bool(window, "setFrame:display:", rect, true);
     }
-    else
+
+    if (title)
     {
-        CANVAS_WARN("failed to recreate depth texture (HRESULT: 0x%08lX)\n", hr);
+        objc_id nsTitle = nsstring_from_cstr(title);
+        if (nsTitle)
+            msg_void_id(window, "setTitle:", nsTitle);
     }
 
     CANVAS_RETURN(CANVAS_OK);
 }
-static int _d3d12_upload_buffer_data(canvas_buffer *buf, void *data, size_t size)
+
+int _canvas_get_window_display(int window_id)
 {
     CANVAS_ENTER_FUNC();
-    CANVAS_ASSERT(buf != NULL);
-    CANVAS_ASSERT(data != NULL);
-    CANVAS_ASSERT(size > 0);
-
-    D3D12_HEAP_PROPERTIES upload_heap = {0};
-    upload_heap.Type = D3D12_HEAP_TYPE_UPLOAD;
-
-    D3D12_RESOURCE_DESC staging_desc = {0};
-    staging_desc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
-    staging_desc.Width = size;
-    staging_desc.Height = 1;
-    staging_desc.DepthOrArraySize = 1;
-    staging_desc.MipLevels = 1;
-    staging_desc.Format = DXGI_FORMAT_UNKNOWN;
-    staging_desc.SampleDesc.Count = 1;
-    staging_desc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
-
-    ID3D12Resource *staging = NULL;
-    HRESULT hr = canvas_win32.device->lpVtbl->CreateCommittedResource(
-        canvas_win32.device,
-        &upload_heap,
-        D3D12_HEAP_FLAG_NONE,
-        &staging_desc,
-        D3D12_RESOURCE_STATE_GENERIC_READ,
-        NULL,
-        &IID_ID3D12Resource,
-        (void **)&staging);
+    CANVAS_BOUNDS(window_id);
 
-    if (FAILED(hr))
+    objc_id window = canvas_info.canvas[window_id].window;
+    if (!window)
     {
-        CANVAS_RETURN_ERR(CANVAS_FAIL, "Failed to create staging buffer\n");
+        CANVAS_RETURN_ERR(CANVAS_ERR_GET_WINDOW, "no window to get display: %d\n", window_id);
     }
 
-    // Map and copy data to staging
-    void *mapped = NULL;
-    D3D12_RANGE read_range = {0, 0};
-    hr = staging->lpVtbl->Map(staging, 0, &read_range, &mapped);
-    if (FAILED(hr))
+    objc_id screen = msg_id(window, "screen");
+    if (!screen)
     {
-        staging->lpVtbl->Release(staging);
-        CANVAS_RETURN(CANVAS_FAIL);
+        CANVAS_RETURN_ERR(CANVAS_ERR_GET_DISPLAY, "no screen for window: %d\n", window_id);
     }
 
-    memcpy(mapped, data, size);
-    staging->lpVtbl->Unmap(staging, 0, NULL);
-
-    // Wait for previous frames to finish before resetting command allocator
-    canvas_win32.fence_value++;
-    canvas_win32.cmdQueue->lpVtbl->Signal(canvas_win32.cmdQueue, canvas_win32.fence, canvas_win32.fence_value);
-    if (canvas_win32.fence->lpVtbl->GetCompletedValue(canvas_win32.fence) < canvas_win32.fence_value)
+    objc_id device_desc = msg_id(screen, "deviceDescription");
+    if (!device_desc)
     {
-        canvas_win32.fence->lpVtbl->SetEventOnCompletion(canvas_win32.fence, canvas_win32.fence_value, canvas_win32.fence_event);
-        WaitForSingleObject(canvas_win32.fence_event, INFINITE);
+        CANVAS_RETURN_ERR(CANVAS_ERR_GET_GPU, "no device description: %d\n", window_id);
     }
 
-    // Reset command allocator and list
-    canvas_win32.cmdAllocator->lpVtbl->Reset(canvas_win32.cmdAllocator);
-    canvas_win32.cmdList->lpVtbl->Reset(canvas_win32.cmdList,
-                                        canvas_win32.cmdAllocator, NULL);
-
-    // Transition destination buffer to COPY_DEST
-    ID3D12Resource *dst = (ID3D12Resource *)buf->platform_handle;
-
-    D3D12_RESOURCE_BARRIER barrier = {0};
-    barrier.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
-    barrier.Transition.pResource = dst;
-    barrier.Transition.StateBefore = D3D12_RESOURCE_STATE_COMMON;
-    barrier.Transition.StateAfter = D3D12_RESOURCE_STATE_COPY_DEST;
-    barrier.Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
-
-    canvas_win32.cmdList->lpVtbl->ResourceBarrier(canvas_win32.cmdList, 1, &barrier);
-
-    // Copy staging -> destination
-    canvas_win32.cmdList->lpVtbl->CopyResource(canvas_win32.cmdList, dst, staging);
-
-    // Transition to appropriate state based on buffer type
-    D3D12_RESOURCE_STATES final_state;
-    switch (buf->type)
+    objc_id screen_number_key = nsstring_from_cstr("NSScreenNumber");
+    if (!screen_number_key)
     {
-    case CANVAS_BUFFER_VERTEX:
-        final_state = D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER;
-        break;
-    case CANVAS_BUFFER_INDEX:
-        final_state = D3D12_RESOURCE_STATE_INDEX_BUFFER;
-        break;
-    case CANVAS_BUFFER_UNIFORM:
-        final_state = D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER;
-        break;
-    case CANVAS_BUFFER_STORAGE:
-        final_state = D3D12_RESOURCE_STATE_COMMON;
-        break;
-    default:
-        final_state = D3D12_RESOURCE_STATE_COMMON;
+        CANVAS_RETURN(CANVAS_ERR_GET_DISPLAY);
     }
 
-    barrier.Transition.StateBefore = D3D12_RESOURCE_STATE_COPY_DEST;
-    barrier.Transition.StateAfter = final_state;
-    canvas_win32.cmdList->lpVtbl->ResourceBarrier(canvas_win32.cmdList, 1, &barrier);
+    objc_id display_id_obj = msg_id_id(device_desc, "objectForKey:", screen_number_key);
+    if (!display_id_obj)
+    {
+        CANVAS_RETURN(CANVAS_ERR_GET_DISPLAY);
+    }
 
-    // Close and execute
-    canvas_win32.cmdList->lpVtbl->Close(canvas_win32.cmdList);
+    unsigned long display_id = msg_ulong(display_id_obj, "unsignedIntValue");
 
-    ID3D12CommandList *cmdLists[] = {(ID3D12CommandList *)canvas_win32.cmdList};
-    canvas_win32.cmdQueue->lpVtbl->ExecuteCommandLists(canvas_win32.cmdQueue, 1, cmdLists);
+    uint32_t max_displays = MAX_DISPLAYS;
+    CGDirectDisplayID displays[MAX_DISPLAYS];
+    uint32_t display_count = 0;
 
-    // Wait for completion
-    canvas_win32.fence_value++;
-    canvas_win32.cmdQueue->lpVtbl->Signal(canvas_win32.cmdQueue, canvas_win32.fence, canvas_win32.fence_value);
+    CGGetActiveDisplayList(max_displays, displays, &display_count);
 
-    if (canvas_win32.fence->lpVtbl->GetCompletedValue(canvas_win32.fence) < canvas_win32.fence_value)
+    for (uint32_t i = 0; i < display_count && i < MAX_DISPLAYS; i++)
     {
-        canvas_win32.fence->lpVtbl->SetEventOnCompletion(canvas_win32.fence, canvas_win32.fence_value, canvas_win32.fence_event);
-        WaitForSingleObject(canvas_win32.fence_event, INFINITE);
-    }
+        if (displays[i] != (CGDirectDisplayID)display_id)
+            continue;
 
-    staging->lpVtbl->Release(staging);
+        canvas_info.canvas[window_id].display = i;
+        CANVAS_RETURN(i);
+    }
 
     CANVAS_RETURN(CANVAS_OK);
 }
 
-canvas_buffer *canvas_buffer_create(int window_id, canvas_buffer_type type, canvas_buffer_usage usage, size_t size, void *initial_data)
+int _canvas_refresh_displays()
 {
     CANVAS_ENTER_FUNC();
-    CANVAS_ASSERT_RANGE(window_id, 0, MAX_CANVAS - 1);
-    CANVAS_ASSERT(size > 0);
 
-    CANVAS_VALID_PTR(window_id);
+    canvas_info.display_count = 0;
+    canvas_info.display_changed = false;
+    canvas_info.highest_refresh_rate = 0;
 
-    if (!canvas_win32.device)
+    uint32_t max_displays = MAX_DISPLAYS;
+    CGDirectDisplayID display[MAX_DISPLAYS];
+    uint32_t display_count = 0;
+
+    CGError err = CGGetActiveDisplayList(max_displays, display, &display_count);
+    if (err != kCGErrorSuccess)
     {
-        CANVAS_RETURN_ERR(NULL, "GPU not initialized\n");
+        CANVAS_RETURN_ERR(CANVAS_ERR_GET_DISPLAY, "get display list: %d\n", err);
     }
 
-    canvas_buffer *buf = (canvas_buffer *)calloc(1, sizeof(canvas_buffer));
-    if (!buf)
+    CGDirectDisplayID main_display = CGMainDisplayID();
+
+    for (uint32_t i = 0; i < display_count && i < MAX_DISPLAYS; i++)
     {
-        CANVAS_RETURN(NULL);
-    }
+        CGDirectDisplayID display_id = display[i];
+        CGRect bounds = CGDisplayBounds(display_id);
+        CGDisplayModeRef mode = CGDisplayCopyDisplayMode(display_id);
+        double refresh_rate = 60.0;
 
-    buf->size = size;
-    buf->type = type;
-    buf->usage = usage;
-    buf->window_id = window_id;
+        if (mode)
+        {
+            refresh_rate = CGDisplayModeGetRefreshRate(mode);
 
-    // Determine heap type
-    D3D12_HEAP_TYPE heap_type;
-    D3D12_RESOURCE_STATES initial_state;
+            if (refresh_rate <= 0.0)
+                refresh_rate = 60.0;
 
-    if (usage == CANVAS_BUFFER_DYNAMIC)
-    {
-        heap_type = D3D12_HEAP_TYPE_UPLOAD;
-        initial_state = D3D12_RESOURCE_STATE_GENERIC_READ;
-    }
-    else
-    {
-        heap_type = D3D12_HEAP_TYPE_DEFAULT;
-        initial_state = D3D12_RESOURCE_STATE_COMMON;
-    }
+            CGDisplayModeRelease(mode);
+        }
 
-    // Create buffer
-    D3D12_HEAP_PROPERTIES heap_props = {0};
-    heap_props.Type = heap_type;
-    heap_props.CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_UNKNOWN;
-    heap_props.MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN;
+        canvas_info.display[i].primary = (display_id == main_display);
+        canvas_info.display[i].x = (int)bounds.origin.x;
+        canvas_info.display[i].y = (int)bounds.origin.y;
+        canvas_info.display[i].width = (int)bounds.size.width;
+        canvas_info.display[i].height = (int)bounds.size.height;
+        canvas_info.display[i].refresh_rate = (int)refresh_rate;
 
-    D3D12_RESOURCE_DESC resource_desc = {0};
-    resource_desc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
-    resource_desc.Width = size;
-    resource_desc.Height = 1;
-    resource_desc.DepthOrArraySize = 1;
-    resource_desc.MipLevels = 1;
-    resource_desc.Format = DXGI_FORMAT_UNKNOWN;
-    resource_desc.SampleDesc.Count = 1;
-    resource_desc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
-    resource_desc.Flags = D3D12_RESOURCE_FLAG_NONE;
+        if ((int)refresh_rate > canvas_info.highest_refresh_rate)
+            canvas_info.highest_refresh_rate = (int)refresh_rate;
 
-    ID3D12Resource *resource = NULL;
-    HRESULT hr = canvas_win32.device->lpVtbl->CreateCommittedResource(
-        canvas_win32.device,
-        &heap_props,
-        D3D12_HEAP_FLAG_NONE,
-        &resource_desc,
-        initial_state,
-        NULL,
-        &IID_ID3D12Resource,
-        (void **)&resource);
+        canvas_info.display_count++;
+    }
 
-    if (FAILED(hr))
+    for (int i = 0; i < MAX_CANVAS; i++)
     {
-        CANVAS_ERR("Failed to create D3D12 buffer (HRESULT: 0x%08lX)\n", hr);
-        free(buf);
-        CANVAS_RETURN(NULL);
+        if (canvas_info.canvas[i].window)
+            _canvas_get_window_display(i);
     }
 
-    buf->platform_handle = resource;
+    CANVAS_RETURN(canvas_info.display_count);
+}
 
-    // Persistent mapping for dynamic buffers
-    if (usage == CANVAS_BUFFER_DYNAMIC)
-    {
-        D3D12_RANGE read_range = {0, 0};
-        hr = resource->lpVtbl->Map(resource, 0, &read_range, &buf->mapped);
+void _canvas_display_reconfigure_callback(CGDirectDisplayID display, CGDisplayChangeSummaryFlags flags, void *userInfo)
+{
+    CANVAS_ENTER_FUNC();
 
-        if (FAILED(hr))
-        {
-            CANVAS_ERR("Failed to map D3D12 buffer\n");
-            resource->lpVtbl->Release(resource);
-            free(buf);
-            CANVAS_RETURN(NULL);
-        }
+    if (flags & (kCGDisplayAddFlag | kCGDisplayRemoveFlag | kCGDisplaySetModeFlag | kCGDisplayDesktopShapeChangedFlag))
+        canvas_info.display_changed = true;
 
-        if (initial_data)
-        {
-            memcpy(buf->mapped, initial_data, size);
-        }
-    }
-    else if (initial_data)
-    {
-        if (_d3d12_upload_buffer_data(buf, initial_data, size) != CANVAS_OK)
-        {
-            CANVAS_ERR("Failed to upload static buffer data\n");
-            resource->lpVtbl->Release(resource);
-            free(buf);
-            CANVAS_RETURN(NULL);
-        }
-    }
+    CANVAS_RETURN_VOID();
+}
 
-    CANVAS_RETURN(buf);
+int _canvas_init_displays()
+{
+    CANVAS_ENTER_FUNC();
+
+    canvas_info.display_count = 0;
+    CGDisplayRegisterReconfigurationCallback(_canvas_display_reconfigure_callback, NULL);
+
+    int result = _canvas_refresh_displays();
+    CANVAS_RETURN(result);
 }
 
-void canvas_buffer_update(canvas_buffer *buf, void *data, size_t size, size_t offset)
+void _post_init()
 {
     CANVAS_ENTER_FUNC();
-    CANVAS_ASSERT_NOT_NULL(buf);
-    CANVAS_ASSERT_NOT_NULL(data);
-    CANVAS_ASSERT(size > 0);
 
-    if (!buf || !data)
+    if (canvas_info.init_post)
     {
         CANVAS_RETURN_VOID();
     }
+    canvas_info.init_post = 1;
 
-    if (buf->usage != CANVAS_BUFFER_DYNAMIC)
+    objc_id poolClass = cls("NSAutoreleasePool");
+    if (!poolClass)
     {
-        CANVAS_WARN("Can only update dynamic buffers\n");
         CANVAS_RETURN_VOID();
     }
 
-    if (offset > buf->size || size > buf->size - offset)
-    {
-        CANVAS_ERR("Buffer update out of bounds\n");
-        CANVAS_RETURN_VOID();
-    }
+    objc_id alloc = msg_id(poolClass, "alloc");
+    canvas_macos.pool = msg_id(alloc, "init");
+    mach_timebase_info(&canvas_macos.timebase);
 
-    memcpy((uint8_t *)buf->mapped + offset, data, size);
     CANVAS_RETURN_VOID();
 }
 
-void *canvas_buffer_map(canvas_buffer *buf)
+static void hid_input_cb(void *ctx, IOReturn res, void *sender, IOHIDValueRef value)
 {
-    CANVAS_ENTER_FUNC();
+    IOHIDElementRef elem = IOHIDValueGetElement(value);
+    uint32_t page = IOHIDElementGetUsagePage(elem);
+    uint32_t usage = IOHIDElementGetUsage(elem);
 
-    if (!buf)
+    if (page == 0x07) // USB HID Keyboard/Keypad page id
     {
-        CANVAS_RETURN(NULL);
-    }
+        bool pressed = IOHIDValueGetIntegerValue(value) != 0;
+        int hid_key = (int)usage;
 
-    if (buf->usage == CANVAS_BUFFER_DYNAMIC)
-    {
-        CANVAS_RETURN(buf->mapped);
+        if (hid_key > 0 && hid_key < 256)
+        {
+            bool was_down = canvas_keyboard.keys[hid_key];
+            canvas_keyboard.keys[hid_key] = pressed;
+
+            if (pressed && !was_down)
+            {
+                canvas_keyboard.keys_pressed[hid_key] = true;
+            }
+            else if (!pressed && was_down)
+            {
+                canvas_keyboard.keys_released[hid_key] = true;
+            }
+        }
     }
+}
 
-    ID3D12Resource *resource = (ID3D12Resource *)buf->platform_handle;
-    D3D12_RANGE read_range = {0, 0};
+static IOHIDManagerRef start_hid()
+{
+    IOHIDManagerRef m = IOHIDManagerCreate(kCFAllocatorDefault, kIOHIDOptionsTypeNone);
 
-    void *mapped = NULL;
-    HRESULT hr = resource->lpVtbl->Map(resource, 0, &read_range, &mapped);
+    const uint32_t devPage = 0x01, devUsage = 0x06;
+    CFMutableDictionaryRef match = CFDictionaryCreateMutable(NULL, 0,
+                                                             &kCFCopyStringDictionaryKeyCallBacks, &kCFTypeDictionaryValueCallBacks);
+    CFNumberRef nPage = CFNumberCreate(NULL, kCFNumberIntType, &devPage);
+    CFNumberRef nUsage = CFNumberCreate(NULL, kCFNumberIntType, &devUsage);
+    CFDictionarySetValue(match, CFSTR(kIOHIDDeviceUsagePageKey), nPage);
+    CFDictionarySetValue(match, CFSTR(kIOHIDDeviceUsageKey), nUsage);
+    CFRelease(nPage);
+    CFRelease(nUsage);
 
-    if (FAILED(hr))
+    IOHIDManagerSetDeviceMatching(m, match);
+    CFRelease(match);
+
+    IOHIDManagerRegisterInputValueCallback(m, hid_input_cb, NULL);
+    IOHIDManagerScheduleWithRunLoop(m, CFRunLoopGetCurrent(), kCFRunLoopCommonModes);
+
+    IOReturn r = IOHIDManagerOpen(m, kIOHIDOptionsTypeNone);
+    if (r != kIOReturnSuccess)
     {
-        CANVAS_RETURN_ERR(NULL, "Failed to map buffer\n");
     }
-
-    CANVAS_RETURN(mapped);
+    return m;
 }
 
-void canvas_buffer_unmap(canvas_buffer *buf)
+int _canvas_platform()
 {
     CANVAS_ENTER_FUNC();
 
-    if (!buf)
-    {
-        CANVAS_RETURN_VOID();
-    }
+    _post_init();
+
+    canvas_macos.hid_manager = start_hid();
 
-    if (buf->usage == CANVAS_BUFFER_DYNAMIC)
+    canvas_macos.app = msg_id(cls("NSApplication"), "sharedApplication");
+    if (!canvas_macos.app)
     {
-        CANVAS_RETURN_VOID();
+        CANVAS_RETURN_ERR(CANVAS_ERR_GET_PLATFORM, "failed to get NSApplication\n");
     }
 
-    ID3D12Resource *resource = (ID3D12Resource *)buf->platform_handle;
-    resource->lpVtbl->Unmap(resource, 0, NULL);
-    CANVAS_RETURN_VOID();
+    msg_void_long(canvas_macos.app, "setActivationPolicy:", NSApplicationActivationPolicyRegular);
+    msg_void_bool(canvas_macos.app, "activateIgnoringOtherApps:", true);
+
+    CANVAS_RETURN(CANVAS_OK);
 }
 
-void canvas_buffer_destroy(canvas_buffer *buf)
+int _canvas_window(int64_t x, int64_t y, int64_t width, int64_t height, const char *title)
 {
     CANVAS_ENTER_FUNC();
 
-    if (!buf)
+    _post_init();
+    canvas_startup();
+
+    unsigned long style = NSWindowStyleMaskTitled | NSWindowStyleMaskClosable | NSWindowStyleMaskMiniaturizable | NSWindowStyleMaskResizable;
+
+    objc_id winClass = cls("NSWindow");
+    if (!winClass)
     {
-        CANVAS_RETURN_VOID();
+        CANVAS_RETURN_ERR(CANVAS_ERR_GET_WINDOW, "failed to get NSWindow class\n");
     }
 
-    ID3D12Resource *resource = (ID3D12Resource *)buf->platform_handle;
+    int window_id = _canvas_get_free();
+    if (window_id < 0)
+    {
+        CANVAS_RETURN(window_id);
+    }
 
-    if (buf->mapped && buf->usage == CANVAS_BUFFER_DYNAMIC)
-        resource->lpVtbl->Unmap(resource, 0, NULL);
+    objc_id walloc = msg_id(winClass, "alloc");
 
-    resource->lpVtbl->Release(resource);
-    free(buf);
-    CANVAS_RETURN_VOID();
-}
+    typedef objc_id (*msg_initWin)(objc_id, objc_sel, _CGRect, unsigned long, long, int);
 
-int _canvas_post_update()
-{
-    CANVAS_ENTER_FUNC();
-    CANVAS_RETURN(CANVAS_OK);
-}
+    _CGRect rect = make_rect(x, y, width, height);
 
-int _canvas_exit()
-{
-    CANVAS_ENTER_FUNC();
-    if (canvas_win32.fence_event)
-        CloseHandle(canvas_win32.fence_event);
-    if (canvas_win32.fence)
-        canvas_win32.fence->lpVtbl->Release(canvas_win32.fence);
-    if (canvas_win32.rtvHeap)
-        canvas_win32.rtvHeap->lpVtbl->Release(canvas_win32.rtvHeap);
-    if (canvas_win32.cmdList)
-        canvas_win32.cmdList->lpVtbl->Release(canvas_win32.cmdList);
-    if (canvas_win32.cmdAllocator)
-        canvas_win32.cmdAllocator->lpVtbl->Release(canvas_win32.cmdAllocator);
-    if (canvas_win32.cmdQueue)
-        canvas_win32.cmdQueue->lpVtbl->Release(canvas_win32.cmdQueue);
-    if (canvas_win32.device)
-        canvas_win32.device->lpVtbl->Release(canvas_win32.device);
-    if (canvas_win32.factory)
-        canvas_win32.factory->lpVtbl->Release(canvas_win32.factory);
-    if (canvas_win32.class)
-        UnregisterClassA("CanvasWindowClass", canvas_win32.instance);
-    CANVAS_RETURN(CANVAS_OK);
-}
+    objc_id window = ((msg_initWin)objc_msgSend)(walloc, sel_c("initWithContentRect:styleMask:backing:defer:"), rect, style, (long)NSBackingStoreBuffered, 0);
 
-#endif
+    if (!window)
+    {
+        canvas_info.canvas[window_id]._valid = false;
+        CANVAS_RETURN_ERR(CANVAS_ERR_GET_WINDOW, "failed to create NSWindow\n");
+    }
 
-//
-//
-//
-#if defined(__linux__)
+    msg_void_bool(window, "setTitlebarAppearsTransparent:", true);
+    msg_void_long(window, "setTitleVisibility:", NSWindowTitleHidden);
 
-int canvas_minimize(int window_id)
-{
-    CANVAS_ENTER_FUNC();
-    CANVAS_VALID(window_id);
+    unsigned long sm = msg_ulong(window, "styleMask");
+    sm |= NSWindowStyleMaskFullSizeContent;
+    msg_void_long(window, "setStyleMask:", sm);
 
-    if (_canvas_using_wayland)
+    if (title)
     {
+        objc_id nsTitle = nsstring_from_cstr(title);
+        if (nsTitle)
+            msg_void_id(window, "setTitle:", nsTitle);
     }
-    else
-    {
-        if (!x11.display)
-        {
-            CANVAS_RETURN_ERR(CANVAS_ERR_GET_DISPLAY, "no display connection\n");
-        }
-
-        Window window = (Window)canvas_info.canvas[window_id].window;
-        if (!window)
-        {
-            CANVAS_RETURN_ERR(CANVAS_ERR_GET_WINDOW, "no window to minimize: %d\n", window_id);
-        }
 
-        int screen = x11.XDefaultScreen(x11.display);
-        x11.XIconifyWindow(x11.display, window, screen);
-        x11.XFlush(x11.display);
-    }
+    msg_void_id(window, "makeKeyAndOrderFront:", NULL);
 
-    canvas_info.canvas[window_id].minimized = true;
+    canvas_info.canvas[window_id].window = window;
+    canvas_info.canvas[window_id].resize = false;
+    canvas_info.canvas[window_id].index = window_id;
+    canvas_info.canvas[window_id].minimized = false;
     canvas_info.canvas[window_id].maximized = false;
+    canvas_info.canvas[window_id].fullscreen = false;
+    canvas_info.canvas[window_id]._valid = true;
 
-    CANVAS_RETURN(CANVAS_OK);
+    CANVAS_RETURN(window_id);
 }
 
-int canvas_maximize(int window_id)
+int _canvas_gpu_init()
 {
     CANVAS_ENTER_FUNC();
-    CANVAS_VALID(window_id);
 
-    if (_canvas_using_wayland)
+    if (canvas_info.init_gpu)
     {
+        CANVAS_RETURN(CANVAS_OK);
     }
-    else
-    {
-        if (!x11.display)
-        {
-            CANVAS_RETURN_ERR(CANVAS_ERR_GET_DISPLAY, "no display connection\n");
-        }
+    canvas_info.init_gpu = 1;
 
-        Window window = (Window)canvas_info.canvas[window_id].window;
-        if (!window)
-        {
-            CANVAS_RETURN_ERR(CANVAS_ERR_GET_WINDOW, "no window to maximize: %d\n", window_id);
-        }
+    canvas_macos.device = MTLCreateSystemDefaultDevice();
+    if (!canvas_macos.device)
+    {
+        CANVAS_RETURN_ERR(CANVAS_ERR_GET_GPU, "failed to create Metal device\n");
+    }
 
-        int screen = x11.XDefaultScreen(x11.display);
+    canvas_macos.queue = msg_id(canvas_macos.device, "newCommandQueue");
+    if (!canvas_macos.queue)
+    {
+        CANVAS_RETURN_ERR(CANVAS_ERR_GET_GPU, "failed to create Metal command queue\n");
+    }
 
-        Atom wm_state = x11.XInternAtom(x11.display, "_NET_WM_STATE", 0);
-        Atom max_horz = x11.XInternAtom(x11.display, "_NET_WM_STATE_MAXIMIZED_HORZ", 0);
-        Atom max_vert = x11.XInternAtom(x11.display, "_NET_WM_STATE_MAXIMIZED_VERT", 0);
+    CANVAS_RETURN(CANVAS_OK);
+}
 
-        XClientMessageEvent ev = {0};
-        ev.type = 33;
-        ev.window = window;
-        ev.message_type = wm_state;
-        ev.format = 32;
-        ev.data.l[0] = 1;
-        ev.data.l[1] = max_horz;
-        ev.data.l[2] = max_vert;
-        ev.data.l[3] = 1;
+int _canvas_update_drawable_size(int window_id)
+{
+    CANVAS_ENTER_FUNC();
+    CANVAS_BOUNDS(window_id);
 
-        x11.XSendEvent(x11.display, x11.XRootWindow(x11.display, screen),
-                       0, (1L << 20) | (1L << 19), (XEvent *)&ev);
-        x11.XFlush(x11.display);
+    if (!_canvas_data[window_id].view || !_canvas_data[window_id].layer)
+    {
+        CANVAS_RETURN_ERR(CANVAS_ERR_GET_DISPLAY, "no view or layer to update drawable size: %d\n", window_id);
     }
 
-    canvas_info.canvas[window_id].maximized = true;
-    canvas_info.canvas[window_id].minimized = false;
+    _CGRect b = msg_rect(_canvas_data[window_id].view, "bounds");
+    double w = b.w * _canvas_data[window_id].scale;
+    double h = b.h * _canvas_data[window_id].scale;
+    msg_void_size(_canvas_data[window_id].layer, "setDrawableSize:", w, h);
 
     CANVAS_RETURN(CANVAS_OK);
 }
 
-int canvas_restore(int window_id)
+int _canvas_window_resize(int window_id)
 {
     CANVAS_ENTER_FUNC();
-    CANVAS_VALID(window_id);
+    CANVAS_BOUNDS(window_id);
 
-    if (_canvas_using_wayland)
+    if (!_canvas_data[window_id].layer)
     {
+        CANVAS_RETURN(CANVAS_OK);
     }
-    else
-    {
-        if (!x11.display)
-        {
-            CANVAS_RETURN_ERR(CANVAS_ERR_GET_DISPLAY, "no display connection\n");
-        }
 
-        Window window = (Window)canvas_info.canvas[window_id].window;
-        if (!window)
-        {
-            CANVAS_RETURN_ERR(CANVAS_ERR_GET_WINDOW, "no window to restore: %d\n", window_id);
-        }
+    canvas_info.canvas[window_id].resize = false;
 
-        int screen = x11.XDefaultScreen(x11.display);
+    _canvas_update_drawable_size(window_id);
 
-        if (canvas_info.canvas[window_id].minimized)
-        {
-            x11.XMapWindow(x11.display, window);
-        }
-        else if (canvas_info.canvas[window_id].maximized)
-        {
-            Atom wm_state = x11.XInternAtom(x11.display, "_NET_WM_STATE", 0);
-            Atom max_horz = x11.XInternAtom(x11.display, "_NET_WM_STATE_MAXIMIZED_HORZ", 0);
-            Atom max_vert = x11.XInternAtom(x11.display, "_NET_WM_STATE_MAXIMIZED_VERT", 0);
-
-            XClientMessageEvent ev = {0};
-            ev.type = 33;
-            ev.window = window;
-            ev.message_type = wm_state;
-            ev.format = 32;
-            ev.data.l[0] = 0;
-            ev.data.l[1] = max_horz;
-            ev.data.l[2] = max_vert;
-            ev.data.l[3] = 1;
-
-            x11.XSendEvent(x11.display, x11.XRootWindow(x11.display, screen),
-                           0, (1L << 20) | (1L << 19), (XEvent *)&ev);
-        }
-        else if (canvas_info.canvas[window_id].fullscreen)
-        {
-            Atom wm_state = x11.XInternAtom(x11.display, "_NET_WM_STATE", 0);
-            Atom fullscreen = x11.XInternAtom(x11.display, "_NET_WM_STATE_FULLSCREEN", 0);
+    CANVAS_RETURN(CANVAS_OK);
+}
 
-            XClientMessageEvent ev = {0};
-            ev.type = 33;
-            ev.window = window;
-            ev.message_type = wm_state;
-            ev.format = 32;
-            ev.data.l[0] = 0; // _NET_WM_STATE_REMOVE
-            ev.data.l[1] = fullscreen;
-            ev.data.l[2] = 0;
-            ev.data.l[3] = 1;
+int _canvas_gpu_new_offscreen(int window_id, canvas_format format)
+{
+    CANVAS_ENTER_FUNC();
+    (void)window_id;
+    (void)format;
+    CANVAS_RETURN_ERR(CANVAS_FAIL, "offscreen canvases need the vulkan backend\n");
+}
 
-            x11.XSendEvent(x11.display, x11.XRootWindow(x11.display, screen), 0, (1L << 20) | (1L << 19), (XEvent *)&ev);
+int _canvas_gpu_new_window(int window_id)
+{
+    CANVAS_ENTER_FUNC();
+    CANVAS_BOUNDS(window_id);
 
-            x11.XMoveResizeWindow(x11.display, window,
-                                  (int)_canvas_data[window_id].saved_x,
-                                  (int)_canvas_data[window_id].saved_y,
-                                  (unsigned int)_canvas_data[window_id].saved_width,
-                                  (unsigned int)_canvas_data[window_id].saved_height);
-        }
+    objc_id window = canvas_info.canvas[window_id].window;
+    if (!window)
+    {
+        CANVAS_RETURN_ERR(CANVAS_ERR_GET_WINDOW, "no window for GPU setup: %d\n", window_id);
+    }
 
-        x11.XFlush(x11.display);
+    objc_id content_view = msg_id(window, "contentView");
+    if (!content_view)
+    {
+        CANVAS_RETURN_ERR(CANVAS_ERR_GET_WINDOW, "no content view: %d\n", window_id);
     }
 
-    canvas_info.canvas[window_id].minimized = false;
-    canvas_info.canvas[window_id].maximized = false;
-    canvas_info.canvas[window_id].fullscreen = false;
+    msg_void_bool(content_view, "setWantsLayer:", true);
 
-    CANVAS_RETURN(CANVAS_OK);
-}
+    objc_id layer_class = cls("CAMetalLayer");
+    if (!layer_class)
+    {
+        CANVAS_RETURN_ERR(CANVAS_ERR_GET_GPU, "failed to get CAMetalLayer class\n");
+    }
 
-int canvas_fullscreen(int window_id)
-{
-    CANVAS_ENTER_FUNC();
-    CANVAS_VALID(window_id);
+    objc_id layer_alloc = msg_id(layer_class, "alloc");
+    objc_id layer = msg_id(layer_alloc, "init");
 
-    if (_canvas_using_wayland)
+    if (!layer)
     {
-        // TODO: Wayland fullscreen support
-        CANVAS_WARN("Wayland fullscreen not yet implemented\n");
-        CANVAS_RETURN(CANVAS_OK);
+        msg_void(layer_alloc, "release");
+        CANVAS_RETURN_ERR(CANVAS_ERR_GET_GPU, "failed to create Metal layer\n");
     }
-    else
-    {
-        if (!x11.display)
-        {
-            CANVAS_RETURN_ERR(CANVAS_ERR_GET_DISPLAY, "no display connection\n");
-        }
 
-        Window window = (Window)canvas_info.canvas[window_id].window;
-        if (!window)
-        {
-            CANVAS_RETURN_ERR(CANVAS_ERR_GET_WINDOW, "no window for fullscreen: %d\n", window_id);
-        }
+    msg_void_id(layer, "setDevice:", canvas_macos.device);
+    msg_void_bool(layer, "setPresentsWithTransaction:", false);
 
-        if (!canvas_info.canvas[window_id].fullscreen)
-        {
-            XWindowAttributes attrs;
-            x11.XGetWindowAttributes(x11.display, window, &attrs);
-            _canvas_data[window_id].saved_x = attrs.x;
-            _canvas_data[window_id].saved_y = attrs.y;
-            _canvas_data[window_id].saved_width = attrs.width;
-            _canvas_data[window_id].saved_height = attrs.height;
+    msg_void_id(content_view, "setLayer:", layer);
 
-            int screen = x11.XDefaultScreen(x11.display);
-            Atom wm_state = x11.XInternAtom(x11.display, "_NET_WM_STATE", 0);
-            Atom fullscreen = x11.XInternAtom(x11.display, "_NET_WM_STATE_FULLSCREEN", 0);
+    /* backingScaleFactor returns a double (CGFloat) on NSWindow, call it directly */
+    double scale = msg_dbl(window, "backingScaleFactor");
 
-            XClientMessageEvent ev = {0};
-            ev.type = 33;
-            ev.window = window;
-            ev.message_type = wm_state;
-            ev.format = 32;
-            ev.data.l[0] = 1; // _NET_WM_STATE_ADD
-            ev.data.l[1] = fullscreen;
-            ev.data.l[2] = 0;
-            ev.data.l[3] = 1;
+    if (scale == 0.0)
+        scale = 1.0;
 
-            x11.XSendEvent(x11.display, x11.XRootWindow(x11.display, screen), 0, (1L << 20) | (1L << 19), (XEvent *)&ev);
-            x11.XFlush(x11.display);
+    msg_void_double(layer, "setContentsScale:", scale);
 
-            canvas_info.canvas[window_id].fullscreen = true;
-        }
-    }
+    _canvas_data[window_id].layer = layer;
+    _canvas_data[window_id].view = content_view;
+    _canvas_data[window_id].scale = scale;
 
-    canvas_info.canvas[window_id].minimized = false;
-    canvas_info.canvas[window_id].maximized = false;
+    _canvas_update_drawable_size(window_id);
+
+    CANVAS_VERBOSE("metal layer setup complete for window %d\n", window_id);
 
     CANVAS_RETURN(CANVAS_OK);
 }
 
-int _canvas_close(int window_id)
+// numbers the frame and keeps its command buffer until MAX_FRAMES_IN_FLIGHT newer ones were committed
+static void _metal_track_submit(int window_id, objc_id cmd)
 {
-    CANVAS_ENTER_FUNC();
-    CANVAS_BOUNDS(window_id);
+    uint64_t frame = ++canvas_info.canvas[window_id].stats.submitted;
+    objc_id *slot = &_canvas_data[window_id].frame_command_buffers[frame % MAX_FRAMES_IN_FLIGHT];
 
-    if (vk_windows[window_id].initialized)
+    if (*slot)
+        msg_void(*slot, "release");
+
+    *slot = msg_id(cmd, "retain");
+}
+
+// a queue completes its command buffers in commit order, so an untracked older frame is
+// covered by the oldest tracked one
+static int _metal_wait_frame(int window_id, uint64_t frame, uint64_t timeout_ns)
+{
+    uint64_t submitted = canvas_info.canvas[window_id].stats.submitted;
+    if (frame == 0 || submitted == 0)
+        return CANVAS_OK;
+
+    if (submitted >= MAX_FRAMES_IN_FLIGHT && frame <= submitted - MAX_FRAMES_IN_FLIGHT)
+        frame = submitted - MAX_FRAMES_IN_FLIGHT + 1;
+
+    objc_id cmd = _canvas_data[window_id].frame_command_buffers[frame % MAX_FRAMES_IN_FLIGHT];
+    if (!cmd)
+        return CANVAS_OK;
+
+    if (timeout_ns == UINT64_MAX)
     {
-        vk_cleanup_window(window_id);
+        msg_void(cmd, "waitUntilCompleted");
+        return CANVAS_OK;
     }
 
-    if (_canvas_using_wayland)
+    // waitUntilCompleted has no timeout, poll the status instead
+    uint64_t start = mach_absolute_time();
+    while (msg_ulong(cmd, "status") < MTLCommandBufferStatusCompleted)
     {
+        uint64_t elapsed = (mach_absolute_time() - start) * canvas_macos.timebase.numer / canvas_macos.timebase.denom;
+        if (elapsed >= timeout_ns)
+            return CANVAS_FAIL;
+
+        struct timespec pause = {0, 50000};
+        nanosleep(&pause, NULL);
     }
-    else
-    {
-        Window window = (Window)canvas_info.canvas[window_id].window;
 
-        if (!window)
-        {
-            CANVAS_RETURN_ERR(CANVAS_ERR_GET_WINDOW, "no window to close: %d\n", window_id);
-        }
+    return CANVAS_OK;
+}
 
-        x11.XDestroyWindow(x11.display, window);
-        x11.XFlush(x11.display);
-    }
+// slice the window's next frame reads
+static uint32_t _metal_frame_slice(canvas_buffer *buf)
+{
+    return (uint32_t)((canvas_info.canvas[buf->window_id].stats.submitted + 1) % MAX_FRAMES_IN_FLIGHT);
+}
 
-    _canvas_data[window_id].last_button_press_time = 0;
-    _canvas_data[window_id].last_button_press_x = 0;
-    _canvas_data[window_id].last_button_press_y = 0;
+// returns the slice the next frame reads once the frame that read it last has finished
+static uint8_t *_metal_frame_slice_write(canvas_buffer *buf)
+{
+    uint64_t next = canvas_info.canvas[buf->window_id].stats.submitted + 1;
+    if (next > MAX_FRAMES_IN_FLIGHT)
+        _metal_wait_frame(buf->window_id, next - MAX_FRAMES_IN_FLIGHT, UINT64_MAX);
 
-    CANVAS_RETURN(CANVAS_OK);
+    return (uint8_t *)buf->mapped + (size_t)_metal_frame_slice(buf) * buf->slice_size;
 }
 
-int _canvas_set(int window_id, int display, int64_t x, int64_t y, int64_t width, int64_t height, const char *title)
+int _canvas_present(int window_id)
 {
     CANVAS_ENTER_FUNC();
-    CANVAS_VALID(window_id);
-    CANVAS_DISPLAY_BOUNDS(display);
+    CANVAS_BOUNDS(window_id);
 
-    if (width <= 0 || height <= 0)
+    if (!_canvas_data[window_id].layer)
     {
-        CANVAS_RETURN_ERR(CANVAS_FAIL, "invalid window dimensions: %dx%d\n", width, height);
+        CANVAS_RETURN_ERR(CANVAS_ERR_GET_WINDOW, "no layer to present: %d\n", window_id);
     }
 
-    if (_canvas_using_wayland)
+    objc_id drawable = msg_id(_canvas_data[window_id].layer, "nextDrawable");
+    if (!drawable)
     {
+        CANVAS_WARN("no drawable available for window %d\n", window_id);
+        CANVAS_RETURN(CANVAS_OK);
     }
-    else
+
+    objc_id cmdBuffer = msg_id(canvas_macos.queue, "commandBuffer");
+    if (!cmdBuffer)
     {
-        Window window = (Window)canvas_info.canvas[window_id].window;
+        CANVAS_RETURN_ERR(CANVAS_FAIL, "failed to create command buffer\n");
+    }
 
-        if (title && strcmp(canvas_info.canvas[window_id].title, title) != 0)
-        {
-            x11.XLockDisplay(x11.display);
-            x11.XStoreName(x11.display, window, title);
-            Atom net_wm_name = x11.XInternAtom(x11.display, "_NET_WM_NAME", 0);
-            Atom utf8_string = x11.XInternAtom(x11.display, "UTF8_STRING", 0);
-            x11.XChangeProperty(x11.display, window, net_wm_name, utf8_string, 8, 0,
-                                (unsigned char *)title, strlen(title));
-            x11.XUnlockDisplay(x11.display);
-        }
+    objc_id renderPassDescriptor = msg_id(cls("MTLRenderPassDescriptor"), "renderPassDescriptor");
+    if (!renderPassDescriptor)
+    {
+        CANVAS_RETURN_ERR(CANVAS_FAIL, "failed to create render pass descriptor\n");
+    }
 
-        _canvas_data[window_id].client_set = true;
+    objc_id color_attachments = msg_id(renderPassDescriptor, "colorAttachments");
+    objc_id color_attachment = msg_id_ulong(color_attachments, "objectAtIndexedSubscript:", 0);
 
-        int global_x = canvas_info.display[display].x + x;
-        int global_y = canvas_info.display[display].y + y;
+    objc_id texture = msg_id(drawable, "texture");
+    msg_void_id(color_attachment, "setTexture:", texture);
+    msg_void_long(color_attachment, "setLoadAction:", MTLLoadActionClear);
+    msg_void_long(color_attachment, "setStoreAction:", MTLStoreActionStore);
 
-        if (global_x < -32768 || global_x > 32767 || global_y < -32768 || global_y > 32767)
-        {
-            CANVAS_RETURN_ERR(CANVAS_FAIL, "window position out of range: %d,%d\n", global_x, global_y);
-        }
+    _MTLClearColor clear_color = make_clear_color(
+        canvas_info.canvas[window_id].clear[0],
+        canvas_info.canvas[window_id].clear[1],
+        canvas_info.canvas[window_id].clear[2],
+        canvas_info.canvas[window_id].clear[3]);
 
-        x11.XLockDisplay(x11.display);
-        x11.XMoveResizeWindow(x11.display, window,
-                              (int)global_x, (int)global_y,
-                              (unsigned int)width, (unsigned int)height);
+    msg_void_clear_color(color_attachment, "setClearColor:", clear_color);
 
-        x11.XFlush(x11.display);
-        x11.XUnlockDisplay(x11.display);
+    objc_id renderEncoder = msg_id_id_descriptor(cmdBuffer, "renderCommandEncoderWithDescriptor:", renderPassDescriptor);
+    if (!renderEncoder)
+    {
+        CANVAS_RETURN_ERR(CANVAS_FAIL, "failed to create render encoder\n");
     }
 
-    canvas_info.canvas[window_id].os_moved = false;
-    canvas_info.canvas[window_id].os_resized = false;
+    msg_void(renderEncoder, "endEncoding");
+    msg_void_id(cmdBuffer, "presentDrawable:", drawable);
+    msg_void(cmdBuffer, "commit");
+    _metal_track_submit(window_id, cmdBuffer);
 
     CANVAS_RETURN(CANVAS_OK);
 }
 
-int _canvas_init_displays()
+void _canvas_gpu_draw_all()
 {
     CANVAS_ENTER_FUNC();
-    canvas_info.display_count = 0;
 
-    if (_canvas_using_wayland)
+    if (!canvas_macos.queue)
     {
-        CANVAS_RETURN(canvas_info.display_count);
+        CANVAS_VERBOSE("no metal command queue\n");
+        CANVAS_RETURN_VOID();
     }
 
-    if (xrandr.library)
+    for (int i = 0; i < MAX_CANVAS; ++i)
     {
-        Window root = x11.XDefaultRootWindow(x11.display);
-        XRRScreenResources *sr = xrandr.XRRGetScreenResourcesCurrent(x11.display, root);
+        if (!canvas_info.canvas[i].window || !_canvas_data[i].layer)
+            continue;
 
-        if (!sr)
-        {
-            CANVAS_WARN("XRRGetScreenResourcesCurrent failed\n");
-            dlclose(xrandr.library);
-            xrandr.library = NULL;
-            goto fallback;
-        }
-
-        unsigned long primary_output = xrandr.XRRGetOutputPrimary(x11.display, root);
-
-        for (int i = 0; i < sr->ncrtc; i++)
-        {
-            if (canvas_info.display_count >= MAX_DISPLAYS)
-                break;
-
-            XRRCrtcInfo *ci = xrandr.XRRGetCrtcInfo(x11.display, sr, sr->crtcs[i]);
-
-            if (!ci || ci->width == 0 || ci->height == 0 || ci->noutput == 0)
-            {
-                if (ci)
-                    xrandr.XRRFreeCrtcInfo(ci);
-                continue;
-            }
-
-            XRROutputInfo *oi = xrandr.XRRGetOutputInfo(x11.display, sr, ci->outputs[0]);
-
-            if (!oi)
-            {
-                xrandr.XRRFreeCrtcInfo(ci);
-                continue;
-            }
-
-            double scale = 1.0;
-            if (oi->mm_width > 0 && oi->mm_height > 0)
-            {
-                double dpi_x = (double)ci->width / (oi->mm_width / 25.4);
-                double dpi_y = (double)ci->height / (oi->mm_height / 25.4);
-                double dpi = (dpi_x + dpi_y) / 2.0;
-
-                if (dpi > 140.0)
-                {
-                    scale = dpi / 96.0;
-                }
-            }
+        _canvas_update_drawable_size(i);
 
-            int refresh_rate = 60;
-            if (ci->mode != 0)
-            {
-                XRRModeInfo *modes = (XRRModeInfo *)sr->modes;
-                for (int j = 0; j < sr->nmode; j++)
-                {
-                    if (modes[j].id == ci->mode)
-                    {
-                        if (modes[j].hTotal > 0 && modes[j].vTotal > 0)
-                        {
-                            double rate = (double)modes[j].dotClock /
-                                          ((double)modes[j].hTotal * (double)modes[j].vTotal);
-                            refresh_rate = (int)(rate + 0.5);
-                        }
-                        break;
-                    }
-                }
-            }
+        objc_id layer = _canvas_data[i].layer;
+        if (!layer)
+            continue;
 
-            canvas_info.display[canvas_info.display_count].x = ci->x;
-            canvas_info.display[canvas_info.display_count].y = ci->y;
-            canvas_info.display[canvas_info.display_count].width = ci->width;
-            canvas_info.display[canvas_info.display_count].height = ci->height;
-            canvas_info.display[canvas_info.display_count].refresh_rate = refresh_rate;
-            canvas_info.display[canvas_info.display_count].scale = scale;
-            canvas_info.display[canvas_info.display_count].primary = (ci->outputs[0] == primary_output);
+        objc_id drawable = msg_id(layer, "nextDrawable");
+        if (!drawable)
+            continue;
 
-            if (refresh_rate > canvas_info.highest_refresh_rate)
-                canvas_info.highest_refresh_rate = refresh_rate;
+        objc_id texture = msg_id(drawable, "texture");
 
-            canvas_info.display_count++;
+        objc_id rpd = msg_id(cls("MTLRenderPassDescriptor"), "renderPassDescriptor");
+        objc_id caps = msg_id(rpd, "colorAttachments");
+        objc_id att0 = msg_id_ulong(caps, "objectAtIndexedSubscript:", 0UL);
 
-            xrandr.XRRFreeOutputInfo(oi);
-            xrandr.XRRFreeCrtcInfo(ci);
-        }
+        msg_void_id(att0, "setTexture:", texture);
+        msg_void_long(att0, "setLoadAction:", MTLLoadActionClear);
+        msg_void_long(att0, "setStoreAction:", MTLStoreActionStore);
 
-        xrandr.XRRFreeScreenResources(sr);
+        _MTLClearColor clear = make_clear_color(
+            canvas_info.canvas[i].clear[0],
+            canvas_info.canvas[i].clear[1],
+            canvas_info.canvas[i].clear[2],
+            canvas_info.canvas[i].clear[3]);
+        msg_void_clear_color(att0, "setClearColor:", clear);
 
-        if (canvas_info.display_count > 0)
-        {
-            dlclose(xrandr.library);
-            xrandr.library = NULL;
-            CANVAS_RETURN(canvas_info.display_count);
-        }
+        objc_id cmd = msg_id(canvas_macos.queue, "commandBuffer");
+        objc_id enc = msg_id_id_descriptor(cmd, "renderCommandEncoderWithDescriptor:", rpd);
+        msg_void(enc, "endEncoding");
 
-        dlclose(xrandr.library);
-        xrandr.library = NULL;
+        msg_void_id(cmd, "presentDrawable:", drawable);
+        msg_void(cmd, "commit");
+        _metal_track_submit(i, cmd);
     }
 
-fallback:
-
-    CANVAS_WARN("using basic X11 (single display, limited info)\n");
-    int screen = x11.XDefaultScreen(x11.display);
-
-    canvas_info.display[0].primary = true;
-    canvas_info.display[0].x = 0;
-    canvas_info.display[0].y = 0;
-    canvas_info.display[0].width = x11.XDisplayWidth(x11.display, screen);
-    canvas_info.display[0].height = x11.XDisplayHeight(x11.display, screen);
-    canvas_info.display[0].refresh_rate = 60;
-    canvas_info.display[0].scale = 1.0;
-    canvas_info.display_count = 1;
-
-    CANVAS_RETURN(canvas_info.display_count);
+    CANVAS_RETURN_VOID();
 }
 
-int _canvas_get_window_display(int window_id)
+static int _metal_upload_buffer_data(canvas_buffer *buf, void *data, size_t size)
 {
     CANVAS_ENTER_FUNC();
-    CANVAS_BOUNDS(window_id);
+    CANVAS_ASSERT(buf != NULL);
+    CANVAS_ASSERT(data != NULL);
+    CANVAS_ASSERT(size > 0);
 
-    if (_canvas_using_wayland)
+    typedef objc_id (*msg_new_buffer)(objc_id, objc_sel, unsigned long, unsigned long);
+    objc_id staging = ((msg_new_buffer)objc_msgSend)(
+        canvas_macos.device,
+        sel_c("newBufferWithLength:options:"),
+        (unsigned long)size,
+        0 // MTLResourceStorageModeShared
+    );
+
+    if (!staging)
     {
+        CANVAS_RETURN_ERR(CANVAS_FAIL, "Failed to create staging buffer\n");
     }
-    else
+
+    void *staging_ptr = msg_id(staging, "contents");
+    memcpy(staging_ptr, data, size);
+
+    objc_id cmd_buffer = msg_id(canvas_macos.queue, "commandBuffer");
+    if (!cmd_buffer)
     {
+        msg_void(staging, "release");
+        CANVAS_RETURN_ERR(CANVAS_FAIL, "Failed to create command buffer\n");
     }
 
-    CANVAS_RETURN(CANVAS_OK);
-}
-
-int _canvas_get_resize_edge_action(int window_id, int x, int y)
-{
-    CANVAS_ENTER_FUNC();
-    if (window_id < 0 || window_id >= MAX_CANVAS)
-        CANVAS_RETURN(-1);
+    objc_id blit_encoder = msg_id(cmd_buffer, "blitCommandEncoder");
+    if (!blit_encoder)
+    {
+        msg_void(staging, "release");
+        CANVAS_RETURN_ERR(CANVAS_FAIL, "Failed to create blit encoder\n");
+    }
 
-    int width = canvas_info.canvas[window_id].width;
-    int height = canvas_info.canvas[window_id].height;
-    int border = 8;
+    typedef void (*msg_copy_buffer)(objc_id, objc_sel, objc_id, unsigned long, objc_id, unsigned long, unsigned long);
+    ((msg_copy_buffer)objc_msgSend)(
+        blit_encoder,
+        sel_c("copyFromBuffer:sourceOffset:toBuffer:destinationOffset:size:"),
+        staging,
+        0UL,
+        buf->platform_handle,
+        0UL,
+        (unsigned long)size);
 
-    bool at_left = x < border;
-    bool at_right = x > width - border;
-    bool at_top = y < border;
-    bool at_bottom = y > height - border;
+    msg_void(blit_encoder, "endEncoding");
 
-    if (at_top && at_left)
-        CANVAS_RETURN(_NET_WM_MOVERESIZE_SIZE_TOPLEFT);
-    if (at_top && at_right)
-        CANVAS_RETURN(_NET_WM_MOVERESIZE_SIZE_TOPRIGHT);
-    if (at_bottom && at_left)
-        CANVAS_RETURN(_NET_WM_MOVERESIZE_SIZE_BOTTOMLEFT);
-    if (at_bottom && at_right)
-        CANVAS_RETURN(_NET_WM_MOVERESIZE_SIZE_BOTTOMRIGHT);
+    msg_void(cmd_buffer, "commit");
+    msg_void(cmd_buffer, "waitUntilCompleted");
 
-    if (at_top)
-        CANVAS_RETURN(_NET_WM_MOVERESIZE_SIZE_TOP);
-    if (at_bottom)
-        CANVAS_RETURN(_NET_WM_MOVERESIZE_SIZE_BOTTOM);
-    if (at_left)
-        CANVAS_RETURN(_NET_WM_MOVERESIZE_SIZE_LEFT);
-    if (at_right)
-        CANVAS_RETURN(_NET_WM_MOVERESIZE_SIZE_RIGHT);
+    msg_void(staging, "release");
 
-    CANVAS_RETURN(-1);
+    CANVAS_RETURN(CANVAS_OK);
 }
 
-void _canvas_start_wm_move_resize(int window_id, int x_root, int y_root, int action)
+canvas_buffer *canvas_buffer_create(int window_id, canvas_buffer_type type, canvas_buffer_usage usage, size_t size, void *initial_data)
 {
     CANVAS_ENTER_FUNC();
-    XClientMessageEvent ev = {0};
-    ev.type = X11_ClientMessage;
-    ev.window = (Window)canvas_info.canvas[window_id].window;
-    ev.message_type = _canvas_data[window_id].x11_net_wm_moveresize;
-    ev.format = 32;
-    ev.data.l[0] = x_root;
-    ev.data.l[1] = y_root;
-    ev.data.l[2] = action;
-    ev.data.l[3] = 1;
-    ev.data.l[4] = 1;
-
-    x11.XUngrabPointer(x11.display, X11_CurrentTime);
-    x11.XSendEvent(x11.display, x11.XDefaultRootWindow(x11.display), false, (1L << 20) | (1L << 19), (XEvent *)&ev);
-    x11.XFlush(x11.display);
-    CANVAS_RETURN_VOID();
-}
+    CANVAS_ASSERT_RANGE(window_id, 0, MAX_CANVAS - 1);
+    CANVAS_ASSERT(size > 0);
 
-int _canvas_window(int64_t x, int64_t y, int64_t width, int64_t height, const char *title)
-{
-    CANVAS_ENTER_FUNC();
+    CANVAS_VALID_PTR(window_id);
 
-    CANVAS_ASSERT(width > 0);
-    CANVAS_ASSERT(height > 0);
+    if (!canvas_macos.device)
+    {
+        CANVAS_RETURN_ERR(NULL, "GPU not initialized\n");
+    }
 
-    canvas_startup();
+    canvas_buffer *buf = (canvas_buffer *)calloc(1, sizeof(canvas_buffer));
+    if (!buf)
+    {
+        CANVAS_RETURN(NULL);
+    }
 
-    canvas_window_handle window = 0;
+    buf->size = size;
+    buf->type = type;
+    buf->usage = usage;
+    buf->window_id = window_id;
 
-    int window_id = _canvas_get_free();
-    if (window_id < 0)
+    size_t buffer_size = size;
+    if (usage == CANVAS_BUFFER_PER_FRAME)
     {
-        CANVAS_RETURN(window_id);
+        buf->slice_size = (size + 255) & ~(size_t)255;
+        buffer_size = buf->slice_size * MAX_FRAMES_IN_FLIGHT;
     }
-    CANVAS_ASSERT_RANGE(window_id, 0, MAX_CANVAS - 1);
-
-    canvas_info.canvas[window_id] = (canvas_type){0};
-    _canvas_data[window_id] = (canvas_data){0};
 
-#if CANVAS_VALIDATION >= 5
-    // Restore canaries after zeroing
-    canvas_info.canvas[window_id]._canary_head = CANVAS_CANARY_HEAD;
-    canvas_info.canvas[window_id]._canary_tail = CANVAS_CANARY_TAIL;
-#endif
+    unsigned long storage_mode;
 
-    if (_canvas_using_wayland)
+    if (_canvas_buffer_host_written(usage))
     {
+        storage_mode = 0; // MTLResourceStorageModeShared
     }
     else
     {
-        if (!x11.display)
-        {
-            CANVAS_RETURN_ERR(CANVAS_ERR_GET_DISPLAY, "no display connection for window creation\\n");
-        }
-
-        window = (canvas_window_handle)x11.XCreateSimpleWindow(
-            x11.display,
-            x11.XDefaultRootWindow(x11.display),
-            x, y, width, height, 0,
-            x11.XBlackPixel(x11.display, 0),
-            x11.XWhitePixel(x11.display, 0));
-
-        if (!window)
-        {
-            CANVAS_RETURN_ERR(CANVAS_ERR_GET_WINDOW, "create x11 window\\n");
-        }
-
-        _canvas_data[window_id].client_set = true;
-
-        _canvas_data[window_id].x11_wm_protocols = x11.XInternAtom(x11.display, "WM_PROTOCOLS", 0);
-        _canvas_data[window_id].x11_wm_delete_window = x11.XInternAtom(x11.display, "WM_DELETE_WINDOW", 0);
-        _canvas_data[window_id].x11_wm_state = x11.XInternAtom(x11.display, "WM_STATE", 0);
-        _canvas_data[window_id].x11_net_wm_state = x11.XInternAtom(x11.display, "_NET_WM_STATE", 0);
-        _canvas_data[window_id].x11_net_wm_state_maximized_horz = x11.XInternAtom(x11.display, "_NET_WM_STATE_MAXIMIZED_HORZ", 0);
-        _canvas_data[window_id].x11_net_wm_state_maximized_vert = x11.XInternAtom(x11.display, "_NET_WM_STATE_MAXIMIZED_VERT", 0);
-        _canvas_data[window_id].x11_net_wm_state_fullscreen = x11.XInternAtom(x11.display, "_NET_WM_STATE_FULLSCREEN", 0);
-        _canvas_data[window_id].x11_motif_wm_hints = x11.XInternAtom(x11.display, "_MOTIF_WM_HINTS", 0);
-        _canvas_data[window_id].x11_net_wm_moveresize = x11.XInternAtom(x11.display, "_NET_WM_MOVERESIZE", 0);
-        _canvas_data[window_id].x11_atoms_initialized = true;
-
-        MotifWmHints hints = {0};
-        hints.flags = MWM_HINTS_DECORATIONS;
-        hints.decorations = 0;
-
-        x11.XChangeProperty(x11.display, (Window)window,
-                            _canvas_data[window_id].x11_motif_wm_hints,
-                            _canvas_data[window_id].x11_motif_wm_hints,
-                            32, PropModeReplace,
-                            (unsigned char *)&hints, 5);
-
-        Atom window_type = x11.XInternAtom(x11.display, "_NET_WM_WINDOW_TYPE", 0);
-        Atom window_type_normal = x11.XInternAtom(x11.display, "_NET_WM_WINDOW_TYPE_NORMAL", 0);
-        x11.XChangeProperty(x11.display, (Window)window, window_type, XA_ATOM, 32, PropModeReplace, (unsigned char *)&window_type_normal, 1);
+        storage_mode = 2; // MTLResourceStorageModePrivate
+    }
 
-        x11.XSetWMProtocols(x11.display, (Window)window, &_canvas_data[window_id].x11_wm_delete_window, 1);
+    typedef objc_id (*msg_new_buffer)(objc_id, objc_sel, unsigned long, unsigned long);
+    objc_id metal_buffer = ((msg_new_buffer)objc_msgSend)(
+        canvas_macos.device,
+        sel_c("newBufferWithLength:options:"),
+        (unsigned long)buffer_size,
+        storage_mode);
 
-        long event_mask = (1L << 0) |  // KeyPressMask
-                          (1L << 1) |  // KeyReleaseMask
-                          (1L << 2) |  // ButtonPressMask
-                          (1L << 3) |  // ButtonReleaseMask
-                          (1L << 5) |  // PointerMotionMask
-                          (1L << 6) |  // PointerMotionHintMask
-                          (1L << 15) | // ExposureMask
-                          (1L << 17) | // StructureNotifyMask
-                          (1L << 19) | // FocusChangeMask
-                          (1L << 22);  // PropertyChangeMask
+    if (!metal_buffer)
+    {
+        CANVAS_ERR("Failed to create Metal buffer\n");
+        free(buf);
+        CANVAS_RETURN(NULL);
+    }
 
-        x11.XSelectInput(x11.display, (Window)window, event_mask);
+    buf->platform_handle = metal_buffer;
 
-        x11.XMapWindow(x11.display, (Window)window);
+    if (_canvas_buffer_host_written(usage))
+    {
+        buf->mapped = msg_id(metal_buffer, "contents");
+        for (uint32_t i = 0; initial_data && i < (buf->slice_size ? MAX_FRAMES_IN_FLIGHT : 1); i++)
+        {
+            memcpy((uint8_t *)buf->mapped + i * buf->slice_size, initial_data, size);
+        }
+    }
+    else if (initial_data)
+    {
+        if (_metal_upload_buffer_data(buf, initial_data, size) != CANVAS_OK)
+        {
+            CANVAS_ERR("Failed to upload private buffer data\n");
+            msg_void(metal_buffer, "release");
+            free(buf);
+            CANVAS_RETURN(NULL);
+        }
     }
 
-    canvas_info.canvas[window_id].window = (canvas_window_handle)window;
-    canvas_info.canvas[window_id].resize = false;
-    canvas_info.canvas[window_id].index = window_id;
-    canvas_info.canvas[window_id].titlebar = false;
-    canvas_info.canvas[window_id].minimized = false;
-    canvas_info.canvas[window_id].maximized = false;
-    canvas_info.canvas[window_id].fullscreen = false;
-    canvas_info.canvas[window_id]._valid = true;
-
-    CANVAS_RETURN(window_id);
+    CANVAS_RETURN(buf);
 }
 
-int _canvas_init_wayland()
+void canvas_buffer_update(canvas_buffer *buf, void *data, size_t size, size_t offset)
 {
-    wl.library = canvas_library_load(canvas_wayland_library_names, 2);
-
-    if (!wl.library)
-    {
-        CANVAS_ERR("libwayland-client.so.0 or libwayland-client.so not found");
-        return CANVAS_ERR_LOAD_LIBRARY;
-    }
-
-    LOAD_WL(wl_display_connect);
-    wl.display = wl.wl_display_connect(NULL);
+    CANVAS_ENTER_FUNC();
+    CANVAS_ASSERT_NOT_NULL(buf);
+    CANVAS_ASSERT_NOT_NULL(data);
+    CANVAS_ASSERT(size > 0);
 
-    if (!wl.display)
+    if (!buf || !data)
     {
-        CANVAS_ERR("open wayland display\n");
-        dlclose(wl.library);
-        return CANVAS_ERR_GET_DISPLAY;
+        CANVAS_RETURN_VOID();
     }
 
-    LOAD_WL(wl_display_get_registry);
-    wl.registry = wl.wl_display_get_registry(wl.display);
-
-    if (!wl.registry)
+    if (!_canvas_buffer_host_written(buf->usage))
     {
-        CANVAS_ERR("load wayland registry\n");
-        dlclose(wl.library);
-        return CANVAS_ERR_GET_DISPLAY;
+        CANVAS_WARN("Can only update dynamic buffers\n");
+        CANVAS_RETURN_VOID();
     }
 
-    LOAD_WL(wl_registry_add_listener);
-    int result = wl.wl_registry_add_listener(wl.registry, NULL, &wl);
-
-    if (!result)
+    if (offset > buf->size || size > buf->size - offset)
     {
-        CANVAS_ERR("add wayland registry\n");
-        dlclose(wl.library);
-        return CANVAS_ERR_GET_DISPLAY;
+        CANVAS_ERR("Buffer update out of bounds\n");
+        CANVAS_RETURN_VOID();
     }
 
-    LOAD_WL(wl_display_disconnect);
-    LOAD_WL(wl_display_dispatch);
-    LOAD_WL(wl_display_roundtrip);
-    LOAD_WL(wl_registry_bind);
-    LOAD_WL(wl_compositor_create_surface);
-    LOAD_WL(wl_surface_destroy);
-    LOAD_WL(wl_compositor_destroy);
-    LOAD_WL(wl_proxy_destroy);
-
-    _canvas_using_wayland = true;
-
-    return CANVAS_OK;
-}
+    uint8_t *dst = buf->usage == CANVAS_BUFFER_PER_FRAME ? _metal_frame_slice_write(buf) : (uint8_t *)buf->mapped;
+    memcpy(dst + offset, data, size);
 
-static unsigned int _canvas_get_x11_cursor_id(canvas_cursor_type cursor)
-{
-    switch (cursor)
-    {
-    case CANVAS_CURSOR_ARROW:
-        return 2; // XC_arrow
-    case CANVAS_CURSOR_TEXT:
-        return 152; // XC_xterm
-    case CANVAS_CURSOR_CROSSHAIR:
-        return 34; // XC_crosshair
-    case CANVAS_CURSOR_HAND:
-        return 58; // XC_hand2
-    case CANVAS_CURSOR_SIZE_NS:
-        return 116; // XC_sb_v_double_arrow
-    case CANVAS_CURSOR_SIZE_EW:
-        return 108; // XC_sb_h_double_arrow
-    case CANVAS_CURSOR_SIZE_NESW:
-        return 52;
-    case CANVAS_CURSOR_SIZE_NWSE:
-        return 52;
-    case CANVAS_CURSOR_SIZE_ALL:
-        return 52; // XC_fleur
-    case CANVAS_CURSOR_NOT_ALLOWED:
-        return 0; // XC_X_cursor
-    case CANVAS_CURSOR_WAIT:
-        return 150; // XC_watch
-    default:
-        return 2; // XC_arrow
-    }
+    // Synchronize shared memory (if needed on older hardware)
+    typedef void (*msg_did_modify)(objc_id, objc_sel, unsigned long, unsigned long);
+    ((msg_did_modify)objc_msgSend)(
+        buf->platform_handle,
+        sel_c("didModifyRange:"),
+        (unsigned long)(dst - (uint8_t *)buf->mapped) + offset,
+        size);
+    CANVAS_RETURN_VOID();
 }
 
-int canvas_cursor(int window_id, canvas_cursor_type cursor)
+void *canvas_buffer_map(canvas_buffer *buf)
 {
     CANVAS_ENTER_FUNC();
-    CANVAS_VALID(window_id);
 
-    if (_canvas_using_wayland)
+    if (!buf)
     {
-        CANVAS_RETURN(CANVAS_OK);
+        CANVAS_RETURN(NULL);
     }
 
-    canvas_info.canvas[window_id].cursor = cursor;
-    canvas_info.canvas[window_id].active_cursor = cursor;
-
-    if (!x11.cursors_loaded)
+    if (buf->usage == CANVAS_BUFFER_PER_FRAME)
     {
-        for (int i = 0; i < 11; i++)
-        {
-            unsigned int id = _canvas_get_x11_cursor_id((canvas_cursor_type)i);
-            x11.cursors[i] = (unsigned long)x11.XCreateFontCursor(x11.display, id);
-            if (!x11.cursors[i])
-            {
-                CANVAS_ERR("failed to create cursor %d\n", i);
-                x11.cursors[i] = (unsigned long)x11.XCreateFontCursor(x11.display, 2);
-            }
-        }
-        x11.cursors_loaded = true;
+        CANVAS_RETURN(_metal_frame_slice_write(buf));
     }
 
-    if (x11.cursors[cursor])
+    if (_canvas_buffer_host_written(buf->usage))
     {
-        x11.XDefineCursor(x11.display, (Window)canvas_info.canvas[window_id].window, x11.cursors[cursor]);
-        x11.XFlush(x11.display);
+        CANVAS_RETURN(buf->mapped); // Already mapped
     }
 
-    CANVAS_RETURN(CANVAS_OK);
+    CANVAS_WARN("Cannot map private Metal buffer\n");
+    CANVAS_RETURN(NULL);
 }
 
-static void _canvas_set_active_cursor(int window_id, canvas_cursor_type cursor)
+void canvas_buffer_unmap(canvas_buffer *buf)
 {
     CANVAS_ENTER_FUNC();
-    if (canvas_info.canvas[window_id].active_cursor == cursor)
-        CANVAS_RETURN_VOID();
-
-    canvas_info.canvas[window_id].active_cursor = cursor;
+    // Metal shared buffers are persistently mapped
+    (void)buf;
+    CANVAS_RETURN_VOID();
+}
 
-    if (!x11.cursors_loaded)
-    {
-        for (int i = 0; i < 11; i++)
-        {
-            unsigned int id = _canvas_get_x11_cursor_id((canvas_cursor_type)i);
-            x11.cursors[i] = (unsigned long)x11.XCreateFontCursor(x11.display, id);
-        }
-        x11.cursors_loaded = true;
-    }
+size_t canvas_buffer_frame_offset(canvas_buffer *buf)
+{
+    if (!buf || buf->usage != CANVAS_BUFFER_PER_FRAME)
+        return 0;
 
-    x11.XDefineCursor(x11.display, (Window)canvas_info.canvas[window_id].window, x11.cursors[cursor]);
-    x11.XFlush(x11.display);
-    CANVAS_RETURN_VOID();
+    return (size_t)_metal_frame_slice(buf) * buf->slice_size;
 }
 
-static int x11_error_handler(Display *display, XErrorEvent *error)
+// draw streams are only replayed by the vulkan backend so far
+void canvas_buffer_bind_vertex(canvas_buffer *buf, uint32_t binding)
 {
-    char error_text[256];
-    x11.XGetErrorText(display, error->error_code, error_text, sizeof(error_text));
+    (void)buf;
+    (void)binding;
+}
 
-    CANVAS_ERR("X11 Error: %s\n", error_text);
-    CANVAS_ERR("  Request code: %d\n", error->request_code);
-    CANVAS_ERR("  Minor code: %d\n", error->minor_code);
-    CANVAS_ERR("  Resource ID: %lu\n", error->resourceid);
+void canvas_buffer_bind_index(canvas_buffer *buf)
+{
+    (void)buf;
+}
 
-    return 0;
+void canvas_buffer_bind_storage(canvas_buffer *buf, uint32_t binding)
+{
+    (void)buf;
+    (void)binding;
 }
 
-int _canvas_init_x11()
+void canvas_set_pipeline(int window_id, canvas_pipeline *pipeline)
 {
-    CANVAS_ENTER_FUNC();
+    (void)window_id;
+    (void)pipeline;
+}
 
-    x11.library = canvas_library_load(canvas_x11_library_names, 2);
+void canvas_draw(int window_id, uint32_t vertex_count, uint32_t first_vertex)
+{
+    (void)window_id;
+    (void)vertex_count;
+    (void)first_vertex;
+}
 
-    if (!x11.library)
-    {
-        CANVAS_ERR("libX11.so.6 or libX11.so not found");
-        return CANVAS_ERR_LOAD_LIBRARY;
-    }
+void canvas_draw_indexed(int window_id, uint32_t index_count, uint32_t first_index, int32_t vertex_offset)
+{
+    (void)window_id;
+    (void)index_count;
+    (void)first_index;
+    (void)vertex_offset;
+}
 
-    int (*XInitThreads_ptr)(void) = dlsym(x11.library, "XInitThreads");
-    if (XInitThreads_ptr)
-    {
-        if (!XInitThreads_ptr())
-        {
-            CANVAS_WARN("XInitThreads failed - multi-threaded X11 may not work correctly\n");
-        }
-    }
-    else
-    {
-        CANVAS_WARN("XInitThreads not found - multi-threaded X11 may not work correctly\n");
-    }
+void canvas_draw_instanced(int window_id, uint32_t vertex_count, uint32_t instance_count, uint32_t first_vertex, uint32_t first_instance)
+{
+    (void)window_id;
+    (void)vertex_count;
+    (void)instance_count;
+    (void)first_vertex;
+    (void)first_instance;
+}
 
-    LOAD_X11(XOpenDisplay);
+void canvas_draw_indexed_instanced(int window_id, uint32_t index_count, uint32_t instance_count, uint32_t first_index, int32_t vertex_offset, uint32_t first_instance)
+{
+    (void)window_id;
+    (void)index_count;
+    (void)instance_count;
+    (void)first_index;
+    (void)vertex_offset;
+    (void)first_instance;
+}
 
-    x11.display = x11.XOpenDisplay(NULL);
+void canvas_draw_indirect(int window_id, canvas_buffer *args, size_t offset, uint32_t draw_count, uint32_t stride)
+{
+    (void)window_id;
+    (void)args;
+    (void)offset;
+    (void)draw_count;
+    (void)stride;
+}
 
-    if (!x11.display)
-    {
-        dlclose(x11.library);
-        CANVAS_ERR("open x11 display\\n");
-        return CANVAS_ERR_GET_DISPLAY;
-    }
+void canvas_draw_indexed_indirect(int window_id, canvas_buffer *args, size_t offset, uint32_t draw_count, uint32_t stride)
+{
+    (void)window_id;
+    (void)args;
+    (void)offset;
+    (void)draw_count;
+    (void)stride;
+}
 
-    LOAD_X11(XSetErrorHandler);
-    LOAD_X11(XGetErrorText);
+bool canvas_draw_indirect_count_supported(void)
+{
+    return false;
+}
 
-    x11.XSetErrorHandler(x11_error_handler);
+void canvas_draw_indirect_count(int window_id, canvas_buffer *args, size_t offset, canvas_buffer *count, size_t count_offset, uint32_t max_draws, uint32_t stride)
+{
+    (void)window_id;
+    (void)args;
+    (void)offset;
+    (void)count;
+    (void)count_offset;
+    (void)max_draws;
+    (void)stride;
+}
 
-    LOAD_X11(XCloseDisplay);
-    LOAD_X11(XCreateSimpleWindow);
-    LOAD_X11(XDestroyWindow);
-    LOAD_X11(XMapWindow);
-    LOAD_X11(XStoreName);
-    LOAD_X11(XSelectInput);
-    LOAD_X11(XNextEvent);
-    LOAD_X11(XSendEvent);
-    LOAD_X11(XPending);
-    LOAD_X11(XRootWindow);
-    LOAD_X11(XFlush);
-    LOAD_X11(XMoveResizeWindow);
-    LOAD_X11(XDisplayWidth);
-    LOAD_X11(XDisplayHeight);
-    LOAD_X11(XInternAtom);
-    LOAD_X11(XIconifyWindow);
-    LOAD_X11(XSetWMProtocols);
-    LOAD_X11(XBlackPixel);
-    LOAD_X11(XWhitePixel);
-    LOAD_X11(XDefaultRootWindow);
-    LOAD_X11(XDefaultScreen);
-    LOAD_X11(XChangeProperty);
-    LOAD_X11(XGetWindowAttributes);
-    LOAD_X11(XGetWindowProperty);
-    LOAD_X11(XGrabPointer);
-    LOAD_X11(XUngrabPointer);
-    LOAD_X11(XMoveWindow);
-    LOAD_X11(XCreateFontCursor);
-    LOAD_X11(XDefineCursor);
-    LOAD_X11(XFree);
-    LOAD_X11(XQueryPointer);
-    LOAD_X11(XTranslateCoordinates);
-    LOAD_X11(XFreeCursor);
-    LOAD_X11(XLockDisplay);
-    LOAD_X11(XUnlockDisplay);
+void canvas_draw_indexed_indirect_count(int window_id, canvas_buffer *args, size_t offset, canvas_buffer *count, size_t count_offset, uint32_t max_draws, uint32_t stride)
+{
+    (void)window_id;
+    (void)args;
+    (void)offset;
+    (void)count;
+    (void)count_offset;
+    (void)max_draws;
+    (void)stride;
+}
 
-    x11.internal_atom = x11.XInternAtom(x11.display, "_CANVAS_INTERNAL", false);
+void canvas_rect(int window_id, float x, float y, float width, float height, const float color[4])
+{
+    (void)window_id;
+    (void)x;
+    (void)y;
+    (void)width;
+    (void)height;
+    (void)color;
+}
 
-    xrandr.library = canvas_library_load(canvas_xrandr_library_names, 2);
+void canvas_line(int window_id, float x0, float y0, float x1, float y1, float thickness, const float color[4])
+{
+    (void)window_id;
+    (void)x0;
+    (void)y0;
+    (void)x1;
+    (void)y1;
+    (void)thickness;
+    (void)color;
+}
 
-    if (!xrandr.library)
-    {
-        CANVAS_WARN("libXrandr.so.2 or libXrandr.so not found");
-        return CANVAS_OK;
-    }
+void canvas_sprite(int window_id, canvas_image *image, float x, float y, float width, float height, const float uv[4], const float color[4])
+{
+    (void)window_id;
+    (void)image;
+    (void)x;
+    (void)y;
+    (void)width;
+    (void)height;
+    (void)uv;
+    (void)color;
+}
 
-    xrandr.XRRGetScreenResourcesCurrent = canvas_library_symbol(xrandr.library, "XRRGetScreenResourcesCurrent");
-    xrandr.XRRFreeScreenResources = canvas_library_symbol(xrandr.library, "XRRFreeScreenResources");
-    xrandr.XRRGetCrtcInfo = canvas_library_symbol(xrandr.library, "XRRGetCrtcInfo");
-    xrandr.XRRFreeCrtcInfo = canvas_library_symbol(xrandr.library, "XRRFreeCrtcInfo");
-    xrandr.XRRGetOutputInfo = canvas_library_symbol(xrandr.library, "XRRGetOutputInfo");
-    xrandr.XRRFreeOutputInfo = canvas_library_symbol(xrandr.library, "XRRFreeOutputInfo");
-    xrandr.XRRGetOutputPrimary = canvas_library_symbol(xrandr.library, "XRRGetOutputPrimary");
+void canvas_blend(int window_id, canvas_blend_mode mode)
+{
+    (void)window_id;
+    (void)mode;
+}
 
-    if (!xrandr.XRRGetScreenResourcesCurrent || !xrandr.XRRFreeScreenResources || !xrandr.XRRGetCrtcInfo || !xrandr.XRRFreeCrtcInfo || !xrandr.XRRGetOutputInfo || !xrandr.XRRFreeOutputInfo || !xrandr.XRRGetOutputPrimary)
-    {
-        dlclose(xrandr.library);
-        CANVAS_WARN("failed to load Xrandr symbols");
-        return CANVAS_OK;
-    }
+void canvas_batch_reorder(int window_id, bool allow)
+{
+    (void)window_id;
+    (void)allow;
+}
 
-    _canvas_using_wayland = false;
+canvas_readback *canvas_readback_request(int window_id)
+{
+    CANVAS_ENTER_FUNC();
+    (void)window_id;
+    CANVAS_RETURN_ERR(NULL, "frame readback needs the vulkan backend\n");
+}
 
-    CANVAS_INFO("X11 initialized successfully\\n");
-    return CANVAS_OK;
+bool canvas_readback_poll(canvas_readback *readback)
+{
+    (void)readback;
+    return false;
 }
 
-int _canvas_platform()
+int canvas_readback_wait(canvas_readback *readback, uint64_t timeout_ns)
+{
+    (void)readback;
+    (void)timeout_ns;
+    return CANVAS_INVALID;
+}
+
+void canvas_readback_release(canvas_readback *readback)
+{
+    (void)readback;
+}
+
+canvas_pipeline *canvas_pipeline_create(int window_id, const canvas_pipeline_desc *desc)
 {
     CANVAS_ENTER_FUNC();
-    if (canvas_info.init)
-    {
-        CANVAS_RETURN(CANVAS_OK);
-    }
+    (void)window_id;
+    (void)desc;
+    CANVAS_RETURN_ERR(NULL, "pipelines take SPIR-V, only the vulkan backend builds them\n");
+}
 
-    //     int load_result = _canvas_init_wayland();
+void canvas_pipeline_destroy(canvas_pipeline *pipeline)
+{
+    (void)pipeline;
+}
 
-    if (!_canvas_using_wayland && _canvas_init_x11() < 0)
-    {
-        CANVAS_RETURN(CANVAS_ERR_GET_DISPLAY);
-    }
+canvas_pipeline *canvas_compute_pipeline_create(const uint32_t *spirv, size_t size, const char *entry)
+{
+    CANVAS_ENTER_FUNC();
+    (void)spirv;
+    (void)size;
+    (void)entry;
+    CANVAS_RETURN_ERR(NULL, "compute pipelines take SPIR-V, only the vulkan backend builds them\n");
+}
 
-    CANVAS_RETURN(CANVAS_OK);
+void canvas_dispatch(int window_id, canvas_pipeline *pipeline, uint32_t x, uint32_t y, uint32_t z)
+{
+    (void)window_id;
+    (void)pipeline;
+    (void)x;
+    (void)y;
+    (void)z;
 }
 
-static canvas_cursor_type _canvas_get_resize_cursor(int action)
+void canvas_buffer_destroy(canvas_buffer *buf)
 {
     CANVAS_ENTER_FUNC();
-    canvas_cursor_type result;
-    switch (action)
+
+    if (!buf)
     {
-    case _NET_WM_MOVERESIZE_SIZE_TOPLEFT:
-        result = CANVAS_CURSOR_SIZE_NESW;
-        break;
-    case _NET_WM_MOVERESIZE_SIZE_TOPRIGHT:
-        result = CANVAS_CURSOR_SIZE_NWSE;
-        break;
-    case _NET_WM_MOVERESIZE_SIZE_BOTTOMLEFT:
-        result = CANVAS_CURSOR_SIZE_NESW;
-        break;
-    case _NET_WM_MOVERESIZE_SIZE_BOTTOMRIGHT:
-        result = CANVAS_CURSOR_SIZE_NWSE;
-        break;
-    case _NET_WM_MOVERESIZE_SIZE_TOP:
-    case _NET_WM_MOVERESIZE_SIZE_BOTTOM:
-        result = CANVAS_CURSOR_SIZE_NS;
-        break;
-    case _NET_WM_MOVERESIZE_SIZE_LEFT:
-    case _NET_WM_MOVERESIZE_SIZE_RIGHT:
-        result = CANVAS_CURSOR_SIZE_EW;
-        break;
-    default:
-        result = CANVAS_CURSOR_ARROW;
-        break;
+        CANVAS_RETURN_VOID();
     }
-    CANVAS_RETURN(result);
+
+    objc_id metal_buffer = (objc_id)buf->platform_handle;
+    msg_void(metal_buffer, "release");
+
+    free(buf);
+    CANVAS_RETURN_VOID();
 }
 
-static bool _canvas_is_window_maximized(int window_id)
+int canvas_frame_wait(int window_id, uint64_t frame, uint64_t timeout_ns)
 {
     CANVAS_ENTER_FUNC();
-    Window window = (Window)canvas_info.canvas[window_id].window;
+    CANVAS_VALID(window_id);
 
-    Atom actual_type;
-    int actual_format;
-    unsigned long nitems, bytes_after;
-    unsigned char *prop_data = NULL;
+    if (frame > canvas_info.canvas[window_id].stats.submitted)
+        CANVAS_RETURN(CANVAS_INVALID);
 
-    Atom net_wm_state = _canvas_data[window_id].x11_net_wm_state;
+    CANVAS_RETURN(_metal_wait_frame(window_id, frame, timeout_ns));
+}
 
-    int result = x11.XGetWindowProperty(
-        x11.display, window,
-        net_wm_state,
-        0, 1024, false, XA_ATOM,
-        &actual_type, &actual_format,
-        &nitems, &bytes_after,
-        &prop_data);
+int canvas_gpu_memory_stats(canvas_memory_stats *stats)
+{
+    CANVAS_ENTER_FUNC();
 
-    if (result != 0 || !prop_data)
-        CANVAS_RETURN(false);
+    if (!stats)
+        CANVAS_RETURN(CANVAS_INVALID);
 
-    Atom *atoms = (Atom *)prop_data;
-    bool horz_maximized = false;
-    bool vert_maximized = false;
+    // every buffer owns its MTLBuffer, there are no blocks to report
+    memset(stats, 0, sizeof(*stats));
+    CANVAS_RETURN(CANVAS_OK);
+}
 
-    for (unsigned long i = 0; i < nitems; i++)
-    {
-        if (atoms[i] == _canvas_data[window_id].x11_net_wm_state_maximized_horz)
-            horz_maximized = true;
-        if (atoms[i] == _canvas_data[window_id].x11_net_wm_state_maximized_vert)
-            vert_maximized = true;
-    }
+bool canvas_upload_done(uint64_t token)
+{
+    (void)token;
+    return true; // uploads wait for their command buffer
+}
 
-    x11.XFree(prop_data);
+int canvas_upload_wait(uint64_t token, uint64_t timeout_ns)
+{
+    (void)token;
+    (void)timeout_ns;
+    return CANVAS_OK;
+}
 
-    CANVAS_RETURN(horz_maximized && vert_maximized);
+void canvas_buffer_update_regions(canvas_buffer *buf, const canvas_buffer_region *regions, uint32_t count)
+{
+    for (uint32_t i = 0; regions && i < count; i++)
+        canvas_buffer_update(buf, (void *)regions[i].data, regions[i].size, regions[i].offset);
+}
+
+uint64_t canvas_upload_batch(const canvas_buffer_write *writes, uint32_t count)
+{
+    for (uint32_t i = 0; writes && i < count; i++)
+        canvas_buffer_update(writes[i].buf, (void *)writes[i].data, writes[i].size, writes[i].offset);
+
+    return 0;
 }
 
 int _canvas_update()
 {
     CANVAS_ENTER_FUNC();
-#if CANVAS_VALIDATION >= 5
-    CANVAS_ASSERT(canvas_info._canary_head == CANVAS_CANARY_HEAD);
-    CANVAS_ASSERT(canvas_info._canary_tail == CANVAS_CANARY_TAIL);
-#endif
 
-    if (_canvas_using_wayland)
+    _post_init();
+
+    if (canvas_info.display_changed)
+        _canvas_refresh_displays();
+
+    objc_id poolClass = cls("NSAutoreleasePool");
+    objc_id framePool = NULL;
+    if (poolClass)
     {
+        objc_id tmp = msg_id(poolClass, "alloc");
+        framePool = msg_id(tmp, "init");
     }
-    else
+
+    canvas_pointer *p = canvas_get_primary_pointer(0);
+
+    objc_id ns_event_class = cls("NSEvent");
+    typedef _CGRect (*msg_mouse_location)(objc_id, objc_sel);
+    _CGRect mouse_loc = ((msg_mouse_location)objc_msgSend)(ns_event_class, sel_c("mouseLocation"));
+
+    int global_x = (int)mouse_loc.x;
+    int global_y = (int)mouse_loc.y;
+
+    p->display = 0;
+    for (int d = 0; d < canvas_info.display_count; d++)
     {
-        if (!x11.display)
+        if (global_x >= canvas_info.display[d].x &&
+            global_x < canvas_info.display[d].x + canvas_info.display[d].width &&
+            global_y >= canvas_info.display[d].y &&
+            global_y < canvas_info.display[d].y + canvas_info.display[d].height)
         {
-            CANVAS_VERBOSE("no display connection for update\n");
-            CANVAS_RETURN(CANVAS_ERR_GET_DISPLAY);
+            p->display = d;
+            p->screen_x = global_x - canvas_info.display[d].x;
+            p->screen_y = canvas_info.display[d].height - (global_y - canvas_info.display[d].y);
+            break;
         }
+    }
 
-        canvas_pointer *p = canvas_get_primary_pointer(0);
-        CANVAS_ASSERT_NOT_NULL(p);
+    uint64_t now = mach_absolute_time();
+    double timestamp = (double)now * (double)canvas_macos.timebase.numer /
+                       (double)canvas_macos.timebase.denom / 1e9;
 
-        Window root_return, child_return;
-        int root_x, root_y, win_x, win_y;
-        unsigned int mask_return;
+    p->_samples[p->_sample_index].x = p->screen_x;
+    p->_samples[p->_sample_index].y = p->screen_y;
+    p->_samples[p->_sample_index].time = timestamp;
+    p->_sample_index = (p->_sample_index + 1) % CANVAS_POINTER_SAMPLE_FRAMES;
 
-        if (x11.XQueryPointer(x11.display, x11.XDefaultRootWindow(x11.display),
-                              &root_return, &child_return,
-                              &root_x, &root_y, &win_x, &win_y, &mask_return))
+    int active_window = -1;
+    bool found_window = false;
+
+    for (int i = MAX_CANVAS - 1; i >= 0; i--)
+    {
+        if (!canvas_info.canvas[i]._valid || !canvas_info.canvas[i].window)
+            continue;
+
+        objc_id window = canvas_info.canvas[i].window;
+        _CGRect frame = msg_rect(window, "frame");
+
+        int win_x = (int)frame.x;
+        int win_y = (int)frame.y;
+        int win_w = (int)frame.w;
+        int win_h = (int)frame.h;
+
+        bool is_inside = (global_x >= win_x && global_x < win_x + win_w &&
+                          global_y >= win_y && global_y < win_y + win_h);
+
+        if (is_inside && !found_window)
         {
-            p->display = 0;
-            for (int d = 0; d < canvas_info.display_count; d++)
+            active_window = i;
+            found_window = true;
+
+            p->window_id = i;
+            p->inside_window = true;
+            p->x = global_x - win_x;
+            p->y = win_h - (global_y - win_y);
+
+            objc_id ns_cursor = _canvas_get_ns_cursor(canvas_info.canvas[i].cursor);
+            if (ns_cursor)
+                msg_void(ns_cursor, "set");
+
+            break;
+        }
+    }
+
+    if (!found_window)
+    {
+        p->inside_window = false;
+        p->x = 0;
+        p->y = 0;
+    }
+
+    objc_id ns_mode = nsstring_from_cstr("kCFRunLoopDefaultMode");
+    objc_id distantPast = msg_id(cls("NSDate"), "distantPast");
+
+    for (;;)
+    {
+        objc_id ev = canvas_next_event(canvas_macos.app, ~0ULL, distantPast, ns_mode, true);
+        if (!ev)
+            break;
+
+        unsigned long eventType = msg_ulong(ev, "type");
+        objc_id eventWindow = msg_id(ev, "window");
+
+        if (eventWindow)
+        {
+            int window_idx = _canvas_window_index(eventWindow);
+            if (window_idx >= 0)
             {
-                if (root_x >= canvas_info.display[d].x &&
-                    root_x < canvas_info.display[d].x + canvas_info.display[d].width &&
-                    root_y >= canvas_info.display[d].y &&
-                    root_y < canvas_info.display[d].y + canvas_info.display[d].height)
+                switch (eventType)
                 {
-                    p->display = d;
-                    p->screen_x = root_x - canvas_info.display[d].x;
-                    p->screen_y = root_y - canvas_info.display[d].y;
+                case 1: // NSEventTypeLeftMouseDown
+                {
+                    canvas_pointer *p = canvas_get_primary_pointer(window_idx);
+                    p->buttons |= CANVAS_BUTTON_LEFT;
+                    p->buttons_pressed |= CANVAS_BUTTON_LEFT;
+                    p->window_id = window_idx;
                     break;
                 }
-            }
 
-            uint32_t old_buttons = p->buttons;
-            uint32_t new_buttons = 0;
+                case 2: // NSEventTypeLeftMouseUp
+                {
+                    canvas_pointer *p = canvas_get_primary_pointer(window_idx);
+                    p->buttons &= ~CANVAS_BUTTON_LEFT;
+                    p->buttons_released |= CANVAS_BUTTON_LEFT;
+                    break;
+                }
 
-            if (mask_return & (1 << 8))
-                new_buttons |= CANVAS_BUTTON_LEFT;
-            if (mask_return & (1 << 9))
-                new_buttons |= CANVAS_BUTTON_MIDDLE;
-            if (mask_return & (1 << 10))
-                new_buttons |= CANVAS_BUTTON_RIGHT;
-            if (mask_return & (1 << 11))
-                new_buttons |= CANVAS_BUTTON_X1;
-            if (mask_return & (1 << 12))
-                new_buttons |= CANVAS_BUTTON_X2;
+                case 3: // NSEventTypeRightMouseDown
+                {
+                    canvas_pointer *p = canvas_get_primary_pointer(window_idx);
+                    p->buttons |= CANVAS_BUTTON_RIGHT;
+                    p->buttons_pressed |= CANVAS_BUTTON_RIGHT;
+                    p->window_id = window_idx;
+                    break;
+                }
 
-            p->buttons_pressed = new_buttons & ~old_buttons;
-            p->buttons_released = old_buttons & ~new_buttons;
-            p->buttons = new_buttons;
+                case 4: // NSEventTypeRightMouseUp
+                {
+                    canvas_pointer *p = canvas_get_primary_pointer(window_idx);
+                    p->buttons &= ~CANVAS_BUTTON_RIGHT;
+                    p->buttons_released |= CANVAS_BUTTON_RIGHT;
+                    break;
+                }
 
-            struct timespec ts;
-            clock_gettime(CLOCK_MONOTONIC, &ts);
-            double timestamp = (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+                case 25: // NSEventTypeOtherMouseDown
+                {
+                    canvas_pointer *p = canvas_get_primary_pointer(window_idx);
+                    long button_number = msg_ulong(ev, "buttonNumber");
+                    if (button_number == 2)
+                    {
+                        p->buttons |= CANVAS_BUTTON_MIDDLE;
+                        p->buttons_pressed |= CANVAS_BUTTON_MIDDLE;
+                    }
+                    else if (button_number == 3)
+                    {
+                        p->buttons |= CANVAS_BUTTON_X1;
+                        p->buttons_pressed |= CANVAS_BUTTON_X1;
+                    }
+                    else if (button_number == 4)
+                    {
+                        p->buttons |= CANVAS_BUTTON_X2;
+                        p->buttons_pressed |= CANVAS_BUTTON_X2;
+                    }
+                    p->window_id = window_idx;
+                    break;
+                }
 
-            p->_samples[p->_sample_index].x = p->screen_x;
-            p->_samples[p->_sample_index].y = p->screen_y;
-            p->_samples[p->_sample_index].time = timestamp;
-            p->_sample_index = (p->_sample_index + 1) % CANVAS_POINTER_SAMPLE_FRAMES;
+                case 26: // NSEventTypeOtherMouseUp
+                {
+                    canvas_pointer *p = canvas_get_primary_pointer(window_idx);
+                    long button_number = msg_ulong(ev, "buttonNumber");
+                    if (button_number == 2)
+                    {
+                        p->buttons &= ~CANVAS_BUTTON_MIDDLE;
+                        p->buttons_released |= CANVAS_BUTTON_MIDDLE;
+                    }
+                    else if (button_number == 3)
+                    {
+                        p->buttons &= ~CANVAS_BUTTON_X1;
+                        p->buttons_released |= CANVAS_BUTTON_X1;
+                    }
+                    else if (button_number == 4)
+                    {
+                        p->buttons &= ~CANVAS_BUTTON_X2;
+                        p->buttons_released |= CANVAS_BUTTON_X2;
+                    }
+                    break;
+                }
 
-            bool found_window = false;
+                case 22: // NSEventTypeScrollWheel
+                {
+                    canvas_pointer *p = canvas_get_primary_pointer(window_idx);
+                    p->scroll_y = (float)msg_dbl(ev, "scrollingDeltaY");
+                    p->scroll_x = (float)msg_dbl(ev, "scrollingDeltaX");
+                    break;
+                }
 
-            for (int i = MAX_CANVAS - 1; i >= 0; i--)
-            {
-                if (!canvas_info.canvas[i]._valid || !canvas_info.canvas[i].window)
-                    continue;
+                case 10: // NSEventTypeKeyDown
+                case 11: // NSEventTypeKeyUp
+                case 12: // NSEventTypeFlagsChanged
+                    break;
 
-                XWindowAttributes attr;
-                if (x11.XGetWindowAttributes(x11.display, (Window)canvas_info.canvas[i].window, &attr))
+                case 6:  // NSEventTypeLeftMouseDragged
+                case 7:  // NSEventTypeRightMouseDragged
+                case 27: // NSEventTypeOtherMouseDragged
                 {
-                    Window child;
-                    int wx, wy;
-                    x11.XTranslateCoordinates(x11.display, (Window)canvas_info.canvas[i].window,
-                                              attr.root, 0, 0, &wx, &wy, &child);
-
-                    bool is_inside = (root_x >= wx && root_x < wx + attr.width &&
-                                      root_y >= wy && root_y < wy + attr.height);
+                    _CGRect frame = msg_rect(eventWindow, "frame");
 
-                    if (is_inside && !found_window)
+                    if ((int)frame.x != canvas_info.canvas[window_idx].x ||
+                        (int)frame.y != canvas_info.canvas[window_idx].y)
                     {
-                        found_window = true;
-
-                        p->window_id = i;
-                        p->inside_window = true;
-                        p->x = root_x - wx;
-                        p->y = root_y - wy;
+                        canvas_info.canvas[window_idx].os_moved = true;
+                        canvas_info.canvas[window_idx].x = (int)frame.x;
+                        canvas_info.canvas[window_idx].y = (int)frame.y;
+                    }
 
-                        if (!canvas_info.canvas[i].maximized)
-                        {
-                            int action = _canvas_get_resize_edge_action(i, p->x, p->y);
-                            if (action >= 0)
-                            {
-                                canvas_cursor_type resize_cursor = _canvas_get_resize_cursor(action);
-                                _canvas_set_active_cursor(i, resize_cursor);
-                            }
-                            else if (p->y < 30)
-                            {
-                                _canvas_set_active_cursor(i, CANVAS_CURSOR_ARROW);
-                            }
-                            else
-                            {
-                                _canvas_set_active_cursor(i, canvas_info.canvas[i].cursor);
-                            }
-                        }
-                        else
-                        {
-                            if (p->y < 30)
-                            {
-                                _canvas_set_active_cursor(i, CANVAS_CURSOR_ARROW);
-                            }
-                            else
-                            {
-                                _canvas_set_active_cursor(i, canvas_info.canvas[i].cursor);
-                            }
-                        }
+                    if ((int)frame.w != canvas_info.canvas[window_idx].width ||
+                        (int)frame.h != canvas_info.canvas[window_idx].height)
+                    {
+                        canvas_info.canvas[window_idx].resize = true;
+                        canvas_info.canvas[window_idx].os_resized = true;
+                        canvas_info.canvas[window_idx].width = (int)frame.w;
+                        canvas_info.canvas[window_idx].height = (int)frame.h;
                     }
+                    break;
+                }
                 }
             }
+        }
+
+        msg_void_id(canvas_macos.app, "sendEvent:", ev);
+    }
+
+    objc_id tracking_mode = nsstring_from_cstr("NSEventTrackingRunLoopMode");
+    for (;;)
+    {
+        objc_id ev = canvas_next_event(canvas_macos.app, ~0ULL, distantPast, tracking_mode, true);
+        if (!ev)
+            break;
+        msg_void_id(canvas_macos.app, "sendEvent:", ev);
+    }
+
+    msg_void(canvas_macos.app, "updateWindows");
+    _canvas_gpu_draw_all();
+
+    if (framePool)
+        msg_void(framePool, "drain");
+
+    CANVAS_RETURN(CANVAS_OK);
+}
+
+int _canvas_post_update()
+{
+    CANVAS_ENTER_FUNC();
+    CANVAS_RETURN(CANVAS_OK);
+}
+
+int _canvas_exit()
+{
+    CANVAS_ENTER_FUNC();
+
+    if (canvas_macos.queue)
+    {
+        ((MSG_void_id)objc_msgSend)(canvas_macos.queue, sel_c("release"));
+        canvas_macos.queue = NULL;
+    }
+    if (canvas_macos.device)
+    {
+        ((MSG_void_id)objc_msgSend)(canvas_macos.device, sel_c("release"));
+        canvas_macos.device = NULL;
+    }
+    if (canvas_macos.pool)
+    {
+        ((MSG_void_id)objc_msgSend)(canvas_macos.pool, sel_c("drain"));
+        canvas_macos.pool = NULL;
+    }
+
+    if (canvas_macos.hid_manager)
+    {
+        IOHIDManagerClose(canvas_macos.hid_manager, kIOHIDOptionsTypeNone);
+        CFRelease(canvas_macos.hid_manager);
+        canvas_macos.hid_manager = NULL;
+    }
+
+    CGDisplayRemoveReconfigurationCallback(_canvas_display_reconfigure_callback, NULL);
+    CANVAS_RETURN(CANVAS_OK);
+}
+
+static inline void _canvas_ensure_timebase()
+{
+    if (canvas_macos.timebase.denom == 0)
+        mach_timebase_info(&canvas_macos.timebase);
+}
+
+double canvas_get_time(canvas_time_data *time)
+{
+    CANVAS_ENTER_FUNC();
+    CANVAS_ASSERT(time != NULL);
+
+    _canvas_ensure_timebase();
+    uint64_t elapsed = mach_absolute_time() - time->start;
+    double result = (double)elapsed * (double)canvas_macos.timebase.numer /
+                    (double)canvas_macos.timebase.denom / 1e9;
+    CANVAS_RETURN(result);
+}
+
+void canvas_sleep(double seconds)
+{
+    CANVAS_ENTER_FUNC();
+
+    if (seconds <= 0.0)
+    {
+        CANVAS_RETURN_VOID();
+    }
+
+    struct timespec ts;
+    ts.tv_sec = (time_t)seconds;
+    double frac = seconds - (double)ts.tv_sec;
+
+    if (frac < 0.0)
+        frac = 0.0;
+    ts.tv_nsec = (long)(frac * 1e9);
+    if (ts.tv_nsec >= 1000000000L)
+    {
+        ts.tv_sec += 1;
+        ts.tv_nsec -= 1000000000L;
+    }
+
+    nanosleep(&ts, NULL);
+    CANVAS_RETURN_VOID();
+}
+
+void canvas_time_init(canvas_time_data *time)
+{
+    CANVAS_ENTER_FUNC();
+    CANVAS_ASSERT(time != NULL);
+
+    _canvas_ensure_timebase();
+
+    time->frame = 0;
+    time->frame_index = 0;
+    time->accumulator = 0;
+    time->alpha = 0;
+    time->delta = 0;
+    time->fps = 0;
+    time->raw_delta = 0;
+
+    for (int i = 0; i < 60; i++)
+        time->times[i] = 0.0;
+
+    time->start = mach_absolute_time();
+    time->current = canvas_get_time(time);
+    time->last = time->current;
+    CANVAS_RETURN_VOID();
+}
+
+#endif /* __APPLE__ */
+
+//
+//
+//
+#if defined(_WIN32) || defined(_WIN64)
+
+int canvas_minimize(int window_id)
+{
+    CANVAS_ENTER_FUNC();
+    CANVAS_VALID(window_id);
+
+    HWND window = (HWND)canvas_info.canvas[window_id].window;
+    if (!window)
+    {
+        CANVAS_RETURN_ERR(CANVAS_ERR_GET_WINDOW, "no window to minimize: %d\n", window_id);
+    }
+
+    ShowWindow(window, SW_MINIMIZE);
+    canvas_info.canvas[window_id].minimized = true;
+    canvas_info.canvas[window_id].maximized = false;
+
+    CANVAS_RETURN(CANVAS_OK);
+}
+
+int canvas_maximize(int window_id)
+{
+    CANVAS_ENTER_FUNC();
+    CANVAS_VALID(window_id);
+
+    HWND window = (HWND)canvas_info.canvas[window_id].window;
+    if (!window)
+    {
+        CANVAS_RETURN_ERR(CANVAS_ERR_GET_WINDOW, "no window to maximize: %d\n", window_id);
+    }
+
+    ShowWindow(window, SW_MAXIMIZE);
+    canvas_info.canvas[window_id].maximized = true;
+    canvas_info.canvas[window_id].minimized = false;
+
+    CANVAS_RETURN(CANVAS_OK);
+}
+
+int canvas_restore(int window_id)
+{
+    CANVAS_ENTER_FUNC();
+    CANVAS_VALID(window_id);
+
+    HWND window = (HWND)canvas_info.canvas[window_id].window;
+    if (!window)
+    {
+        CANVAS_RETURN_ERR(CANVAS_ERR_GET_WINDOW, "no window to restore: %d\n", window_id);
+    }
+
+    if (canvas_info.canvas[window_id].fullscreen)
+    {
+        SetWindowLong(window, GWL_STYLE, _canvas_data[window_id].saved_style);
+
+        HWND insertAfter = _canvas_data[window_id].saved_z_order ? _canvas_data[window_id].saved_z_order : HWND_NOTOPMOST;
+        SetWindowPos(window, insertAfter,
+                     (int)_canvas_data[window_id].saved_x,
+                     (int)_canvas_data[window_id].saved_y,
+                     (unsigned int)_canvas_data[window_id].saved_width,
+                     (unsigned int)_canvas_data[window_id].saved_height,
+                     SWP_FRAMECHANGED | SWP_SHOWWINDOW | SWP_NOACTIVATE);
+
+        ShowWindow(window, SW_NORMAL);
+    }
+    else
+    {
+        ShowWindow(window, SW_RESTORE);
+    }
+
+    canvas_info.canvas[window_id].minimized = false;
+    canvas_info.canvas[window_id].maximized = false;
+    canvas_info.canvas[window_id].fullscreen = false;
+
+    CANVAS_RETURN(CANVAS_OK);
+}
+
+int canvas_fullscreen(int window_id)
+{
+    CANVAS_ENTER_FUNC();
+    CANVAS_VALID(window_id);
+
+    HWND window = (HWND)canvas_info.canvas[window_id].window;
+    if (!window)
+    {
+        CANVAS_RETURN_ERR(CANVAS_ERR_GET_WINDOW, "no window for fullscreen: %d\n", window_id);
+    }
+
+    if (!canvas_info.canvas[window_id].fullscreen)
+    {
+        RECT rect;
+        GetWindowRect(window, &rect);
+        _canvas_data[window_id].saved_x = rect.left;
+        _canvas_data[window_id].saved_y = rect.top;
+        _canvas_data[window_id].saved_width = rect.right - rect.left;
+        _canvas_data[window_id].saved_height = rect.bottom - rect.top;
+        _canvas_data[window_id].saved_style = GetWindowLong(window, GWL_STYLE);
+        _canvas_data[window_id].saved_z_order = GetWindow(window, GW_HWNDPREV);
+
+        HMONITOR monitor = MonitorFromWindow(window, MONITOR_DEFAULTTONEAREST);
+        MONITORINFO mi = {sizeof(mi)};
+        GetMonitorInfo(monitor, &mi);
+
+        SetWindowLong(window, GWL_STYLE, WS_VISIBLE | WS_POPUP);
+        SetWindowPos(window, HWND_TOPMOST,
+                     mi.rcMonitor.left,
+                     mi.rcMonitor.top,
+                     mi.rcMonitor.right - mi.rcMonitor.left,
+                     mi.rcMonitor.bottom - mi.rcMonitor.top,
+                     SWP_FRAMECHANGED | SWP_SHOWWINDOW | SWP_NOACTIVATE);
+
+        ShowWindow(window, SW_MAXIMIZE);
+        UpdateWindow(window);
+
+        canvas_info.canvas[window_id].resize = true;
+        _canvas_window_resize(window_id);
+
+        canvas_info.canvas[window_id].fullscreen = true;
+    }
+
+    canvas_info.canvas[window_id].minimized = false;
+    canvas_info.canvas[window_id].maximized = false;
+
+    CANVAS_RETURN(CANVAS_OK);
+}
+
+int _canvas_close(int window_id)
+{
+    CANVAS_ENTER_FUNC();
+    CANVAS_BOUNDS(window_id);
+
+    if (canvas_win32.device && canvas_win32.fence && canvas_win32.cmdQueue)
+    {
+        canvas_win32.fence_value++;
+        canvas_win32.cmdQueue->lpVtbl->Signal(canvas_win32.cmdQueue, canvas_win32.fence, canvas_win32.fence_value);
+        if (canvas_win32.fence->lpVtbl->GetCompletedValue(canvas_win32.fence) < canvas_win32.fence_value)
+        {
+            canvas_win32.fence->lpVtbl->SetEventOnCompletion(canvas_win32.fence, canvas_win32.fence_value, canvas_win32.fence_event);
+            WaitForSingleObject(canvas_win32.fence_event, INFINITE);
+        }
+    }
+
+    if (canvas_info.canvas[window_id].depth_texture)
+    {
+        ID3D12Resource *depth = (ID3D12Resource *)canvas_info.canvas[window_id].depth_texture;
+        depth->lpVtbl->Release(depth);
+        canvas_info.canvas[window_id].depth_texture = NULL;
+    }
+
+    if (_canvas_data[window_id].swapChain)
+    {
+        _canvas_data[window_id].swapChain->lpVtbl->Release(_canvas_data[window_id].swapChain);
+        _canvas_data[window_id].swapChain = NULL;
+    }
+
+    for (int i = 0; i < 2; i++)
+    {
+        if (_canvas_data[window_id].backBuffers[i])
+        {
+            _canvas_data[window_id].backBuffers[i]->lpVtbl->Release(_canvas_data[window_id].backBuffers[i]);
+            _canvas_data[window_id].backBuffers[i] = NULL;
+        }
+    }
+
+    DestroyWindow((HWND)canvas_info.canvas[window_id].window);
+    CANVAS_RETURN(CANVAS_OK);
+}
+
+int _canvas_set(int window_id, int display, int64_t x, int64_t y, int64_t width, int64_t height, const char *title)
+{
+    CANVAS_ENTER_FUNC();
+    CANVAS_BOUNDS(window_id);
+
+    HWND window = (HWND)canvas_info.canvas[window_id].window;
+
+    if (!window)
+    {
+        CANVAS_RETURN_ERR(CANVAS_ERR_GET_WINDOW, "no window to set: %d\n", window_id);
+    }
+
+    if (display < 0 || display >= canvas_info.display_count)
+        display = 0;
+
+    CANVAS_DISPLAY_BOUNDS(display);
+
+    int screen_x = (int)(canvas_info.display[display].x + x);
+    int screen_y = (int)(canvas_info.display[display].y + y);
+
+    int win_width = (width == -1) ? (int)canvas_info.canvas[window_id].width : (int)width;
+    int win_height = (height == -1) ? (int)canvas_info.canvas[window_id].height : (int)height;
+
+    UINT flags = SWP_NOZORDER | SWP_NOACTIVATE | SWP_NOOWNERZORDER;
+    
+    if (win_width <= 0 || win_height <= 0)
+        flags |= SWP_NOSIZE;
+
+
+    if (!SetWindowPos(window, NULL, screen_x, screen_y, win_width, win_height, flags))
+        CANVAS_WARN("SetWindowPos failed: %lu\n", GetLastError());
+
+    if (title)
+        SetWindowTextA(window, title);
+
+    canvas_info.canvas[window_id].display = display;
+
+    CANVAS_RETURN(CANVAS_OK);
+}
+
+int _canvas_get_window_display(int window_id)
+{
+    CANVAS_ENTER_FUNC();
+    CANVAS_BOUNDS(window_id);
+
+    HWND window = (HWND)canvas_info.canvas[window_id].window;
+
+    if (!window)
+    {
+        CANVAS_RETURN_ERR(CANVAS_ERR_GET_WINDOW, "no window to set: %d\n", window_id);
+    }
+
+    HMONITOR monitor = MonitorFromWindow(window, MONITOR_DEFAULTTOPRIMARY);
+
+    for (int i = 0; i < canvas_info.display_count; i++)
+    {
+        DISPLAY_DEVICEA dd = {0};
+        dd.cb = sizeof(dd);
+
+        if (!EnumDisplayDevicesA(NULL, i, &dd, 0))
+            continue;
+
+        if (!(dd.StateFlags & DISPLAY_DEVICE_ACTIVE))
+            continue;
+
+        DEVMODEA dm = {0};
+        dm.dmSize = sizeof(dm);
+
+        if (!EnumDisplaySettingsA(dd.DeviceName, ENUM_CURRENT_SETTINGS, &dm))
+            continue;
+
+        MONITORINFOEXA mi = {0};
+        mi.cbSize = sizeof(mi);
+
+        if (!GetMonitorInfoA(monitor, (MONITORINFO *)&mi))
+            continue;
+
+        if (strcmp(mi.szDevice, dd.DeviceName) != 0)
+            continue;
+
+        canvas_info.canvas[window_id].display = i;
+        CANVAS_RETURN(i);
+    }
+
+    CANVAS_RETURN(CANVAS_OK);
+}
+
+int _canvas_refresh_displays()
+{
+    CANVAS_ENTER_FUNC();
+
+    canvas_info.display_count = 0;
+    canvas_info.display_changed = false;
+    canvas_info.highest_refresh_rate = 0;
+
+    for (int i = 0; i < MAX_DISPLAYS; i++)
+    {
+        DISPLAY_DEVICEA dd = {0};
+        dd.cb = sizeof(dd);
+
+        if (!EnumDisplayDevicesA(NULL, i, &dd, 0))
+            continue;
+
+        if (!(dd.StateFlags & DISPLAY_DEVICE_ACTIVE))
+            continue;
+
+        DEVMODEA dm = {0};
+        dm.dmSize = sizeof(dm);
+
+        if (!EnumDisplaySettingsA(dd.DeviceName, ENUM_CURRENT_SETTINGS, &dm))
+            continue;
+
+        POINT pt = {dm.dmPosition.x + 1, dm.dmPosition.y + 1};
+        HMONITOR monitor = MonitorFromPoint(pt, MONITOR_DEFAULTTONEAREST);
+
+        canvas_win32.monitors[i] = monitor;
+
+        canvas_info.display[i].primary = (dd.StateFlags & DISPLAY_DEVICE_PRIMARY_DEVICE) != 0;
+        canvas_info.display[i].x = dm.dmPosition.x;
+        canvas_info.display[i].y = dm.dmPosition.y;
+        canvas_info.display[i].width = dm.dmPelsWidth;
+        canvas_info.display[i].height = dm.dmPelsHeight;
+        canvas_info.display[i].refresh_rate = dm.dmDisplayFrequency;
+
+        if (dm.dmDisplayFrequency > canvas_info.highest_refresh_rate)
+            canvas_info.highest_refresh_rate = dm.dmDisplayFrequency;
+
+        canvas_info.display_count++;
+    }
+
+    for (int i = 0; i < MAX_CANVAS; i++)
+    {
+        if (canvas_info.canvas[i].window)
+            _canvas_get_window_display(i);
+    }
+
+    CANVAS_RETURN(canvas_info.display_count);
+}
+int _canvas_init_displays()
+{
+    CANVAS_ENTER_FUNC();
+
+    canvas_info.display_count = 0;
+
+    // SetProcessDpiAwarenessContext(DPI_AWARENESS_CONTEXT_PER_MONITOR_AWARE_V2);
+
+    int result = _canvas_refresh_displays();
+    CANVAS_RETURN(result);
+}
+
+double canvas_get_time(canvas_time_data *time)
+{
+    CANVAS_ENTER_FUNC();
+    CANVAS_ASSERT(time != NULL);
+
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+    double result = (double)((uint64_t)counter.QuadPart - time->start) /
+                    (double)_canvas_qpc_frequency.QuadPart;
+    CANVAS_RETURN(result);
+}
+
+void canvas_sleep(double seconds)
+{
+    CANVAS_ENTER_FUNC();
+
+    HANDLE timer = CreateWaitableTimer(NULL, TRUE, NULL);
+    if (timer)
+    {
+        LARGE_INTEGER li;
+        li.QuadPart = -(LONGLONG)(seconds * 10000000.0); // 100ns units
+        SetWaitableTimer(timer, &li, 0, NULL, NULL, FALSE);
+        WaitForSingleObject(timer, INFINITE);
+        CloseHandle(timer);
+    }
+
+    CANVAS_RETURN_VOID();
+}
+
+void canvas_time_init(canvas_time_data *time)
+{
+    CANVAS_ENTER_FUNC();
+    CANVAS_ASSERT(time != NULL);
+
+    time->frame = 0;
+    time->frame_index = 0;
+    time->accumulator = 0;
+    time->alpha = 0;
+    time->delta = 0;
+    time->fps = 0;
+    time->raw_delta = 0;
+
+    for (int i = 0; i < 60; i++)
+        time->times[i] = 0.0;
+
+    QueryPerformanceFrequency(&_canvas_qpc_frequency);
+
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+
+    time->start = (uint64_t)counter.QuadPart;
+    time->current = canvas_get_time(time);
+    time->last = time->current;
+    CANVAS_RETURN_VOID();
+}
+
+HCURSOR _canvas_get_win32_cursor(canvas_cursor_type cursor)
+{
+    CANVAS_ENTER_FUNC();
+
+    LPCTSTR cursor_name;
+
+    switch (cursor)
+    {
+    case CANVAS_CURSOR_ARROW:
+        cursor_name = IDC_ARROW;
+        break;
+    case CANVAS_CURSOR_TEXT:
+        cursor_name = IDC_IBEAM;
+        break;
+    case CANVAS_CURSOR_CROSSHAIR:
+        cursor_name = IDC_CROSS;
+        break;
+    case CANVAS_CURSOR_HAND:
+        cursor_name = IDC_HAND;
+        break;
+    case CANVAS_CURSOR_SIZE_NS:
+        cursor_name = IDC_SIZENS;
+        break;
+    case CANVAS_CURSOR_SIZE_EW:
+        cursor_name = IDC_SIZEWE;
+        break;
+    case CANVAS_CURSOR_SIZE_NESW:
+        cursor_name = IDC_SIZENESW;
+        break;
+    case CANVAS_CURSOR_SIZE_NWSE:
+        cursor_name = IDC_SIZENWSE;
+        break;
+    case CANVAS_CURSOR_SIZE_ALL:
+        cursor_name = IDC_SIZEALL;
+        break;
+    case CANVAS_CURSOR_NOT_ALLOWED:
+        cursor_name = IDC_NO;
+        break;
+    case CANVAS_CURSOR_WAIT:
+        cursor_name = IDC_WAIT;
+        break;
+    default:
+        cursor_name = IDC_ARROW;
+        break;
+    }
+
+    HCURSOR result = LoadCursor(NULL, cursor_name);
+    CANVAS_RETURN(result);
+}
+
+int canvas_cursor(int window_id, canvas_cursor_type cursor)
+{
+    CANVAS_ENTER_FUNC();
+    CANVAS_VALID(window_id);
+
+    canvas_info.canvas[window_id].cursor = cursor;
+    SetCursor(_canvas_get_win32_cursor(cursor));
+
+    CANVAS_RETURN(CANVAS_OK);
+}
+
+LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
+{
+    int window_index = _canvas_window_index(hwnd);
+
+    if (window_index < 0)
+        return DefWindowProc(hwnd, msg, wParam, lParam);
+
+    switch (msg)
+    {
+    case WM_MOUSEWHEEL:
+    {
+        canvas_pointer *p = canvas_get_primary_pointer(window_index);
+        short delta = GET_WHEEL_DELTA_WPARAM(wParam);
+        p->scroll_y = (float)delta / 120.0f;
+        return 0;
+    }
+
+    case WM_MOUSEHWHEEL:
+    {
+        canvas_pointer *p = canvas_get_primary_pointer(window_index);
+        short delta = GET_WHEEL_DELTA_WPARAM(wParam);
+        p->scroll_x = (float)delta / 120.0f;
+        return 0;
+    }
+
+    case WM_SETCURSOR:
+    {
+        if (LOWORD(lParam) == HTCLIENT)
+        {
+            SetCursor(_canvas_get_win32_cursor(canvas_info.canvas[window_index].cursor));
+            return TRUE;
+        }
+        break;
+    }
+
+    case WM_CREATE:
+    {
+        if (!canvas_info.canvas[window_index].titlebar)
+        {
+            DWM_WINDOW_CORNER_PREFERENCE corner = DWMWCP_ROUND;
+            DwmSetWindowAttribute(hwnd, DWMWA_WINDOW_CORNER_PREFERENCE, &corner, sizeof(corner));
+
+            enum DWM_SYSTEMBACKDROP_TYPE backdrop = DWMSBT_MAINWINDOW;
+            DwmSetWindowAttribute(hwnd, DWMWA_SYSTEMBACKDROP_TYPE, &backdrop, sizeof(backdrop));
+        }
+        return CANVAS_OK;
+    }
+
+    case WM_NCCALCSIZE:
+    {
+        if (canvas_info.canvas[window_index].fullscreen)
+            break;
+
+        if (wParam == true && !canvas_info.canvas[window_index].titlebar)
+        {
+            NCCALCSIZE_PARAMS *params = (NCCALCSIZE_PARAMS *)lParam;
+
+            params->rgrc[0].top += 1;
+            params->rgrc[0].right -= 8;
+            params->rgrc[0].bottom -= 8;
+            params->rgrc[0].left += 8;
+            return 0;
+        }
+        break;
+    }
+
+    case WM_NCHITTEST:
+    {
+        if (canvas_info.canvas[window_index].fullscreen)
+            break;
+
+        if (!canvas_info.canvas[window_index].titlebar)
+        {
+            LRESULT hit = DefWindowProc(hwnd, msg, wParam, lParam);
+
+            if (hit == HTCLIENT)
+            {
+                POINT pt = {LOWORD(lParam), HIWORD(lParam)};
+                ScreenToClient(hwnd, &pt);
+
+                RECT rcWindow;
+                GetClientRect(hwnd, &rcWindow);
+
+                if (pt.y < 30 && pt.y >= 0)
+                {
+                    return HTCAPTION;
+                }
+            }
+
+            return hit;
+        }
+
+        break;
+    }
+
+    case WM_DISPLAYCHANGE:
+    {
+        canvas_info.canvas[window_index].os_moved = true;
+        canvas_info.display_changed = true;
+        return CANVAS_OK;
+    }
+
+    case WM_MOVE:
+    {
+        // _canvas_update_window_display(window_index);
+
+        return CANVAS_OK;
+    }
+
+    case WM_MOVING:
+    {
+
+        return CANVAS_OK;
+    }
+
+    case WM_SIZE:
+    {
+
+        if (wParam != SIZE_MINIMIZED)
+        {
+            UINT width = LOWORD(lParam);
+            UINT height = HIWORD(lParam);
+            if (width > 0 && height > 0)
+            {
+                canvas_info.canvas[window_index].width = width;
+                canvas_info.canvas[window_index].height = height;
+                canvas_info.canvas[window_index].resize = true;
+                canvas_info.canvas[window_index].os_resized = true;
+            }
+
+            if (!canvas_info.os_timed)
+            {
+                InvalidateRect(hwnd, NULL, FALSE);
+            }
+        }
+        return CANVAS_OK;
+    }
+
+    case WM_SIZING:
+    {
+
+        canvas_info.canvas[window_index].os_resized = true;
+
+        /* TODO
+            RECT *rect = (RECT *)lParam;
+            UINT width = rect->right - rect->left;
+            UINT height = rect->bottom - rect->top;
+
+            RECT client;
+            GetClientRect(hwnd, &client);
+            width = client.right - client.left;
+            height = client.bottom - client.top;
+
+            if (width > 0 && height > 0)
+            {
+                canvas_info.canvas[window_index].resize = true;
+                _canvas_window_resize(window_index);
+                _canvas_update();
+            }
+                */
+
+        return TRUE;
+    }
+
+    case WM_ENTERSIZEMOVE:
+    {
+        if (canvas_info.os_timed)
+            break;
+
+        canvas_info.os_timed = true;
+        timeBeginPeriod(1);
+        SetTimer(hwnd, 1, 0, NULL);
+        return CANVAS_OK;
+    }
+
+    case WM_EXITSIZEMOVE:
+    {
+        if (!canvas_info.os_timed)
+            break;
+
+        canvas_info.os_timed = false;
+        KillTimer(hwnd, 1);
+        timeEndPeriod(1);
+        return CANVAS_OK;
+    }
+
+    case WM_TIMER:
+    {
+        if (wParam != 1)
+            break;
+
+        canvas_main_loop();
+
+        return CANVAS_OK;
+    }
+
+    case WM_SYSCOMMAND:
+    {
+        if (wParam == SC_MINIMIZE)
+            canvas_info.canvas[window_index].minimized = true;
+        else if (wParam == SC_MAXIMIZE)
+            canvas_info.canvas[window_index].maximized = true;
+        else if (wParam == SC_RESTORE)
+        {
+            canvas_info.canvas[window_index].minimized = false;
+            canvas_info.canvas[window_index].maximized = false;
+        }
+        break;
+    }
+
+    case WM_KEYDOWN:
+    case WM_SYSKEYDOWN:
+    {
+        int scancode = (lParam >> 16) & 0xFF;
+        bool extended = (lParam >> 24) & 1;
+
+        if (extended)
+        {
+            if (scancode == 0x1D)
+                scancode = 0xE01D;
+            else if (scancode == 0x38)
+                scancode = 0xE038;
+            else
+                scancode |= 0xE000;
+        }
+
+        int hid = 0;
+        if (scancode < 128)
+            hid = win32_to_hid[scancode];
+        else if (scancode == 0xE01D)
+            hid = 228;
+        else if (scancode == 0xE038)
+            hid = 230;
+        else if (scancode == 0xE05B)
+            hid = 227;
+        else if (scancode == 0xE05C)
+            hid = 231;
+
+        if (hid > 0 && hid < 256 && !canvas_keyboard.keys[hid])
+        {
+            canvas_keyboard.keys[hid] = true;
+            canvas_keyboard.keys_pressed[hid] = true;
+        }
+        return 0;
+    }
+
+    case WM_KEYUP:
+    case WM_SYSKEYUP:
+    {
+        int scancode = (lParam >> 16) & 0xFF;
+        bool extended = (lParam >> 24) & 1;
+
+        if (extended)
+        {
+            if (scancode == 0x1D)
+                scancode = 0xE01D;
+            else if (scancode == 0x38)
+                scancode = 0xE038;
+            else
+                scancode |= 0xE000;
+        }
+
+        int hid = 0;
+        if (scancode < 128)
+            hid = win32_to_hid[scancode];
+        else if (scancode == 0xE01D)
+            hid = 228;
+        else if (scancode == 0xE038)
+            hid = 230;
+        else if (scancode == 0xE05B)
+            hid = 227;
+        else if (scancode == 0xE05C)
+            hid = 231;
+
+        if (hid > 0 && hid < 256 && canvas_keyboard.keys[hid])
+        {
+            canvas_keyboard.keys[hid] = false;
+            canvas_keyboard.keys_released[hid] = true;
+        }
+        return 0;
+    }
+
+    case WM_CLOSE:
+    {
+        canvas_info.canvas[window_index].close = true;
+
+        if (canvas_info.os_timed)
+        {
+            KillTimer(hwnd, 1);
+            timeEndPeriod(1);
+            canvas_info.os_timed = false;
+        }
+
+        return 0;
+    }
+
+    case WM_DESTROY:
+        PostQuitMessage(0);
+    }
+
+    return DefWindowProc(hwnd, msg, wParam, lParam);
+}
+
+int _canvas_window(int64_t x, int64_t y, int64_t width, int64_t height, const char *title)
+{
+    canvas_startup();
+
+    int window_id = _canvas_get_free();
+    if (window_id < 0)
+        return window_id;
+
+    DWORD style = WS_SYSMENU | WS_MINIMIZEBOX | WS_MAXIMIZEBOX | WS_THICKFRAME | WS_VISIBLE;
+
+    canvas_info.canvas[window_id].index = window_id;
+
+    HWND window = CreateWindowA("CanvasWindowClass", title, style, x, y, width, height, NULL, NULL, canvas_win32.instance, NULL);
+
+    if (!window)
+    {
+        CANVAS_ERR("create win32 window");
+        return CANVAS_ERR_GET_WINDOW;
+    }
+
+    RAWINPUTDEVICE rid;
+    rid.usUsagePage = 0x01; // HID_USAGE_PAGE_GENERIC
+    rid.usUsage = 0x02;     // HID_USAGE_GENERIC_MOUSE
+    rid.dwFlags = 0;        // 0 = get input only when focused
+    rid.hwndTarget = window;
+
+    if (!RegisterRawInputDevices(&rid, 1, sizeof(rid)))
+        CANVAS_WARN("failed to register raw input (error: %lu)\n", GetLastError());
+
+    canvas_info.canvas[window_id].window = window;
+    canvas_info.canvas[window_id].resize = false;
+    canvas_info.canvas[window_id].titlebar = false;
+    canvas_info.canvas[window_id].minimized = false;
+    canvas_info.canvas[window_id].maximized = false;
+    canvas_info.canvas[window_id].fullscreen = false;
+    canvas_info.canvas[window_id]._valid = true;
+
+    return window_id;
+}
+
+int _canvas_platform()
+{
+    CANVAS_ENTER_FUNC();
+
+    canvas_win32.instance = GetModuleHandle(NULL);
+
+    WNDCLASSA wc = {0};
+    wc.style = CS_HREDRAW | CS_VREDRAW | CS_DBLCLKS;
+    wc.lpfnWndProc = WndProc;
+    wc.hInstance = canvas_win32.instance;
+    wc.hCursor = LoadCursor(NULL, IDC_ARROW);
+    wc.hbrBackground = NULL;
+    wc.lpszClassName = "CanvasWindowClass";
+
+    canvas_win32.class = RegisterClassA(&wc);
+
+    if (!canvas_win32.class)
+    {
+        CANVAS_RETURN_ERR(CANVAS_ERR_GET_PLATFORM, "register windows class failed");
+    }
+
+    CANVAS_RETURN(CANVAS_OK);
+}
+
+int _canvas_update()
+{
+    CANVAS_ENTER_FUNC();
+
+    canvas_pointer *p = canvas_get_primary_pointer(0);
+
+    POINT abs_screen_pt;
+    if (GetCursorPos(&abs_screen_pt))
+    {
+        HMONITOR monitor = MonitorFromPoint(abs_screen_pt, MONITOR_DEFAULTTONEAREST);
+        p->display = 0;
+
+        for (int d = 0; d < canvas_info.display_count; d++)
+        {
+            if (canvas_win32.monitors[d] == monitor)
+            {
+                p->display = d;
+                p->screen_x = abs_screen_pt.x - canvas_info.display[d].x;
+                p->screen_y = abs_screen_pt.y - canvas_info.display[d].y;
+                break;
+            }
+        }
+
+        uint32_t old_buttons = p->buttons;
+        uint32_t new_buttons = 0;
+
+        if (GetAsyncKeyState(VK_LBUTTON) & 0x8000)
+            new_buttons |= CANVAS_BUTTON_LEFT;
+        if (GetAsyncKeyState(VK_RBUTTON) & 0x8000)
+            new_buttons |= CANVAS_BUTTON_RIGHT;
+        if (GetAsyncKeyState(VK_MBUTTON) & 0x8000)
+            new_buttons |= CANVAS_BUTTON_MIDDLE;
+        if (GetAsyncKeyState(VK_XBUTTON1) & 0x8000)
+            new_buttons |= CANVAS_BUTTON_X1;
+        if (GetAsyncKeyState(VK_XBUTTON2) & 0x8000)
+            new_buttons |= CANVAS_BUTTON_X2;
+
+        p->buttons_pressed = new_buttons & ~old_buttons;
+        p->buttons_released = old_buttons & ~new_buttons;
+        p->buttons = new_buttons;
+
+        LARGE_INTEGER counter;
+        QueryPerformanceCounter(&counter);
+        double timestamp = (double)counter.QuadPart / (double)_canvas_qpc_frequency.QuadPart;
+
+        p->_samples[p->_sample_index].x = p->screen_x;
+        p->_samples[p->_sample_index].y = p->screen_y;
+        p->_samples[p->_sample_index].time = timestamp;
+        p->_sample_index = (p->_sample_index + 1) % CANVAS_POINTER_SAMPLE_FRAMES;
+
+        HWND hwnd_at_point = WindowFromPoint(abs_screen_pt);
+        int active_window = -1;
+        bool found_window = false;
+
+        for (int i = 0; i < MAX_CANVAS; i++)
+        {
+            if (!canvas_info.canvas[i]._valid || !canvas_info.canvas[i].window)
+                continue;
+
+            HWND hwnd = (HWND)canvas_info.canvas[i].window;
+
+            if (hwnd == hwnd_at_point || IsChild(hwnd, hwnd_at_point))
+            {
+                active_window = i;
+                found_window = true;
+
+                POINT client_pt = abs_screen_pt;
+                ScreenToClient(hwnd, &client_pt);
+
+                p->window_id = i;
+                p->inside_window = true;
+                p->x = client_pt.x;
+                p->y = client_pt.y;
+
+                break;
+            }
+        }
+
+        if (!found_window)
+        {
+            p->inside_window = false;
+            p->x = 0;
+            p->y = 0;
+        }
+    }
+
+    MSG msg;
+    while (PeekMessage(&msg, NULL, 0, 0, PM_REMOVE))
+    {
+        TranslateMessage(&msg);
+        DispatchMessage(&msg);
+    }
+
+    if (canvas_win32.device)
+    {
+        for (int i = 0; i < MAX_CANVAS; ++i)
+        {
+            if (canvas_info.canvas[i].resize)
+            {
+                _canvas_window_resize(i);
+            }
+        }
+
+        canvas_win32.cmdAllocator->lpVtbl->Reset(canvas_win32.cmdAllocator);
+        canvas_win32.cmdList->lpVtbl->Reset(canvas_win32.cmdList, canvas_win32.cmdAllocator, NULL);
+
+        for (int i = 0; i < MAX_CANVAS; ++i)
+        {
+            if (canvas_info.canvas[i].window == NULL ||
+                _canvas_data[i].swapChain == NULL ||
+                _canvas_data[i].backBuffers[0] == NULL)
+                continue;
+
+            UINT backBufferIndex = _canvas_data[i].swapChain->lpVtbl->GetCurrentBackBufferIndex(_canvas_data[i].swapChain);
+
+            D3D12_RESOURCE_BARRIER barrier = {0};
+            barrier.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
+            barrier.Transition.pResource = _canvas_data[i].backBuffers[backBufferIndex];
+            barrier.Transition.StateBefore = D3D12_RESOURCE_STATE_PRESENT;
+            barrier.Transition.StateAfter = D3D12_RESOURCE_STATE_RENDER_TARGET;
+            barrier.Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
+            canvas_win32.cmdList->lpVtbl->ResourceBarrier(canvas_win32.cmdList, 1, &barrier);
+
+            canvas_win32.cmdList->lpVtbl->ClearRenderTargetView(canvas_win32.cmdList, _canvas_data[i].rtvHandles[backBufferIndex], canvas_info.canvas[i].clear, 0, NULL);
+
+            barrier.Transition.StateBefore = D3D12_RESOURCE_STATE_RENDER_TARGET;
+            barrier.Transition.StateAfter = D3D12_RESOURCE_STATE_PRESENT;
+            canvas_win32.cmdList->lpVtbl->ResourceBarrier(canvas_win32.cmdList, 1, &barrier);
+        }
+
+        canvas_win32.cmdList->lpVtbl->Close(canvas_win32.cmdList);
+        ID3D12CommandList *cmdLists[] = {(ID3D12CommandList *)canvas_win32.cmdList};
+        canvas_win32.cmdQueue->lpVtbl->ExecuteCommandLists(canvas_win32.cmdQueue, 1, cmdLists);
+
+        for (int i = 0; i < MAX_CANVAS; ++i)
+        {
+            if (_canvas_data[i].swapChain != NULL)
+            {
+                if (canvas_info.canvas[i].vsync)
+                {
+                    _canvas_data[i].swapChain->lpVtbl->Present(_canvas_data[i].swapChain, 1, 0);
+                }
+                else
+                {
+                    _canvas_data[i].swapChain->lpVtbl->Present(_canvas_data[i].swapChain, 0, DXGI_PRESENT_ALLOW_TEARING);
+                }
+            }
+        }
+
+        canvas_win32.fence_value++;
+        canvas_win32.cmdQueue->lpVtbl->Signal(canvas_win32.cmdQueue, canvas_win32.fence, canvas_win32.fence_value);
+        if (canvas_win32.fence->lpVtbl->GetCompletedValue(canvas_win32.fence) < canvas_win32.fence_value)
+        {
+            canvas_win32.fence->lpVtbl->SetEventOnCompletion(canvas_win32.fence, canvas_win32.fence_value, canvas_win32.fence_event);
+            WaitForSingleObject(canvas_win32.fence_event, INFINITE);
+        }
+    }
+
+    CANVAS_RETURN(CANVAS_OK);
+}
+
+int _canvas_gpu_init()
+{
+    CANVAS_ENTER_FUNC();
+
+    if (canvas_info.init_gpu)
+    {
+        CANVAS_RETURN(CANVAS_OK);
+    }
+
+    canvas_info.init_gpu = 1;
+
+    HRESULT result;
+
+    result = CreateDXGIFactory1(&IID_IDXGIFactory4, (void **)&canvas_win32.factory);
+    if (FAILED(result))
+    {
+        CANVAS_ERR("create dx12 factory failed (HRESULT: 0x%08lX)\n", result);
+        return CANVAS_ERR_GET_GPU;
+    }
+
+    result = D3D12CreateDevice(NULL, D3D_FEATURE_LEVEL_11_0, &IID_ID3D12Device, (void **)&canvas_win32.device);
+    if (FAILED(result))
+    {
+        CANVAS_ERR("create dx12 device failed (HRESULT: 0x%08lX)\n", result);
+        canvas_win32.factory->lpVtbl->Release(canvas_win32.factory);
+        canvas_win32.factory = NULL;
+        return CANVAS_ERR_GET_GPU;
+    }
+
+    D3D12_COMMAND_QUEUE_DESC queueDesc = {0};
+    queueDesc.Type = D3D12_COMMAND_LIST_TYPE_DIRECT;
+
+    result = canvas_win32.device->lpVtbl->CreateCommandQueue(canvas_win32.device, &queueDesc, &IID_ID3D12CommandQueue, (void **)&canvas_win32.cmdQueue);
+    if (FAILED(result))
+    {
+        CANVAS_ERR("create command queue failed (HRESULT: 0x%08lX)\n", result);
+        goto cleanup_gpu;
+    }
+
+    result = canvas_win32.device->lpVtbl->CreateCommandAllocator(canvas_win32.device, D3D12_COMMAND_LIST_TYPE_DIRECT, &IID_ID3D12CommandAllocator, (void **)&canvas_win32.cmdAllocator);
+    if (FAILED(result))
+    {
+        CANVAS_ERR("create command allocator failed (HRESULT: 0x%08lX)\n", result);
+        goto cleanup_gpu;
+    }
+
+    result = canvas_win32.device->lpVtbl->CreateCommandList(canvas_win32.device, 0, D3D12_COMMAND_LIST_TYPE_DIRECT, canvas_win32.cmdAllocator, NULL, &IID_ID3D12GraphicsCommandList, (void **)&canvas_win32.cmdList);
+    if (FAILED(result))
+    {
+        CANVAS_ERR("create command list failed (HRESULT: 0x%08lX)\n", result);
+        goto cleanup_gpu;
+    }
+
+    canvas_win32.cmdList->lpVtbl->Close(canvas_win32.cmdList);
+
+    D3D12_DESCRIPTOR_HEAP_DESC heapDesc = {0};
+    heapDesc.NumDescriptors = MAX_CANVAS * 2;
+    heapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_RTV;
+
+    result = canvas_win32.device->lpVtbl->CreateDescriptorHeap(canvas_win32.device, &heapDesc, &IID_ID3D12DescriptorHeap, (void **)&canvas_win32.rtvHeap);
+    if (FAILED(result))
+    {
+        CANVAS_ERR("create descriptor heap failed (HRESULT: 0x%08lX)\n", result);
+        goto cleanup_gpu;
+    }
+
+    canvas_win32.rtvDescriptorSize = canvas_win32.device->lpVtbl->GetDescriptorHandleIncrementSize(canvas_win32.device, D3D12_DESCRIPTOR_HEAP_TYPE_RTV);
+
+    result = canvas_win32.device->lpVtbl->CreateFence(canvas_win32.device, 0, D3D12_FENCE_FLAG_NONE, &IID_ID3D12Fence, (void **)&canvas_win32.fence);
+    if (FAILED(result))
+    {
+        CANVAS_ERR("create fence failed (HRESULT: 0x%08lX)\n", result);
+        goto cleanup_gpu;
+    }
+
+    canvas_win32.fence_event = CreateEvent(NULL, FALSE, FALSE, NULL);
+    if (!canvas_win32.fence_event)
+    {
+        CANVAS_ERR("create fence event failed (GetLastError: %lu)\n", GetLastError());
+        goto cleanup_gpu;
+    }
+
+    return CANVAS_OK;
+
+cleanup_gpu:
+    if (canvas_win32.fence)
+    {
+        canvas_win32.fence->lpVtbl->Release(canvas_win32.fence);
+        canvas_win32.fence = NULL;
+    }
+    if (canvas_win32.rtvHeap)
+    {
+        canvas_win32.rtvHeap->lpVtbl->Release(canvas_win32.rtvHeap);
+        canvas_win32.rtvHeap = NULL;
+    }
+    if (canvas_win32.cmdList)
+    {
+        canvas_win32.cmdList->lpVtbl->Release(canvas_win32.cmdList);
+        canvas_win32.cmdList = NULL;
+    }
+    if (canvas_win32.cmdAllocator)
+    {
+        canvas_win32.cmdAllocator->lpVtbl->Release(canvas_win32.cmdAllocator);
+        canvas_win32.cmdAllocator = NULL;
+    }
+    if (canvas_win32.cmdQueue)
+    {
+        canvas_win32.cmdQueue->lpVtbl->Release(canvas_win32.cmdQueue);
+        canvas_win32.cmdQueue = NULL;
+    }
+    if (canvas_win32.device)
+    {
+        canvas_win32.device->lpVtbl->Release(canvas_win32.device);
+        canvas_win32.device = NULL;
+    }
+    if (canvas_win32.factory)
+    {
+        canvas_win32.factory->lpVtbl->Release(canvas_win32.factory);
+        canvas_win32.factory = NULL;
+    }
+
+    canvas_info.init_gpu = 0;
+    CANVAS_RETURN(CANVAS_ERR_GET_GPU);
+}
+
+int _canvas_gpu_new_offscreen(int window_id, canvas_format format)
+{
+    CANVAS_ENTER_FUNC();
+    (void)window_id;
+    (void)format;
+    CANVAS_RETURN_ERR(CANVAS_FAIL, "offscreen canvases need the vulkan backend\n");
+}
+
+int _canvas_gpu_new_window(int window_id)
+{
+    CANVAS_ENTER_FUNC();
+    CANVAS_BOUNDS(window_id);
+
+    _canvas_data[window_id] = (canvas_data){0};
+
+    HWND window = (HWND)canvas_info.canvas[window_id].window;
+
+    RECT rect;
+    GetClientRect(window, &rect);
+
+    DXGI_SWAP_CHAIN_DESC1 scDesc = {0};
+    scDesc.Width = rect.right - rect.left;
+    scDesc.Height = rect.bottom - rect.top;
+    scDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+    scDesc.SampleDesc.Count = 1;
+    scDesc.BufferUsage = DXGI_USAGE_RENDER_TARGET_OUTPUT;
+    scDesc.BufferCount = 2;
+    scDesc.SwapEffect = DXGI_SWAP_EFFECT_FLIP_DISCARD;
+    scDesc.Flags = DXGI_SWAP_CHAIN_FLAG_ALLOW_TEARING;
+    scDesc.Scaling = DXGI_SCALING_STRETCH;
+    scDesc.AlphaMode = DXGI_ALPHA_MODE_IGNORE;
+
+    IDXGISwapChain1 *swapChain1;
+    HRESULT result = canvas_win32.factory->lpVtbl->CreateSwapChainForHwnd(
+        canvas_win32.factory,
+        (IUnknown *)canvas_win32.cmdQueue,
+        window,
+        &scDesc,
+        NULL,
+        NULL,
+        &swapChain1);
+
+    if (FAILED(result))
+    {
+        CANVAS_ERR("create swapchain for hwnd\n");
+        return CANVAS_ERR_GET_GPU;
+    }
+
+    result = swapChain1->lpVtbl->QueryInterface(
+        swapChain1,
+        &IID_IDXGISwapChain3,
+        (void **)&_canvas_data[window_id].swapChain);
+    swapChain1->lpVtbl->Release(swapChain1);
+
+    if (FAILED(result))
+    {
+        CANVAS_RETURN_ERR(CANVAS_ERR_GET_GPU, "query swapchain interface\n");
+    }
+
+    canvas_win32.factory->lpVtbl->MakeWindowAssociation(
+        canvas_win32.factory,
+        window,
+        DXGI_MWA_NO_ALT_ENTER);
+
+    D3D12_CPU_DESCRIPTOR_HANDLE rtvHandle;
+    canvas_win32.rtvHeap->lpVtbl->GetCPUDescriptorHandleForHeapStart(canvas_win32.rtvHeap, &rtvHandle);
+
+    rtvHandle.ptr += window_id * 2 * canvas_win32.rtvDescriptorSize;
+
+    for (int i = 0; i < 2; i++)
+    {
+        result = _canvas_data[window_id].swapChain->lpVtbl->GetBuffer(
+            _canvas_data[window_id].swapChain,
+            i,
+            &IID_ID3D12Resource,
+            (void **)&_canvas_data[window_id].backBuffers[i]);
+
+        if (FAILED(result))
+        {
+            CANVAS_RETURN_ERR(CANVAS_ERR_GET_GPU, "get swapchain buffer %d\n", i);
+        }
+
+        _canvas_data[window_id].rtvHandles[i] = rtvHandle;
+        canvas_win32.device->lpVtbl->CreateRenderTargetView(
+            canvas_win32.device,
+            _canvas_data[window_id].backBuffers[i],
+            NULL,
+            rtvHandle);
+        rtvHandle.ptr += canvas_win32.rtvDescriptorSize;
+    }
+
+    // Create depth stencil texture
+    D3D12_HEAP_PROPERTIES depthHeapProps = {0};
+    depthHeapProps.Type = D3D12_HEAP_TYPE_DEFAULT;
+
+    D3D12_RESOURCE_DESC depthDesc = {0};
+    depthDesc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
+    depthDesc.Width = rect.right - rect.left;
+    depthDesc.Height = rect.bottom - rect.top;
+    depthDesc.DepthOrArraySize = 1;
+    depthDesc.MipLevels = 1;
+    depthDesc.Format = DXGI_FORMAT_D32_FLOAT;
+    depthDesc.SampleDesc.Count = 1;
+    depthDesc.Flags = D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL;
+
+    D3D12_CLEAR_VALUE depthClearValue = {0};
+    depthClearValue.Format = DXGI_FORMAT_D32_FLOAT;
+    depthClearValue.DepthStencil.Depth = 1.0f;
+
+    ID3D12Resource *depthTexture;
+    result = canvas_win32.device->lpVtbl->CreateCommittedResource(
+        canvas_win32.device,
+        &depthHeapProps,
+        D3D12_HEAP_FLAG_NONE,
+        &depthDesc,
+        D3D12_RESOURCE_STATE_DEPTH_WRITE,
+        &depthClearValue,
+        &IID_ID3D12Resource,
+        (void **)&depthTexture);
+
+    if (FAILED(result))
+    {
+        CANVAS_RETURN_ERR(CANVAS_ERR_GET_GPU, "failed to create depth texture (HRESULT: 0x%08lX)\n", result);
+    }
+
+    canvas_info.canvas[window_id].depth_texture = depthTexture;
+
+    CANVAS_RETURN(CANVAS_OK);
+}
+
+int _canvas_window_resize(int window_id)
+{
+    CANVAS_ENTER_FUNC();
+    CANVAS_BOUNDS(window_id);
+
+    canvas_data *window = &_canvas_data[window_id];
+
+    if (!window->swapChain || !canvas_info.canvas[window_id].resize)
+    {
+        canvas_info.canvas[window_id].resize = false;
+        CANVAS_RETURN(CANVAS_OK);
+    }
+
+    canvas_info.canvas[window_id].resize = false;
+
+    canvas_win32.fence_value++;
+    canvas_win32.cmdQueue->lpVtbl->Signal(canvas_win32.cmdQueue, canvas_win32.fence, canvas_win32.fence_value);
+    if (canvas_win32.fence->lpVtbl->GetCompletedValue(canvas_win32.fence) < canvas_win32.fence_value)
+    {
+        canvas_win32.fence->lpVtbl->SetEventOnCompletion(canvas_win32.fence, canvas_win32.fence_value, canvas_win32.fence_event);
+        WaitForSingleObject(canvas_win32.fence_event, INFINITE);
+    }
+
+    RECT rect;
+    GetClientRect((HWND)canvas_info.canvas[window_id].window, &rect);
+    UINT width = rect.right - rect.left;
+    UINT height = rect.bottom - rect.top;
+
+    if (width == 0 || height == 0)
+    {
+        CANVAS_RETURN(CANVAS_OK);
+    }
+
+    for (int i = 0; i < 2; i++)
+    {
+        if (window->backBuffers[i])
+        {
+            window->backBuffers[i]->lpVtbl->Release(window->backBuffers[i]);
+            window->backBuffers[i] = NULL;
+        }
+    }
+
+    HRESULT hr = window->swapChain->lpVtbl->ResizeBuffers(
+        window->swapChain, 2, width, height,
+        DXGI_FORMAT_UNKNOWN,
+        DXGI_SWAP_CHAIN_FLAG_ALLOW_TEARING);
+
+    if (FAILED(hr))
+    {
+        CANVAS_RETURN_ERR(CANVAS_ERR_GET_GPU, "resize swapchain buffers\n");
+    }
+
+    D3D12_CPU_DESCRIPTOR_HANDLE rtvHandle;
+    canvas_win32.rtvHeap->lpVtbl->GetCPUDescriptorHandleForHeapStart(canvas_win32.rtvHeap, &rtvHandle);
+    rtvHandle.ptr += window_id * 2 * canvas_win32.rtvDescriptorSize;
+
+    for (int i = 0; i < 2; i++)
+    {
+        hr = window->swapChain->lpVtbl->GetBuffer(
+            window->swapChain, i, &IID_ID3D12Resource,
+            (void **)&window->backBuffers[i]);
+
+        if (FAILED(hr))
+        {
+            CANVAS_RETURN_ERR(CANVAS_ERR_GET_GPU, "get resized buffer %d\n", i);
+        }
+
+        window->rtvHandles[i] = rtvHandle;
+        canvas_win32.device->lpVtbl->CreateRenderTargetView(
+            canvas_win32.device, window->backBuffers[i], NULL, rtvHandle);
+        rtvHandle.ptr += canvas_win32.rtvDescriptorSize;
+    }
+
+    if (canvas_info.canvas[window_id].depth_texture)
+    {
+        ID3D12Resource *old_depth = (ID3D12Resource *)canvas_info.canvas[window_id].depth_texture;
+        old_depth->lpVtbl->Release(old_depth);
+        canvas_info.canvas[window_id].depth_texture = NULL;
+    }
+
+    D3D12_HEAP_PROPERTIES depthHeapProps = {0};
+    depthHeapProps.Type = D3D12_HEAP_TYPE_DEFAULT;
+
+    D3D12_RESOURCE_DESC depthDesc = {0};
+    depthDesc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
+    depthDesc.Width = width;
+    depthDesc.Height = height;
+    depthDesc.DepthOrArraySize = 1;
+    depthDesc.MipLevels = 1;
+    depthDesc.Format = DXGI_FORMAT_D32_FLOAT;
+    depthDesc.SampleDesc.Count = 1;
+    depthDesc.Flags = D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL;
+
+    D3D12_CLEAR_VALUE depthClearValue = {0};
+    depthClearValue.Format = DXGI_FORMAT_D32_FLOAT;
+    depthClearValue.DepthStencil.Depth = 1.0f;
+
+    ID3D12Resource *depthTexture;
+    hr = canvas_win32.device->lpVtbl->CreateCommittedResource(
+        canvas_win32.device,
+        &depthHeapProps,
+        D3D12_HEAP_FLAG_NONE,
+        &depthDesc,
+        D3D12_RESOURCE_STATE_DEPTH_WRITE,
+        &depthClearValue,
+        &IID_ID3D12Resource,
+        (void **)&depthTexture);
+
+    if (SUCCEEDED(hr))
+    {
+        canvas_info.canvas[window_id].depth_texture = depthTexture;
+    }
+    else
+    {
+        CANVAS_WARN("failed to recreate depth texture (HRESULT: 0x%08lX)\n", hr);
+    }
+
+    CANVAS_RETURN(CANVAS_OK);
+}
+static int _d3d12_upload_buffer_data(canvas_buffer *buf, void *data, size_t size)
+{
+    CANVAS_ENTER_FUNC();
+    CANVAS_ASSERT(buf != NULL);
+    CANVAS_ASSERT(data != NULL);
+    CANVAS_ASSERT(size > 0);
+
+    D3D12_HEAP_PROPERTIES upload_heap = {0};
+    upload_heap.Type = D3D12_HEAP_TYPE_UPLOAD;
+
+    D3D12_RESOURCE_DESC staging_desc = {0};
+    staging_desc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
+    staging_desc.Width = size;
+    staging_desc.Height = 1;
+    staging_desc.DepthOrArraySize = 1;
+    staging_desc.MipLevels = 1;
+    staging_desc.Format = DXGI_FORMAT_UNKNOWN;
+    staging_desc.SampleDesc.Count = 1;
+    staging_desc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
+
+    ID3D12Resource *staging = NULL;
+    HRESULT hr = canvas_win32.device->lpVtbl->CreateCommittedResource(
+        canvas_win32.device,
+        &upload_heap,
+        D3D12_HEAP_FLAG_NONE,
+        &staging_desc,
+        D3D12_RESOURCE_STATE_GENERIC_READ,
+        NULL,
+        &IID_ID3D12Resource,
+        (void **)&staging);
+
+    if (FAILED(hr))
+    {
+        CANVAS_RETURN_ERR(CANVAS_FAIL, "Failed to create staging buffer\n");
+    }
+
+    // Map and copy data to staging
+    void *mapped = NULL;
+    D3D12_RANGE read_range = {0, 0};
+    hr = staging->lpVtbl->Map(staging, 0, &read_range, &mapped);
+    if (FAILED(hr))
+    {
+        staging->lpVtbl->Release(staging);
+        CANVAS_RETURN(CANVAS_FAIL);
+    }
+
+    memcpy(mapped, data, size);
+    staging->lpVtbl->Unmap(staging, 0, NULL);
+
+    // Wait for previous frames to finish before resetting command allocator
+    canvas_win32.fence_value++;
+    canvas_win32.cmdQueue->lpVtbl->Signal(canvas_win32.cmdQueue, canvas_win32.fence, canvas_win32.fence_value);
+    if (canvas_win32.fence->lpVtbl->GetCompletedValue(canvas_win32.fence) < canvas_win32.fence_value)
+    {
+        canvas_win32.fence->lpVtbl->SetEventOnCompletion(canvas_win32.fence, canvas_win32.fence_value, canvas_win32.fence_event);
+        WaitForSingleObject(canvas_win32.fence_event, INFINITE);
+    }
+
+    // Reset command allocator and list
+    canvas_win32.cmdAllocator->lpVtbl->Reset(canvas_win32.cmdAllocator);
+    canvas_win32.cmdList->lpVtbl->Reset(canvas_win32.cmdList,
+                                        canvas_win32.cmdAllocator, NULL);
+
+    // Transition destination buffer to COPY_DEST
+    ID3D12Resource *dst = (ID3D12Resource *)buf->platform_handle;
+
+    D3D12_RESOURCE_BARRIER barrier = {0};
+    barrier.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
+    barrier.Transition.pResource = dst;
+    barrier.Transition.StateBefore = D3D12_RESOURCE_STATE_COMMON;
+    barrier.Transition.StateAfter = D3D12_RESOURCE_STATE_COPY_DEST;
+    barrier.Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
+
+    canvas_win32.cmdList->lpVtbl->ResourceBarrier(canvas_win32.cmdList, 1, &barrier);
+
+    // Copy staging -> destination
+    canvas_win32.cmdList->lpVtbl->CopyResource(canvas_win32.cmdList, dst, staging);
+
+    // Transition to appropriate state based on buffer type
+    D3D12_RESOURCE_STATES final_state;
+    switch (buf->type)
+    {
+    case CANVAS_BUFFER_VERTEX:
+        final_state = D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER;
+        break;
+    case CANVAS_BUFFER_INDEX:
+        final_state = D3D12_RESOURCE_STATE_INDEX_BUFFER;
+        break;
+    case CANVAS_BUFFER_UNIFORM:
+        final_state = D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER;
+        break;
+    case CANVAS_BUFFER_STORAGE:
+        final_state = D3D12_RESOURCE_STATE_COMMON;
+        break;
+    case CANVAS_BUFFER_INDIRECT:
+        final_state = D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT;
+        break;
+    default:
+        final_state = D3D12_RESOURCE_STATE_COMMON;
+    }
+
+    barrier.Transition.StateBefore = D3D12_RESOURCE_STATE_COPY_DEST;
+    barrier.Transition.StateAfter = final_state;
+    canvas_win32.cmdList->lpVtbl->ResourceBarrier(canvas_win32.cmdList, 1, &barrier);
+
+    // Close and execute
+    canvas_win32.cmdList->lpVtbl->Close(canvas_win32.cmdList);
+
+    ID3D12CommandList *cmdLists[] = {(ID3D12CommandList *)canvas_win32.cmdList};
+    canvas_win32.cmdQueue->lpVtbl->ExecuteCommandLists(canvas_win32.cmdQueue, 1, cmdLists);
+
+    // Wait for completion
+    canvas_win32.fence_value++;
+    canvas_win32.cmdQueue->lpVtbl->Signal(canvas_win32.cmdQueue, canvas_win32.fence, canvas_win32.fence_value);
+
+    if (canvas_win32.fence->lpVtbl->GetCompletedValue(canvas_win32.fence) < canvas_win32.fence_value)
+    {
+        canvas_win32.fence->lpVtbl->SetEventOnCompletion(canvas_win32.fence, canvas_win32.fence_value, canvas_win32.fence_event);
+        WaitForSingleObject(canvas_win32.fence_event, INFINITE);
+    }
+
+    staging->lpVtbl->Release(staging);
+
+    CANVAS_RETURN(CANVAS_OK);
+}
+
+canvas_buffer *canvas_buffer_create(int window_id, canvas_buffer_type type, canvas_buffer_usage usage, size_t size, void *initial_data)
+{
+    CANVAS_ENTER_FUNC();
+    CANVAS_ASSERT_RANGE(window_id, 0, MAX_CANVAS - 1);
+    CANVAS_ASSERT(size > 0);
+
+    CANVAS_VALID_PTR(window_id);
+
+    if (!canvas_win32.device)
+    {
+        CANVAS_RETURN_ERR(NULL, "GPU not initialized\n");
+    }
+
+    canvas_buffer *buf = (canvas_buffer *)calloc(1, sizeof(canvas_buffer));
+    if (!buf)
+    {
+        CANVAS_RETURN(NULL);
+    }
+
+    buf->size = size;
+    buf->type = type;
+    buf->usage = usage;
+    buf->window_id = window_id;
+
+    // Determine heap type
+    D3D12_HEAP_TYPE heap_type;
+    D3D12_RESOURCE_STATES initial_state;
+
+    if (_canvas_buffer_host_written(usage))
+    {
+        heap_type = D3D12_HEAP_TYPE_UPLOAD;
+        initial_state = D3D12_RESOURCE_STATE_GENERIC_READ;
+    }
+    else
+    {
+        heap_type = D3D12_HEAP_TYPE_DEFAULT;
+        initial_state = D3D12_RESOURCE_STATE_COMMON;
+    }
+
+    // Create buffer
+    D3D12_HEAP_PROPERTIES heap_props = {0};
+    heap_props.Type = heap_type;
+    heap_props.CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_UNKNOWN;
+    heap_props.MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN;
+
+    D3D12_RESOURCE_DESC resource_desc = {0};
+    resource_desc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
+    resource_desc.Width = size;
+    resource_desc.Height = 1;
+    resource_desc.DepthOrArraySize = 1;
+    resource_desc.MipLevels = 1;
+    resource_desc.Format = DXGI_FORMAT_UNKNOWN;
+    resource_desc.SampleDesc.Count = 1;
+    resource_desc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
+    resource_desc.Flags = D3D12_RESOURCE_FLAG_NONE;
+
+    ID3D12Resource *resource = NULL;
+    HRESULT hr = canvas_win32.device->lpVtbl->CreateCommittedResource(
+        canvas_win32.device,
+        &heap_props,
+        D3D12_HEAP_FLAG_NONE,
+        &resource_desc,
+        initial_state,
+        NULL,
+        &IID_ID3D12Resource,
+        (void **)&resource);
+
+    if (FAILED(hr))
+    {
+        CANVAS_ERR("Failed to create D3D12 buffer (HRESULT: 0x%08lX)\n", hr);
+        free(buf);
+        CANVAS_RETURN(NULL);
+    }
+
+    buf->platform_handle = resource;
+
+    // Persistent mapping for dynamic buffers
+    if (_canvas_buffer_host_written(usage))
+    {
+        D3D12_RANGE read_range = {0, 0};
+        hr = resource->lpVtbl->Map(resource, 0, &read_range, &buf->mapped);
+
+        if (FAILED(hr))
+        {
+            CANVAS_ERR("Failed to map D3D12 buffer\n");
+            resource->lpVtbl->Release(resource);
+            free(buf);
+            CANVAS_RETURN(NULL);
+        }
+
+        if (initial_data)
+        {
+            memcpy(buf->mapped, initial_data, size);
+        }
+    }
+    else if (initial_data)
+    {
+        if (_d3d12_upload_buffer_data(buf, initial_data, size) != CANVAS_OK)
+        {
+            CANVAS_ERR("Failed to upload static buffer data\n");
+            resource->lpVtbl->Release(resource);
+            free(buf);
+            CANVAS_RETURN(NULL);
+        }
+    }
+
+    CANVAS_RETURN(buf);
+}
+
+void canvas_buffer_update(canvas_buffer *buf, void *data, size_t size, size_t offset)
+{
+    CANVAS_ENTER_FUNC();
+    CANVAS_ASSERT_NOT_NULL(buf);
+    CANVAS_ASSERT_NOT_NULL(data);
+    CANVAS_ASSERT(size > 0);
+
+    if (!buf || !data)
+    {
+        CANVAS_RETURN_VOID();
+    }
+
+    if (!_canvas_buffer_host_written(buf->usage))
+    {
+        CANVAS_WARN("Can only update dynamic buffers\n");
+        CANVAS_RETURN_VOID();
+    }
+
+    if (offset > buf->size || size > buf->size - offset)
+    {
+        CANVAS_ERR("Buffer update out of bounds\n");
+        CANVAS_RETURN_VOID();
+    }
+
+    memcpy((uint8_t *)buf->mapped + offset, data, size);
+    CANVAS_RETURN_VOID();
+}
+
+void *canvas_buffer_map(canvas_buffer *buf)
+{
+    CANVAS_ENTER_FUNC();
+
+    if (!buf)
+    {
+        CANVAS_RETURN(NULL);
+    }
+
+    if (_canvas_buffer_host_written(buf->usage))
+    {
+        CANVAS_RETURN(buf->mapped);
+    }
+
+    ID3D12Resource *resource = (ID3D12Resource *)buf->platform_handle;
+    D3D12_RANGE read_range = {0, 0};
+
+    void *mapped = NULL;
+    HRESULT hr = resource->lpVtbl->Map(resource, 0, &read_range, &mapped);
+
+    if (FAILED(hr))
+    {
+        CANVAS_RETURN_ERR(NULL, "Failed to map buffer\n");
+    }
+
+    CANVAS_RETURN(mapped);
+}
+
+void canvas_buffer_unmap(canvas_buffer *buf)
+{
+    CANVAS_ENTER_FUNC();
+
+    if (!buf)
+    {
+        CANVAS_RETURN_VOID();
+    }
+
+    if (_canvas_buffer_host_written(buf->usage))
+    {
+        CANVAS_RETURN_VOID();
+    }
+
+    ID3D12Resource *resource = (ID3D12Resource *)buf->platform_handle;
+    resource->lpVtbl->Unmap(resource, 0, NULL);
+    CANVAS_RETURN_VOID();
+}
+
+size_t canvas_buffer_frame_offset(canvas_buffer *buf)
+{
+    (void)buf;
+    return 0; // frames finish before the update returns, one slice is enough
+}
+
+// draw streams are only replayed by the vulkan backend so far
+void canvas_buffer_bind_vertex(canvas_buffer *buf, uint32_t binding)
+{
+    (void)buf;
+    (void)binding;
+}
+
+void canvas_buffer_bind_index(canvas_buffer *buf)
+{
+    (void)buf;
+}
+
+void canvas_buffer_bind_storage(canvas_buffer *buf, uint32_t binding)
+{
+    (void)buf;
+    (void)binding;
+}
+
+void canvas_set_pipeline(int window_id, canvas_pipeline *pipeline)
+{
+    (void)window_id;
+    (void)pipeline;
+}
+
+void canvas_draw(int window_id, uint32_t vertex_count, uint32_t first_vertex)
+{
+    (void)window_id;
+    (void)vertex_count;
+    (void)first_vertex;
+}
+
+void canvas_draw_indexed(int window_id, uint32_t index_count, uint32_t first_index, int32_t vertex_offset)
+{
+    (void)window_id;
+    (void)index_count;
+    (void)first_index;
+    (void)vertex_offset;
+}
+
+void canvas_draw_instanced(int window_id, uint32_t vertex_count, uint32_t instance_count, uint32_t first_vertex, uint32_t first_instance)
+{
+    (void)window_id;
+    (void)vertex_count;
+    (void)instance_count;
+    (void)first_vertex;
+    (void)first_instance;
+}
+
+void canvas_draw_indexed_instanced(int window_id, uint32_t index_count, uint32_t instance_count, uint32_t first_index, int32_t vertex_offset, uint32_t first_instance)
+{
+    (void)window_id;
+    (void)index_count;
+    (void)instance_count;
+    (void)first_index;
+    (void)vertex_offset;
+    (void)first_instance;
+}
+
+void canvas_draw_indirect(int window_id, canvas_buffer *args, size_t offset, uint32_t draw_count, uint32_t stride)
+{
+    (void)window_id;
+    (void)args;
+    (void)offset;
+    (void)draw_count;
+    (void)stride;
+}
+
+void canvas_draw_indexed_indirect(int window_id, canvas_buffer *args, size_t offset, uint32_t draw_count, uint32_t stride)
+{
+    (void)window_id;
+    (void)args;
+    (void)offset;
+    (void)draw_count;
+    (void)stride;
+}
+
+bool canvas_draw_indirect_count_supported(void)
+{
+    return false;
+}
+
+void canvas_draw_indirect_count(int window_id, canvas_buffer *args, size_t offset, canvas_buffer *count, size_t count_offset, uint32_t max_draws, uint32_t stride)
+{
+    (void)window_id;
+    (void)args;
+    (void)offset;
+    (void)count;
+    (void)count_offset;
+    (void)max_draws;
+    (void)stride;
+}
+
+void canvas_draw_indexed_indirect_count(int window_id, canvas_buffer *args, size_t offset, canvas_buffer *count, size_t count_offset, uint32_t max_draws, uint32_t stride)
+{
+    (void)window_id;
+    (void)args;
+    (void)offset;
+    (void)count;
+    (void)count_offset;
+    (void)max_draws;
+    (void)stride;
+}
+
+void canvas_rect(int window_id, float x, float y, float width, float height, const float color[4])
+{
+    (void)window_id;
+    (void)x;
+    (void)y;
+    (void)width;
+    (void)height;
+    (void)color;
+}
+
+void canvas_line(int window_id, float x0, float y0, float x1, float y1, float thickness, const float color[4])
+{
+    (void)window_id;
+    (void)x0;
+    (void)y0;
+    (void)x1;
+    (void)y1;
+    (void)thickness;
+    (void)color;
+}
+
+void canvas_sprite(int window_id, canvas_image *image, float x, float y, float width, float height, const float uv[4], const float color[4])
+{
+    (void)window_id;
+    (void)image;
+    (void)x;
+    (void)y;
+    (void)width;
+    (void)height;
+    (void)uv;
+    (void)color;
+}
+
+void canvas_blend(int window_id, canvas_blend_mode mode)
+{
+    (void)window_id;
+    (void)mode;
+}
+
+void canvas_batch_reorder(int window_id, bool allow)
+{
+    (void)window_id;
+    (void)allow;
+}
+
+canvas_readback *canvas_readback_request(int window_id)
+{
+    CANVAS_ENTER_FUNC();
+    (void)window_id;
+    CANVAS_RETURN_ERR(NULL, "frame readback needs the vulkan backend\n");
+}
+
+bool canvas_readback_poll(canvas_readback *readback)
+{
+    (void)readback;
+    return false;
+}
+
+int canvas_readback_wait(canvas_readback *readback, uint64_t timeout_ns)
+{
+    (void)readback;
+    (void)timeout_ns;
+    return CANVAS_INVALID;
+}
+
+void canvas_readback_release(canvas_readback *readback)
+{
+    (void)readback;
+}
+
+canvas_pipeline *canvas_pipeline_create(int window_id, const canvas_pipeline_desc *desc)
+{
+    CANVAS_ENTER_FUNC();
+    (void)window_id;
+    (void)desc;
+    CANVAS_RETURN_ERR(NULL, "pipelines take SPIR-V, only the vulkan backend builds them\n");
+}
+
+void canvas_pipeline_destroy(canvas_pipeline *pipeline)
+{
+    (void)pipeline;
+}
+
+canvas_pipeline *canvas_compute_pipeline_create(const uint32_t *spirv, size_t size, const char *entry)
+{
+    CANVAS_ENTER_FUNC();
+    (void)spirv;
+    (void)size;
+    (void)entry;
+    CANVAS_RETURN_ERR(NULL, "compute pipelines take SPIR-V, only the vulkan backend builds them\n");
+}
+
+void canvas_dispatch(int window_id, canvas_pipeline *pipeline, uint32_t x, uint32_t y, uint32_t z)
+{
+    (void)window_id;
+    (void)pipeline;
+    (void)x;
+    (void)y;
+    (void)z;
+}
+
+void canvas_buffer_destroy(canvas_buffer *buf)
+{
+    CANVAS_ENTER_FUNC();
+
+    if (!buf)
+    {
+        CANVAS_RETURN_VOID();
+    }
+
+    ID3D12Resource *resource = (ID3D12Resource *)buf->platform_handle;
+
+    if (buf->mapped && _canvas_buffer_host_written(buf->usage))
+        resource->lpVtbl->Unmap(resource, 0, NULL);
+
+    resource->lpVtbl->Release(resource);
+    free(buf);
+    CANVAS_RETURN_VOID();
+}
+
+int canvas_frame_wait(int window_id, uint64_t frame, uint64_t timeout_ns)
+{
+    CANVAS_ENTER_FUNC();
+    CANVAS_VALID(window_id);
+    (void)frame;
+    (void)timeout_ns;
+
+    // the queue is fenced at the end of every frame
+    CANVAS_RETURN(CANVAS_OK);
+}
+
+int canvas_gpu_memory_stats(canvas_memory_stats *stats)
+{
+    CANVAS_ENTER_FUNC();
+
+    if (!stats)
+        CANVAS_RETURN(CANVAS_INVALID);
+
+    // every buffer is a committed resource, there are no blocks to report
+    memset(stats, 0, sizeof(*stats));
+    CANVAS_RETURN(CANVAS_OK);
+}
+
+bool canvas_upload_done(uint64_t token)
+{
+    (void)token;
+    return true; // uploads wait on the queue fence
+}
+
+int canvas_upload_wait(uint64_t token, uint64_t timeout_ns)
+{
+    (void)token;
+    (void)timeout_ns;
+    return CANVAS_OK;
+}
+
+void canvas_buffer_update_regions(canvas_buffer *buf, const canvas_buffer_region *regions, uint32_t count)
+{
+    for (uint32_t i = 0; regions && i < count; i++)
+        canvas_buffer_update(buf, (void *)regions[i].data, regions[i].size, regions[i].offset);
+}
+
+uint64_t canvas_upload_batch(const canvas_buffer_write *writes, uint32_t count)
+{
+    for (uint32_t i = 0; writes && i < count; i++)
+        canvas_buffer_update(writes[i].buf, (void *)writes[i].data, writes[i].size, writes[i].offset);
+
+    return 0;
+}
+
+int _canvas_post_update()
+{
+    CANVAS_ENTER_FUNC();
+    CANVAS_RETURN(CANVAS_OK);
+}
+
+int _canvas_exit()
+{
+    CANVAS_ENTER_FUNC();
+    if (canvas_win32.fence_event)
+        CloseHandle(canvas_win32.fence_event);
+    if (canvas_win32.fence)
+        canvas_win32.fence->lpVtbl->Release(canvas_win32.fence);
+    if (canvas_win32.rtvHeap)
+        canvas_win32.rtvHeap->lpVtbl->Release(canvas_win32.rtvHeap);
+    if (canvas_win32.cmdList)
+        canvas_win32.cmdList->lpVtbl->Release(canvas_win32.cmdList);
+    if (canvas_win32.cmdAllocator)
+        canvas_win32.cmdAllocator->lpVtbl->Release(canvas_win32.cmdAllocator);
+    if (canvas_win32.cmdQueue)
+        canvas_win32.cmdQueue->lpVtbl->Release(canvas_win32.cmdQueue);
+    if (canvas_win32.device)
+        canvas_win32.device->lpVtbl->Release(canvas_win32.device);
+    if (canvas_win32.factory)
+        canvas_win32.factory->lpVtbl->Release(canvas_win32.factory);
+    if (canvas_win32.class)
+        UnregisterClassA("CanvasWindowClass", canvas_win32.instance);
+    CANVAS_RETURN(CANVAS_OK);
+}
+
+#endif
+
+//
+//
+//
+#if defined(__linux__)
+
+int canvas_minimize(int window_id)
+{
+    CANVAS_ENTER_FUNC();
+    CANVAS_VALID(window_id);
+
+    if (_canvas_using_wayland)
+    {
+    }
+    else
+    {
+        if (!x11.display)
+        {
+            CANVAS_RETURN_ERR(CANVAS_ERR_GET_DISPLAY, "no display connection\n");
+        }
+
+        Window window = (Window)canvas_info.canvas[window_id].window;
+        if (!window)
+        {
+            CANVAS_RETURN_ERR(CANVAS_ERR_GET_WINDOW, "no window to minimize: %d\n", window_id);
+        }
+
+        int screen = x11.XDefaultScreen(x11.display);
+        x11.XIconifyWindow(x11.display, window, screen);
+        x11.XFlush(x11.display);
+    }
+
+    canvas_info.canvas[window_id].minimized = true;
+    canvas_info.canvas[window_id].maximized = false;
+
+    CANVAS_RETURN(CANVAS_OK);
+}
+
+int canvas_maximize(int window_id)
+{
+    CANVAS_ENTER_FUNC();
+    CANVAS_VALID(window_id);
+
+    if (_canvas_using_wayland)
+    {
+    }
+    else
+    {
+        if (!x11.display)
+        {
+            CANVAS_RETURN_ERR(CANVAS_ERR_GET_DISPLAY, "no display connection\n");
+        }
+
+        Window window = (Window)canvas_info.canvas[window_id].window;
+        if (!window)
+        {
+            CANVAS_RETURN_ERR(CANVAS_ERR_GET_WINDOW, "no window to maximize: %d\n", window_id);
+        }
+
+        int screen = x11.XDefaultScreen(x11.display);
+
+        Atom wm_state = x11.XInternAtom(x11.display, "_NET_WM_STATE", 0);
+        Atom max_horz = x11.XInternAtom(x11.display, "_NET_WM_STATE_MAXIMIZED_HORZ", 0);
+        Atom max_vert = x11.XInternAtom(x11.display, "_NET_WM_STATE_MAXIMIZED_VERT", 0);
+
+        XClientMessageEvent ev = {0};
+        ev.type = 33;
+        ev.window = window;
+        ev.message_type = wm_state;
+        ev.format = 32;
+        ev.data.l[0] = 1;
+        ev.data.l[1] = max_horz;
+        ev.data.l[2] = max_vert;
+        ev.data.l[3] = 1;
+
+        x11.XSendEvent(x11.display, x11.XRootWindow(x11.display, screen),
+                       0, (1L << 20) | (1L << 19), (XEvent *)&ev);
+        x11.XFlush(x11.display);
+    }
+
+    canvas_info.canvas[window_id].maximized = true;
+    canvas_info.canvas[window_id].minimized = false;
+
+    CANVAS_RETURN(CANVAS_OK);
+}
+
+int canvas_restore(int window_id)
+{
+    CANVAS_ENTER_FUNC();
+    CANVAS_VALID(window_id);
+
+    if (_canvas_using_wayland)
+    {
+    }
+    else
+    {
+        if (!x11.display)
+        {
+            CANVAS_RETURN_ERR(CANVAS_ERR_GET_DISPLAY, "no display connection\n");
+        }
+
+        Window window = (Window)canvas_info.canvas[window_id].window;
+        if (!window)
+        {
+            CANVAS_RETURN_ERR(CANVAS_ERR_GET_WINDOW, "no window to restore: %d\n", window_id);
+        }
+
+        int screen = x11.XDefaultScreen(x11.display);
+
+        if (canvas_info.canvas[window_id].minimized)
+        {
+            x11.XMapWindow(x11.display, window);
+        }
+        else if (canvas_info.canvas[window_id].maximized)
+        {
+            Atom wm_state = x11.XInternAtom(x11.display, "_NET_WM_STATE", 0);
+            Atom max_horz = x11.XInternAtom(x11.display, "_NET_WM_STATE_MAXIMIZED_HORZ", 0);
+            Atom max_vert = x11.XInternAtom(x11.display, "_NET_WM_STATE_MAXIMIZED_VERT", 0);
+
+            XClientMessageEvent ev = {0};
+            ev.type = 33;
+            ev.window = window;
+            ev.message_type = wm_state;
+            ev.format = 32;
+            ev.data.l[0] = 0;
+            ev.data.l[1] = max_horz;
+            ev.data.l[2] = max_vert;
+            ev.data.l[3] = 1;
+
+            x11.XSendEvent(x11.display, x11.XRootWindow(x11.display, screen),
+                           0, (1L << 20) | (1L << 19), (XEvent *)&ev);
+        }
+        else if (canvas_info.canvas[window_id].fullscreen)
+        {
+            Atom wm_state = x11.XInternAtom(x11.display, "_NET_WM_STATE", 0);
+            Atom fullscreen = x11.XInternAtom(x11.display, "_NET_WM_STATE_FULLSCREEN", 0);
+
+            XClientMessageEvent ev = {0};
+            ev.type = 33;
+            ev.window = window;
+            ev.message_type = wm_state;
+            ev.format = 32;
+            ev.data.l[0] = 0; // _NET_WM_STATE_REMOVE
+            ev.data.l[1] = fullscreen;
+            ev.data.l[2] = 0;
+            ev.data.l[3] = 1;
+
+            x11.XSendEvent(x11.display, x11.XRootWindow(x11.display, screen), 0, (1L << 20) | (1L << 19), (XEvent *)&ev);
+
+            x11.XMoveResizeWindow(x11.display, window,
+                                  (int)_canvas_data[window_id].saved_x,
+                                  (int)_canvas_data[window_id].saved_y,
+                                  (unsigned int)_canvas_data[window_id].saved_width,
+                                  (unsigned int)_canvas_data[window_id].saved_height);
+        }
+
+        x11.XFlush(x11.display);
+    }
+
+    canvas_info.canvas[window_id].minimized = false;
+    canvas_info.canvas[window_id].maximized = false;
+    canvas_info.canvas[window_id].fullscreen = false;
+
+    CANVAS_RETURN(CANVAS_OK);
+}
+
+int canvas_fullscreen(int window_id)
+{
+    CANVAS_ENTER_FUNC();
+    CANVAS_VALID(window_id);
+
+    if (_canvas_using_wayland)
+    {
+        // TODO: Wayland fullscreen support
+        CANVAS_WARN("Wayland fullscreen not yet implemented\n");
+        CANVAS_RETURN(CANVAS_OK);
+    }
+    else
+    {
+        if (!x11.display)
+        {
+            CANVAS_RETURN_ERR(CANVAS_ERR_GET_DISPLAY, "no display connection\n");
+        }
+
+        Window window = (Window)canvas_info.canvas[window_id].window;
+        if (!window)
+        {
+            CANVAS_RETURN_ERR(CANVAS_ERR_GET_WINDOW, "no window for fullscreen: %d\n", window_id);
+        }
+
+        if (!canvas_info.canvas[window_id].fullscreen)
+        {
+            XWindowAttributes attrs;
+            x11.XGetWindowAttributes(x11.display, window, &attrs);
+            _canvas_data[window_id].saved_x = attrs.x;
+            _canvas_data[window_id].saved_y = attrs.y;
+            _canvas_data[window_id].saved_width = attrs.width;
+            _canvas_data[window_id].saved_height = attrs.height;
+
+            int screen = x11.XDefaultScreen(x11.display);
+            Atom wm_state = x11.XInternAtom(x11.display, "_NET_WM_STATE", 0);
+            Atom fullscreen = x11.XInternAtom(x11.display, "_NET_WM_STATE_FULLSCREEN", 0);
+
+            XClientMessageEvent ev = {0};
+            ev.type = 33;
+            ev.window = window;
+            ev.message_type = wm_state;
+            ev.format = 32;
+            ev.data.l[0] = 1; // _NET_WM_STATE_ADD
+            ev.data.l[1] = fullscreen;
+            ev.data.l[2] = 0;
+            ev.data.l[3] = 1;
+
+            x11.XSendEvent(x11.display, x11.XRootWindow(x11.display, screen), 0, (1L << 20) | (1L << 19), (XEvent *)&ev);
+            x11.XFlush(x11.display);
+
+            canvas_info.canvas[window_id].fullscreen = true;
+        }
+    }
+
+    canvas_info.canvas[window_id].minimized = false;
+    canvas_info.canvas[window_id].maximized = false;
+
+    CANVAS_RETURN(CANVAS_OK);
+}
+
+int _canvas_close(int window_id)
+{
+    CANVAS_ENTER_FUNC();
+    CANVAS_BOUNDS(window_id);
+
+    if (vk_windows[window_id].initialized)
+    {
+        vk_cleanup_window(window_id);
+    }
+
+    if (canvas_info.canvas[window_id].offscreen)
+    {
+        CANVAS_RETURN(CANVAS_OK);
+    }
+
+    if (_canvas_using_wayland)
+    {
+        _canvas_wayland_surface_scale_destroy(window_id);
+    }
+    else
+    {
+        Window window = (Window)canvas_info.canvas[window_id].window;
+
+        if (!window)
+        {
+            CANVAS_RETURN_ERR(CANVAS_ERR_GET_WINDOW, "no window to close: %d\n", window_id);
+        }
+
+        x11.XDestroyWindow(x11.display, window);
+        x11.XFlush(x11.display);
+    }
+
+    _canvas_data[window_id].last_button_press_time = 0;
+    _canvas_data[window_id].last_button_press_x = 0;
+    _canvas_data[window_id].last_button_press_y = 0;
+
+    CANVAS_RETURN(CANVAS_OK);
+}
+
+int _canvas_set(int window_id, int display, int64_t x, int64_t y, int64_t width, int64_t height, const char *title)
+{
+    CANVAS_ENTER_FUNC();
+    CANVAS_VALID(window_id);
+    CANVAS_DISPLAY_BOUNDS(display);
+
+    if (width <= 0 || height <= 0)
+    {
+        CANVAS_RETURN_ERR(CANVAS_FAIL, "invalid window dimensions: %dx%d\n", width, height);
+    }
+
+    if (_canvas_using_wayland)
+    {
+    }
+    else
+    {
+        Window window = (Window)canvas_info.canvas[window_id].window;
+
+        if (title && strcmp(canvas_info.canvas[window_id].title, title) != 0)
+        {
+            x11.XLockDisplay(x11.display);
+            x11.XStoreName(x11.display, window, title);
+            Atom net_wm_name = x11.XInternAtom(x11.display, "_NET_WM_NAME", 0);
+            Atom utf8_string = x11.XInternAtom(x11.display, "UTF8_STRING", 0);
+            x11.XChangeProperty(x11.display, window, net_wm_name, utf8_string, 8, 0,
+                                (unsigned char *)title, strlen(title));
+            x11.XUnlockDisplay(x11.display);
+        }
+
+        _canvas_data[window_id].client_set = true;
+
+        int global_x = canvas_info.display[display].x + x;
+        int global_y = canvas_info.display[display].y + y;
+
+        if (global_x < -32768 || global_x > 32767 || global_y < -32768 || global_y > 32767)
+        {
+            CANVAS_RETURN_ERR(CANVAS_FAIL, "window position out of range: %d,%d\n", global_x, global_y);
+        }
+
+        x11.XLockDisplay(x11.display);
+        x11.XMoveResizeWindow(x11.display, window,
+                              (int)global_x, (int)global_y,
+                              (unsigned int)width, (unsigned int)height);
+
+        x11.XFlush(x11.display);
+        x11.XUnlockDisplay(x11.display);
+    }
+
+    canvas_info.canvas[window_id].os_moved = false;
+    canvas_info.canvas[window_id].os_resized = false;
+
+    CANVAS_RETURN(CANVAS_OK);
+}
+
+int _canvas_init_displays()
+{
+    CANVAS_ENTER_FUNC();
+    if (_canvas_using_wayland)
+    {
+        // outputs are tracked by the registry listener, this only flushes their initial state
+        wl.wl_display_roundtrip(wl.display);
+
+        if (!wl.xdg_output_manager)
+        {
+            CANVAS_WARN("zxdg_output_manager_v1 not available, display positions are approximate\n");
+        }
+
+        canvas_info.display_count = wl.output_count;
+        CANVAS_RETURN(canvas_info.display_count);
+    }
+
+    canvas_info.display_count = 0;
+
+    if (xrandr.library)
+    {
+        Window root = x11.XDefaultRootWindow(x11.display);
+        XRRScreenResources *sr = xrandr.XRRGetScreenResourcesCurrent(x11.display, root);
+
+        if (!sr)
+        {
+            CANVAS_WARN("XRRGetScreenResourcesCurrent failed\n");
+            dlclose(xrandr.library);
+            xrandr.library = NULL;
+            goto fallback;
+        }
+
+        unsigned long primary_output = xrandr.XRRGetOutputPrimary(x11.display, root);
+
+        for (int i = 0; i < sr->ncrtc; i++)
+        {
+            if (canvas_info.display_count >= MAX_DISPLAYS)
+                break;
+
+            XRRCrtcInfo *ci = xrandr.XRRGetCrtcInfo(x11.display, sr, sr->crtcs[i]);
+
+            if (!ci || ci->width == 0 || ci->height == 0 || ci->noutput == 0)
+            {
+                if (ci)
+                    xrandr.XRRFreeCrtcInfo(ci);
+                continue;
+            }
+
+            XRROutputInfo *oi = xrandr.XRRGetOutputInfo(x11.display, sr, ci->outputs[0]);
+
+            if (!oi)
+            {
+                xrandr.XRRFreeCrtcInfo(ci);
+                continue;
+            }
+
+            double scale = 1.0;
+            if (oi->mm_width > 0 && oi->mm_height > 0)
+            {
+                double dpi_x = (double)ci->width / (oi->mm_width / 25.4);
+                double dpi_y = (double)ci->height / (oi->mm_height / 25.4);
+                double dpi = (dpi_x + dpi_y) / 2.0;
+
+                if (dpi > 140.0)
+                {
+                    scale = dpi / 96.0;
+                }
+            }
+
+            int refresh_rate = 60;
+            if (ci->mode != 0)
+            {
+                XRRModeInfo *modes = (XRRModeInfo *)sr->modes;
+                for (int j = 0; j < sr->nmode; j++)
+                {
+                    if (modes[j].id == ci->mode)
+                    {
+                        if (modes[j].hTotal > 0 && modes[j].vTotal > 0)
+                        {
+                            double rate = (double)modes[j].dotClock /
+                                          ((double)modes[j].hTotal * (double)modes[j].vTotal);
+                            refresh_rate = (int)(rate + 0.5);
+                        }
+                        break;
+                    }
+                }
+            }
+
+            canvas_info.display[canvas_info.display_count].x = ci->x;
+            canvas_info.display[canvas_info.display_count].y = ci->y;
+            canvas_info.display[canvas_info.display_count].width = ci->width;
+            canvas_info.display[canvas_info.display_count].height = ci->height;
+            canvas_info.display[canvas_info.display_count].refresh_rate = refresh_rate;
+            canvas_info.display[canvas_info.display_count].scale = scale;
+            canvas_info.display[canvas_info.display_count].primary = (ci->outputs[0] == primary_output);
+
+            if (refresh_rate > canvas_info.highest_refresh_rate)
+                canvas_info.highest_refresh_rate = refresh_rate;
+
+            canvas_info.display_count++;
+
+            xrandr.XRRFreeOutputInfo(oi);
+            xrandr.XRRFreeCrtcInfo(ci);
+        }
+
+        xrandr.XRRFreeScreenResources(sr);
+
+        if (canvas_info.display_count > 0)
+        {
+            dlclose(xrandr.library);
+            xrandr.library = NULL;
+            CANVAS_RETURN(canvas_info.display_count);
+        }
+
+        dlclose(xrandr.library);
+        xrandr.library = NULL;
+    }
+
+fallback:
+
+    CANVAS_WARN("using basic X11 (single display, limited info)\n");
+    int screen = x11.XDefaultScreen(x11.display);
+
+    canvas_info.display[0].primary = true;
+    canvas_info.display[0].x = 0;
+    canvas_info.display[0].y = 0;
+    canvas_info.display[0].width = x11.XDisplayWidth(x11.display, screen);
+    canvas_info.display[0].height = x11.XDisplayHeight(x11.display, screen);
+    canvas_info.display[0].refresh_rate = 60;
+    canvas_info.display[0].scale = 1.0;
+    canvas_info.display_count = 1;
+
+    CANVAS_RETURN(canvas_info.display_count);
+}
+
+int _canvas_get_window_display(int window_id)
+{
+    CANVAS_ENTER_FUNC();
+    CANVAS_BOUNDS(window_id);
+
+    if (_canvas_using_wayland)
+    {
+    }
+    else
+    {
+    }
+
+    CANVAS_RETURN(CANVAS_OK);
+}
+
+int _canvas_get_resize_edge_action(int window_id, int x, int y)
+{
+    CANVAS_ENTER_FUNC();
+    if (window_id < 0 || window_id >= MAX_CANVAS)
+        CANVAS_RETURN(-1);
+
+    int width = canvas_info.canvas[window_id].width;
+    int height = canvas_info.canvas[window_id].height;
+    int border = 8;
+
+    bool at_left = x < border;
+    bool at_right = x > width - border;
+    bool at_top = y < border;
+    bool at_bottom = y > height - border;
+
+    if (at_top && at_left)
+        CANVAS_RETURN(_NET_WM_MOVERESIZE_SIZE_TOPLEFT);
+    if (at_top && at_right)
+        CANVAS_RETURN(_NET_WM_MOVERESIZE_SIZE_TOPRIGHT);
+    if (at_bottom && at_left)
+        CANVAS_RETURN(_NET_WM_MOVERESIZE_SIZE_BOTTOMLEFT);
+    if (at_bottom && at_right)
+        CANVAS_RETURN(_NET_WM_MOVERESIZE_SIZE_BOTTOMRIGHT);
+
+    if (at_top)
+        CANVAS_RETURN(_NET_WM_MOVERESIZE_SIZE_TOP);
+    if (at_bottom)
+        CANVAS_RETURN(_NET_WM_MOVERESIZE_SIZE_BOTTOM);
+    if (at_left)
+        CANVAS_RETURN(_NET_WM_MOVERESIZE_SIZE_LEFT);
+    if (at_right)
+        CANVAS_RETURN(_NET_WM_MOVERESIZE_SIZE_RIGHT);
+
+    CANVAS_RETURN(-1);
+}
+
+void _canvas_start_wm_move_resize(int window_id, int x_root, int y_root, int action)
+{
+    CANVAS_ENTER_FUNC();
+    XClientMessageEvent ev = {0};
+    ev.type = X11_ClientMessage;
+    ev.window = (Window)canvas_info.canvas[window_id].window;
+    ev.message_type = _canvas_data[window_id].x11_net_wm_moveresize;
+    ev.format = 32;
+    ev.data.l[0] = x_root;
+    ev.data.l[1] = y_root;
+    ev.data.l[2] = action;
+    ev.data.l[3] = 1;
+    ev.data.l[4] = 1;
+
+    x11.XUngrabPointer(x11.display, X11_CurrentTime);
+    x11.XSendEvent(x11.display, x11.XDefaultRootWindow(x11.display), false, (1L << 20) | (1L << 19), (XEvent *)&ev);
+    x11.XFlush(x11.display);
+    CANVAS_RETURN_VOID();
+}
+
+int _canvas_window(int64_t x, int64_t y, int64_t width, int64_t height, const char *title)
+{
+    CANVAS_ENTER_FUNC();
+
+    CANVAS_ASSERT(width > 0);
+    CANVAS_ASSERT(height > 0);
+
+    canvas_startup();
+
+    canvas_window_handle window = 0;
+
+    int window_id = _canvas_get_free();
+    if (window_id < 0)
+    {
+        CANVAS_RETURN(window_id);
+    }
+    CANVAS_ASSERT_RANGE(window_id, 0, MAX_CANVAS - 1);
+
+    canvas_info.canvas[window_id] = (canvas_type){0};
+    _canvas_data[window_id] = (canvas_data){0};
+
+#if CANVAS_VALIDATION >= 5
+    // Restore canaries after zeroing
+    canvas_info.canvas[window_id]._canary_head = CANVAS_CANARY_HEAD;
+    canvas_info.canvas[window_id]._canary_tail = CANVAS_CANARY_TAIL;
+#endif
+
+    if (_canvas_using_wayland)
+    {
+    }
+    else
+    {
+        if (!x11.display)
+        {
+            CANVAS_RETURN_ERR(CANVAS_ERR_GET_DISPLAY, "no display connection for window creation\\n");
+        }
+
+        window = (canvas_window_handle)x11.XCreateSimpleWindow(
+            x11.display,
+            x11.XDefaultRootWindow(x11.display),
+            x, y, width, height, 0,
+            x11.XBlackPixel(x11.display, 0),
+            x11.XWhitePixel(x11.display, 0));
+
+        if (!window)
+        {
+            CANVAS_RETURN_ERR(CANVAS_ERR_GET_WINDOW, "create x11 window\\n");
+        }
+
+        _canvas_data[window_id].client_set = true;
+
+        _canvas_data[window_id].x11_wm_protocols = x11.XInternAtom(x11.display, "WM_PROTOCOLS", 0);
+        _canvas_data[window_id].x11_wm_delete_window = x11.XInternAtom(x11.display, "WM_DELETE_WINDOW", 0);
+        _canvas_data[window_id].x11_wm_state = x11.XInternAtom(x11.display, "WM_STATE", 0);
+        _canvas_data[window_id].x11_net_wm_state = x11.XInternAtom(x11.display, "_NET_WM_STATE", 0);
+        _canvas_data[window_id].x11_net_wm_state_maximized_horz = x11.XInternAtom(x11.display, "_NET_WM_STATE_MAXIMIZED_HORZ", 0);
+        _canvas_data[window_id].x11_net_wm_state_maximized_vert = x11.XInternAtom(x11.display, "_NET_WM_STATE_MAXIMIZED_VERT", 0);
+        _canvas_data[window_id].x11_net_wm_state_fullscreen = x11.XInternAtom(x11.display, "_NET_WM_STATE_FULLSCREEN", 0);
+        _canvas_data[window_id].x11_motif_wm_hints = x11.XInternAtom(x11.display, "_MOTIF_WM_HINTS", 0);
+        _canvas_data[window_id].x11_net_wm_moveresize = x11.XInternAtom(x11.display, "_NET_WM_MOVERESIZE", 0);
+        _canvas_data[window_id].x11_atoms_initialized = true;
+
+        MotifWmHints hints = {0};
+        hints.flags = MWM_HINTS_DECORATIONS;
+        hints.decorations = 0;
+
+        x11.XChangeProperty(x11.display, (Window)window,
+                            _canvas_data[window_id].x11_motif_wm_hints,
+                            _canvas_data[window_id].x11_motif_wm_hints,
+                            32, PropModeReplace,
+                            (unsigned char *)&hints, 5);
+
+        Atom window_type = x11.XInternAtom(x11.display, "_NET_WM_WINDOW_TYPE", 0);
+        Atom window_type_normal = x11.XInternAtom(x11.display, "_NET_WM_WINDOW_TYPE_NORMAL", 0);
+        x11.XChangeProperty(x11.display, (Window)window, window_type, XA_ATOM, 32, PropModeReplace, (unsigned char *)&window_type_normal, 1);
+
+        x11.XSetWMProtocols(x11.display, (Window)window, &_canvas_data[window_id].x11_wm_delete_window, 1);
+
+        long event_mask = (1L << 0) |  // KeyPressMask
+                          (1L << 1) |  // KeyReleaseMask
+                          (1L << 2) |  // ButtonPressMask
+                          (1L << 3) |  // ButtonReleaseMask
+                          (1L << 5) |  // PointerMotionMask
+                          (1L << 6) |  // PointerMotionHintMask
+                          (1L << 15) | // ExposureMask
+                          (1L << 17) | // StructureNotifyMask
+                          (1L << 19) | // FocusChangeMask
+                          (1L << 22);  // PropertyChangeMask
+
+        x11.XSelectInput(x11.display, (Window)window, event_mask);
+
+        x11.XMapWindow(x11.display, (Window)window);
+    }
+
+    canvas_info.canvas[window_id].window = (canvas_window_handle)window;
+    canvas_info.canvas[window_id].resize = false;
+    canvas_info.canvas[window_id].index = window_id;
+    canvas_info.canvas[window_id].titlebar = false;
+    canvas_info.canvas[window_id].minimized = false;
+    canvas_info.canvas[window_id].maximized = false;
+    canvas_info.canvas[window_id].fullscreen = false;
+    canvas_info.canvas[window_id]._valid = true;
+
+    CANVAS_RETURN(window_id);
+}
+
+static const struct wl_interface zxdg_output_v1_interface;
+static const struct wl_interface wp_viewport_interface;
+static const struct wl_interface wp_fractional_scale_v1_interface;
+
+// message argument types shared by the xdg_output, viewporter and fractional scale protocols
+static const struct wl_interface *_canvas_wl_ext_types[] = {
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    &zxdg_output_v1_interface,
+    NULL, // wl_output_interface, filled in by _canvas_init_wayland
+    &wp_viewport_interface,
+    NULL, // wl_surface_interface
+    &wp_fractional_scale_v1_interface,
+    NULL, // wl_surface_interface
+};
+
+static const struct wl_message _canvas_xdg_output_manager_requests[] = {
+    {"destroy", "", _canvas_wl_ext_types + 0},
+    {"get_xdg_output", "no", _canvas_wl_ext_types + 4},
+};
+
+static const struct wl_interface zxdg_output_manager_v1_interface = {
+    "zxdg_output_manager_v1", 3, 2, _canvas_xdg_output_manager_requests, 0, NULL};
+
+static const struct wl_message _canvas_xdg_output_requests[] = {
+    {"destroy", "", _canvas_wl_ext_types + 0},
+};
+
+static const struct wl_message _canvas_xdg_output_events[] = {
+    {"logical_position", "ii", _canvas_wl_ext_types + 0},
+    {"logical_size", "ii", _canvas_wl_ext_types + 0},
+    {"done", "", _canvas_wl_ext_types + 0},
+    {"name", "2s", _canvas_wl_ext_types + 0},
+    {"description", "2s", _canvas_wl_ext_types + 0},
+};
+
+static const struct wl_interface zxdg_output_v1_interface = {
+    "zxdg_output_v1", 3, 1, _canvas_xdg_output_requests, 5, _canvas_xdg_output_events};
+
+static const struct wl_message _canvas_viewporter_requests[] = {
+    {"destroy", "", _canvas_wl_ext_types + 0},
+    {"get_viewport", "no", _canvas_wl_ext_types + 6},
+};
+
+static const struct wl_interface wp_viewporter_interface = {
+    "wp_viewporter", 1, 2, _canvas_viewporter_requests, 0, NULL};
+
+static const struct wl_message _canvas_viewport_requests[] = {
+    {"destroy", "", _canvas_wl_ext_types + 0},
+    {"set_source", "ffff", _canvas_wl_ext_types + 0},
+    {"set_destination", "ii", _canvas_wl_ext_types + 0},
+};
+
+static const struct wl_interface wp_viewport_interface = {
+    "wp_viewport", 1, 3, _canvas_viewport_requests, 0, NULL};
+
+static const struct wl_message _canvas_fractional_scale_manager_requests[] = {
+    {"destroy", "", _canvas_wl_ext_types + 0},
+    {"get_fractional_scale", "no", _canvas_wl_ext_types + 8},
+};
+
+static const struct wl_interface wp_fractional_scale_manager_v1_interface = {
+    "wp_fractional_scale_manager_v1", 1, 2, _canvas_fractional_scale_manager_requests, 0, NULL};
+
+static const struct wl_message _canvas_fractional_scale_requests[] = {
+    {"destroy", "", _canvas_wl_ext_types + 0},
+};
+
+static const struct wl_message _canvas_fractional_scale_events[] = {
+    {"preferred_scale", "u", _canvas_wl_ext_types + 0},
+};
+
+static const struct wl_interface wp_fractional_scale_v1_interface = {
+    "wp_fractional_scale_v1", 1, 1, _canvas_fractional_scale_requests, 1, _canvas_fractional_scale_events};
+
+static int _canvas_wl_output_find(struct wl_proxy *proxy)
+{
+    for (int i = 0; i < wl.output_count; i++)
+    {
+        if (wl.outputs[i].output == proxy || wl.outputs[i].xdg_output == proxy)
+            return i;
+    }
+
+    return -1;
+}
+
+// display[i] mirrors wl.outputs[i], only the changed slot is rewritten
+static void _canvas_wl_output_commit(int index)
+{
+    _canvas_wl_output *o = &wl.outputs[index];
+    canvas_display *d = &canvas_info.display[index];
+
+    int32_t scale = o->scale > 0 ? o->scale : 1;
+
+    d->primary = (index == 0);
+
+    if (o->has_logical && o->logical_width > 0 && o->logical_height > 0)
+    {
+        d->x = o->logical_x;
+        d->y = o->logical_y;
+        d->width = o->logical_width;
+        d->height = o->logical_height;
+        d->scale = o->mode_width > 0 ? (float)o->mode_width / (float)o->logical_width : (float)scale;
+    }
+    else
+    {
+        d->x = o->x;
+        d->y = o->y;
+        d->width = o->mode_width / scale;
+        d->height = o->mode_height / scale;
+        d->scale = (float)scale;
+    }
+
+    d->refresh_rate = o->refresh_mhz > 0 ? (o->refresh_mhz + 500) / 1000 : 60;
+
+    canvas_info.highest_refresh_rate = 0;
+    for (int i = 0; i < wl.output_count; i++)
+    {
+        if (canvas_info.display[i].refresh_rate > canvas_info.highest_refresh_rate)
+            canvas_info.highest_refresh_rate = canvas_info.display[i].refresh_rate;
+    }
+
+    canvas_info.display_count = wl.output_count;
+    canvas_info.display_changed = true;
+
+    CANVAS_VERBOSE("wayland output %d: %" PRId64 "x%" PRId64 " @ %d Hz, scale %.2f\n",
+                   index, d->width, d->height, d->refresh_rate, d->scale);
+}
+
+static void _canvas_wl_output_geometry(void *data, struct wl_proxy *output, int32_t x, int32_t y,
+                                       int32_t physical_width, int32_t physical_height, int32_t subpixel,
+                                       const char *make, const char *model, int32_t transform)
+{
+    int i = _canvas_wl_output_find(output);
+    if (i < 0)
+        return;
+
+    wl.outputs[i].x = x;
+    wl.outputs[i].y = y;
+}
+
+static void _canvas_wl_output_mode(void *data, struct wl_proxy *output, uint32_t flags,
+                                   int32_t width, int32_t height, int32_t refresh)
+{
+    int i = _canvas_wl_output_find(output);
+    if (i < 0 || !(flags & WL_OUTPUT_MODE_CURRENT))
+        return;
+
+    wl.outputs[i].mode_width = width;
+    wl.outputs[i].mode_height = height;
+    wl.outputs[i].refresh_mhz = refresh;
+
+    // wl_output v1 has no done event
+    if (wl.outputs[i].version < 2)
+        _canvas_wl_output_commit(i);
+}
+
+static void _canvas_wl_output_done(void *data, struct wl_proxy *output)
+{
+    int i = _canvas_wl_output_find(output);
+    if (i >= 0)
+        _canvas_wl_output_commit(i);
+}
+
+static void _canvas_wl_output_scale(void *data, struct wl_proxy *output, int32_t factor)
+{
+    int i = _canvas_wl_output_find(output);
+    if (i >= 0)
+        wl.outputs[i].scale = factor;
+}
+
+static void _canvas_wl_output_string(void *data, struct wl_proxy *output, const char *value)
+{
+}
+
+static const struct
+{
+    void (*geometry)(void *, struct wl_proxy *, int32_t, int32_t, int32_t, int32_t, int32_t, const char *, const char *, int32_t);
+    void (*mode)(void *, struct wl_proxy *, uint32_t, int32_t, int32_t, int32_t);
+    void (*done)(void *, struct wl_proxy *);
+    void (*scale)(void *, struct wl_proxy *, int32_t);
+    void (*name)(void *, struct wl_proxy *, const char *);
+    void (*description)(void *, struct wl_proxy *, const char *);
+} _canvas_wl_output_listener = {
+    _canvas_wl_output_geometry,
+    _canvas_wl_output_mode,
+    _canvas_wl_output_done,
+    _canvas_wl_output_scale,
+    _canvas_wl_output_string,
+    _canvas_wl_output_string,
+};
+
+static void _canvas_xdg_output_logical_position(void *data, struct wl_proxy *xdg_output, int32_t x, int32_t y)
+{
+    int i = _canvas_wl_output_find(xdg_output);
+    if (i < 0)
+        return;
+
+    wl.outputs[i].logical_x = x;
+    wl.outputs[i].logical_y = y;
+    wl.outputs[i].has_logical = true;
+}
+
+static void _canvas_xdg_output_logical_size(void *data, struct wl_proxy *xdg_output, int32_t width, int32_t height)
+{
+    int i = _canvas_wl_output_find(xdg_output);
+    if (i < 0)
+        return;
+
+    wl.outputs[i].logical_width = width;
+    wl.outputs[i].logical_height = height;
+    wl.outputs[i].has_logical = true;
+}
+
+static void _canvas_xdg_output_done(void *data, struct wl_proxy *xdg_output)
+{
+    // deprecated since v3, wl_output.done is authoritative there
+    int i = _canvas_wl_output_find(xdg_output);
+    if (i >= 0 && (wl.outputs[i].version < 2 || wl.wl_proxy_get_version(xdg_output) < 3))
+        _canvas_wl_output_commit(i);
+}
+
+static const struct
+{
+    void (*logical_position)(void *, struct wl_proxy *, int32_t, int32_t);
+    void (*logical_size)(void *, struct wl_proxy *, int32_t, int32_t);
+    void (*done)(void *, struct wl_proxy *);
+    void (*name)(void *, struct wl_proxy *, const char *);
+    void (*description)(void *, struct wl_proxy *, const char *);
+} _canvas_xdg_output_listener = {
+    _canvas_xdg_output_logical_position,
+    _canvas_xdg_output_logical_size,
+    _canvas_xdg_output_done,
+    _canvas_wl_output_string,
+    _canvas_wl_output_string,
+};
+
+static struct wl_proxy *_canvas_wl_registry_bind(uint32_t name, const struct wl_interface *interface, uint32_t version)
+{
+    return wl.wl_proxy_marshal_flags((struct wl_proxy *)wl.registry, 0, interface, version, 0,
+                                     name, interface->name, version, NULL);
+}
+
+static void _canvas_wl_output_attach_xdg(int index)
+{
+    if (!wl.xdg_output_manager || wl.outputs[index].xdg_output)
+        return;
+
+    struct wl_proxy *xdg_output = wl.wl_proxy_marshal_flags(wl.xdg_output_manager, 1, &zxdg_output_v1_interface,
+                                                            wl.wl_proxy_get_version(wl.xdg_output_manager), 0,
+                                                            NULL, wl.outputs[index].output);
+    if (!xdg_output)
+        return;
+
+    wl.outputs[index].xdg_output = xdg_output;
+    wl.wl_proxy_add_listener(xdg_output, (void (**)(void))&_canvas_xdg_output_listener, NULL);
+}
+
+static void _canvas_wl_registry_global(void *data, struct wl_registry *registry, uint32_t name,
+                                       const char *interface, uint32_t version)
+{
+    if (strcmp(interface, "wl_compositor") == 0)
+    {
+        wl.compositor = (struct wl_compositor *)_canvas_wl_registry_bind(name, wl.wl_compositor_interface, version < 4 ? version : 4);
+    }
+    else if (strcmp(interface, "wl_output") == 0)
+    {
+        if (wl.output_count >= MAX_DISPLAYS)
+        {
+            CANVAS_WARN("ignoring wayland output %u, MAX_DISPLAYS reached\n", name);
+            return;
+        }
+
+        uint32_t bind_version = version < 4 ? version : 4;
+        struct wl_proxy *output = _canvas_wl_registry_bind(name, wl.wl_output_interface, bind_version);
+        if (!output)
+            return;
+
+        int i = wl.output_count++;
+        memset(&wl.outputs[i], 0, sizeof(wl.outputs[i]));
+        wl.outputs[i].output = output;
+        wl.outputs[i].name = name;
+        wl.outputs[i].version = bind_version;
+        wl.outputs[i].scale = 1;
+
+        wl.wl_proxy_add_listener(output, (void (**)(void))&_canvas_wl_output_listener, NULL);
+        _canvas_wl_output_attach_xdg(i);
+    }
+    else if (strcmp(interface, "zxdg_output_manager_v1") == 0)
+    {
+        wl.xdg_output_manager = _canvas_wl_registry_bind(name, &zxdg_output_manager_v1_interface, version < 3 ? version : 3);
+
+        for (int i = 0; i < wl.output_count; i++)
+            _canvas_wl_output_attach_xdg(i);
+    }
+    else if (strcmp(interface, "wp_viewporter") == 0)
+    {
+        wl.viewporter = _canvas_wl_registry_bind(name, &wp_viewporter_interface, 1);
+    }
+    else if (strcmp(interface, "wp_fractional_scale_manager_v1") == 0)
+    {
+        wl.fractional_scale_manager = _canvas_wl_registry_bind(name, &wp_fractional_scale_manager_v1_interface, 1);
+    }
+}
+
+static void _canvas_wl_registry_global_remove(void *data, struct wl_registry *registry, uint32_t name)
+{
+    int index = -1;
+    for (int i = 0; i < wl.output_count; i++)
+    {
+        if (wl.outputs[i].name == name)
+        {
+            index = i;
+            break;
+        }
+    }
+
+    if (index < 0)
+        return;
+
+    if (wl.outputs[index].xdg_output)
+        wl.wl_proxy_marshal_flags(wl.outputs[index].xdg_output, 0, NULL, 1, WL_MARSHAL_FLAG_DESTROY);
+
+    if (wl.outputs[index].version >= 3)
+        wl.wl_proxy_marshal_flags(wl.outputs[index].output, 0, NULL, wl.outputs[index].version, WL_MARSHAL_FLAG_DESTROY);
+    else
+        wl.wl_proxy_destroy(wl.outputs[index].output);
+
+    for (int i = index; i < wl.output_count - 1; i++)
+    {
+        wl.outputs[i] = wl.outputs[i + 1];
+        canvas_info.display[i] = canvas_info.display[i + 1];
+    }
+
+    wl.output_count--;
+    canvas_info.display_count = wl.output_count;
+    canvas_info.display_changed = true;
+
+    canvas_info.highest_refresh_rate = 0;
+    for (int i = 0; i < wl.output_count; i++)
+    {
+        canvas_info.display[i].primary = (i == 0);
+        if (canvas_info.display[i].refresh_rate > canvas_info.highest_refresh_rate)
+            canvas_info.highest_refresh_rate = canvas_info.display[i].refresh_rate;
+    }
+
+    for (int i = 0; i < MAX_CANVAS; i++)
+    {
+        if (canvas_info.canvas[i].display >= wl.output_count)
+            canvas_info.canvas[i].display = 0;
+    }
+}
+
+static const struct
+{
+    void (*global)(void *, struct wl_registry *, uint32_t, const char *, uint32_t);
+    void (*global_remove)(void *, struct wl_registry *, uint32_t);
+} _canvas_wl_registry_listener = {
+    _canvas_wl_registry_global,
+    _canvas_wl_registry_global_remove,
+};
+
+static void _canvas_wl_fractional_scale_preferred(void *data, struct wl_proxy *fractional_scale, uint32_t scale)
+{
+    for (int i = 0; i < MAX_CANVAS; i++)
+    {
+        if (_canvas_data[i].wl_fractional_scale != fractional_scale)
+            continue;
+
+        if (_canvas_data[i].wl_preferred_scale != scale)
+        {
+            _canvas_data[i].wl_preferred_scale = scale;
+            _canvas_window_resize(i);
+        }
+        return;
+    }
+}
+
+static const struct
+{
+    void (*preferred_scale)(void *, struct wl_proxy *, uint32_t);
+} _canvas_wl_fractional_scale_listener = {
+    _canvas_wl_fractional_scale_preferred,
+};
+
+static void _canvas_wayland_surface_scale_init(int window_id)
+{
+    canvas_data *data = &_canvas_data[window_id];
+    struct wl_proxy *surface = (struct wl_proxy *)canvas_info.canvas[window_id].window;
+
+    if (!data->wl_preferred_scale)
+        data->wl_preferred_scale = 120;
+
+    if (!surface || !wl.viewporter)
+        return;
+
+    if (!data->wl_viewport)
+        data->wl_viewport = wl.wl_proxy_marshal_flags(wl.viewporter, 1, &wp_viewport_interface, 1, 0, NULL, surface);
+
+    if (wl.fractional_scale_manager && !data->wl_fractional_scale)
+    {
+        data->wl_fractional_scale = wl.wl_proxy_marshal_flags(wl.fractional_scale_manager, 1, &wp_fractional_scale_v1_interface, 1, 0, NULL, surface);
+
+        if (data->wl_fractional_scale)
+            wl.wl_proxy_add_listener(data->wl_fractional_scale, (void (**)(void))&_canvas_wl_fractional_scale_listener, NULL);
+    }
+}
+
+// buffer pixels per surface unit, without a viewport the buffer has to match the surface
+static float _canvas_wayland_buffer_scale(int window_id)
+{
+    if (!_canvas_data[window_id].wl_viewport)
+        return 1.0f;
+
+    float render_scale = canvas_info.canvas[window_id].render_scale;
+    if (render_scale <= 0.0f)
+        render_scale = 1.0f;
+
+    uint32_t preferred = _canvas_data[window_id].wl_preferred_scale ? _canvas_data[window_id].wl_preferred_scale : 120;
+
+    return render_scale * (float)preferred / 120.0f;
+}
+
+static void _canvas_wayland_set_destination(int window_id)
+{
+    if (!_canvas_data[window_id].wl_viewport)
+        return;
+
+    int32_t width = (int32_t)canvas_info.canvas[window_id].width;
+    int32_t height = (int32_t)canvas_info.canvas[window_id].height;
+
+    if (width <= 0 || height <= 0)
+        return;
+
+    // applied with the next present commit
+    wl.wl_proxy_marshal_flags(_canvas_data[window_id].wl_viewport, 2, NULL, 1, 0, width, height);
+}
+
+static void _canvas_wayland_surface_scale_destroy(int window_id)
+{
+    canvas_data *data = &_canvas_data[window_id];
+
+    if (data->wl_fractional_scale)
+        wl.wl_proxy_marshal_flags(data->wl_fractional_scale, 0, NULL, 1, WL_MARSHAL_FLAG_DESTROY);
+
+    if (data->wl_viewport)
+        wl.wl_proxy_marshal_flags(data->wl_viewport, 0, NULL, 1, WL_MARSHAL_FLAG_DESTROY);
+
+    data->wl_fractional_scale = NULL;
+    data->wl_viewport = NULL;
+}
+
+// non-blocking: picks up output hotplug / mode changes between frames
+static void _canvas_wayland_dispatch()
+{
+    while (wl.wl_display_prepare_read(wl.display) != 0)
+        wl.wl_display_dispatch_pending(wl.display);
+
+    wl.wl_display_flush(wl.display);
+
+    struct pollfd pfd = {0};
+    pfd.fd = wl.wl_display_get_fd(wl.display);
+    pfd.events = POLLIN;
+
+    if (poll(&pfd, 1, 0) > 0)
+        wl.wl_display_read_events(wl.display);
+    else
+        wl.wl_display_cancel_read(wl.display);
+
+    wl.wl_display_dispatch_pending(wl.display);
+}
+
+int _canvas_init_wayland()
+{
+    wl.library = canvas_library_load(canvas_wayland_library_names, 2);
+
+    if (!wl.library)
+    {
+        CANVAS_ERR("libwayland-client.so.0 or libwayland-client.so not found");
+        return CANVAS_ERR_LOAD_LIBRARY;
+    }
+
+    LOAD_WL(wl_display_connect);
+    LOAD_WL(wl_display_disconnect);
+    LOAD_WL(wl_display_dispatch);
+    LOAD_WL(wl_display_dispatch_pending);
+    LOAD_WL(wl_display_roundtrip);
+    LOAD_WL(wl_display_flush);
+    LOAD_WL(wl_display_get_fd);
+    LOAD_WL(wl_display_prepare_read);
+    LOAD_WL(wl_display_read_events);
+    LOAD_WL(wl_display_cancel_read);
+    LOAD_WL(wl_proxy_marshal_flags);
+    LOAD_WL(wl_proxy_add_listener);
+    LOAD_WL(wl_proxy_get_version);
+    LOAD_WL(wl_proxy_destroy);
+    LOAD_WL(wl_registry_interface);
+    LOAD_WL(wl_compositor_interface);
+    LOAD_WL(wl_surface_interface);
+    LOAD_WL(wl_output_interface);
+
+    _canvas_wl_ext_types[5] = wl.wl_output_interface;
+    _canvas_wl_ext_types[7] = wl.wl_surface_interface;
+    _canvas_wl_ext_types[9] = wl.wl_surface_interface;
+
+    wl.display = wl.wl_display_connect(NULL);
+
+    if (!wl.display)
+    {
+        CANVAS_ERR("open wayland display\n");
+        dlclose(wl.library);
+        wl.library = NULL;
+        return CANVAS_ERR_GET_DISPLAY;
+    }
+
+    // wl_display.get_registry
+    wl.registry = (struct wl_registry *)wl.wl_proxy_marshal_flags((struct wl_proxy *)wl.display, 1, wl.wl_registry_interface,
+                                                                  wl.wl_proxy_get_version((struct wl_proxy *)wl.display), 0, NULL);
+
+    if (!wl.registry)
+    {
+        CANVAS_ERR("load wayland registry\n");
+        wl.wl_display_disconnect(wl.display);
+        dlclose(wl.library);
+        wl.library = NULL;
+        return CANVAS_ERR_GET_DISPLAY;
+    }
+
+    if (wl.wl_proxy_add_listener((struct wl_proxy *)wl.registry, (void (**)(void))&_canvas_wl_registry_listener, NULL) < 0)
+    {
+        CANVAS_ERR("add wayland registry\n");
+        wl.wl_display_disconnect(wl.display);
+        dlclose(wl.library);
+        wl.library = NULL;
+        return CANVAS_ERR_GET_DISPLAY;
+    }
+
+    // first roundtrip binds globals, output events follow in _canvas_init_displays
+    wl.wl_display_roundtrip(wl.display);
+
+    if (!wl.compositor)
+    {
+        CANVAS_ERR("wayland compositor not advertised\n");
+        wl.wl_display_disconnect(wl.display);
+        dlclose(wl.library);
+        wl.library = NULL;
+        return CANVAS_ERR_GET_DISPLAY;
+    }
+
+    _canvas_using_wayland = true;
+
+    return CANVAS_OK;
+}
+
+static unsigned int _canvas_get_x11_cursor_id(canvas_cursor_type cursor)
+{
+    switch (cursor)
+    {
+    case CANVAS_CURSOR_ARROW:
+        return 2; // XC_arrow
+    case CANVAS_CURSOR_TEXT:
+        return 152; // XC_xterm
+    case CANVAS_CURSOR_CROSSHAIR:
+        return 34; // XC_crosshair
+    case CANVAS_CURSOR_HAND:
+        return 58; // XC_hand2
+    case CANVAS_CURSOR_SIZE_NS:
+        return 116; // XC_sb_v_double_arrow
+    case CANVAS_CURSOR_SIZE_EW:
+        return 108; // XC_sb_h_double_arrow
+    case CANVAS_CURSOR_SIZE_NESW:
+        return 52;
+    case CANVAS_CURSOR_SIZE_NWSE:
+        return 52;
+    case CANVAS_CURSOR_SIZE_ALL:
+        return 52; // XC_fleur
+    case CANVAS_CURSOR_NOT_ALLOWED:
+        return 0; // XC_X_cursor
+    case CANVAS_CURSOR_WAIT:
+        return 150; // XC_watch
+    default:
+        return 2; // XC_arrow
+    }
+}
+
+int canvas_cursor(int window_id, canvas_cursor_type cursor)
+{
+    CANVAS_ENTER_FUNC();
+    CANVAS_VALID(window_id);
+
+    if (_canvas_using_wayland)
+    {
+        CANVAS_RETURN(CANVAS_OK);
+    }
+
+    canvas_info.canvas[window_id].cursor = cursor;
+    canvas_info.canvas[window_id].active_cursor = cursor;
+
+    if (!x11.cursors_loaded)
+    {
+        for (int i = 0; i < 11; i++)
+        {
+            unsigned int id = _canvas_get_x11_cursor_id((canvas_cursor_type)i);
+            x11.cursors[i] = (unsigned long)x11.XCreateFontCursor(x11.display, id);
+            if (!x11.cursors[i])
+            {
+                CANVAS_ERR("failed to create cursor %d\n", i);
+                x11.cursors[i] = (unsigned long)x11.XCreateFontCursor(x11.display, 2);
+            }
+        }
+        x11.cursors_loaded = true;
+    }
+
+    if (x11.cursors[cursor])
+    {
+        x11.XDefineCursor(x11.display, (Window)canvas_info.canvas[window_id].window, x11.cursors[cursor]);
+        x11.XFlush(x11.display);
+    }
+
+    CANVAS_RETURN(CANVAS_OK);
+}
+
+static void _canvas_set_active_cursor(int window_id, canvas_cursor_type cursor)
+{
+    CANVAS_ENTER_FUNC();
+    if (canvas_info.canvas[window_id].active_cursor == cursor)
+        CANVAS_RETURN_VOID();
+
+    canvas_info.canvas[window_id].active_cursor = cursor;
+
+    if (!x11.cursors_loaded)
+    {
+        for (int i = 0; i < 11; i++)
+        {
+            unsigned int id = _canvas_get_x11_cursor_id((canvas_cursor_type)i);
+            x11.cursors[i] = (unsigned long)x11.XCreateFontCursor(x11.display, id);
+        }
+        x11.cursors_loaded = true;
+    }
+
+    x11.XDefineCursor(x11.display, (Window)canvas_info.canvas[window_id].window, x11.cursors[cursor]);
+    x11.XFlush(x11.display);
+    CANVAS_RETURN_VOID();
+}
+
+static int x11_error_handler(Display *display, XErrorEvent *error)
+{
+    char error_text[256];
+    x11.XGetErrorText(display, error->error_code, error_text, sizeof(error_text));
+
+    CANVAS_ERR("X11 Error: %s\n", error_text);
+    CANVAS_ERR("  Request code: %d\n", error->request_code);
+    CANVAS_ERR("  Minor code: %d\n", error->minor_code);
+    CANVAS_ERR("  Resource ID: %lu\n", error->resourceid);
+
+    return 0;
+}
+
+int _canvas_init_x11()
+{
+    CANVAS_ENTER_FUNC();
+
+    x11.library = canvas_library_load(canvas_x11_library_names, 2);
+
+    if (!x11.library)
+    {
+        CANVAS_ERR("libX11.so.6 or libX11.so not found");
+        return CANVAS_ERR_LOAD_LIBRARY;
+    }
+
+    int (*XInitThreads_ptr)(void) = dlsym(x11.library, "XInitThreads");
+    if (XInitThreads_ptr)
+    {
+        if (!XInitThreads_ptr())
+        {
+            CANVAS_WARN("XInitThreads failed - multi-threaded X11 may not work correctly\n");
+        }
+    }
+    else
+    {
+        CANVAS_WARN("XInitThreads not found - multi-threaded X11 may not work correctly\n");
+    }
+
+    LOAD_X11(XOpenDisplay);
+
+    x11.display = x11.XOpenDisplay(NULL);
+
+    if (!x11.display)
+    {
+        dlclose(x11.library);
+        CANVAS_ERR("open x11 display\\n");
+        return CANVAS_ERR_GET_DISPLAY;
+    }
+
+    LOAD_X11(XSetErrorHandler);
+    LOAD_X11(XGetErrorText);
+
+    x11.XSetErrorHandler(x11_error_handler);
+
+    LOAD_X11(XCloseDisplay);
+    LOAD_X11(XCreateSimpleWindow);
+    LOAD_X11(XDestroyWindow);
+    LOAD_X11(XMapWindow);
+    LOAD_X11(XStoreName);
+    LOAD_X11(XSelectInput);
+    LOAD_X11(XNextEvent);
+    LOAD_X11(XSendEvent);
+    LOAD_X11(XPending);
+    LOAD_X11(XRootWindow);
+    LOAD_X11(XFlush);
+    LOAD_X11(XMoveResizeWindow);
+    LOAD_X11(XDisplayWidth);
+    LOAD_X11(XDisplayHeight);
+    LOAD_X11(XInternAtom);
+    LOAD_X11(XIconifyWindow);
+    LOAD_X11(XSetWMProtocols);
+    LOAD_X11(XBlackPixel);
+    LOAD_X11(XWhitePixel);
+    LOAD_X11(XDefaultRootWindow);
+    LOAD_X11(XDefaultScreen);
+    LOAD_X11(XChangeProperty);
+    LOAD_X11(XGetWindowAttributes);
+    LOAD_X11(XGetWindowProperty);
+    LOAD_X11(XGrabPointer);
+    LOAD_X11(XUngrabPointer);
+    LOAD_X11(XMoveWindow);
+    LOAD_X11(XCreateFontCursor);
+    LOAD_X11(XDefineCursor);
+    LOAD_X11(XFree);
+    LOAD_X11(XQueryPointer);
+    LOAD_X11(XTranslateCoordinates);
+    LOAD_X11(XFreeCursor);
+    LOAD_X11(XLockDisplay);
+    LOAD_X11(XUnlockDisplay);
+
+    x11.internal_atom = x11.XInternAtom(x11.display, "_CANVAS_INTERNAL", false);
+
+    xrandr.library = canvas_library_load(canvas_xrandr_library_names, 2);
+
+    if (!xrandr.library)
+    {
+        CANVAS_WARN("libXrandr.so.2 or libXrandr.so not found");
+        return CANVAS_OK;
+    }
+
+    xrandr.XRRGetScreenResourcesCurrent = canvas_library_symbol(xrandr.library, "XRRGetScreenResourcesCurrent");
+    xrandr.XRRFreeScreenResources = canvas_library_symbol(xrandr.library, "XRRFreeScreenResources");
+    xrandr.XRRGetCrtcInfo = canvas_library_symbol(xrandr.library, "XRRGetCrtcInfo");
+    xrandr.XRRFreeCrtcInfo = canvas_library_symbol(xrandr.library, "XRRFreeCrtcInfo");
+    xrandr.XRRGetOutputInfo = canvas_library_symbol(xrandr.library, "XRRGetOutputInfo");
+    xrandr.XRRFreeOutputInfo = canvas_library_symbol(xrandr.library, "XRRFreeOutputInfo");
+    xrandr.XRRGetOutputPrimary = canvas_library_symbol(xrandr.library, "XRRGetOutputPrimary");
+
+    if (!xrandr.XRRGetScreenResourcesCurrent || !xrandr.XRRFreeScreenResources || !xrandr.XRRGetCrtcInfo || !xrandr.XRRFreeCrtcInfo || !xrandr.XRRGetOutputInfo || !xrandr.XRRFreeOutputInfo || !xrandr.XRRGetOutputPrimary)
+    {
+        dlclose(xrandr.library);
+        CANVAS_WARN("failed to load Xrandr symbols");
+        return CANVAS_OK;
+    }
+
+    _canvas_using_wayland = false;
+
+    CANVAS_INFO("X11 initialized successfully\\n");
+    return CANVAS_OK;
+}
+
+int _canvas_platform()
+{
+    CANVAS_ENTER_FUNC();
+    if (canvas_info.init)
+    {
+        CANVAS_RETURN(CANVAS_OK);
+    }
+
+    // Wayland stays dormant until windows get an xdg_shell toplevel, window creation has no Wayland path yet.
+    // Display enumeration and render scale are wired to wl_output and the viewporter for when it is selected here.
+    //     int load_result = _canvas_init_wayland();
+
+    if (!_canvas_using_wayland && _canvas_init_x11() < 0)
+    {
+        CANVAS_RETURN(CANVAS_ERR_GET_DISPLAY);
+    }
+
+    CANVAS_RETURN(CANVAS_OK);
+}
+
+static canvas_cursor_type _canvas_get_resize_cursor(int action)
+{
+    CANVAS_ENTER_FUNC();
+    canvas_cursor_type result;
+    switch (action)
+    {
+    case _NET_WM_MOVERESIZE_SIZE_TOPLEFT:
+        result = CANVAS_CURSOR_SIZE_NESW;
+        break;
+    case _NET_WM_MOVERESIZE_SIZE_TOPRIGHT:
+        result = CANVAS_CURSOR_SIZE_NWSE;
+        break;
+    case _NET_WM_MOVERESIZE_SIZE_BOTTOMLEFT:
+        result = CANVAS_CURSOR_SIZE_NESW;
+        break;
+    case _NET_WM_MOVERESIZE_SIZE_BOTTOMRIGHT:
+        result = CANVAS_CURSOR_SIZE_NWSE;
+        break;
+    case _NET_WM_MOVERESIZE_SIZE_TOP:
+    case _NET_WM_MOVERESIZE_SIZE_BOTTOM:
+        result = CANVAS_CURSOR_SIZE_NS;
+        break;
+    case _NET_WM_MOVERESIZE_SIZE_LEFT:
+    case _NET_WM_MOVERESIZE_SIZE_RIGHT:
+        result = CANVAS_CURSOR_SIZE_EW;
+        break;
+    default:
+        result = CANVAS_CURSOR_ARROW;
+        break;
+    }
+    CANVAS_RETURN(result);
+}
+
+static bool _canvas_is_window_maximized(int window_id)
+{
+    CANVAS_ENTER_FUNC();
+    Window window = (Window)canvas_info.canvas[window_id].window;
+
+    Atom actual_type;
+    int actual_format;
+    unsigned long nitems, bytes_after;
+    unsigned char *prop_data = NULL;
+
+    Atom net_wm_state = _canvas_data[window_id].x11_net_wm_state;
+
+    int result = x11.XGetWindowProperty(
+        x11.display, window,
+        net_wm_state,
+        0, 1024, false, XA_ATOM,
+        &actual_type, &actual_format,
+        &nitems, &bytes_after,
+        &prop_data);
+
+    if (result != 0 || !prop_data)
+        CANVAS_RETURN(false);
+
+    Atom *atoms = (Atom *)prop_data;
+    bool horz_maximized = false;
+    bool vert_maximized = false;
+
+    for (unsigned long i = 0; i < nitems; i++)
+    {
+        if (atoms[i] == _canvas_data[window_id].x11_net_wm_state_maximized_horz)
+            horz_maximized = true;
+        if (atoms[i] == _canvas_data[window_id].x11_net_wm_state_maximized_vert)
+            vert_maximized = true;
+    }
+
+    x11.XFree(prop_data);
+
+    CANVAS_RETURN(horz_maximized && vert_maximized);
+}
+
+int _canvas_update()
+{
+    CANVAS_ENTER_FUNC();
+#if CANVAS_VALIDATION >= 5
+    CANVAS_ASSERT(canvas_info._canary_head == CANVAS_CANARY_HEAD);
+    CANVAS_ASSERT(canvas_info._canary_tail == CANVAS_CANARY_TAIL);
+#endif
+
+    if (_canvas_using_wayland)
+    {
+        _canvas_wayland_dispatch();
+    }
+    else if (!x11.display)
+    {
+        // nothing to poll, offscreen canvases still render
+        if (!canvas_info.headless)
+        {
+            CANVAS_VERBOSE("no display connection for update\n");
+            CANVAS_RETURN(CANVAS_ERR_GET_DISPLAY);
+        }
+    }
+    else
+    {
+        canvas_pointer *p = canvas_get_primary_pointer(0);
+        CANVAS_ASSERT_NOT_NULL(p);
+
+        Window root_return, child_return;
+        int root_x, root_y, win_x, win_y;
+        unsigned int mask_return;
+
+        if (x11.XQueryPointer(x11.display, x11.XDefaultRootWindow(x11.display),
+                              &root_return, &child_return,
+                              &root_x, &root_y, &win_x, &win_y, &mask_return))
+        {
+            p->display = 0;
+            for (int d = 0; d < canvas_info.display_count; d++)
+            {
+                if (root_x >= canvas_info.display[d].x &&
+                    root_x < canvas_info.display[d].x + canvas_info.display[d].width &&
+                    root_y >= canvas_info.display[d].y &&
+                    root_y < canvas_info.display[d].y + canvas_info.display[d].height)
+                {
+                    p->display = d;
+                    p->screen_x = root_x - canvas_info.display[d].x;
+                    p->screen_y = root_y - canvas_info.display[d].y;
+                    break;
+                }
+            }
+
+            uint32_t old_buttons = p->buttons;
+            uint32_t new_buttons = 0;
+
+            if (mask_return & (1 << 8))
+                new_buttons |= CANVAS_BUTTON_LEFT;
+            if (mask_return & (1 << 9))
+                new_buttons |= CANVAS_BUTTON_MIDDLE;
+            if (mask_return & (1 << 10))
+                new_buttons |= CANVAS_BUTTON_RIGHT;
+            if (mask_return & (1 << 11))
+                new_buttons |= CANVAS_BUTTON_X1;
+            if (mask_return & (1 << 12))
+                new_buttons |= CANVAS_BUTTON_X2;
+
+            p->buttons_pressed = new_buttons & ~old_buttons;
+            p->buttons_released = old_buttons & ~new_buttons;
+            p->buttons = new_buttons;
+
+            struct timespec ts;
+            clock_gettime(CLOCK_MONOTONIC, &ts);
+            double timestamp = (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+
+            p->_samples[p->_sample_index].x = p->screen_x;
+            p->_samples[p->_sample_index].y = p->screen_y;
+            p->_samples[p->_sample_index].time = timestamp;
+            p->_sample_index = (p->_sample_index + 1) % CANVAS_POINTER_SAMPLE_FRAMES;
+
+            bool found_window = false;
+
+            for (int i = MAX_CANVAS - 1; i >= 0; i--)
+            {
+                if (!canvas_info.canvas[i]._valid || !canvas_info.canvas[i].window)
+                    continue;
+
+                XWindowAttributes attr;
+                if (x11.XGetWindowAttributes(x11.display, (Window)canvas_info.canvas[i].window, &attr))
+                {
+                    Window child;
+                    int wx, wy;
+                    x11.XTranslateCoordinates(x11.display, (Window)canvas_info.canvas[i].window,
+                                              attr.root, 0, 0, &wx, &wy, &child);
+
+                    bool is_inside = (root_x >= wx && root_x < wx + attr.width &&
+                                      root_y >= wy && root_y < wy + attr.height);
+
+                    if (is_inside && !found_window)
+                    {
+                        found_window = true;
+
+                        p->window_id = i;
+                        p->inside_window = true;
+                        p->x = root_x - wx;
+                        p->y = root_y - wy;
+
+                        if (!canvas_info.canvas[i].maximized)
+                        {
+                            int action = _canvas_get_resize_edge_action(i, p->x, p->y);
+                            if (action >= 0)
+                            {
+                                canvas_cursor_type resize_cursor = _canvas_get_resize_cursor(action);
+                                _canvas_set_active_cursor(i, resize_cursor);
+                            }
+                            else if (p->y < 30)
+                            {
+                                _canvas_set_active_cursor(i, CANVAS_CURSOR_ARROW);
+                            }
+                            else
+                            {
+                                _canvas_set_active_cursor(i, canvas_info.canvas[i].cursor);
+                            }
+                        }
+                        else
+                        {
+                            if (p->y < 30)
+                            {
+                                _canvas_set_active_cursor(i, CANVAS_CURSOR_ARROW);
+                            }
+                            else
+                            {
+                                _canvas_set_active_cursor(i, canvas_info.canvas[i].cursor);
+                            }
+                        }
+                    }
+                }
+            }
+
+            if (!found_window)
+            {
+                p->inside_window = false;
+                p->x = 0;
+                p->y = 0;
+            }
+        }
+
+        XEvent event;
+        while (x11.XPending(x11.display))
+        {
+            x11.XNextEvent(x11.display, &event);
+
+            int window_id = -1;
+            if (event.type >= 2 && event.type <= 35)
+            {
+                _x11_event *base_event = (_x11_event *)&event;
+                window_id = _canvas_window_index((void *)base_event->window);
+            }
+
+            if (window_id < 0)
+                continue;
+
+            switch (event.type)
+            {
+            case X11_ConfigureNotify:
+            {
+                XConfigureEvent *xce = (XConfigureEvent *)&event;
+
+                if (_canvas_data[window_id].client_set)
+                {
+                    _canvas_data[window_id].client_set = false;
+                    break;
+                }
+
+                if (xce->send_event)
+                    break;
+
+                canvas_info.canvas[window_id].x = xce->x;
+                canvas_info.canvas[window_id].y = xce->y;
+
+                bool size_changed = (canvas_info.canvas[window_id].width != xce->width ||
+                                     canvas_info.canvas[window_id].height != xce->height);
+
+                if (size_changed)
+                {
+                    canvas_info.canvas[window_id].width = xce->width;
+                    canvas_info.canvas[window_id].height = xce->height;
+                    canvas_info.canvas[window_id].resize = true;
+                    canvas_info.canvas[window_id].os_resized = true;
+
+                    vk_request_resize(window_id);
+                }
+
+                break;
+            }
+
+            case X11_ButtonPress:
+            {
+                XButtonEvent *xbe = (XButtonEvent *)&event;
+
+                canvas_pointer *p = canvas_get_primary_pointer(window_id);
+
+                if (xbe->button == 4)
+                {
+                    p->scroll_y = 1.0f;
+                    break;
+                }
+                if (xbe->button == 5)
+                {
+                    p->scroll_y = -1.0f;
+                    break;
+                }
+                if (xbe->button == 6)
+                {
+                    p->scroll_x = -1.0f;
+                    break;
+                }
+                if (xbe->button == 7)
+                {
+                    p->scroll_x = 1.0f;
+                    break;
+                }
+
+                if (xbe->button == 1)
+                {
+                    p->window_id = window_id;
+
+                    int time_diff = xbe->time - _canvas_data[window_id].last_button_press_time;
+                    int dx = xbe->x - _canvas_data[window_id].last_button_press_x;
+                    int dy = xbe->y - _canvas_data[window_id].last_button_press_y;
+
+                    if (time_diff < 400 && dx * dx + dy * dy < 25 && xbe->y < 30)
+                    {
+                        if (canvas_info.canvas[window_id].maximized)
+                            canvas_restore(window_id);
+                        else
+                            canvas_maximize(window_id);
+                    }
+                    else
+                    {
+                        if (!canvas_info.canvas[window_id].maximized)
+                        {
+                            int action = _canvas_get_resize_edge_action(window_id, xbe->x, xbe->y);
+
+                            if (action >= 0)
+                            {
+                                canvas_info.canvas[window_id].os_resized = true;
+                                _canvas_start_wm_move_resize(window_id, xbe->x_root, xbe->y_root, action);
+                            }
+                            else if (xbe->y < 30)
+                            {
+                                canvas_info.canvas[window_id].os_moved = true;
+                                _canvas_start_wm_move_resize(window_id, xbe->x_root, xbe->y_root, _NET_WM_MOVERESIZE_MOVE);
+                            }
+                        }
+                        else if (xbe->y < 30)
+                        {
+                            canvas_info.canvas[window_id].os_moved = true;
+                            _canvas_start_wm_move_resize(window_id, xbe->x_root, xbe->y_root, _NET_WM_MOVERESIZE_MOVE);
+                        }
+                    }
+
+                    _canvas_data[window_id].last_button_press_time = xbe->time;
+                    _canvas_data[window_id].last_button_press_x = xbe->x;
+                    _canvas_data[window_id].last_button_press_y = xbe->y;
+                }
+
+                break;
+            }
+
+            case X11_PropertyNotify:
+            {
+                XPropertyEvent *xpe = (XPropertyEvent *)&event;
+
+                if (xpe->atom == _canvas_data[window_id].x11_net_wm_state)
+                {
+                    bool was_maximized = canvas_info.canvas[window_id].maximized;
+                    bool is_maximized = _canvas_is_window_maximized(window_id);
+
+                    canvas_info.canvas[window_id].maximized = is_maximized;
+
+                    if (was_maximized != is_maximized)
+                        canvas_info.canvas[window_id].active_cursor = CANVAS_CURSOR_ARROW;
+                }
+                break;
+            }
+
+            case X11_ClientMessage:
+            {
+                XClientMessageEvent *cm = (XClientMessageEvent *)&event;
+
+                if ((Atom)cm->data.l[0] == _canvas_data[window_id].x11_wm_delete_window)
+                    canvas_info.canvas[window_id].close = true;
+
+                break;
+            }
+
+            case X11_UnmapNotify:
+            {
+                canvas_info.canvas[window_id].minimized = true;
+                canvas_info.canvas[window_id].maximized = false;
+                break;
+            }
+
+            case 2:
+            {
+                XKeyEvent *xke = (XKeyEvent *)&event;
+                unsigned int keycode = xke->keycode;
+
+                if (keycode >= 8 && keycode < 256)
+                {
+                    keycode -= 8;
+                    int hid = x11_to_hid[keycode];
+                    if (hid > 0 && hid < 256 && !canvas_keyboard.keys[hid])
+                    {
+                        canvas_keyboard.keys[hid] = true;
+                        canvas_keyboard.keys_pressed[hid] = true;
+                    }
+                }
+                break;
+            }
+
+            case 3:
+            {
+                XKeyEvent *xke = (XKeyEvent *)&event;
+                unsigned int keycode = xke->keycode;
+
+                if (keycode >= 8 && keycode < 256)
+                {
+                    keycode -= 8;
+                    int hid = x11_to_hid[keycode];
+                    if (hid > 0 && hid < 256 && canvas_keyboard.keys[hid])
+                    {
+                        canvas_keyboard.keys[hid] = false;
+                        canvas_keyboard.keys_released[hid] = true;
+                    }
+                }
+                break;
+            }
+
+            case X11_MapNotify:
+            {
+                canvas_info.canvas[window_id].minimized = false;
+                break;
+            }
+            }
+        }
+    }
+
+    vk_draw_frames();
+
+    // draw streams are rebuilt every frame, a window that skipped the frame drops its stream
+    for (int i = 0; i < MAX_CANVAS; i++)
+    {
+        vk_windows[i].command_count = 0;
+        vk_windows[i].batch.quad_count = 0;
+        vk_windows[i].batch.run_count = 0;
+    }
+
+    CANVAS_RETURN(CANVAS_OK);
+}
+
+int _canvas_gpu_init(void)
+{
+    CANVAS_ENTER_FUNC();
+    if (canvas_info.init_gpu)
+        CANVAS_RETURN(CANVAS_OK);
+
+    int result = canvas_backend_vulkan_init();
+
+    if (result != CANVAS_OK)
+        CANVAS_RETURN(result);
+
+    canvas_info.init_gpu = 1;
+    CANVAS_RETURN(CANVAS_OK);
+}
 
-            if (!found_window)
-            {
-                p->inside_window = false;
-                p->x = 0;
-                p->y = 0;
-            }
+// the first canvas picks the device, a null surface when it is offscreen
+static int vk_create_device(VkSurfaceKHR surface)
+{
+    CANVAS_ENTER_FUNC();
+
+    if (vk_info.device)
+        CANVAS_RETURN(CANVAS_OK);
+
+    VkResult vk_result = vk_select_physical_device(surface);
+    if (vk_result != VK_SUCCESS)
+    {
+        CANVAS_RETURN_ERR(CANVAS_ERR_GET_GPU, "failed to select physical device\n");
+    }
+
+    int result = vk_create_logical_device();
+    if (result != CANVAS_OK)
+        CANVAS_RETURN(result);
+
+    result = vk_load_device_functions();
+    if (result != CANVAS_OK)
+    {
+        vk_info.vkDestroyDevice(vk_info.device, NULL);
+        vk_info.device = VK_NULL_HANDLE;
+    }
+
+    CANVAS_RETURN(result);
+}
+
+// render pass, command buffers and sync objects on top of the window's color targets
+static int vk_create_frame_objects(int window_id)
+{
+    CANVAS_ENTER_FUNC();
+
+    canvas_vulkan_window *vk_win = &vk_windows[window_id];
+    int result;
+
+    if (!vk_info.dynamic_rendering)
+    {
+        result = vk_create_render_pass(window_id);
+        if (result != CANVAS_OK)
+            CANVAS_RETURN(result);
+
+        result = vk_create_framebuffers(window_id);
+        if (result != CANVAS_OK)
+            CANVAS_RETURN(result);
+    }
+
+    result = vk_create_command_pool(window_id);
+    if (result != CANVAS_OK)
+        CANVAS_RETURN(result);
+
+    result = vk_create_command_buffers(window_id);
+    if (result != CANVAS_OK)
+        CANVAS_RETURN(result);
+
+    result = vk_create_sync_objects(window_id);
+    if (result != CANVAS_OK)
+        CANVAS_RETURN(result);
+
+    vk_win->initialized = true;
+    vk_win->current_frame = 0;
+    vk_win->batch.blend = CANVAS_BLEND_ALPHA;
+
+    CANVAS_RETURN(CANVAS_OK);
+}
+
+int _canvas_gpu_new_window(int window_id)
+{
+    CANVAS_ENTER_FUNC();
+    CANVAS_BOUNDS(window_id);
+
+    canvas_vulkan_window *vk_win = &vk_windows[window_id];
+    memset(vk_win, 0, sizeof(canvas_vulkan_window));
+
+    int result;
+
+    result = vk_create_surface(window_id, &vk_win->surface);
+    if (result != CANVAS_OK)
+        CANVAS_RETURN_ERR(result, "failed to create surface for window %d\n", window_id);
+
+    result = vk_create_device(vk_win->surface);
+    if (result == CANVAS_OK && !vk_info.swapchain)
+    {
+        CANVAS_ERR("the device was picked for offscreen canvases and cannot present\n");
+        result = CANVAS_ERR_GET_GPU;
+    }
+
+    if (result != CANVAS_OK)
+    {
+        vk_info.vkDestroySurfaceKHR(vk_info.instance, vk_win->surface, NULL);
+        CANVAS_RETURN(result);
+    }
+
+    result = vk_create_swapchain(window_id);
+    if (result != CANVAS_OK)
+        goto cleanup;
+
+    result = vk_create_frame_objects(window_id);
+    if (result != CANVAS_OK)
+        goto cleanup;
+
+    CANVAS_VERBOSE("vulkan setup complete for window %d\n", window_id);
+    CANVAS_RETURN(CANVAS_OK);
+
+cleanup:
+    vk_cleanup_window(window_id);
+    CANVAS_RETURN(result);
+}
+
+int _canvas_gpu_new_offscreen(int window_id, canvas_format format)
+{
+    CANVAS_ENTER_FUNC();
+    CANVAS_BOUNDS(window_id);
+
+    canvas_vulkan_window *vk_win = &vk_windows[window_id];
+    memset(vk_win, 0, sizeof(canvas_vulkan_window));
+
+    int result = vk_create_device(VK_NULL_HANDLE);
+    if (result != CANVAS_OK)
+        CANVAS_RETURN(result);
+
+    result = vk_create_offscreen_targets(window_id, vk_offscreen_format(format));
+    if (result == CANVAS_OK)
+        result = vk_create_frame_objects(window_id);
+
+    if (result != CANVAS_OK)
+    {
+        // the cleanup only runs on initialized windows
+        vk_win->initialized = true;
+        vk_cleanup_window(window_id);
+        CANVAS_RETURN(result);
+    }
+
+    CANVAS_VERBOSE("vulkan offscreen setup complete for canvas %d\n", window_id);
+    CANVAS_RETURN(CANVAS_OK);
+}
+
+int _canvas_window_resize(int window_id)
+{
+    CANVAS_ENTER_FUNC();
+    CANVAS_BOUNDS(window_id);
+
+    canvas_vulkan_window *vk_win = &vk_windows[window_id];
+
+    if (!vk_win->initialized)
+        CANVAS_RETURN(CANVAS_OK);
+
+    vk_win->needs_recreate = true;
+    CANVAS_RETURN(CANVAS_OK);
+}
+
+int _canvas_post_update()
+{
+    CANVAS_ENTER_FUNC();
+    if (_canvas_using_wayland)
+    {
+    }
+    else if (x11.display)
+    {
+        x11.XFlush(x11.display);
+    }
+
+    CANVAS_RETURN(CANVAS_OK);
+}
+
+int _canvas_exit()
+{
+    CANVAS_ENTER_FUNC();
+    if (vk_info.library)
+        vk_cleanup();
+
+    if (x11.cursors_loaded)
+    {
+        for (int i = 0; i < 11; i++)
+        {
+            if (x11.cursors[i])
+                x11.XFreeCursor(x11.display, x11.cursors[i]);
+        }
+    }
+
+    if (x11.display)
+        x11.XCloseDisplay(x11.display);
+
+    if (x11.library)
+        dlclose(x11.library);
+
+    if (xrandr.library)
+        dlclose(xrandr.library);
+
+    if (wl.display)
+    {
+        for (int i = 0; i < wl.output_count; i++)
+        {
+            if (wl.outputs[i].xdg_output)
+                wl.wl_proxy_destroy(wl.outputs[i].xdg_output);
+            wl.wl_proxy_destroy(wl.outputs[i].output);
         }
+        wl.output_count = 0;
+
+        if (wl.xdg_output_manager)
+            wl.wl_proxy_destroy(wl.xdg_output_manager);
+        if (wl.compositor)
+            wl.wl_proxy_destroy((struct wl_proxy *)wl.compositor);
+        if (wl.registry)
+            wl.wl_proxy_destroy((struct wl_proxy *)wl.registry);
+
+        wl.wl_display_disconnect(wl.display);
+        wl.display = NULL;
+    }
+
+    if (wl.library)
+    {
+        dlclose(wl.library);
+        wl.library = NULL;
+    }
+
+    CANVAS_RETURN(CANVAS_OK);
+}
+
+double canvas_get_time(canvas_time_data *time)
+{
+    CANVAS_ENTER_FUNC();
+    CANVAS_ASSERT(time != NULL);
+
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    if (ts.tv_sec < 0 || ts.tv_nsec < 0)
+        CANVAS_RETURN(0.0);
+
+    uint64_t now = (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+
+    double result = (double)(now - time->start) / 1e9;
+    CANVAS_RETURN(result);
+}
+
+void canvas_sleep(double seconds)
+{
+    CANVAS_ENTER_FUNC();
+
+    struct timespec ts;
+    ts.tv_sec = (time_t)seconds;
+    ts.tv_nsec = (long)((seconds - (double)ts.tv_sec) * 1e9);
+    clock_nanosleep(CLOCK_MONOTONIC, 0, &ts, NULL);
+
+    CANVAS_RETURN_VOID();
+}
+
+void canvas_time_init(canvas_time_data *time)
+{
+    CANVAS_ENTER_FUNC();
+    CANVAS_ASSERT(time != NULL);
+    time->frame = 0;
+    time->frame_index = 0;
+    time->accumulator = 0;
+    time->alpha = 0;
+    time->delta = 0;
+    time->fps = 0;
+    time->raw_delta = 0;
+
+    for (int i = 0; i < 60; i++)
+        time->times[i] = 0.0;
+
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    time->start = (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+    time->current = canvas_get_time(time);
+    time->last = time->current;
+    CANVAS_RETURN_VOID();
+}
+
+#endif // _linux_
+
+//
+//
+// Capture
+
+#if defined(_WIN32)
+typedef HANDLE _canvas_thread;
+typedef CRITICAL_SECTION _canvas_mutex;
+typedef CONDITION_VARIABLE _canvas_cond;
+typedef LPTHREAD_START_ROUTINE _canvas_thread_func;
+#define _CANVAS_THREAD_FUNC(name) static DWORD WINAPI name(LPVOID arg)
+#define _CANVAS_THREAD_END return 0
+
+static bool _canvas_thread_start(_canvas_thread *thread, _canvas_thread_func func, void *arg)
+{
+    *thread = CreateThread(NULL, 0, func, arg, 0, NULL);
+    return *thread != NULL;
+}
+
+static void _canvas_thread_join(_canvas_thread thread)
+{
+    WaitForSingleObject(thread, INFINITE);
+    CloseHandle(thread);
+}
+
+#define _canvas_mutex_init(m) InitializeCriticalSection(m)
+#define _canvas_mutex_destroy(m) DeleteCriticalSection(m)
+#define _canvas_mutex_lock(m) EnterCriticalSection(m)
+#define _canvas_mutex_unlock(m) LeaveCriticalSection(m)
+#define _canvas_cond_init(c) InitializeConditionVariable(c)
+#define _canvas_cond_destroy(c) ((void)(c))
+#define _canvas_cond_wait(c, m) SleepConditionVariableCS(c, m, INFINITE)
+#define _canvas_cond_broadcast(c) WakeAllConditionVariable(c)
+#else
+#include <pthread.h>
+
+typedef pthread_t _canvas_thread;
+typedef pthread_mutex_t _canvas_mutex;
+typedef pthread_cond_t _canvas_cond;
+typedef void *(*_canvas_thread_func)(void *);
+#define _CANVAS_THREAD_FUNC(name) static void *name(void *arg)
+#define _CANVAS_THREAD_END return NULL
+
+static bool _canvas_thread_start(_canvas_thread *thread, _canvas_thread_func func, void *arg)
+{
+    return pthread_create(thread, NULL, func, arg) == 0;
+}
+
+static void _canvas_thread_join(_canvas_thread thread)
+{
+    pthread_join(thread, NULL);
+}
 
-        XEvent event;
-        while (x11.XPending(x11.display))
-        {
-            x11.XNextEvent(x11.display, &event);
+#define _canvas_mutex_init(m) pthread_mutex_init(m, NULL)
+#define _canvas_mutex_destroy(m) pthread_mutex_destroy(m)
+#define _canvas_mutex_lock(m) pthread_mutex_lock(m)
+#define _canvas_mutex_unlock(m) pthread_mutex_unlock(m)
+#define _canvas_cond_init(c) pthread_cond_init(c, NULL)
+#define _canvas_cond_destroy(c) pthread_cond_destroy(c)
+#define _canvas_cond_wait(c, m) pthread_cond_wait(c, m)
+#define _canvas_cond_broadcast(c) pthread_cond_broadcast(c)
+#endif
 
-            int window_id = -1;
-            if (event.type >= 2 && event.type <= 35)
-            {
-                _x11_event *base_event = (_x11_event *)&event;
-                window_id = _canvas_window_index((void *)base_event->window);
-            }
+#define CANVAS_CAPTURE_IO_BUFFER (1 << 20)
+#define CANVAS_CAPTURE_PATH 512
 
-            if (window_id < 0)
-                continue;
+// an entry moves through the stages in this order and is reused once written
+typedef enum
+{
+    _CANVAS_CAPTURE_FREE,
+    _CANVAS_CAPTURE_READING, // readback requested, main thread polls it
+    _CANVAS_CAPTURE_QUEUED,  // pixels ready for a worker
+    _CANVAS_CAPTURE_CONVERTING,
+    _CANVAS_CAPTURE_ENCODED, // waiting for the writer, readback can be released
+    _CANVAS_CAPTURE_WRITTEN,
+} _canvas_capture_state;
 
-            switch (event.type)
-            {
-            case X11_ConfigureNotify:
-            {
-                XConfigureEvent *xce = (XConfigureEvent *)&event;
+typedef struct
+{
+    _canvas_capture_state state;
+    canvas_readback *readback;
+    uint64_t order; // request order, readbacks are queued in it
+    uint64_t seq;   // frame number in the output
 
-                if (_canvas_data[window_id].client_set)
-                {
-                    _canvas_data[window_id].client_set = false;
-                    break;
-                }
+    uint32_t width, height;
+    uint8_t *out; // encoded bytes, kept and regrown across frames
+    size_t out_size;
+    size_t out_capacity;
+} _canvas_capture_entry;
 
-                if (xce->send_event)
-                    break;
+typedef struct
+{
+    int window;
+    canvas_capture_format format;
+    char path[CANVAS_CAPTURE_PATH];
+    uint32_t fps;
+
+    _canvas_capture_entry entries[CANVAS_CAPTURE_QUEUE];
+    uint64_t requests;
+    uint64_t next_seq;  // assigned when a frame is queued
+    uint64_t write_seq; // next frame the writer takes, output stays in order
+    uint32_t y4m_width, y4m_height;
+
+    _canvas_mutex lock;
+    _canvas_cond work;    // queued frames for the workers
+    _canvas_cond encoded; // converted frames for the writer
+    _canvas_thread workers[CANVAS_CAPTURE_WORKERS];
+    _canvas_thread writer;
+    uint32_t worker_count;
+    bool writer_started;
+    bool stopping;
+
+    FILE *file; // y4m only, image sequences open one file per frame
+    canvas_capture_stats stats;
+} _canvas_capture;
+
+static _canvas_capture *_canvas_captures[MAX_CANVAS];
+static uint32_t _canvas_crc_table[256];
+static bool _canvas_crc_ready;
+
+// filled once on the main thread before the first png worker starts, workers of running captures read it
+static void _canvas_crc_init(void)
+{
+    if (_canvas_crc_ready)
+        return;
 
-                canvas_info.canvas[window_id].x = xce->x;
-                canvas_info.canvas[window_id].y = xce->y;
+    for (uint32_t n = 0; n < 256; n++)
+    {
+        uint32_t c = n;
+        for (int k = 0; k < 8; k++)
+            c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+        _canvas_crc_table[n] = c;
+    }
 
-                bool size_changed = (canvas_info.canvas[window_id].width != xce->width ||
-                                     canvas_info.canvas[window_id].height != xce->height);
+    _canvas_crc_ready = true;
+}
 
-                if (size_changed)
-                {
-                    canvas_info.canvas[window_id].width = xce->width;
-                    canvas_info.canvas[window_id].height = xce->height;
-                    canvas_info.canvas[window_id].resize = true;
-                    canvas_info.canvas[window_id].os_resized = true;
+static uint32_t _canvas_crc(uint32_t crc, const uint8_t *data, size_t size)
+{
+    crc = ~crc;
+    for (size_t i = 0; i < size; i++)
+        crc = _canvas_crc_table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    return ~crc;
+}
 
-                    canvas_vulkan_window *vk_win = &vk_windows[window_id];
-                    if (vk_win->initialized)
-                    {
-                        vk_win->needs_resize = true;
-                    }
-                }
+static uint8_t *_canvas_put_be32(uint8_t *p, uint32_t v)
+{
+    p[0] = (uint8_t)(v >> 24);
+    p[1] = (uint8_t)(v >> 16);
+    p[2] = (uint8_t)(v >> 8);
+    p[3] = (uint8_t)v;
+    return p + 4;
+}
 
-                break;
-            }
+#ifdef __cplusplus
+#define _CANVAS_RESTRICT __restrict
+#else
+#define _CANVAS_RESTRICT restrict
+#endif
 
-            case X11_ButtonPress:
-            {
-                XButtonEvent *xbe = (XButtonEvent *)&event;
+// the row loops below only vectorize with constant channel offsets, non-aliasing rows and
+// size_t indices, so each is inlined twice with the offsets spelled out
+static inline void _canvas_swizzle_row(uint8_t *_CANVAS_RESTRICT dst, const uint8_t *_CANVAS_RESTRICT src, size_t width, const int r, const int b)
+{
+    for (size_t x = 0; x < width; x++)
+    {
+        dst[x * 3 + 0] = src[x * 4 + r];
+        dst[x * 3 + 1] = src[x * 4 + 1];
+        dst[x * 3 + 2] = src[x * 4 + b];
+    }
+}
 
-                canvas_pointer *p = canvas_get_primary_pointer(window_id);
+// the 3 byte stores need a byte shuffle, so this vectorizes with SSSE3, AVX2 or NEON but not baseline x86-64
+static void _canvas_swizzle_rgb(uint8_t *dst, const uint8_t *src, uint32_t width, bool bgra)
+{
+    if (bgra)
+        _canvas_swizzle_row(dst, src, width, 2, 0);
+    else
+        _canvas_swizzle_row(dst, src, width, 0, 2);
+}
 
-                if (xbe->button == 4)
-                {
-                    p->scroll_y = 1.0f;
-                    break;
-                }
-                if (xbe->button == 5)
-                {
-                    p->scroll_y = -1.0f;
-                    break;
-                }
-                if (xbe->button == 6)
-                {
-                    p->scroll_x = -1.0f;
-                    break;
-                }
-                if (xbe->button == 7)
-                {
-                    p->scroll_x = 1.0f;
-                    break;
-                }
+static inline void _canvas_y4m_row(uint8_t *_CANVAS_RESTRICT y, uint8_t *_CANVAS_RESTRICT u, uint8_t *_CANVAS_RESTRICT v,
+                                   const uint8_t *_CANVAS_RESTRICT src, size_t width, const int ri, const int bi)
+{
+    for (size_t x = 0; x < width; x++)
+    {
+        int r = src[x * 4 + ri], g = src[x * 4 + 1], b = src[x * 4 + bi];
+        y[x] = (uint8_t)(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+        u[x] = (uint8_t)(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+        v[x] = (uint8_t)(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+    }
+}
 
-                if (xbe->button == 1)
-                {
-                    p->window_id = window_id;
+// BT.601 studio range 4:4:4, the y4m default
+static size_t _canvas_encode_y4m(uint8_t *out, const canvas_readback *rb, bool bgra)
+{
+    size_t plane = (size_t)rb->width * rb->height;
 
-                    int time_diff = xbe->time - _canvas_data[window_id].last_button_press_time;
-                    int dx = xbe->x - _canvas_data[window_id].last_button_press_x;
-                    int dy = xbe->y - _canvas_data[window_id].last_button_press_y;
+    memcpy(out, "FRAME\n", 6);
+    uint8_t *y = out + 6;
+    uint8_t *u = y + plane;
+    uint8_t *v = u + plane;
 
-                    if (time_diff < 400 && dx * dx + dy * dy < 25 && xbe->y < 30)
-                    {
-                        if (canvas_info.canvas[window_id].maximized)
-                            canvas_restore(window_id);
-                        else
-                            canvas_maximize(window_id);
-                    }
-                    else
-                    {
-                        if (!canvas_info.canvas[window_id].maximized)
-                        {
-                            int action = _canvas_get_resize_edge_action(window_id, xbe->x, xbe->y);
+    for (uint32_t row = 0; row < rb->height; row++)
+    {
+        const uint8_t *src = (const uint8_t *)rb->pixels + (size_t)row * rb->row_pitch;
+        size_t base = (size_t)row * rb->width;
 
-                            if (action >= 0)
-                            {
-                                canvas_info.canvas[window_id].os_resized = true;
-                                _canvas_start_wm_move_resize(window_id, xbe->x_root, xbe->y_root, action);
-                            }
-                            else if (xbe->y < 30)
-                            {
-                                canvas_info.canvas[window_id].os_moved = true;
-                                _canvas_start_wm_move_resize(window_id, xbe->x_root, xbe->y_root, _NET_WM_MOVERESIZE_MOVE);
-                            }
-                        }
-                        else if (xbe->y < 30)
-                        {
-                            canvas_info.canvas[window_id].os_moved = true;
-                            _canvas_start_wm_move_resize(window_id, xbe->x_root, xbe->y_root, _NET_WM_MOVERESIZE_MOVE);
-                        }
-                    }
+        if (bgra)
+            _canvas_y4m_row(y + base, u + base, v + base, src, rb->width, 2, 0);
+        else
+            _canvas_y4m_row(y + base, u + base, v + base, src, rb->width, 0, 2);
+    }
 
-                    _canvas_data[window_id].last_button_press_time = xbe->time;
-                    _canvas_data[window_id].last_button_press_x = xbe->x;
-                    _canvas_data[window_id].last_button_press_y = xbe->y;
-                }
+    return 6 + plane * 3;
+}
 
-                break;
-            }
+// https://qoiformat.org, 3 channels since the alpha of presented frames is meaningless
+static size_t _canvas_encode_qoi(uint8_t *out, const canvas_readback *rb, bool bgra)
+{
+    const int ri = bgra ? 2 : 0;
+    const int bi = bgra ? 0 : 2;
+    uint8_t index[64][3] = {{0}};
+    uint64_t indexed = 0; // the decoder's index starts with alpha 0, unset slots must not match
+    uint8_t pr = 0, pg = 0, pb = 0;
+    uint32_t run = 0;
 
-            case X11_PropertyNotify:
-            {
-                XPropertyEvent *xpe = (XPropertyEvent *)&event;
+    uint8_t *p = out;
+    memcpy(p, "qoif", 4);
+    p = _canvas_put_be32(p + 4, rb->width);
+    p = _canvas_put_be32(p, rb->height);
+    *p++ = 3; // channels
+    *p++ = 0; // srgb with linear alpha
 
-                if (xpe->atom == _canvas_data[window_id].x11_net_wm_state)
-                {
-                    bool was_maximized = canvas_info.canvas[window_id].maximized;
-                    bool is_maximized = _canvas_is_window_maximized(window_id);
+    // alpha is always 255, the hash and the ops below are the spec's with that folded in
+    for (uint32_t row = 0; row < rb->height; row++)
+    {
+        const uint8_t *src = (const uint8_t *)rb->pixels + (size_t)row * rb->row_pitch;
+        bool last_row = row + 1 == rb->height;
 
-                    canvas_info.canvas[window_id].maximized = is_maximized;
+        for (uint32_t x = 0; x < rb->width; x++)
+        {
+            uint8_t r = src[x * 4 + ri], g = src[x * 4 + 1], b = src[x * 4 + bi];
 
-                    if (was_maximized != is_maximized)
-                        canvas_info.canvas[window_id].active_cursor = CANVAS_CURSOR_ARROW;
+            if (r == pr && g == pg && b == pb)
+            {
+                run++;
+                if (run == 62 || (last_row && x + 1 == rb->width))
+                {
+                    *p++ = (uint8_t)(0xc0 | (run - 1));
+                    run = 0;
                 }
-                break;
+                continue;
             }
 
-            case X11_ClientMessage:
+            if (run > 0)
             {
-                XClientMessageEvent *cm = (XClientMessageEvent *)&event;
-
-                if ((Atom)cm->data.l[0] == _canvas_data[window_id].x11_wm_delete_window)
-                    canvas_info.canvas[window_id].close = true;
-
-                break;
+                *p++ = (uint8_t)(0xc0 | (run - 1));
+                run = 0;
             }
 
-            case X11_UnmapNotify:
+            uint32_t hash = (r * 3u + g * 5u + b * 7u + 255u * 11u) % 64;
+
+            if ((indexed >> hash & 1) && index[hash][0] == r && index[hash][1] == g && index[hash][2] == b)
             {
-                canvas_info.canvas[window_id].minimized = true;
-                canvas_info.canvas[window_id].maximized = false;
-                break;
+                *p++ = (uint8_t)hash;
             }
-
-            case 2:
+            else
             {
-                XKeyEvent *xke = (XKeyEvent *)&event;
-                unsigned int keycode = xke->keycode;
+                index[hash][0] = r;
+                index[hash][1] = g;
+                index[hash][2] = b;
+                indexed |= 1ull << hash;
 
-                if (keycode >= 8 && keycode < 256)
+                int8_t dr = (int8_t)(r - pr), dg = (int8_t)(g - pg), db = (int8_t)(b - pb);
+                int8_t dr_dg = (int8_t)(dr - dg), db_dg = (int8_t)(db - dg);
+
+                if (dr > -3 && dr < 2 && dg > -3 && dg < 2 && db > -3 && db < 2)
                 {
-                    keycode -= 8;
-                    int hid = x11_to_hid[keycode];
-                    if (hid > 0 && hid < 256 && !canvas_keyboard.keys[hid])
-                    {
-                        canvas_keyboard.keys[hid] = true;
-                        canvas_keyboard.keys_pressed[hid] = true;
-                    }
+                    *p++ = (uint8_t)(0x40 | (dr + 2) << 4 | (dg + 2) << 2 | (db + 2));
                 }
-                break;
-            }
-
-            case 3:
-            {
-                XKeyEvent *xke = (XKeyEvent *)&event;
-                unsigned int keycode = xke->keycode;
-
-                if (keycode >= 8 && keycode < 256)
+                else if (dr_dg > -9 && dr_dg < 8 && dg > -33 && dg < 32 && db_dg > -9 && db_dg < 8)
                 {
-                    keycode -= 8;
-                    int hid = x11_to_hid[keycode];
-                    if (hid > 0 && hid < 256 && canvas_keyboard.keys[hid])
-                    {
-                        canvas_keyboard.keys[hid] = false;
-                        canvas_keyboard.keys_released[hid] = true;
-                    }
+                    *p++ = (uint8_t)(0x80 | (dg + 32));
+                    *p++ = (uint8_t)((dr_dg + 8) << 4 | (db_dg + 8));
+                }
+                else
+                {
+                    *p++ = 0xfe;
+                    *p++ = r;
+                    *p++ = g;
+                    *p++ = b;
                 }
-                break;
             }
 
-            case X11_MapNotify:
+            pr = r;
+            pg = g;
+            pb = b;
+        }
+    }
+
+    static const uint8_t end[8] = {0, 0, 0, 0, 0, 0, 0, 1};
+    memcpy(p, end, sizeof(end));
+    return (size_t)(p - out) + sizeof(end);
+}
+
+// RGB with stored deflate blocks, bigger files but no compressor in the way of the frame rate
+static size_t _canvas_encode_png(uint8_t *out, const canvas_readback *rb, bool bgra)
+{
+    static const uint8_t signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+    size_t row_bytes = 1 + (size_t)rb->width * 3;
+    size_t raw = row_bytes * rb->height;
+    size_t blocks = (raw + 65534) / 65535;
+    size_t zlib = 2 + blocks * 5 + raw + 4;
+
+    uint8_t *p = out;
+    memcpy(p, signature, 8);
+    p += 8;
+
+    uint8_t *chunk = p;
+    p = _canvas_put_be32(p, 13);
+    memcpy(p, "IHDR", 4);
+    p = _canvas_put_be32(p + 4, rb->width);
+    p = _canvas_put_be32(p, rb->height);
+    *p++ = 8; // bit depth
+    *p++ = 2; // truecolor
+    *p++ = 0;
+    *p++ = 0;
+    *p++ = 0;
+    p = _canvas_put_be32(p, _canvas_crc(0, chunk + 4, 17));
+
+    chunk = p;
+    p = _canvas_put_be32(p, (uint32_t)zlib);
+    memcpy(p, "IDAT", 4);
+    p += 4;
+    *p++ = 0x78;
+    *p++ = 0x01;
+
+    // rows are streamed through the blocks, filter type 0 ahead of each
+    uint32_t a = 1, b = 0;
+    size_t block_left = 0, left = raw;
+    uint32_t row = 0;
+    size_t row_offset = 0;
+    uint8_t *row_buf = (uint8_t *)malloc(row_bytes);
+    if (!row_buf)
+        return 0;
+
+    while (left > 0)
+    {
+        if (block_left == 0)
+        {
+            block_left = left < 65535 ? left : 65535;
+            *p++ = left == block_left ? 1 : 0;
+            *p++ = (uint8_t)block_left;
+            *p++ = (uint8_t)(block_left >> 8);
+            *p++ = (uint8_t)~block_left;
+            *p++ = (uint8_t)(~block_left >> 8);
+        }
+
+        if (row_offset == 0)
+        {
+            row_buf[0] = 0;
+            _canvas_swizzle_rgb(row_buf + 1, (const uint8_t *)rb->pixels + (size_t)row * rb->row_pitch, rb->width, bgra);
+        }
+
+        size_t n = row_bytes - row_offset;
+        if (n > block_left)
+            n = block_left;
+
+        memcpy(p, row_buf + row_offset, n);
+
+        // 5552 bytes is the most the sums take before they could overflow
+        for (size_t done = 0; done < n;)
+        {
+            size_t end = n - done > 5552 ? done + 5552 : n;
+            for (; done < end; done++)
             {
-                canvas_info.canvas[window_id].minimized = false;
-                break;
-            }
+                a += p[done];
+                b += a;
             }
+            a %= 65521;
+            b %= 65521;
+        }
+
+        p += n;
+        left -= n;
+        block_left -= n;
+        row_offset += n;
+        if (row_offset == row_bytes)
+        {
+            row_offset = 0;
+            row++;
         }
     }
 
-    // Render all windows
-    for (int i = 0; i < MAX_CANVAS; i++)
+    free(row_buf);
+    p = _canvas_put_be32(p, b << 16 | a);
+    p = _canvas_put_be32(p, _canvas_crc(0, chunk + 4, 4 + zlib));
+
+    p = _canvas_put_be32(p, 0);
+    memcpy(p, "IEND", 4);
+    p = _canvas_put_be32(p + 4, _canvas_crc(0, (const uint8_t *)"IEND", 4));
+
+    return (size_t)(p - out);
+}
+
+static size_t _canvas_capture_bound(canvas_capture_format format, uint32_t width, uint32_t height)
+{
+    size_t pixels = (size_t)width * height;
+
+    switch (format)
     {
-        if (!canvas_info.canvas[i]._valid || !vk_windows[i].initialized)
+    case CANVAS_CAPTURE_Y4M:
+        return 6 + pixels * 3;
+    case CANVAS_CAPTURE_QOI:
+        return 14 + pixels * 4 + 8;
+    default:
+    {
+        size_t raw = (1 + (size_t)width * 3) * height;
+        return 8 + 25 + 12 + 2 + (raw + 65534) / 65535 * 5 + raw + 4 + 12;
+    }
+    }
+}
+
+// stage 2: converts queued frames straight out of the readback memory
+_CANVAS_THREAD_FUNC(_canvas_capture_worker)
+{
+    _canvas_capture *cap = (_canvas_capture *)arg;
+
+    _canvas_mutex_lock(&cap->lock);
+
+    for (;;)
+    {
+        _canvas_capture_entry *entry = NULL;
+        for (uint32_t i = 0; i < CANVAS_CAPTURE_QUEUE; i++)
+        {
+            _canvas_capture_entry *e = &cap->entries[i];
+            if (e->state == _CANVAS_CAPTURE_QUEUED && (!entry || e->seq < entry->seq))
+                entry = e;
+        }
+
+        if (!entry)
+        {
+            if (cap->stopping)
+                break;
+
+            _canvas_cond_wait(&cap->work, &cap->lock);
             continue;
+        }
+
+        entry->state = _CANVAS_CAPTURE_CONVERTING;
+        const canvas_readback *rb = entry->readback;
+        _canvas_mutex_unlock(&cap->lock);
+
+        bool bgra = rb->format == CANVAS_FORMAT_BGRA8 || rb->format == CANVAS_FORMAT_BGRA8_SRGB;
+        size_t bound = _canvas_capture_bound(cap->format, rb->width, rb->height);
+
+        if (entry->out_capacity < bound)
+        {
+            free(entry->out);
+            entry->out = (uint8_t *)malloc(bound);
+            entry->out_capacity = entry->out ? bound : 0;
+        }
 
-        vk_draw_frame(i);
+        entry->width = rb->width;
+        entry->height = rb->height;
+        entry->out_size = 0;
+
+        if (entry->out)
+        {
+            if (cap->format == CANVAS_CAPTURE_Y4M)
+                entry->out_size = _canvas_encode_y4m(entry->out, rb, bgra);
+            else if (cap->format == CANVAS_CAPTURE_QOI)
+                entry->out_size = _canvas_encode_qoi(entry->out, rb, bgra);
+            else
+                entry->out_size = _canvas_encode_png(entry->out, rb, bgra);
+        }
+
+        _canvas_mutex_lock(&cap->lock);
+        entry->state = _CANVAS_CAPTURE_ENCODED;
+        _canvas_cond_broadcast(&cap->encoded);
     }
 
-    CANVAS_RETURN(CANVAS_OK);
+    _canvas_mutex_unlock(&cap->lock);
+    _CANVAS_THREAD_END;
 }
 
-int _canvas_gpu_init(void)
+static bool _canvas_capture_write(_canvas_capture *cap, _canvas_capture_entry *entry)
 {
-    CANVAS_ENTER_FUNC();
-    if (canvas_info.init_gpu)
-        CANVAS_RETURN(CANVAS_OK);
+    if (entry->out_size == 0)
+        return false;
 
-    int result = canvas_backend_vulkan_init();
+    if (cap->format == CANVAS_CAPTURE_Y4M)
+    {
+        // the stream has one size, frames after a resize are dropped
+        if (cap->y4m_width == 0)
+        {
+            cap->y4m_width = entry->width;
+            cap->y4m_height = entry->height;
+            fprintf(cap->file, "YUV4MPEG2 W%u H%u F%u:1 Ip A1:1 C444\n", entry->width, entry->height, cap->fps);
+        }
 
-    if (result != CANVAS_OK)
-        CANVAS_RETURN(result);
+        if (entry->width != cap->y4m_width || entry->height != cap->y4m_height)
+            return false;
 
-    canvas_info.init_gpu = 1;
-    CANVAS_RETURN(CANVAS_OK);
-}
+        return fwrite(entry->out, 1, entry->out_size, cap->file) == entry->out_size;
+    }
 
-int _canvas_gpu_new_window(int window_id)
-{
-    CANVAS_ENTER_FUNC();
-    CANVAS_BOUNDS(window_id);
+    char name[CANVAS_CAPTURE_PATH + 32];
+    snprintf(name, sizeof(name), "%s%06" PRIu64 ".%s", cap->path, entry->seq,
+             cap->format == CANVAS_CAPTURE_QOI ? "qoi" : "png");
 
-    canvas_vulkan_window *vk_win = &vk_windows[window_id];
-    memset(vk_win, 0, sizeof(canvas_vulkan_window));
+    FILE *file = fopen(name, "wb");
+    if (!file)
+        return false;
 
-    int result;
+    bool ok = fwrite(entry->out, 1, entry->out_size, file) == entry->out_size;
+    return fclose(file) == 0 && ok;
+}
 
-    result = vk_create_surface(window_id, &vk_win->surface);
-    if (result != CANVAS_OK)
-        CANVAS_RETURN_ERR(result, "failed to create surface for window %d\n", window_id);
+// stage 3: writes converted frames in order, the only thread touching the files
+_CANVAS_THREAD_FUNC(_canvas_capture_writer)
+{
+    _canvas_capture *cap = (_canvas_capture *)arg;
 
-    if (!vk_info.device)
+    _canvas_mutex_lock(&cap->lock);
+
+    for (;;)
     {
-        VkResult vk_result = vk_select_physical_device(vk_win->surface);
-        if (vk_result != VK_SUCCESS)
+        _canvas_capture_entry *entry = NULL;
+        bool pending = false;
+
+        for (uint32_t i = 0; i < CANVAS_CAPTURE_QUEUE; i++)
         {
-            CANVAS_ERR("failed to select physical device\n");
-            vk_info.vkDestroySurfaceKHR(vk_info.instance, vk_win->surface, NULL);
-            CANVAS_RETURN(CANVAS_ERR_GET_GPU);
+            _canvas_capture_entry *e = &cap->entries[i];
+            if (e->state >= _CANVAS_CAPTURE_QUEUED && e->state <= _CANVAS_CAPTURE_ENCODED)
+            {
+                pending = true;
+                if (e->state == _CANVAS_CAPTURE_ENCODED && e->seq == cap->write_seq)
+                    entry = e;
+            }
         }
 
-        result = vk_create_logical_device();
-        if (result != CANVAS_OK)
+        if (!entry)
         {
-            vk_info.vkDestroySurfaceKHR(vk_info.instance, vk_win->surface, NULL);
-            CANVAS_RETURN(result);
+            if (cap->stopping && !pending)
+                break;
+
+            _canvas_cond_wait(&cap->encoded, &cap->lock);
+            continue;
         }
 
-        result = vk_load_device_functions();
-        if (result != CANVAS_OK)
+        _canvas_mutex_unlock(&cap->lock);
+        bool written = _canvas_capture_write(cap, entry);
+        _canvas_mutex_lock(&cap->lock);
+
+        if (written)
         {
-            vk_info.vkDestroyDevice(vk_info.device, NULL);
-            vk_info.vkDestroySurfaceKHR(vk_info.instance, vk_win->surface, NULL);
-            CANVAS_RETURN(result);
+            cap->stats.written++;
+            cap->stats.bytes += entry->out_size;
+        }
+        else
+        {
+            cap->stats.dropped++;
         }
-    }
 
-    result = vk_create_swapchain(window_id);
-    if (result != CANVAS_OK)
-        goto cleanup;
+        entry->state = _CANVAS_CAPTURE_WRITTEN;
+        cap->write_seq++;
+    }
 
-    result = vk_create_render_pass(window_id);
-    if (result != CANVAS_OK)
-        goto cleanup;
+    _canvas_mutex_unlock(&cap->lock);
+    _CANVAS_THREAD_END;
+}
 
-    result = vk_create_framebuffers(window_id);
-    if (result != CANVAS_OK)
-        goto cleanup;
+// stage 1, once per frame on the main thread: hands finished readbacks on and asks for the next one
+static void _canvas_capture_frame(int window_id)
+{
+    _canvas_capture *cap = _canvas_captures[window_id];
+    if (!cap)
+        return;
 
-    result = vk_create_command_pool(window_id);
-    if (result != CANVAS_OK)
-        goto cleanup;
+    _canvas_mutex_lock(&cap->lock);
 
-    result = vk_create_command_buffers(window_id);
-    if (result != CANVAS_OK)
-        goto cleanup;
+    bool queued = false;
 
-    result = vk_create_sync_objects(window_id);
-    if (result != CANVAS_OK)
-        goto cleanup;
+    // readbacks finish in the order they were requested
+    for (;;)
+    {
+        _canvas_capture_entry *oldest = NULL;
+        for (uint32_t i = 0; i < CANVAS_CAPTURE_QUEUE; i++)
+        {
+            _canvas_capture_entry *e = &cap->entries[i];
+            if (e->state == _CANVAS_CAPTURE_READING && (!oldest || e->order < oldest->order))
+                oldest = e;
+        }
 
-    vk_win->initialized = true;
-    vk_win->current_frame = 0;
+        if (!oldest || !canvas_readback_poll(oldest->readback))
+            break;
 
-    CANVAS_VERBOSE("vulkan setup complete for window %d\n", window_id);
-    CANVAS_RETURN(CANVAS_OK);
+        oldest->seq = cap->next_seq++;
+        oldest->state = _CANVAS_CAPTURE_QUEUED;
+        cap->stats.captured++;
+        queued = true;
+    }
 
-cleanup:
-    vk_cleanup_window(window_id);
-    CANVAS_RETURN(result);
-}
+    // pixels are not needed once converted, written entries take the next frame
+    _canvas_capture_entry *free_entry = NULL;
+    bool unrecorded = false;
+    for (uint32_t i = 0; i < CANVAS_CAPTURE_QUEUE; i++)
+    {
+        _canvas_capture_entry *e = &cap->entries[i];
 
-int _canvas_window_resize(int window_id)
-{
-    CANVAS_ENTER_FUNC();
-    CANVAS_BOUNDS(window_id);
+        // a skipped frame left its request unrecorded, a second one would copy the same image
+        if (e->state == _CANVAS_CAPTURE_READING && e->readback->frame == 0)
+            unrecorded = true;
 
-    canvas_vulkan_window *vk_win = &vk_windows[window_id];
+        if (e->state >= _CANVAS_CAPTURE_ENCODED && e->readback)
+        {
+            canvas_readback_release(e->readback);
+            e->readback = NULL;
+        }
 
-    if (!vk_win->initialized)
-        CANVAS_RETURN(CANVAS_OK);
+        if (e->state == _CANVAS_CAPTURE_WRITTEN)
+            e->state = _CANVAS_CAPTURE_FREE;
 
-    vk_win->needs_resize = true;
-    CANVAS_RETURN(CANVAS_OK);
-}
+        if (e->state == _CANVAS_CAPTURE_FREE && !free_entry)
+            free_entry = e;
+    }
 
-int _canvas_post_update()
-{
-    CANVAS_ENTER_FUNC();
-    if (_canvas_using_wayland)
+    // a full queue, no readback slot or a request still waiting for its frame drops the frame instead of waiting
+    canvas_readback *readback = free_entry && !unrecorded ? canvas_readback_request(window_id) : NULL;
+    if (readback)
     {
+        free_entry->readback = readback;
+        free_entry->order = cap->requests++;
+        free_entry->state = _CANVAS_CAPTURE_READING;
+        cap->stats.requested++;
     }
     else
     {
-        x11.XFlush(x11.display);
+        cap->stats.dropped++;
     }
 
-    CANVAS_RETURN(CANVAS_OK);
+    if (queued)
+        _canvas_cond_broadcast(&cap->work);
+
+    _canvas_mutex_unlock(&cap->lock);
 }
 
-int _canvas_exit()
+int canvas_capture_start(int window_id, canvas_capture_format format, const char *path, uint32_t fps)
 {
     CANVAS_ENTER_FUNC();
-    if (vk_info.library)
-        vk_cleanup();
+    CANVAS_VALID(window_id);
+    CANVAS_ASSERT_NOT_NULL(path);
 
-    if (x11.cursors_loaded)
+    if (!path || format < CANVAS_CAPTURE_Y4M || format > CANVAS_CAPTURE_PNG || strlen(path) >= CANVAS_CAPTURE_PATH)
+        CANVAS_RETURN_ERR(CANVAS_INVALID, "capture needs a format and a path shorter than %d\n", CANVAS_CAPTURE_PATH);
+
+    if (_canvas_captures[window_id])
+        CANVAS_RETURN_ERR(CANVAS_INVALID, "window %d is already being captured\n", window_id);
+
+    // a request that is released before it is recorded costs nothing, it tells whether the window can be read
+    canvas_readback *probe = canvas_readback_request(window_id);
+    if (!probe)
+        CANVAS_RETURN_ERR(CANVAS_FAIL, "frames of window %d can't be read back\n", window_id);
+
+    canvas_format pixel_format = probe->format;
+    canvas_readback_release(probe);
+
+    if (pixel_format == CANVAS_FORMAT_RGBA16F)
+        CANVAS_RETURN_ERR(CANVAS_INVALID, "capture takes 8 bit color formats\n");
+
+    _canvas_capture *cap = (_canvas_capture *)calloc(1, sizeof(_canvas_capture));
+    if (!cap)
+        CANVAS_RETURN(CANVAS_FAIL);
+
+    cap->window = window_id;
+    cap->format = format;
+    cap->fps = fps ? fps : 60;
+    memcpy(cap->path, path, strlen(path) + 1);
+
+    if (format == CANVAS_CAPTURE_Y4M)
     {
-        for (int i = 0; i < 11; i++)
+        cap->file = fopen(path, "wb");
+        if (!cap->file)
         {
-            if (x11.cursors[i])
-                x11.XFreeCursor(x11.display, x11.cursors[i]);
+            free(cap);
+            CANVAS_RETURN_ERR(CANVAS_FAIL, "failed to open %s\n", path);
         }
+
+        // frames are written whole, a large buffer turns them into few sequential writes
+        setvbuf(cap->file, NULL, _IOFBF, CANVAS_CAPTURE_IO_BUFFER);
     }
 
-    if (x11.display)
-        x11.XCloseDisplay(x11.display);
+    if (format == CANVAS_CAPTURE_PNG)
+        _canvas_crc_init();
 
-    if (x11.library)
-        dlclose(x11.library);
+    _canvas_mutex_init(&cap->lock);
+    _canvas_cond_init(&cap->work);
+    _canvas_cond_init(&cap->encoded);
+    _canvas_captures[window_id] = cap;
 
-    if (xrandr.library)
-        dlclose(xrandr.library);
+    for (uint32_t i = 0; i < CANVAS_CAPTURE_WORKERS; i++)
+    {
+        if (!_canvas_thread_start(&cap->workers[i], _canvas_capture_worker, cap))
+            break;
+        cap->worker_count++;
+    }
+
+    cap->writer_started = _canvas_thread_start(&cap->writer, _canvas_capture_writer, cap);
+
+    if (cap->worker_count == 0 || !cap->writer_started)
+    {
+        canvas_capture_stop(window_id);
+        CANVAS_RETURN_ERR(CANVAS_FAIL, "failed to start capture threads\n");
+    }
 
     CANVAS_RETURN(CANVAS_OK);
 }
 
-double canvas_get_time(canvas_time_data *time)
+int canvas_capture_stop(int window_id)
 {
     CANVAS_ENTER_FUNC();
-    CANVAS_ASSERT(time != NULL);
+    CANVAS_BOUNDS(window_id);
 
-    struct timespec ts;
-    clock_gettime(CLOCK_MONOTONIC, &ts);
+    _canvas_capture *cap = _canvas_captures[window_id];
+    if (!cap)
+        CANVAS_RETURN(CANVAS_OK);
 
-    if (ts.tv_sec < 0 || ts.tv_nsec < 0)
-        CANVAS_RETURN(0.0);
+    _canvas_mutex_lock(&cap->lock);
 
-    uint64_t now = (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+    // frames still on the gpu are dropped, queued ones are finished below
+    for (uint32_t i = 0; i < CANVAS_CAPTURE_QUEUE; i++)
+    {
+        _canvas_capture_entry *e = &cap->entries[i];
+        if (e->state != _CANVAS_CAPTURE_READING)
+            continue;
 
-    double result = (double)(now - time->start) / 1e9;
-    CANVAS_RETURN(result);
-}
+        canvas_readback_release(e->readback);
+        e->readback = NULL;
+        e->state = _CANVAS_CAPTURE_FREE;
+        cap->stats.dropped++;
+    }
 
-void canvas_sleep(double seconds)
-{
-    CANVAS_ENTER_FUNC();
+    cap->stopping = true;
+    _canvas_cond_broadcast(&cap->work);
+    _canvas_cond_broadcast(&cap->encoded);
+    _canvas_mutex_unlock(&cap->lock);
 
-    struct timespec ts;
-    ts.tv_sec = (time_t)seconds;
-    ts.tv_nsec = (long)((seconds - (double)ts.tv_sec) * 1e9);
-    clock_nanosleep(CLOCK_MONOTONIC, 0, &ts, NULL);
+    for (uint32_t i = 0; i < cap->worker_count; i++)
+        _canvas_thread_join(cap->workers[i]);
 
-    CANVAS_RETURN_VOID();
+    if (cap->writer_started)
+        _canvas_thread_join(cap->writer);
+
+    for (uint32_t i = 0; i < CANVAS_CAPTURE_QUEUE; i++)
+    {
+        if (cap->entries[i].readback)
+            canvas_readback_release(cap->entries[i].readback);
+        free(cap->entries[i].out);
+    }
+
+    int result = CANVAS_OK;
+    if (cap->file && fclose(cap->file) != 0)
+        result = CANVAS_FAIL;
+
+    _canvas_cond_destroy(&cap->work);
+    _canvas_cond_destroy(&cap->encoded);
+    _canvas_mutex_destroy(&cap->lock);
+
+    CANVAS_INFO("capture of window %d: %" PRIu64 " frames written, %" PRIu64 " dropped\n",
+                window_id, cap->stats.written, cap->stats.dropped);
+
+    free(cap);
+    _canvas_captures[window_id] = NULL;
+    CANVAS_RETURN(result);
 }
 
-void canvas_time_init(canvas_time_data *time)
+int canvas_capture_status(int window_id, canvas_capture_stats *stats)
 {
     CANVAS_ENTER_FUNC();
-    CANVAS_ASSERT(time != NULL);
-    time->frame = 0;
-    time->frame_index = 0;
-    time->accumulator = 0;
-    time->alpha = 0;
-    time->delta = 0;
-    time->fps = 0;
-    time->raw_delta = 0;
+    CANVAS_BOUNDS(window_id);
+    CANVAS_ASSERT_NOT_NULL(stats);
 
-    for (int i = 0; i < 60; i++)
-        time->times[i] = 0.0;
+    _canvas_capture *cap = _canvas_captures[window_id];
+    if (!cap || !stats)
+        CANVAS_RETURN(CANVAS_INVALID);
 
-    struct timespec ts;
-    clock_gettime(CLOCK_MONOTONIC, &ts);
-    time->start = (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
-    time->current = canvas_get_time(time);
-    time->last = time->current;
-    CANVAS_RETURN_VOID();
-}
+    _canvas_mutex_lock(&cap->lock);
+    *stats = cap->stats;
 
-#endif // _linux_
+    stats->queued = 0;
+    for (uint32_t i = 0; i < CANVAS_CAPTURE_QUEUE; i++)
+    {
+        if (cap->entries[i].state != _CANVAS_CAPTURE_FREE && cap->entries[i].state != _CANVAS_CAPTURE_WRITTEN)
+            stats->queued++;
+    }
+
+    _canvas_mutex_unlock(&cap->lock);
+    CANVAS_RETURN(CANVAS_OK);
+}
 
 bool canvas_pointer_down(canvas_pointer *p, canvas_pointer_button btn)
 {
@@ -9990,12 +17336,19 @@ int canvas_startup()
 
     int result = _canvas_platform();
 
-    if (result != CANVAS_OK)
+    if (result != CANVAS_OK && !canvas_info.headless)
         CANVAS_RETURN_ERR(result, "platform initialization failed\n");
 
-    result = _canvas_init_displays();
-    if (result < 0)
-        CANVAS_RETURN_ERR(result, "display initialization failed\n");
+    if (result != CANVAS_OK)
+    {
+        CANVAS_INFO("no display server, continuing with offscreen canvases only\n");
+    }
+    else
+    {
+        result = _canvas_init_displays();
+        if (result < 0)
+            CANVAS_RETURN_ERR(result, "display initialization failed\n");
+    }
 
     canvas_info.init = true;
 
@@ -10023,7 +17376,7 @@ void canvas_main_loop()
             continue;
 
         any_alive = true;
-        CANVAS_ASSERT_NOT_NULL(canvas_info.canvas[i].window);
+        CANVAS_ASSERT(canvas_info.canvas[i].window || canvas_info.canvas[i].offscreen);
         CANVAS_ASSERT_RANGE(canvas_info.canvas[i].index, 0, MAX_CANVAS - 1);
         CANVAS_PARANOID_CHECK();
 
@@ -10062,6 +17415,8 @@ void canvas_main_loop()
             _canvas_current_state = CANVAS_STATE_RUNNING;
 #endif
         }
+
+        _canvas_capture_frame(i);
     }
 
     _canvas_post_update();
@@ -10099,6 +17454,10 @@ int canvas_exit()
     _canvas_current_state = CANVAS_STATE_SHUTDOWN_BEGIN;
 #endif
     canvas_info.quit = 1;
+
+    for (int i = 0; i < MAX_CANVAS; i++)
+        canvas_capture_stop(i);
+
     int result = _canvas_exit();
 #if CANVAS_VALIDATION >= 5
     _canvas_current_state = CANVAS_STATE_DESTROYED;
@@ -10174,6 +17533,9 @@ int canvas_set(int window_id, int display, int64_t x, int64_t y, int64_t width,
     if (canvas_info.canvas[window_id].fullscreen) // todo: allow changing display in fullscreen
         CANVAS_RETURN(CANVAS_OK);
 
+    if (canvas_info.canvas[window_id].offscreen)
+        CANVAS_RETURN_ERR(CANVAS_INVALID, "offscreen canvas %d keeps the size it was created with\n", window_id);
+
     if (canvas_info.display_count <= 0)
         CANVAS_RETURN_ERR(CANVAS_ERR_GET_DISPLAY, "no displays available\n");
 
@@ -10253,6 +17615,7 @@ int canvas_window(int64_t x, int64_t y, int64_t width, int64_t height, const cha
     _canvas_get_window_display(result);
 
     canvas_info.canvas[result].cursor = CANVAS_CURSOR_ARROW;
+    canvas_info.canvas[result].render_scale = 1.0f;
 
     CANVAS_RETURN(result);
 }
@@ -10283,6 +17646,59 @@ int canvas(int64_t x, int64_t y, int64_t width, int64_t height, const char *titl
     CANVAS_RETURN(result);
 }
 
+int canvas_offscreen(int64_t width, int64_t height, canvas_format format)
+{
+    CANVAS_ENTER_FUNC();
+    CANVAS_PARANOID_OP("canvas_offscreen");
+    CANVAS_ASSERT_RANGE(format, CANVAS_FORMAT_RGBA8, CANVAS_FORMAT_RGBA16F);
+
+    if (width <= 0 || height <= 0)
+        CANVAS_RETURN_ERR(CANVAS_ERR_INVALID_SIZE, "invalid offscreen size\n");
+
+    // a missing display server is fine once an offscreen canvas asked for startup
+    canvas_info.headless = true;
+
+    int result = canvas_startup();
+    if (result != CANVAS_OK)
+        CANVAS_RETURN_ERR(result, "startup failed\n");
+
+    result = _canvas_gpu_init();
+    if (result != CANVAS_OK)
+        CANVAS_RETURN_ERR(result, "GPU initialization failed\n");
+
+    int window_id = _canvas_get_free();
+    if (window_id < 0)
+        CANVAS_RETURN(window_id);
+
+    canvas_type *c = &canvas_info.canvas[window_id];
+    *c = (canvas_type){0};
+#if CANVAS_VALIDATION >= 5
+    c->_canary_head = CANVAS_CANARY_HEAD;
+    c->_canary_tail = CANVAS_CANARY_TAIL;
+#endif
+    c->index = window_id;
+    c->width = width;
+    c->height = height;
+    c->offscreen = true;
+    c->render_scale = 1.0f;
+    c->cursor = CANVAS_CURSOR_ARROW;
+    c->_valid = true;
+    snprintf(c->title, MAX_CANVAS_TITLE, "offscreen %d", window_id);
+    canvas_time_init(&c->time);
+
+    canvas_color(window_id, (float[]){0.0f, 0.0f, 0.0f, 1.0f});
+
+    result = _canvas_gpu_new_offscreen(window_id, format);
+    if (result != CANVAS_OK)
+    {
+        *c = (canvas_type){0};
+        CANVAS_RETURN_ERR(result, "GPU offscreen setup failed\n");
+    }
+
+    CANVAS_PARANOID_CHECK();
+    CANVAS_RETURN(window_id);
+}
+
 int canvas_close(int window_id)
 {
     CANVAS_ENTER_FUNC();
@@ -10295,6 +17711,7 @@ int canvas_close(int window_id)
 
     canvas_info.canvas[window_id]._valid = false;
 
+    canvas_capture_stop(window_id);
     _canvas_close(window_id);
 
 #if CANVAS_VALIDATION >= 5
@@ -10352,6 +17769,49 @@ int canvas_color(int window_id, const float color[4])
     CANVAS_RETURN(CANVAS_OK);
 }
 
+int canvas_set_present_mode(int window_id, canvas_present_mode mode)
+{
+    CANVAS_ENTER_FUNC();
+    CANVAS_VALID(window_id);
+
+    if (mode < CANVAS_PRESENT_FIFO || mode > CANVAS_PRESENT_IMMEDIATE)
+        CANVAS_RETURN_ERR(CANVAS_INVALID, "invalid present mode: %d\n", mode);
+
+    canvas_info.canvas[window_id].vsync = (mode == CANVAS_PRESENT_FIFO || mode == CANVAS_PRESENT_FIFO_RELAXED);
+
+    if (canvas_info.canvas[window_id].present_mode == mode)
+        CANVAS_RETURN(CANVAS_OK);
+
+    canvas_info.canvas[window_id].present_mode = mode;
+
+    CANVAS_RETURN(_canvas_window_resize(window_id));
+}
+
+int canvas_set_render_scale(int window_id, float scale)
+{
+    CANVAS_ENTER_FUNC();
+    CANVAS_VALID(window_id);
+
+    if (!(scale > 0.0f) || scale > 1.0f)
+        CANVAS_RETURN_ERR(CANVAS_INVALID, "render scale %f out of (0, 1]\n", scale);
+
+    if (canvas_info.canvas[window_id].render_scale == scale)
+        CANVAS_RETURN(CANVAS_OK);
+
+    // only a Wayland viewport decouples the buffer from the surface size, elsewhere the scale would do nothing
+#if defined(__linux__)
+    bool scalable = _canvas_using_wayland && _canvas_data[window_id].wl_viewport;
+#else
+    bool scalable = false;
+#endif
+    if (!scalable)
+        CANVAS_RETURN_ERR(CANVAS_ERR_UNSUPPORTED, "window %d: render scale needs a Wayland viewport\n", window_id);
+
+    canvas_info.canvas[window_id].render_scale = scale;
+
+    CANVAS_RETURN(_canvas_window_resize(window_id));
+}
+
 //
 //
 // Time
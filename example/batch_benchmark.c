@@ -0,0 +1,91 @@
+#include "canvas.h"
+#include <math.h>
+
+#define PRIMITIVES 100000
+#define CHECKER_SIZE 8
+
+canvas_image *checker;
+double append_time;
+double frame_time;
+double last_update;
+uint64_t frames;
+uint64_t draws_at_report;
+double last_report;
+
+void update(int window)
+{
+        float width = (float)canvas_info.canvas[window].width;
+        float height = (float)canvas_info.canvas[window].height;
+        float t = (float)canvas_info.time.current;
+
+        canvas_color(window, (float[]){0.05f, 0.05f, 0.08f, 1.0f});
+
+        // update to update is one whole loop iteration: events, then flushing, recording,
+        // submitting and presenting the previous frame's primitives, then this callback
+        double start = canvas_get_time(&canvas_info.time);
+        if (last_update > 0.0)
+                frame_time += start - last_update;
+        last_update = start;
+
+        // a third each of rects, lines and sprites, interleaved so the batcher sees mixed state
+        for (int i = 0; i < PRIMITIVES; i++)
+        {
+                float x = fmodf(i * 37.0f + t * 20.0f, width);
+                float y = fmodf(i * 91.0f, height);
+                float color[4] = {(i & 255) / 255.0f, ((i >> 3) & 255) / 255.0f, 0.6f, 0.5f};
+
+                switch (i % 3)
+                {
+                case 0:
+                        canvas_rect(window, x, y, 6.0f, 6.0f, color);
+                        break;
+                case 1:
+                        canvas_line(window, x, y, x + 10.0f * cosf(t + i), y + 10.0f * sinf(t + i), 1.5f, color);
+                        break;
+                default:
+                        canvas_sprite(window, checker, x, y, 8.0f, 8.0f, NULL, color);
+                        break;
+                }
+        }
+
+        append_time += canvas_get_time(&canvas_info.time) - start;
+        frames++;
+
+        if (t - last_report >= 1.0)
+        {
+                uint64_t draws = canvas_info.canvas[window].stats.draws;
+
+                printf("%d primitives: %.3f ms appending, %.3f ms whole frame, %.1f draws per frame\n",
+                       PRIMITIVES,
+                       append_time * 1000.0 / frames,
+                       frame_time * 1000.0 / frames,
+                       (double)(draws - draws_at_report) / frames);
+
+                draws_at_report = draws;
+                append_time = 0.0;
+                frame_time = 0.0;
+                frames = 0;
+                last_report = t;
+        }
+}
+
+int main()
+{
+        int window = canvas(-1, -1, 1280, 720, "Batch Benchmark");
+
+        uint32_t pixels[CHECKER_SIZE * CHECKER_SIZE];
+        for (int y = 0; y < CHECKER_SIZE; y++)
+                for (int x = 0; x < CHECKER_SIZE; x++)
+                        pixels[y * CHECKER_SIZE + x] = ((x ^ y) & 1) ? 0xffffffffu : 0xff404040u;
+
+        checker = canvas_image_create(window, CHECKER_SIZE, CHECKER_SIZE, pixels);
+
+        // the primitives are scattered, regrouping them only changes which ones end up on top
+        canvas_batch_reorder(window, true);
+
+        // neither vsync nor the frame limiter may hide the frame cost
+        canvas_set_present_mode(window, CANVAS_PRESENT_IMMEDIATE);
+        canvas_info.limit_fps = 0;
+
+        return canvas_run(update);
+}